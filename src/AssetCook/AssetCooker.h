@@ -0,0 +1,457 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../Model/Model.h"
+#include "../Platform/Directory.h"
+#include "../Platform/MappedFile.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Render/ShaderPreprocessor.h"
+#include "../Texture/TextureCook.h"
+#include "../Tools/Hash.h"
+#include "../Tools/Json.h"
+#include "../Tools/Path.h"
+#include "../Tools/ThreadPool.h"
+
+enum AssetKind
+{
+	ASSET_MODEL,
+	ASSET_TEXTURE,
+	ASSET_SHADER,
+};
+
+/*
+* Cooks ahead of time what the game otherwise cooks on first load: mesh caches for models and
+* block compressed mip chains for textures, written to the same paths with the same keys, so the
+* game finds them and loads them as they are. Shaders are preprocessed, a broken include fails the
+* cook instead of the first run.
+*
+* The graph: a model references textures (through its materials, with the usage they are sampled
+* as), a shader depends on its includes. A node is re-cooked when its key changed or an output is
+* missing. The key is the content hash of the node and of the files it depends on, plus whatever
+* the output also depends on (cook versions and settings), and is kept in a manifest between runs.
+* Models are cooked first, in parallel, since cooking them discovers which textures exist and how
+* they are used. The textures and shaders then cook in parallel.
+*/
+class AssetCooker
+{
+public:
+	struct Settings
+	{
+		std::vector<std::string> m_roots = {"Assets", "src/Shaders"};
+		std::string m_manifestPath = "Assets/assetcook.manifest";
+		TextureCookSettings m_textureSettings;
+		// cooks everything, ignoring the manifest
+		bool m_isForced = false;
+	};
+
+	explicit AssetCooker(const Settings& settings) : m_settings(settings) {}
+
+	// false when any node failed to cook
+	bool Run();
+
+	static bool IsModel(const std::string& path);
+	static bool IsTexture(const std::string& path);
+	static bool IsShader(const std::string& path);
+
+private:
+	struct Reference
+	{
+		std::string m_path;
+		TextureUsage m_usage;
+	};
+
+	struct Node
+	{
+		std::string m_path;
+		AssetKind m_kind;
+		uint64_t m_key = 0;
+		// files whose content is part of the key, besides the node's own
+		std::vector<std::string> m_dependencies;
+		// textures a model uses
+		std::vector<Reference> m_references;
+		std::vector<std::string> m_outputs;
+		TextureUsage m_usage = TEXTURE_USAGE_COLOR;
+		bool m_isDirty = false;
+		bool m_hasFailed = false;
+	};
+
+	uint64_t computeKey(const Node& node) const;
+	bool isUpToDate(const Node& node, uint64_t key) const;
+	void cookNodes(std::vector<Node*>& nodes);
+	bool cookModel(Node& node);
+	bool cookTexture(Node& node);
+	// what TextureCache::Decode would cook the image to, written to cookedPath
+	bool cookImage(const uint8_t* data, size_t size, const std::string& path, TextureUsage usage, const std::string& cookedPath) const;
+	bool cookShader(Node& node);
+
+	bool readManifest();
+	bool writeManifest() const;
+
+	Node& getNode(const std::string& path, AssetKind kind);
+
+	Settings m_settings;
+	// sorted by path, the manifest comes out the same for the same inputs
+	std::map<std::string, Node> m_nodes;
+	std::map<std::string, Node> m_manifest;
+};
+
+inline bool AssetCooker::IsModel(const std::string& path)
+{
+	return HasExtension(path, ".obj") || HasExtension(path, ".gltf") || HasExtension(path, ".glb") || HasExtension(path, ".fbx") || HasExtension(path, ".dae");
+}
+
+inline bool AssetCooker::IsTexture(const std::string& path)
+{
+	// cooked files are outputs, never sources
+	if(HasExtension(path, ".cooked.ktx2"))
+		return false;
+	return HasExtension(path, ".png") || HasExtension(path, ".jpg") || HasExtension(path, ".jpeg") || HasExtension(path, ".tga") || HasExtension(path, ".bmp");
+}
+
+inline bool AssetCooker::IsShader(const std::string& path)
+{
+	return HasExtension(path, ".vert") || HasExtension(path, ".frag") || HasExtension(path, ".glsl");
+}
+
+inline AssetCooker::Node& AssetCooker::getNode(const std::string& path, AssetKind kind)
+{
+	Node& node = m_nodes[path];
+	node.m_path = path;
+	node.m_kind = kind;
+	return node;
+}
+
+inline bool AssetCooker::Run()
+{
+	PROFILE_ZONE("Asset Cook");
+	std::vector<std::string> files;
+	for(const std::string& root : m_settings.m_roots)
+		ListFiles(root, files);
+	for(const std::string& file : files)
+	{
+		const std::string path = NormalizePath(file);
+		if(IsModel(path))
+			getNode(path, ASSET_MODEL);
+		else if(IsTexture(path))
+			getNode(path, ASSET_TEXTURE);
+		else if(IsShader(path))
+			getNode(path, ASSET_SHADER);
+	}
+	if(!m_settings.m_isForced)
+		readManifest();
+
+	// models first, their references decide which textures are cooked and as what
+	std::vector<Node*> models;
+	for(auto& entry : m_nodes)
+	{
+		Node& node = entry.second;
+		if(node.m_kind != ASSET_MODEL)
+			continue;
+		auto previous = m_manifest.find(node.m_path);
+		if(previous != m_manifest.end())
+		{
+			node.m_dependencies = previous->second.m_dependencies;
+			node.m_references = previous->second.m_references;
+			node.m_outputs = previous->second.m_outputs;
+		}
+		node.m_key = computeKey(node);
+		node.m_isDirty = !isUpToDate(node, node.m_key);
+		models.push_back(&node);
+	}
+	cookNodes(models);
+
+	// a texture any material uses as a normal map is cooked as one, everything else as colour
+	for(auto& entry : m_nodes)
+	{
+		for(const Reference& reference : entry.second.m_references)
+		{
+			Node& texture = getNode(reference.m_path, ASSET_TEXTURE);
+			if(reference.m_usage == TEXTURE_USAGE_NORMAL)
+				texture.m_usage = TEXTURE_USAGE_NORMAL;
+		}
+	}
+
+	std::vector<Node*> others;
+	for(auto& entry : m_nodes)
+	{
+		Node& node = entry.second;
+		if(node.m_kind == ASSET_MODEL)
+			continue;
+		auto previous = m_manifest.find(node.m_path);
+		if(previous != m_manifest.end() && node.m_kind == ASSET_SHADER)
+			node.m_dependencies = previous->second.m_dependencies;
+		node.m_key = computeKey(node);
+		if(node.m_kind == ASSET_TEXTURE)
+			node.m_outputs = {TextureCook::GetCookedPath(node.m_path)};
+		node.m_isDirty = !isUpToDate(node, node.m_key);
+		others.push_back(&node);
+	}
+	cookNodes(others);
+
+	uint32_t cookedCount = 0, failedCount = 0;
+	for(const auto& entry : m_nodes)
+	{
+		cookedCount += entry.second.m_isDirty && !entry.second.m_hasFailed ? 1 : 0;
+		failedCount += entry.second.m_hasFailed ? 1 : 0;
+	}
+	std::cout << "Cooked " << cookedCount << " of " << m_nodes.size() << " assets, " << m_nodes.size() - cookedCount - failedCount << " up to date, "
+			  << failedCount << " failed" << std::endl;
+	writeManifest();
+	return failedCount == 0;
+}
+
+inline uint64_t AssetCooker::computeKey(const Node& node) const
+{
+	uint64_t key = 0;
+	if(node.m_kind == ASSET_MODEL)
+	{
+		// what the game keys its mesh cache on, the model and its material libraries
+		key = MeshCache::HashSource(node.m_path);
+		// a .glb's images are cooked with the model, with the texture settings
+		if(HasExtension(node.m_path, ".glb") || HasExtension(node.m_path, ".gltf"))
+			key = HashCombine(key, TextureCook::GetCookKey(0, TEXTURE_USAGE_COLOR, m_settings.m_textureSettings));
+	}
+	else
+	{
+		MappedFile file;
+		if(!file.Open(node.m_path.c_str()))
+			return 0;
+		key = HashBytes(file.GetData(), file.GetSize());
+		// what the game keys its cooked file on
+		if(node.m_kind == ASSET_TEXTURE)
+			key = TextureCook::GetCookKey(key, node.m_usage, m_settings.m_textureSettings);
+	}
+	for(const std::string& dependency : node.m_dependencies)
+	{
+		MappedFile file;
+		key = HashCombine(key, file.Open(dependency.c_str()) ? HashBytes(file.GetData(), file.GetSize()) : 0);
+	}
+	return HashCombine(key, node.m_kind);
+}
+
+inline bool AssetCooker::isUpToDate(const Node& node, uint64_t key) const
+{
+	auto previous = m_manifest.find(node.m_path);
+	if(key == 0 || previous == m_manifest.end() || previous->second.m_key != key || previous->second.m_hasFailed)
+		return false;
+	for(const std::string& output : node.m_outputs)
+	{
+		if(!IsFile(output))
+			return false;
+	}
+	return true;
+}
+
+inline void AssetCooker::cookNodes(std::vector<Node*>& nodes)
+{
+	nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [](const Node* node) { return !node->m_isDirty; }), nodes.end());
+	GetThreadPool().ParallelFor(static_cast<uint32_t>(nodes.size()), [&nodes, this](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			Node& node = *nodes[i];
+			bool isCooked = false;
+			if(node.m_kind == ASSET_MODEL)
+				isCooked = cookModel(node);
+			else if(node.m_kind == ASSET_TEXTURE)
+				isCooked = cookTexture(node);
+			else
+				isCooked = cookShader(node);
+			node.m_hasFailed = !isCooked;
+			// one write per line, workers finishing together don't interleave
+			std::cout << (isCooked ? "cooked " : "ERROR::ASSET_COOK::FAILED ") + node.m_path + "\n" << std::flush;
+		}
+	});
+}
+
+inline bool AssetCooker::cookModel(Node& node)
+{
+	const std::string directory = node.m_path.substr(0, node.m_path.find_last_of('/'));
+	node.m_references.clear();
+	node.m_outputs.clear();
+	node.m_dependencies.clear();
+	std::vector<MeshData> meshes;
+	NodeHierarchy nodes;
+	std::vector<NodeMesh> nodeMeshes;
+
+	// the same import the game runs: glTF straight from its buffers, obj by the parallel parser,
+	// the rest through Assimp
+	bool isGltfLoaded = false;
+	if(HasExtension(node.m_path, ".gltf") || HasExtension(node.m_path, ".glb"))
+	{
+		GltfScene scene;
+		const GltfLoadResult result = LoadGltf(node.m_path, scene);
+		if(result == GLTF_LOAD_FAILED)
+			return false;
+		isGltfLoaded = result == GLTF_LOAD_OK;
+		for(const GltfPrimitive& primitive : scene.m_primitives)
+		{
+			meshes.emplace_back();
+			for(const TextureRef& texture : primitive.m_textures)
+			{
+				if(!texture.m_data)
+				{
+					meshes.back().m_textures.push_back(texture);
+					continue;
+				}
+				// images inside a .glb have no file to be a texture node of their own, they are cooked
+				// here from the mapping, under the name the game caches them by
+				const TextureUsage usage = texture.m_type == "texture_normal" ? TEXTURE_USAGE_NORMAL : TEXTURE_USAGE_COLOR;
+				const std::string path = NormalizePath(directory + '/' + texture.m_path);
+				const std::string cookedPath = TextureCook::GetCookedPath(path);
+				if(std::find(node.m_outputs.begin(), node.m_outputs.end(), cookedPath) != node.m_outputs.end())
+					continue;
+				if(!cookImage(texture.m_data, texture.m_size, path, usage, cookedPath))
+					return false;
+				node.m_outputs.push_back(cookedPath);
+			}
+		}
+	}
+	if(!isGltfLoaded)
+	{
+		if(HasExtension(node.m_path, ".obj"))
+		{
+			if(!LoadObj(node.m_path, meshes))
+				return false;
+			Model::AddRootNode(static_cast<uint32_t>(meshes.size()), nodes, nodeMeshes);
+		}
+		else if(!Model::ImportAssimp(node.m_path, meshes, nodes, nodeMeshes))
+			return false;
+		const std::string cachePath = MeshCache::GetCachePath(node.m_path);
+		if(!MeshCache::Write(cachePath, MeshCache::HashSource(node.m_path), meshes, nodes, nodeMeshes))
+			return false;
+		node.m_outputs.push_back(cachePath);
+	}
+
+	for(const MeshData& mesh : meshes)
+	{
+		for(const TextureRef& texture : mesh.m_textures)
+		{
+			const TextureUsage usage = texture.m_type == "texture_normal" ? TEXTURE_USAGE_NORMAL : TEXTURE_USAGE_COLOR;
+			const std::string path = NormalizePath(directory + '/' + texture.m_path);
+			const auto isSame = [&path, usage](const Reference& reference) { return reference.m_path == path && reference.m_usage == usage; };
+			if(std::none_of(node.m_references.begin(), node.m_references.end(), isSame))
+				node.m_references.push_back({path, usage});
+		}
+	}
+	return true;
+}
+
+inline bool AssetCooker::cookTexture(Node& node)
+{
+	MappedFile file;
+	if(!file.Open(node.m_path.c_str()))
+		return false;
+	return cookImage(file.GetData(), file.GetSize(), node.m_path, node.m_usage, node.m_outputs[0]);
+}
+
+inline bool AssetCooker::cookImage(const uint8_t* data, size_t size, const std::string& path, TextureUsage usage, const std::string& cookedPath) const
+{
+	DecodedImage source;
+	if(!DecodeImageFromMemory(data, size, path, source))
+		return false;
+	const TextureFormat format = TextureCook::ChooseFormat(source, usage, m_settings.m_textureSettings);
+	DecodedImage cooked;
+	if(!TextureCook::Cook(source, usage, format, m_settings.m_textureSettings.m_mipFilter, cooked))
+		return false;
+	const uint64_t cookKey = TextureCook::GetCookKey(HashBytes(data, size), usage, m_settings.m_textureSettings);
+	return TextureCook::Write(cookedPath, cookKey, cooked);
+}
+
+inline bool AssetCooker::cookShader(Node& node)
+{
+	// without defines, the permutations only differ in which blocks are compiled
+	std::string source;
+	std::vector<ShaderDependency> dependencies;
+	if(!PreprocessShader(node.m_path, {}, source, dependencies))
+		return false;
+	node.m_dependencies.clear();
+	for(size_t i = 1; i < dependencies.size(); i++)
+		node.m_dependencies.push_back(dependencies[i].m_path);
+	// the includes are only known now, the key has to cover them for the next run
+	node.m_key = computeKey(node);
+	return true;
+}
+
+inline bool AssetCooker::readManifest()
+{
+	MappedFile file;
+	if(!file.Open(m_settings.m_manifestPath.c_str()))
+		return false;
+	JsonValue json;
+	if(!JsonValue::Parse(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), json))
+	{
+		std::cout << "ERROR::ASSET_COOK::INVALID_MANIFEST " << m_settings.m_manifestPath << std::endl;
+		return false;
+	}
+	const JsonValue& nodes = json["nodes"];
+	for(size_t i = 0; i < nodes.GetSize(); i++)
+	{
+		const JsonValue& value = nodes[i];
+		Node& node = m_manifest[value["path"].GetString()];
+		node.m_path = value["path"].GetString();
+		node.m_key = std::strtoull(value["key"].GetString().c_str(), nullptr, 16);
+		for(size_t j = 0; j < value["dependencies"].GetSize(); j++)
+			node.m_dependencies.push_back(value["dependencies"][j].GetString());
+		for(size_t j = 0; j < value["references"].GetSize(); j++)
+		{
+			const JsonValue& reference = value["references"][j];
+			node.m_references.push_back({reference["path"].GetString(), static_cast<TextureUsage>(reference["usage"].GetUint(0))});
+		}
+		for(size_t j = 0; j < value["outputs"].GetSize(); j++)
+			node.m_outputs.push_back(value["outputs"][j].GetString());
+	}
+	return true;
+}
+
+inline bool AssetCooker::writeManifest() const
+{
+	const auto quote = [](const std::string& text) {
+		std::string quoted = "\"";
+		for(char c : text)
+		{
+			if(c == '"' || c == '\\')
+				quoted += '\\';
+			quoted += c;
+		}
+		return quoted + "\"";
+	};
+	const auto list = [&quote](const std::vector<std::string>& values) {
+		std::string text = "[";
+		for(size_t i = 0; i < values.size(); i++)
+			text += (i > 0 ? ", " : "") + quote(values[i]);
+		return text + "]";
+	};
+
+	std::ofstream file(m_settings.m_manifestPath, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::ASSET_COOK::MANIFEST_NOT_WRITTEN " << m_settings.m_manifestPath << std::endl;
+		return false;
+	}
+	file << "{\n\t\"nodes\": [";
+	bool isFirst = true;
+	for(const auto& entry : m_nodes)
+	{
+		// a failed node keeps no key, it is retried next run
+		const Node& node = entry.second;
+		char key[17];
+		std::snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(node.m_hasFailed ? 0 : node.m_key));
+		file << (isFirst ? "\n" : ",\n") << "\t\t{\"path\": " << quote(node.m_path) << ", \"key\": \"" << key << "\", \"dependencies\": " << list(node.m_dependencies)
+			 << ", \"outputs\": " << list(node.m_outputs) << ", \"references\": [";
+		for(size_t i = 0; i < node.m_references.size(); i++)
+			file << (i > 0 ? ", " : "") << "{\"path\": " << quote(node.m_references[i].m_path) << ", \"usage\": " << node.m_references[i].m_usage << "}";
+		file << "]}";
+		isFirst = false;
+	}
+	file << "\n\t]\n}\n";
+	return file.good();
+}
@@ -0,0 +1,51 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "../Tools/GlExtensions.h"
+#include "AssetCooker.h"
+
+/*
+* assetcook [--root <dir>]... [--manifest <path>] [--no-texture-compression] [--mip-filter box] [--force]
+* Cooks what changed under the roots since the last run, from the working directory the game runs in.
+* The cook settings have to match the ones the game runs with or it cooks everything again itself.
+*/
+int main(int argc, char* argv[])
+{
+	AssetCooker::Settings settings;
+	bool hasRoots = false;
+	for(int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "--root") == 0 && hasValue)
+		{
+			// the first root given replaces the defaults
+			if(!hasRoots)
+				settings.m_roots.clear();
+			hasRoots = true;
+			settings.m_roots.push_back(argv[++i]);
+		}
+		else if(std::strcmp(argv[i], "--manifest") == 0 && hasValue)
+			settings.m_manifestPath = argv[++i];
+		else if(std::strcmp(argv[i], "--no-texture-compression") == 0)
+			settings.m_textureSettings.m_isCompressionEnabled = false;
+		else if(std::strcmp(argv[i], "--mip-filter") == 0 && hasValue)
+			settings.m_textureSettings.m_mipFilter = std::strcmp(argv[++i], "box") == 0 ? MIP_FILTER_BOX : MIP_FILTER_KAISER;
+		else if(std::strcmp(argv[i], "--force") == 0)
+			settings.m_isForced = true;
+		else
+		{
+			std::cout << "ERROR::COMMAND_LINE::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	// no GL context here, the cook targets desktop GPUs. A GPU that can't sample the formats
+	// rejects the cooked files and the game cooks them again for itself
+	GlExtensions& extensions = GetGlExtensions();
+	extensions.m_hasS3tc = true;
+	extensions.m_hasBptc = true;
+
+	const bool isCooked = AssetCooker(settings).Run();
+	return isCooked ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,4 +1,36 @@
 ﻿#pragma once
+
+#include <cstdint>
+
+// keys the cameras poll every frame, packed into one mask so the held state can be recorded and replayed
+enum CameraKey : uint32_t
+{
+	CAMERA_KEY_UP = 1 << 0,
+	CAMERA_KEY_DOWN = 1 << 1,
+	CAMERA_KEY_LEFT = 1 << 2,
+	CAMERA_KEY_RIGHT = 1 << 3,
+	CAMERA_KEY_ASCEND = 1 << 4,
+	CAMERA_KEY_DESCEND = 1 << 5,
+	CAMERA_KEY_SPEED_BOOST = 1 << 6,
+};
+
+// what the renderer needs from a camera, kept per simulation step so frames can interpolate between steps
+struct CameraState
+{
+	glm::vec3 m_pos;
+	glm::vec3 m_front;
+	glm::vec3 m_up;
+};
+
+inline CameraState InterpolateCameraState(const CameraState& previous, const CameraState& current, float alpha)
+{
+	CameraState state;
+	state.m_pos = glm::mix(previous.m_pos, current.m_pos, alpha);
+	state.m_front = glm::normalize(glm::mix(previous.m_front, current.m_front, alpha));
+	state.m_up = glm::normalize(glm::mix(previous.m_up, current.m_up, alpha));
+	return state;
+}
+
 class Camera
 {
 public:
@@ -8,9 +40,17 @@ public:
 	virtual void MouseCallback(double xPos, double yPos) = 0;
 	virtual void KeyDown(int glfwKey) = 0;
 	virtual void KeyUp(int glfwKey) = 0;
-	virtual void ProcessInput(GLFWwindow* window) = 0;
+	virtual uint32_t PollKeyStates(GLFWwindow* window) const = 0;
+	virtual void SetKeyStates(uint32_t keyStates) = 0;
 	virtual void Update(float deltaTime) = 0;
 
 	virtual void GetCameraProperties(glm::vec3& pos, glm::vec3& front, glm::vec3& up) const = 0;
 	virtual float GetFov() const = 0;
+
+	CameraState GetState() const
+	{
+		CameraState state;
+		GetCameraProperties(state.m_pos, state.m_front, state.m_up);
+		return state;
+	}
 };
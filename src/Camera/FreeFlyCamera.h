@@ -10,7 +10,8 @@ public:
 	~FreeFlyCamera();
 
 	virtual void MouseCallback(double xPos, double yPos);
-	virtual void ProcessInput(GLFWwindow* window);
+	virtual uint32_t PollKeyStates(GLFWwindow* window) const;
+	virtual void SetKeyStates(uint32_t keyStates);
 	virtual void Update(float deltaTime);
 	virtual void KeyDown(int glfwKey) {};
 	virtual void KeyUp(int glfwKey) {};
@@ -97,15 +98,35 @@ inline void FreeFlyCamera::MouseCallback(double xPos, double yPos)
 		m_pitch = -PITCH_MAX;
 }
 
-inline void FreeFlyCamera::ProcessInput(GLFWwindow* window)
+inline uint32_t FreeFlyCamera::PollKeyStates(GLFWwindow* window) const
 {
-	m_isUpKeyPressed = glfwGetKey(window, UP_KEY) == GLFW_PRESS;
-	m_isDownKeyPressed = glfwGetKey(window, DOWN_KEY) == GLFW_PRESS;
-	m_isLeftKeyPressed = glfwGetKey(window, LEFT_KEY) == GLFW_PRESS;
-	m_isRightKeyPressed = glfwGetKey(window, RIGHT_KEY) == GLFW_PRESS;
-	m_isAscendKeyPressed = glfwGetKey(window, ASCEND_KEY) == GLFW_PRESS;
-	m_isDescendKeyPressed = glfwGetKey(window, DESCEND_KEY) == GLFW_PRESS;
-	m_isBoostKeyPressed = glfwGetKey(window, SPEED_BOOST_KEY) == GLFW_PRESS;
+	uint32_t keyStates = 0;
+	if(glfwGetKey(window, UP_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_UP;
+	if(glfwGetKey(window, DOWN_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_DOWN;
+	if(glfwGetKey(window, LEFT_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_LEFT;
+	if(glfwGetKey(window, RIGHT_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_RIGHT;
+	if(glfwGetKey(window, ASCEND_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_ASCEND;
+	if(glfwGetKey(window, DESCEND_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_DESCEND;
+	if(glfwGetKey(window, SPEED_BOOST_KEY) == GLFW_PRESS)
+		keyStates |= CAMERA_KEY_SPEED_BOOST;
+	return keyStates;
+}
+
+inline void FreeFlyCamera::SetKeyStates(uint32_t keyStates)
+{
+	m_isUpKeyPressed = (keyStates & CAMERA_KEY_UP) != 0;
+	m_isDownKeyPressed = (keyStates & CAMERA_KEY_DOWN) != 0;
+	m_isLeftKeyPressed = (keyStates & CAMERA_KEY_LEFT) != 0;
+	m_isRightKeyPressed = (keyStates & CAMERA_KEY_RIGHT) != 0;
+	m_isAscendKeyPressed = (keyStates & CAMERA_KEY_ASCEND) != 0;
+	m_isDescendKeyPressed = (keyStates & CAMERA_KEY_DESCEND) != 0;
+	m_isBoostKeyPressed = (keyStates & CAMERA_KEY_SPEED_BOOST) != 0;
 }
 
 inline void FreeFlyCamera::Update(float deltaTime)
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "Camera.h"
+
+/*
+* Binary capture of everything a Camera is fed: mouse positions, key presses and releases, the
+* held key mask polled every frame and the delta time passed to Update.
+*
+* Layout: 8 byte header (magic "CINP", uint16 version, uint16 reserved) followed by events.
+* Every event is a uint8 type, a uint32 with the microseconds since the previous event and a
+* type specific payload, all little endian. A frame ends with its FRAME event, so replaying up
+* to and including it reproduces exactly what the camera saw before that Update.
+*/
+namespace InputRecording
+{
+	constexpr char MAGIC[4] = {'C', 'I', 'N', 'P'};
+	constexpr uint16_t VERSION = 1;
+	constexpr size_t HEADER_SIZE = 8;
+
+	enum EventType : uint8_t
+	{
+		EVENT_MOUSE = 1,	  // double x, double y
+		EVENT_KEY_DOWN = 2,	  // int16 glfw key
+		EVENT_KEY_UP = 3,	  // int16 glfw key
+		EVENT_KEY_STATES = 4, // uint16 CameraKey mask, only written when it changed
+		EVENT_FRAME = 5,	  // float delta time
+	};
+}
+
+class InputRecorder
+{
+public:
+	~InputRecorder() { Close(); }
+
+	bool Open(const char* path);
+	void Close();
+	bool IsRecording() const { return m_file.is_open(); }
+
+	void RecordMouse(double xPos, double yPos);
+	void RecordKeyDown(int glfwKey);
+	void RecordKeyUp(int glfwKey);
+	void RecordKeyStates(uint32_t keyStates);
+	void RecordFrame(float deltaTime);
+
+private:
+	void WriteEvent(InputRecording::EventType type, const void* payload, size_t payloadSize);
+
+	std::ofstream m_file;
+	uint64_t m_lastEventNs = 0;
+	uint32_t m_lastKeyStates = 0;
+	uint64_t m_frameCount = 0;
+};
+
+class InputReplayer
+{
+public:
+	bool Open(const char* path);
+
+	// 0 replays the recorded delta times, anything else replaces them
+	void SetFixedDeltaTime(float deltaTime) { m_fixedDeltaTime = deltaTime; }
+
+	// feeds the camera everything recorded for the next frame and returns the delta time to update it with
+	float ReplayFrame(Camera& camera);
+	bool IsFinished() const { return m_readOffset >= m_data.size(); }
+
+	uint64_t GetFrameCount() const { return m_frameCount; }
+	// recording time of the last replayed event, in seconds since the recording started
+	double GetRecordedTime() const { return m_recordedUs * 1e-6; }
+
+private:
+	template<typename T>
+	bool Read(T& value);
+
+	std::vector<uint8_t> m_data;
+	size_t m_readOffset = 0;
+	uint64_t m_frameCount = 0;
+	uint64_t m_recordedUs = 0;
+	float m_fixedDeltaTime = 0.0f;
+};
+
+//----------InputRecorder
+inline bool InputRecorder::Open(const char* path)
+{
+	m_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!m_file.is_open())
+	{
+		std::cout << "ERROR::INPUT_RECORDER::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	uint8_t header[InputRecording::HEADER_SIZE] = {};
+	std::memcpy(header, InputRecording::MAGIC, sizeof(InputRecording::MAGIC));
+	header[4] = static_cast<uint8_t>(InputRecording::VERSION & 0xFF);
+	header[5] = static_cast<uint8_t>(InputRecording::VERSION >> 8);
+	m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+	m_lastEventNs = CpuProfiler::NowNs();
+	m_lastKeyStates = 0;
+	m_frameCount = 0;
+	return true;
+}
+
+inline void InputRecorder::Close()
+{
+	if(!m_file.is_open())
+		return;
+	m_file.close();
+	std::cout << "Input recording closed, " << m_frameCount << " frames" << std::endl;
+}
+
+inline void InputRecorder::RecordMouse(double xPos, double yPos)
+{
+	const double payload[2] = {xPos, yPos};
+	WriteEvent(InputRecording::EVENT_MOUSE, payload, sizeof(payload));
+}
+
+inline void InputRecorder::RecordKeyDown(int glfwKey)
+{
+	const int16_t key = static_cast<int16_t>(glfwKey);
+	WriteEvent(InputRecording::EVENT_KEY_DOWN, &key, sizeof(key));
+}
+
+inline void InputRecorder::RecordKeyUp(int glfwKey)
+{
+	const int16_t key = static_cast<int16_t>(glfwKey);
+	WriteEvent(InputRecording::EVENT_KEY_UP, &key, sizeof(key));
+}
+
+inline void InputRecorder::RecordKeyStates(uint32_t keyStates)
+{
+	if(keyStates == m_lastKeyStates)
+		return;
+	m_lastKeyStates = keyStates;
+	const uint16_t states = static_cast<uint16_t>(keyStates);
+	WriteEvent(InputRecording::EVENT_KEY_STATES, &states, sizeof(states));
+}
+
+inline void InputRecorder::RecordFrame(float deltaTime)
+{
+	WriteEvent(InputRecording::EVENT_FRAME, &deltaTime, sizeof(deltaTime));
+	if(m_file.is_open())
+		m_frameCount++;
+}
+
+inline void InputRecorder::WriteEvent(InputRecording::EventType type, const void* payload, size_t payloadSize)
+{
+	if(!m_file.is_open())
+		return;
+
+	const uint64_t nowNs = CpuProfiler::NowNs();
+	const uint64_t sinceLastUs = (nowNs - m_lastEventNs) / 1000;
+	// only advance by whole microseconds so rounding doesn't accumulate over a long recording
+	m_lastEventNs += sinceLastUs * 1000;
+	const uint32_t deltaUs = sinceLastUs > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(sinceLastUs);
+
+	uint8_t event[1 + sizeof(uint32_t) + 2 * sizeof(double)];
+	event[0] = type;
+	std::memcpy(event + 1, &deltaUs, sizeof(deltaUs));
+	std::memcpy(event + 1 + sizeof(deltaUs), payload, payloadSize);
+	m_file.write(reinterpret_cast<const char*>(event), 1 + sizeof(deltaUs) + payloadSize);
+}
+//==========InputRecorder
+
+//----------InputReplayer
+inline bool InputReplayer::Open(const char* path)
+{
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::INPUT_REPLAYER::OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	m_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+	uint16_t version = 0;
+	if(m_data.size() >= InputRecording::HEADER_SIZE)
+		version = static_cast<uint16_t>(m_data[4] | (m_data[5] << 8));
+	if(m_data.size() < InputRecording::HEADER_SIZE || std::memcmp(m_data.data(), InputRecording::MAGIC, sizeof(InputRecording::MAGIC)) != 0
+	   || version != InputRecording::VERSION)
+	{
+		std::cout << "ERROR::INPUT_REPLAYER::BAD_HEADER " << path << std::endl;
+		m_data.clear();
+		return false;
+	}
+
+	// count frames up front so callers know how long the replay runs
+	m_frameCount = 0;
+	size_t offset = InputRecording::HEADER_SIZE;
+	while(offset < m_data.size())
+	{
+		const uint8_t type = m_data[offset];
+		offset += 1 + sizeof(uint32_t);
+		switch(type)
+		{
+			case InputRecording::EVENT_MOUSE: offset += 2 * sizeof(double); break;
+			case InputRecording::EVENT_KEY_DOWN:
+			case InputRecording::EVENT_KEY_UP: offset += sizeof(int16_t); break;
+			case InputRecording::EVENT_KEY_STATES: offset += sizeof(uint16_t); break;
+			case InputRecording::EVENT_FRAME: offset += sizeof(float); m_frameCount++; break;
+			default:
+				std::cout << "ERROR::INPUT_REPLAYER::UNKNOWN_EVENT " << static_cast<int>(type) << " in " << path << std::endl;
+				m_data.clear();
+				return false;
+		}
+	}
+
+	m_readOffset = InputRecording::HEADER_SIZE;
+	m_recordedUs = 0;
+	std::cout << "Replaying input from " << path << ", " << m_frameCount << " frames" << std::endl;
+	return true;
+}
+
+template<typename T>
+inline bool InputReplayer::Read(T& value)
+{
+	if(m_readOffset + sizeof(T) > m_data.size())
+	{
+		m_readOffset = m_data.size();
+		return false;
+	}
+	std::memcpy(&value, m_data.data() + m_readOffset, sizeof(T));
+	m_readOffset += sizeof(T);
+	return true;
+}
+
+inline float InputReplayer::ReplayFrame(Camera& camera)
+{
+	while(!IsFinished())
+	{
+		uint8_t type = 0;
+		uint32_t deltaUs = 0;
+		if(!Read(type) || !Read(deltaUs))
+			break;
+		m_recordedUs += deltaUs;
+
+		switch(type)
+		{
+			case InputRecording::EVENT_MOUSE:
+			{
+				double pos[2];
+				if(Read(pos))
+					camera.MouseCallback(pos[0], pos[1]);
+				break;
+			}
+			case InputRecording::EVENT_KEY_DOWN:
+			{
+				int16_t key;
+				if(Read(key))
+					camera.KeyDown(key);
+				break;
+			}
+			case InputRecording::EVENT_KEY_UP:
+			{
+				int16_t key;
+				if(Read(key))
+					camera.KeyUp(key);
+				break;
+			}
+			case InputRecording::EVENT_KEY_STATES:
+			{
+				uint16_t keyStates;
+				if(Read(keyStates))
+					camera.SetKeyStates(keyStates);
+				break;
+			}
+			case InputRecording::EVENT_FRAME:
+			{
+				float deltaTime = 0.0f;
+				Read(deltaTime);
+				return m_fixedDeltaTime > 0.0f ? m_fixedDeltaTime : deltaTime;
+			}
+			default:
+				m_readOffset = m_data.size();
+				break;
+		}
+	}
+	// trailing input after the last frame, nothing left to update with
+	return 0.0f;
+}
+//==========InputReplayer
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "../Common.h"
+#include "Camera.h"
+
+/*
+* Camera that follows a looping keyframed path and ignores all input.
+* Driven with a fixed delta time it visits exactly the same views every run, which is what
+* the benchmark needs.
+*/
+class ScriptedCamera : public Camera
+{
+public:
+	struct Keyframe
+	{
+		float m_time;
+		glm::vec3 m_pos;
+		float m_yaw;
+		float m_pitch;
+	};
+
+	ScriptedCamera();
+	explicit ScriptedCamera(const std::vector<Keyframe>& keyframes);
+	~ScriptedCamera();
+
+	virtual void MouseCallback(double /*xPos*/, double /*yPos*/) {};
+	virtual uint32_t PollKeyStates(GLFWwindow* /*window*/) const { return 0; }
+	virtual void SetKeyStates(uint32_t /*keyStates*/) {};
+	virtual void Update(float deltaTime);
+	virtual void KeyDown(int /*glfwKey*/) {};
+	virtual void KeyUp(int /*glfwKey*/) {};
+
+	virtual void GetCameraProperties(glm::vec3& pos, glm::vec3& front, glm::vec3& up) const;
+	virtual float GetFov() const { return m_fov; }
+
+	float GetDuration() const { return m_keyframes.empty() ? 0.0f : m_keyframes.back().m_time; }
+
+private:
+	// settings
+	const float FOV_DEFAULT = 45.0f;
+	const glm::vec3 UP = glm::vec3(0.0f, 1.0f, 0.0f);
+
+	// variables
+	std::vector<Keyframe> m_keyframes;
+	float m_time = 0.0f;
+	float m_fov = FOV_DEFAULT;
+
+	glm::vec3 m_pos = glm::vec3(0.0f);
+	glm::vec3 m_front = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+inline ScriptedCamera::ScriptedCamera()
+	: ScriptedCamera({
+		// low pass over the container floor, around the backpack and back, 20 seconds per loop
+		{0.0f,  glm::vec3(0.0f, 2.0f, 10.0f),    -90.0f, -10.0f},
+		{4.0f,  glm::vec3(-8.0f, 4.0f, 2.0f),    -45.0f, -20.0f},
+		{8.0f,  glm::vec3(-2.0f, 3.0f, 2.0f),    -90.0f, -15.0f},
+		{12.0f, glm::vec3(6.0f, 8.0f, -6.0f),    200.0f, -35.0f},
+		{16.0f, glm::vec3(20.0f, 12.0f, 20.0f),  225.0f, -25.0f},
+		{20.0f, glm::vec3(0.0f, 2.0f, 10.0f),    270.0f, -10.0f},
+	})
+{
+}
+
+inline ScriptedCamera::ScriptedCamera(const std::vector<Keyframe>& keyframes)
+	: m_keyframes(keyframes)
+{
+	Update(0.0f);
+}
+
+inline ScriptedCamera::~ScriptedCamera()
+{
+}
+
+inline void ScriptedCamera::Update(float deltaTime)
+{
+	if(m_keyframes.empty())
+		return;
+
+	const float duration = GetDuration();
+	m_time += deltaTime;
+	if(duration > 0.0f)
+		m_time = std::fmod(m_time, duration);
+
+	size_t next = 1;
+	while(next < m_keyframes.size() - 1 && m_keyframes[next].m_time < m_time)
+		next++;
+	const size_t prev = next > 0 ? next - 1 : 0;
+	next = std::min(next, m_keyframes.size() - 1);
+
+	const Keyframe& a = m_keyframes[prev];
+	const Keyframe& b = m_keyframes[next];
+	const float span = b.m_time - a.m_time;
+	float t = span > 0.0f ? (m_time - a.m_time) / span : 0.0f;
+	t = glm::clamp(t, 0.0f, 1.0f);
+	// ease in/out so the camera doesn't jerk at keyframes
+	t = t * t * (3.0f - 2.0f * t);
+
+	m_pos = glm::mix(a.m_pos, b.m_pos, t);
+	const float yawF = glm::mix(a.m_yaw, b.m_yaw, t);
+	const float pitchF = glm::mix(a.m_pitch, b.m_pitch, t);
+
+	glm::vec3 direction;
+	direction.x = cos(glm::radians(yawF)) * cos(glm::radians(pitchF));
+	direction.y = sin(glm::radians(pitchF));
+	direction.z = sin(glm::radians(yawF)) * cos(glm::radians(pitchF));
+	m_front = glm::normalize(direction);
+}
+
+inline void ScriptedCamera::GetCameraProperties(glm::vec3& pos, glm::vec3& front, glm::vec3& up) const
+{
+	pos = m_pos;
+	front = m_front;
+	up = UP;
+}
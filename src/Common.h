@@ -1,6 +1,84 @@
 ﻿#pragma once
 
+#include <vector>
+
 //#define FULLSCREEN // uncomment to full screen
 
 constexpr int SCRWIDTH = 960;
-constexpr int SCRHEIGHT = 540;
\ No newline at end of file
+constexpr int SCRHEIGHT = 540;
+
+constexpr int CONTAINER_GRID_SIZE = 50;
+constexpr int BACKPACK_COUNT = 1;
+
+// simulation steps per second, rendering interpolates in between
+constexpr int SIMULATION_RATE = 60;
+
+// time per frame the GL thread may spend on uploads from async loads
+constexpr double UPLOAD_BUDGET_MS = 2.0;
+// gpu memory textures may use before streamed levels are evicted, 0 loads every level and never evicts
+constexpr double TEXTURE_BUDGET_MB = 512.0;
+// tracked memory (MemoryStats) above which a warning is printed and the overlay turns red, 0 is unlimited
+constexpr double GPU_MEMORY_BUDGET_MB = 1024.0;
+constexpr double CPU_MEMORY_BUDGET_MB = 512.0;
+
+/*
+* Runtime settings, defaulted from the constants above and overridden from the command line.
+*/
+struct AppSettings
+{
+	int m_width = SCRWIDTH;
+	int m_height = SCRHEIGHT;
+	// containers per side of the floor grid
+	int m_containerGridSize = CONTAINER_GRID_SIZE;
+	int m_backpackCount = BACKPACK_COUNT;
+	int m_simulationRate = SIMULATION_RATE;
+	double m_uploadBudgetMs = UPLOAD_BUDGET_MS;
+	double m_textureBudgetMb = TEXTURE_BUDGET_MB;
+	double m_gpuMemoryBudgetMb = GPU_MEMORY_BUDGET_MB;
+	double m_cpuMemoryBudgetMb = CPU_MEMORY_BUDGET_MB;
+	// cook textures to block compressed formats, off keeps the cooked mip chain uncompressed
+	bool m_compressTextures = true;
+	// mip filter of cooked textures, Kaiser unless set
+	bool m_useBoxMipFilter = false;
+
+	// headless benchmark
+	bool m_isHeadless = false;
+	int m_benchmarkFrames = 600;
+	float m_benchmarkDeltaTime = 1.0f / 60.0f;
+	// follow the scripted camera path instead of the input driven camera, implied by headless
+	bool m_useScriptedCamera = false;
+
+	// model to time the Assimp and obj importers on instead of running the scene
+	const char* m_importBenchmarkPath = nullptr;
+	// cold and warm starts of the app to time instead of running the scene, each a run of this
+	// executable that quits after its first frame with the scene drawn
+	int m_startupBenchmarkRuns = 0;
+	// quit once the startup report is complete
+	bool m_isStartupOnly = false;
+
+	// archives mounted at startup in order, each replaces the files of the ones before and the loose files
+	std::vector<const char*> m_archivePaths;
+	// directory to pack into m_packOutputPath instead of running the scene
+	const char* m_packDirectory = nullptr;
+	const char* m_packOutputPath = nullptr;
+
+	// camera input capture, replay takes over from live input
+	const char* m_inputRecordPath = nullptr;
+	const char* m_inputReplayPath = nullptr;
+	// 0 replays the recorded delta times
+	float m_replayDeltaTime = 0.0f;
+
+	// output paths, null when not requested
+	const char* m_reportPath = nullptr;
+	const char* m_startupReportPath = nullptr;
+	const char* m_gpuCsvPath = nullptr;
+	const char* m_cpuTracePath = nullptr;
+	const char* m_frameStatsPath = nullptr;
+	double m_hitchFactor = 2.0;
+};
+
+inline AppSettings& GetAppSettings()
+{
+	static AppSettings settings;
+	return settings;
+}
@@ -2,7 +2,11 @@
 #include <assimp/types.h>
 #include <vector>
 
+#include "../Profiling/MemoryStats.h"
+#include "../Render/GlBuffer.h"
+#include "../Render/ShaderVariants.h"
 #include "../Shader.h"
+#include "../Texture/TextureCache.h"
 
 struct Vertex
 {
@@ -13,76 +17,257 @@ struct Vertex
 
 struct Texture
 {
-	unsigned int m_id;
+	// keeps the shared texture alive, the GL id is read through it at draw time
+	TextureHandle m_handle;
 	std::string m_type;
 	aiString m_path;
+	// uniform it is sampled through (texture_diffuse1, ...), set by the mesh it is given to
+	std::string m_sampler;
 };
 
+// texture a mesh uses, before it is loaded
+struct TextureRef
+{
+	std::string m_type;
+	std::string m_path;
+	// set for an image inside the model file (a .glb buffer view), m_path is then only the name it
+	// is cached under. Points into the model's mapping, valid while the model loads
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// cpu side result of importing a mesh, everything needed to build a Mesh without touching GL
+struct MeshData
+{
+	std::vector<Vertex>       m_vertices;
+	std::vector<unsigned int> m_indices;
+	std::vector<TextureRef>   m_textures;
+};
+
+// what happens to the cpu copy of the vertices and indices once they are on the gpu
+enum GeometryPolicy
+{
+	GEOMETRY_DROP_AFTER_UPLOAD,
+	// kept for cpu side queries, e.g. collision, and counted as MEMORY_CPU_GEOMETRY
+	GEOMETRY_KEEP,
+};
+
+// one vertex attribute read straight from a buffer, in whatever layout the buffer has
+struct VertexAttributeBinding
+{
+	// 0 leaves the attribute disabled, it then reads as (0, 0, 0, 1)
+	unsigned int m_buffer = 0;
+	size_t m_offset = 0;
+	// 0 is tightly packed
+	GLsizei m_stride = 0;
+	GLint m_componentCount = 0;
+	GLenum m_componentType = GL_FLOAT;
+	GLboolean m_isNormalized = GL_FALSE;
+};
+
+// a mesh whose data is already in GL buffers someone else owns, e.g. glTF buffer views
+struct MeshBufferLayout
+{
+	// position, normal and texture coordinates, the attribute locations of the shaders
+	VertexAttributeBinding m_attributes[3];
+	// 0 draws the vertices in order
+	unsigned int m_indexBuffer = 0;
+	size_t m_indexOffset = 0;
+	GLenum m_indexType = GL_UNSIGNED_INT;
+	// indices, or vertices without an index buffer
+	unsigned int m_count = 0;
+};
+
+// first of the four vec4 attributes the per instance transform is read from, FEATURE_INSTANCED
+constexpr GLuint INSTANCE_TRANSFORM_LOCATION = 3;
+
+// a mesh drawn with a transform of its own, e.g. from the node referencing it
+struct MeshInstance
+{
+	uint32_t m_mesh;
+	glm::mat4 m_transform;
+};
+
+inline void ComputeBounds(const Vertex* vertices, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+	boundsMin = boundsMax = vertexCount > 0 ? vertices[0].m_position : glm::vec3(0.0f);
+	for(size_t i = 1; i < vertexCount; i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[i].m_position);
+		boundsMax = glm::max(boundsMax, vertices[i].m_position);
+	}
+}
+
 class Mesh
 {
 public:
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
-	void Draw(Shader& shader);
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures,
+		 GeometryPolicy policy = GEOMETRY_DROP_AFTER_UPLOAD);
+	// uploads straight from memory the caller owns (e.g. a mapped mesh cache), copied only to keep it
+	Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, std::vector<Texture> textures,
+		 const glm::vec3& boundsMin, const glm::vec3& boundsMax, GeometryPolicy policy = GEOMETRY_DROP_AFTER_UPLOAD);
+	// GL thread only, the buffers have to outlive the mesh
+	Mesh(const MeshBufferLayout& layout, std::vector<Texture> textures, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	// more than one instance draws instanced, each with its own transform from SetInstanceTransforms
+	void Draw(Shader& shader, GLsizei instanceCount = 1);
+	// GL thread only, reads the instance transforms as glm::mat4 from buffer at offset, one per instance
+	void SetInstanceTransforms(unsigned int buffer, size_t offset);
+	// ShaderMaterialFlag bits for the textures the mesh has
+	uint32_t GetMaterialFlags() const;
 
-	// mesh data
+	// mesh data, the vertex and index vectors are empty unless the mesh was made with GEOMETRY_KEEP
 	std::vector<Vertex>       m_vertices;
 	std::vector<unsigned int> m_indices;
 	std::vector<Texture>      m_textures;
+	unsigned int              m_indexCount = 0;
+	GLenum                    m_indexType = GL_UNSIGNED_INT;
+	size_t                    m_indexOffset = 0;
+	bool                      m_isIndexed = true;
+	glm::vec3                 m_boundsMin = glm::vec3(0.0f);
+	glm::vec3                 m_boundsMax = glm::vec3(0.0f);
 
 private:
 	//  render data
-	unsigned int VAO, VBO, EBO;
+	// the buffers stay empty when they aren't the mesh's own
+	GlVertexArray m_vertexArray;
+	GlBuffer m_vertexBuffer{MEMORY_GPU_MESH};
+	GlBuffer m_indexBuffer{MEMORY_GPU_MESH};
+	TrackedAllocation m_geometryMemory;
 
-	void SetupMesh();
+	void SetupMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount);
+	// numbers the textures of each type in order, once instead of per draw
+	void nameSamplers();
+	void KeepGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
 };
 
-inline Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures)
+inline Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, GeometryPolicy policy)
+{
+	m_textures = std::move(textures);
+	nameSamplers();
+
+	ComputeBounds(vertices.data(), vertices.size(), m_boundsMin, m_boundsMax);
+
+	SetupMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+	// otherwise freed right here, the gpu has its copy
+	if(policy == GEOMETRY_KEEP)
+		KeepGeometry(std::move(vertices), std::move(indices));
+}
+
+inline Mesh::Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, std::vector<Texture> textures,
+				  const glm::vec3& boundsMin, const glm::vec3& boundsMax, GeometryPolicy policy)
 {
-	m_vertices = vertices;
-	m_indices = indices;
 	m_textures = textures;
+	nameSamplers();
+	m_boundsMin = boundsMin;
+	m_boundsMax = boundsMax;
 
-	SetupMesh();
+	SetupMesh(vertices, vertexCount, indices, indexCount);
+	if(policy == GEOMETRY_KEEP)
+		KeepGeometry(std::vector<Vertex>(vertices, vertices + vertexCount), std::vector<unsigned int>(indices, indices + indexCount));
 }
 
-inline void Mesh::Draw(Shader& shader)
+inline Mesh::Mesh(const MeshBufferLayout& layout, std::vector<Texture> textures, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
 {
-	unsigned int diffuseNr = 1;
-	unsigned int specularNr = 1;
-	for(unsigned int i = 0; i < m_textures.size(); i++)
+	m_textures = std::move(textures);
+	nameSamplers();
+	m_boundsMin = boundsMin;
+	m_boundsMax = boundsMax;
+	m_indexCount = layout.m_count;
+	m_indexType = layout.m_indexType;
+	m_indexOffset = layout.m_indexOffset;
+	m_isIndexed = layout.m_indexBuffer != 0;
+
+	m_vertexArray.Bind();
+	for(GLuint location = 0; location < 3; location++)
+	{
+		const VertexAttributeBinding& attribute = layout.m_attributes[location];
+		if(attribute.m_buffer == 0)
+			continue;
+		glBindBuffer(GL_ARRAY_BUFFER, attribute.m_buffer);
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, attribute.m_componentCount, attribute.m_componentType, attribute.m_isNormalized, attribute.m_stride,
+							  reinterpret_cast<void*>(attribute.m_offset));
+	}
+	if(m_isIndexed)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, layout.m_indexBuffer);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+inline uint32_t Mesh::GetMaterialFlags() const
+{
+	uint32_t flags = 0;
+	for(const Texture& texture : m_textures)
+	{
+		if(texture.m_type == "texture_diffuse")
+			flags |= MATERIAL_DIFFUSE_MAP;
+		else if(texture.m_type == "texture_specular")
+			flags |= MATERIAL_SPECULAR_MAP;
+	}
+	return flags;
+}
+
+inline void Mesh::Draw(Shader& shader, GLsizei instanceCount)
+{
+	for(const Texture& texture : m_textures)
 	{
-		glActiveTexture(GL_TEXTURE0 + i);
-		std::string number;
-		std::string name = m_textures[i].m_type;
-		if(name == "texture_diffuse")
-			number = std::to_string(diffuseNr++);
-		else if(name == "texture_specular")
-			number = std::to_string(specularNr++);
-
-		shader.SetInt(name + number, i);
-		glBindTexture(GL_TEXTURE_2D, m_textures[i].m_id);
+		glActiveTexture(GL_TEXTURE0 + shader.GetSamplerUnit(texture.m_sampler));
+		glBindTexture(GL_TEXTURE_2D, texture.m_handle.GetId());
 	}
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(m_indices.size()), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(m_vertexArray.GetId());
+	if(m_isIndexed)
+		glDrawElementsInstanced(GL_TRIANGLES, m_indexCount, m_indexType, reinterpret_cast<void*>(m_indexOffset), instanceCount);
+	else
+		glDrawArraysInstanced(GL_TRIANGLES, 0, m_indexCount, instanceCount);
 	glBindVertexArray(0);
 
+	RenderStats& stats = GetRenderStats();
+	stats.m_textureBinds += static_cast<uint32_t>(m_textures.size());
+	stats.m_vertexArrayBinds++;
+	stats.m_drawCalls++;
+	stats.m_triangles += static_cast<uint64_t>(m_indexCount / 3) * static_cast<uint64_t>(instanceCount);
+
 	glActiveTexture(GL_TEXTURE0);
 }
 
-inline void Mesh::SetupMesh()
+inline void Mesh::SetInstanceTransforms(unsigned int buffer, size_t offset)
 {
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	m_vertexArray.Bind();
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	// a mat4 attribute takes one location per column
+	for(GLuint column = 0; column < 4; column++)
+	{
+		const GLuint location = INSTANCE_TRANSFORM_LOCATION + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), reinterpret_cast<void*>(offset + column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+	}
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+inline void Mesh::nameSamplers()
+{
+	unsigned int diffuseNr = 1;
+	unsigned int specularNr = 1;
+	for(Texture& texture : m_textures)
+	{
+		texture.m_sampler = texture.m_type;
+		if(texture.m_type == "texture_diffuse")
+			texture.m_sampler += std::to_string(diffuseNr++);
+		else if(texture.m_type == "texture_specular")
+			texture.m_sampler += std::to_string(specularNr++);
+	}
+}
 
-	glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(Vertex), &m_vertices[0], GL_STATIC_DRAW);
+inline void Mesh::SetupMesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+{
+	m_indexCount = static_cast<unsigned int>(indexCount);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned int),
-				 &m_indices[0], GL_STATIC_DRAW);
+	m_vertexArray.Bind();
+	m_vertexBuffer.SetData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, GL_STATIC_DRAW);
+	// bound while the vertex array is, so it becomes the array's index buffer
+	m_indexBuffer.SetData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
 
 	// vertex positions
 	glEnableVertexAttribArray(0);
@@ -96,3 +281,10 @@ inline void Mesh::SetupMesh()
 
 	glBindVertexArray(0);
 }
+
+inline void Mesh::KeepGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
+{
+	m_vertices = std::move(vertices);
+	m_indices = std::move(indices);
+	m_geometryMemory = TrackedAllocation(MEMORY_CPU_GEOMETRY, m_vertices.capacity() * sizeof(Vertex) + m_indices.capacity() * sizeof(unsigned int));
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <cstring>
+#include <string>
+
+#include "../Platform/VirtualFileSystem.h"
+
+// a whole AssetFile read as a stream, Assimp only ever reads
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+	bool Open(const char* path) { return m_file.Open(path); }
+
+	size_t Read(void* buffer, size_t size, size_t count) override
+	{
+		if(size == 0)
+			return 0;
+		count = std::min(count, (m_file.GetSize() - m_position) / size);
+		std::memcpy(buffer, m_file.GetData() + m_position, size * count);
+		m_position += size * count;
+		return count;
+	}
+	size_t Write(const void*, size_t, size_t) override { return 0; }
+	aiReturn Seek(size_t offset, aiOrigin origin) override
+	{
+		// like fseek, the offset is signed when relative to the current position or the end
+		const ptrdiff_t base = origin == aiOrigin_SET ? 0 : origin == aiOrigin_CUR ? static_cast<ptrdiff_t>(m_position) : static_cast<ptrdiff_t>(m_file.GetSize());
+		const ptrdiff_t position = base + static_cast<ptrdiff_t>(offset);
+		if(position < 0 || static_cast<size_t>(position) > m_file.GetSize())
+			return aiReturn_FAILURE;
+		m_position = static_cast<size_t>(position);
+		return aiReturn_SUCCESS;
+	}
+	size_t Tell() const override { return m_position; }
+	size_t FileSize() const override { return m_file.GetSize(); }
+	void Flush() override {}
+
+private:
+	AssetFile m_file;
+	size_t m_position = 0;
+};
+
+// makes Assimp read the model and everything it references (materials, buffers) through the VirtualFileSystem
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+	bool Exists(const char* path) const override { return GetFileSystem().Exists(path); }
+	char getOsSeparator() const override { return '/'; }
+	Assimp::IOStream* Open(const char* path, const char* mode) override
+	{
+		if(std::strchr(mode, 'w') || std::strchr(mode, 'a'))
+			return nullptr;
+		AssetIOStream* stream = new AssetIOStream();
+		if(!stream->Open(path))
+		{
+			delete stream;
+			return nullptr;
+		}
+		return stream;
+	}
+	void Close(Assimp::IOStream* stream) override { delete stream; }
+};
@@ -0,0 +1,491 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Mesh/Mesh.h"
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/Json.h"
+
+enum GltfLoadResult
+{
+	GLTF_LOAD_OK,
+	// the file is broken, Assimp wouldn't do better
+	GLTF_LOAD_FAILED,
+	// valid, but uses something the loader doesn't handle, Assimp has to import it
+	GLTF_LOAD_UNSUPPORTED,
+};
+
+// a byte range of one buffer, uploaded as one GL buffer
+struct GltfBufferView
+{
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	// only the views a primitive reads are uploaded
+	bool m_isUsed = false;
+};
+
+// one glTF mesh primitive, drawn as one Mesh
+struct GltfPrimitive
+{
+	// m_buffer of each binding and m_indexBuffer are buffer view indices + 1 (0 still means none),
+	// offsets are relative to the view. The upload swaps in the GL buffer of each view
+	MeshBufferLayout m_layout;
+	std::vector<TextureRef> m_textures;
+	glm::vec3 m_boundsMin = glm::vec3(0.0f);
+	glm::vec3 m_boundsMax = glm::vec3(0.0f);
+};
+
+// everything the upload stage needs, the buffer views point into m_files
+struct GltfScene
+{
+	std::vector<std::unique_ptr<AssetFile>> m_files;
+	std::vector<GltfBufferView> m_views;
+	std::vector<GltfPrimitive> m_primitives;
+	// m_mesh is a primitive index, one instance per primitive of every node referencing a mesh
+	std::vector<MeshInstance> m_instances;
+};
+
+/*
+* glTF 2.0 import without Assimp, for .glb and for .gltf with external buffers. Vertex and index
+* data is never converted: the file is mapped, each buffer view a primitive reads becomes one GL
+* buffer uploaded straight from the mapping, and the accessors turn into vertex attribute pointers
+* into it. The node hierarchy is flattened into one transform per instance, a mesh referenced by
+* several nodes is uploaded once.
+* Triangle lists with float positions are handled. Anything else (other primitive modes, sparse or
+* bufferless accessors, data: uris, required extensions) is GLTF_LOAD_UNSUPPORTED and goes to Assimp.
+* Materials map baseColorTexture to texture_diffuse. glTF uvs have their origin at the top left,
+* like Assimp's output with aiProcess_FlipUVs, so they are used as they are.
+*/
+namespace Gltf
+{
+	constexpr uint32_t GLB_MAGIC = 0x46546C67;
+	constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A;
+	constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;
+	constexpr uint32_t GLB_HEADER_SIZE = 12;
+	constexpr uint32_t GLB_CHUNK_HEADER_SIZE = 8;
+	constexpr uint32_t MODE_TRIANGLES = 4;
+
+	// a buffer as mapped, for a .glb buffer 0 is the BIN chunk
+	struct Buffer
+	{
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+	};
+
+	inline uint32_t ReadUint32(const uint8_t* data)
+	{
+		uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t GetComponentCount(const std::string& type)
+	{
+		if(type == "SCALAR")
+			return 1;
+		if(type == "VEC2")
+			return 2;
+		if(type == "VEC3")
+			return 3;
+		if(type == "VEC4")
+			return 4;
+		return 0;
+	}
+
+	// the glTF component types are the GL enums
+	inline uint32_t GetComponentSize(uint32_t componentType)
+	{
+		switch(componentType)
+		{
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE: return 1;
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT: return 2;
+		case GL_UNSIGNED_INT:
+		case GL_FLOAT: return 4;
+		default: return 0;
+		}
+	}
+
+	// uris are percent encoded
+	inline std::string DecodeUri(const std::string& uri)
+	{
+		std::string decoded;
+		for(size_t i = 0; i < uri.size(); i++)
+		{
+			if(uri[i] == '%' && i + 2 < uri.size())
+			{
+				decoded += static_cast<char>(std::strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+				i += 2;
+			}
+			else
+			{
+				decoded += uri[i];
+			}
+		}
+		return decoded;
+	}
+
+	// reads the accessor into binding (view index + 1 as the buffer) and checks it stays inside its view
+	inline GltfLoadResult BindAccessor(const JsonValue& json, const JsonValue& accessor, const std::vector<GltfBufferView>& views,
+									   VertexAttributeBinding& binding, uint32_t& count)
+	{
+		if(accessor.HasMember("sparse") || !accessor.HasMember("bufferView"))
+			return GLTF_LOAD_UNSUPPORTED;
+		const uint32_t viewIndex = accessor["bufferView"].GetUint(0xFFFFFFFF);
+		const uint32_t componentSize = GetComponentSize(accessor["componentType"].GetUint(0));
+		const uint32_t componentCount = GetComponentCount(accessor["type"].GetString());
+		count = accessor["count"].GetUint(0);
+		if(viewIndex >= views.size() || componentSize == 0 || componentCount == 0 || count == 0)
+			return GLTF_LOAD_FAILED;
+
+		const JsonValue& view = json["bufferViews"][viewIndex];
+		binding.m_buffer = viewIndex + 1;
+		binding.m_offset = accessor["byteOffset"].GetUint(0);
+		binding.m_stride = static_cast<GLsizei>(view["byteStride"].GetUint(0));
+		binding.m_componentCount = static_cast<GLint>(componentCount);
+		binding.m_componentType = accessor["componentType"].GetUint(0);
+		binding.m_isNormalized = accessor["normalized"].GetBool(false) ? GL_TRUE : GL_FALSE;
+
+		const size_t elementSize = static_cast<size_t>(componentSize) * componentCount;
+		const size_t stride = binding.m_stride != 0 ? static_cast<size_t>(binding.m_stride) : elementSize;
+		if(binding.m_offset + stride * (count - 1) + elementSize > views[viewIndex].m_size)
+		{
+			std::cout << "ERROR::GLTF::ACCESSOR_OUT_OF_RANGE" << std::endl;
+			return GLTF_LOAD_FAILED;
+		}
+		return GLTF_LOAD_OK;
+	}
+
+	// texture paths are relative to the model's directory, like the ones Assimp reports
+	inline GltfLoadResult LoadMaterialTexture(const JsonValue& json, const JsonValue& textureInfo, const std::string& path,
+											  const std::vector<GltfBufferView>& views, std::vector<TextureRef>& textures, const char* type)
+	{
+		if(textureInfo.IsNull())
+			return GLTF_LOAD_OK;
+		const uint32_t imageIndex = json["textures"][textureInfo["index"].GetUint(0xFFFFFFFF)]["source"].GetUint(0xFFFFFFFF);
+		const JsonValue& image = json["images"][imageIndex];
+		if(image.IsNull())
+			return GLTF_LOAD_FAILED;
+
+		if(image.HasMember("uri"))
+		{
+			const std::string& uri = image["uri"].GetString();
+			if(uri.compare(0, 5, "data:") == 0)
+				return GLTF_LOAD_UNSUPPORTED;
+			textures.push_back({type, DecodeUri(uri)});
+			return GLTF_LOAD_OK;
+		}
+
+		const uint32_t viewIndex = image["bufferView"].GetUint(0xFFFFFFFF);
+		if(viewIndex >= views.size())
+			return GLTF_LOAD_FAILED;
+		// decoded straight from the mapping, the name only has to be unique, no such file exists
+		const std::string extension = image["mimeType"].GetString() == "image/jpeg" ? ".jpg" : ".png";
+		const std::string fileName = path.substr(path.find_last_of('/') + 1);
+		TextureRef texture = {type, fileName + ".image" + std::to_string(imageIndex) + extension};
+		texture.m_data = views[viewIndex].m_data;
+		texture.m_size = views[viewIndex].m_size;
+		textures.push_back(texture);
+		return GLTF_LOAD_OK;
+	}
+
+	inline GltfLoadResult LoadPrimitive(const JsonValue& json, const JsonValue& primitive, const std::string& path, std::vector<GltfBufferView>& views,
+										GltfPrimitive& output)
+	{
+		if(primitive["mode"].GetUint(MODE_TRIANGLES) != MODE_TRIANGLES)
+			return GLTF_LOAD_UNSUPPORTED;
+
+		// in the order of the shader attribute locations
+		static const char* const ATTRIBUTE_NAMES[] = {"POSITION", "NORMAL", "TEXCOORD_0"};
+		const JsonValue& attributes = primitive["attributes"];
+		uint32_t vertexCount = 0;
+		for(uint32_t i = 0; i < 3; i++)
+		{
+			const JsonValue& accessor = json["accessors"][attributes[ATTRIBUTE_NAMES[i]].GetUint(0xFFFFFFFF)];
+			if(accessor.IsNull())
+			{
+				if(i == 0)
+					return GLTF_LOAD_FAILED;
+				continue;
+			}
+			uint32_t count = 0;
+			const GltfLoadResult result = BindAccessor(json, accessor, views, output.m_layout.m_attributes[i], count);
+			if(result != GLTF_LOAD_OK)
+				return result;
+			vertexCount = i == 0 ? count : vertexCount;
+			if(count != vertexCount)
+				return GLTF_LOAD_FAILED;
+			views[output.m_layout.m_attributes[i].m_buffer - 1].m_isUsed = true;
+		}
+
+		const VertexAttributeBinding& position = output.m_layout.m_attributes[0];
+		if(position.m_componentType != GL_FLOAT || position.m_componentCount != 3)
+			return GLTF_LOAD_UNSUPPORTED;
+
+		// the spec requires position bounds, files that leave them out get them computed
+		const JsonValue& accessor = json["accessors"][attributes["POSITION"].GetUint(0)];
+		if(accessor["min"].GetSize() == 3 && accessor["max"].GetSize() == 3)
+		{
+			for(int i = 0; i < 3; i++)
+			{
+				output.m_boundsMin[i] = static_cast<float>(accessor["min"][i].GetNumber(0.0));
+				output.m_boundsMax[i] = static_cast<float>(accessor["max"][i].GetNumber(0.0));
+			}
+		}
+		else
+		{
+			const uint8_t* data = views[position.m_buffer - 1].m_data + position.m_offset;
+			const size_t stride = position.m_stride != 0 ? static_cast<size_t>(position.m_stride) : sizeof(glm::vec3);
+			for(uint32_t i = 0; i < vertexCount; i++)
+			{
+				glm::vec3 value;
+				std::memcpy(&value, data + i * stride, sizeof(value));
+				output.m_boundsMin = i == 0 ? value : glm::min(output.m_boundsMin, value);
+				output.m_boundsMax = i == 0 ? value : glm::max(output.m_boundsMax, value);
+			}
+		}
+
+		output.m_layout.m_count = vertexCount;
+		if(primitive.HasMember("indices"))
+		{
+			VertexAttributeBinding indices;
+			uint32_t count = 0;
+			const GltfLoadResult result = BindAccessor(json, json["accessors"][primitive["indices"].GetUint(0xFFFFFFFF)], views, indices, count);
+			if(result != GLTF_LOAD_OK)
+				return result;
+			if(indices.m_componentCount != 1 ||
+			   (indices.m_componentType != GL_UNSIGNED_BYTE && indices.m_componentType != GL_UNSIGNED_SHORT && indices.m_componentType != GL_UNSIGNED_INT))
+				return GLTF_LOAD_FAILED;
+			output.m_layout.m_indexBuffer = indices.m_buffer;
+			output.m_layout.m_indexOffset = indices.m_offset;
+			output.m_layout.m_indexType = indices.m_componentType;
+			output.m_layout.m_count = count;
+			views[indices.m_buffer - 1].m_isUsed = true;
+		}
+
+		const JsonValue& material = json["materials"][primitive["material"].GetUint(0xFFFFFFFF)];
+		return LoadMaterialTexture(json, material["pbrMetallicRoughness"]["baseColorTexture"], path, views, output.m_textures, "texture_diffuse");
+	}
+
+	inline glm::mat4 GetNodeTransform(const JsonValue& node)
+	{
+		const JsonValue& matrix = node["matrix"];
+		if(matrix.GetSize() == 16)
+		{
+			// column major, like glm
+			float values[16];
+			for(size_t i = 0; i < 16; i++)
+				values[i] = static_cast<float>(matrix[i].GetNumber(0.0));
+			return glm::make_mat4(values);
+		}
+
+		const JsonValue& translation = node["translation"];
+		const JsonValue& rotation = node["rotation"];
+		const JsonValue& scale = node["scale"];
+		const glm::vec3 t(translation[0].GetNumber(0.0), translation[1].GetNumber(0.0), translation[2].GetNumber(0.0));
+		// x, y, z, w in the file
+		const glm::quat r(static_cast<float>(rotation[3].GetNumber(1.0)), static_cast<float>(rotation[0].GetNumber(0.0)),
+						  static_cast<float>(rotation[1].GetNumber(0.0)), static_cast<float>(rotation[2].GetNumber(0.0)));
+		const glm::vec3 s(scale[0].GetNumber(1.0), scale[1].GetNumber(1.0), scale[2].GetNumber(1.0));
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), t) * glm::mat4_cast(r);
+		return glm::scale(transform, s);
+	}
+
+	// maps the .glb, or the .gltf and the files its buffers name. Fills json and one Buffer per buffer
+	inline GltfLoadResult MapFiles(const std::string& path, GltfScene& scene, JsonValue& json, std::vector<Buffer>& buffers)
+	{
+		scene.m_files.emplace_back(new AssetFile());
+		AssetFile& file = *scene.m_files.back();
+		if(!file.Open(path.c_str()))
+		{
+			std::cout << "ERROR::GLTF::FILE_NOT_FOUND " << path << std::endl;
+			return GLTF_LOAD_FAILED;
+		}
+
+		const uint8_t* data = file.GetData();
+		const size_t size = file.GetSize();
+		Buffer binChunk;
+		const char* text = reinterpret_cast<const char*>(data);
+		size_t textSize = size;
+		if(size >= GLB_HEADER_SIZE && ReadUint32(data) == GLB_MAGIC)
+		{
+			// JSON chunk first, then an optional BIN chunk, both 4 byte aligned
+			size_t offset = GLB_HEADER_SIZE;
+			textSize = 0;
+			while(offset + GLB_CHUNK_HEADER_SIZE <= size)
+			{
+				const uint32_t length = ReadUint32(data + offset);
+				const uint32_t type = ReadUint32(data + offset + 4);
+				offset += GLB_CHUNK_HEADER_SIZE;
+				if(length > size - offset)
+					break;
+				if(type == GLB_CHUNK_JSON && textSize == 0)
+				{
+					text = reinterpret_cast<const char*>(data + offset);
+					textSize = length;
+				}
+				else if(type == GLB_CHUNK_BIN && !binChunk.m_data)
+				{
+					binChunk = {data + offset, length};
+				}
+				offset += length;
+			}
+		}
+		if(!JsonValue::Parse(text, textSize, json))
+		{
+			std::cout << "ERROR::GLTF::INVALID_JSON " << path << std::endl;
+			return GLTF_LOAD_FAILED;
+		}
+
+		const std::string directory = path.substr(0, path.find_last_of('/') + 1);
+		for(size_t i = 0; i < json["buffers"].GetSize(); i++)
+		{
+			const JsonValue& buffer = json["buffers"][i];
+			Buffer mapped;
+			if(!buffer.HasMember("uri"))
+			{
+				mapped = binChunk;
+			}
+			else
+			{
+				const std::string& uri = buffer["uri"].GetString();
+				if(uri.compare(0, 5, "data:") == 0)
+					return GLTF_LOAD_UNSUPPORTED;
+				scene.m_files.emplace_back(new AssetFile());
+				if(!scene.m_files.back()->Open((directory + DecodeUri(uri)).c_str()))
+				{
+					std::cout << "ERROR::GLTF::BUFFER_NOT_FOUND " << directory + uri << std::endl;
+					return GLTF_LOAD_FAILED;
+				}
+				mapped = {scene.m_files.back()->GetData(), scene.m_files.back()->GetSize()};
+			}
+			if(!mapped.m_data || mapped.m_size < buffer["byteLength"].GetUint(0))
+			{
+				std::cout << "ERROR::GLTF::BUFFER_TOO_SHORT " << path << std::endl;
+				return GLTF_LOAD_FAILED;
+			}
+			buffers.push_back(mapped);
+		}
+		return GLTF_LOAD_OK;
+	}
+}
+
+// any thread, doesn't touch GL
+inline GltfLoadResult LoadGltf(const std::string& path, GltfScene& scene)
+{
+	PROFILE_ZONE("glTF Load");
+	using namespace Gltf;
+	scene = GltfScene();
+
+	JsonValue json;
+	std::vector<Buffer> buffers;
+	GltfLoadResult result = MapFiles(path, scene, json, buffers);
+	if(result != GLTF_LOAD_OK)
+		return result;
+	if(json["extensionsRequired"].GetSize() != 0)
+		return GLTF_LOAD_UNSUPPORTED;
+
+	const JsonValue& views = json["bufferViews"];
+	for(size_t i = 0; i < views.GetSize(); i++)
+	{
+		const uint32_t bufferIndex = views[i]["buffer"].GetUint(0xFFFFFFFF);
+		const size_t offset = views[i]["byteOffset"].GetUint(0);
+		const size_t length = views[i]["byteLength"].GetUint(0);
+		if(bufferIndex >= buffers.size() || offset + length > buffers[bufferIndex].m_size)
+		{
+			std::cout << "ERROR::GLTF::BUFFER_VIEW_OUT_OF_RANGE " << path << std::endl;
+			return GLTF_LOAD_FAILED;
+		}
+		GltfBufferView view;
+		view.m_data = buffers[bufferIndex].m_data + offset;
+		view.m_size = length;
+		scene.m_views.push_back(view);
+	}
+
+	// every primitive of every mesh, a mesh's primitives are consecutive
+	std::vector<uint32_t> firstPrimitives;
+	const JsonValue& meshes = json["meshes"];
+	for(size_t i = 0; i < meshes.GetSize(); i++)
+	{
+		firstPrimitives.push_back(static_cast<uint32_t>(scene.m_primitives.size()));
+		const JsonValue& primitives = meshes[i]["primitives"];
+		for(size_t j = 0; j < primitives.GetSize(); j++)
+		{
+			scene.m_primitives.emplace_back();
+			result = LoadPrimitive(json, primitives[j], path, scene.m_views, scene.m_primitives.back());
+			if(result != GLTF_LOAD_OK)
+				return result;
+		}
+	}
+	firstPrimitives.push_back(static_cast<uint32_t>(scene.m_primitives.size()));
+
+	// the default scene, else the first, else every node no other node has as a child
+	const JsonValue& nodes = json["nodes"];
+	std::vector<uint32_t> roots;
+	const JsonValue& sceneNodes = json["scenes"][json["scene"].GetUint(0)]["nodes"];
+	for(size_t i = 0; i < sceneNodes.GetSize(); i++)
+		roots.push_back(sceneNodes[i].GetUint(0xFFFFFFFF));
+	if(json["scenes"].GetSize() == 0)
+	{
+		std::vector<bool> isChild(nodes.GetSize(), false);
+		for(size_t i = 0; i < nodes.GetSize(); i++)
+		{
+			for(size_t j = 0; j < nodes[i]["children"].GetSize(); j++)
+			{
+				const uint32_t child = nodes[i]["children"][j].GetUint(0xFFFFFFFF);
+				if(child < isChild.size())
+					isChild[child] = true;
+			}
+		}
+		for(uint32_t i = 0; i < nodes.GetSize(); i++)
+		{
+			if(!isChild[i])
+				roots.push_back(i);
+		}
+	}
+
+	struct PendingNode
+	{
+		uint32_t m_node;
+		glm::mat4 m_parentTransform;
+	};
+	std::vector<PendingNode> pending;
+	for(size_t i = roots.size(); i > 0; i--)
+		pending.push_back({roots[i - 1], glm::mat4(1.0f)});
+	// the spec makes the hierarchy a forest, the count stops a cyclic file from looping forever
+	size_t visitCount = 0;
+	while(!pending.empty())
+	{
+		const PendingNode current = pending.back();
+		pending.pop_back();
+		const JsonValue& node = nodes[current.m_node];
+		if(node.IsNull() || ++visitCount > nodes.GetSize())
+		{
+			std::cout << "ERROR::GLTF::INVALID_NODE_HIERARCHY " << path << std::endl;
+			return GLTF_LOAD_FAILED;
+		}
+
+		const glm::mat4 transform = current.m_parentTransform * GetNodeTransform(node);
+		const uint32_t mesh = node["mesh"].GetUint(0xFFFFFFFF);
+		if(mesh < meshes.GetSize())
+		{
+			for(uint32_t i = firstPrimitives[mesh]; i < firstPrimitives[mesh + 1]; i++)
+				scene.m_instances.push_back({i, transform});
+		}
+		const JsonValue& children = node["children"];
+		for(size_t i = children.GetSize(); i > 0; i--)
+			pending.push_back({children[i - 1].GetUint(0xFFFFFFFF), transform});
+	}
+	return GLTF_LOAD_OK;
+}
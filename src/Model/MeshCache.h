@@ -0,0 +1,350 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Mesh/Mesh.h"
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/Hash.h"
+#include "NodeHierarchy.h"
+
+/*
+* Cooked binary form of a model's meshes, written the first time a model is imported and mapped
+* on every later load instead of running Assimp.
+*
+* Layout: MeshCacheHeader, MeshCacheEntry table, node parent table, node local transform table,
+* NodeMesh table, MeshCacheTextureRef table, string table, then the vertex and index arrays of every
+* mesh, each aligned to DATA_ALIGNMENT. The nodes are the NodeHierarchy, in its depth first order
+* and with column major glm::mat4 transforms. Vertices are stored as
+* Vertex and indices as unsigned int, exactly what Mesh uploads, so they go from the mapping to
+* glBufferData untouched.
+* The header carries the hash of the source files, a cache is only used while that still matches.
+*/
+constexpr char MESH_CACHE_MAGIC[4] = {'M', 'S', 'H', 'C'};
+
+struct MeshCacheHeader
+{
+	char m_magic[4];
+	uint32_t m_version;
+	uint64_t m_sourceHash;
+	uint32_t m_vertexSize;
+	uint32_t m_meshCount;
+	uint32_t m_nodeCount;
+	uint32_t m_nodeMeshCount;
+	uint32_t m_textureRefCount;
+	uint32_t m_stringTableSize;
+	uint64_t m_meshTableOffset;
+	uint64_t m_nodeParentTableOffset;
+	uint64_t m_nodeTransformTableOffset;
+	uint64_t m_nodeMeshTableOffset;
+	uint64_t m_textureRefTableOffset;
+	uint64_t m_stringTableOffset;
+	uint64_t m_fileSize;
+};
+
+struct MeshCacheEntry
+{
+	uint64_t m_vertexOffset;
+	uint64_t m_indexOffset;
+	uint32_t m_vertexCount;
+	uint32_t m_indexCount;
+	uint32_t m_firstTextureRef;
+	uint32_t m_textureRefCount;
+	float m_boundsMin[3];
+	float m_boundsMax[3];
+};
+
+// both are offsets of null terminated strings in the string table
+struct MeshCacheTextureRef
+{
+	uint32_t m_typeOffset;
+	uint32_t m_pathOffset;
+};
+
+class MeshCache
+{
+public:
+	// bump whenever the layout or the import settings change, old caches then fail to open and get re-cooked
+	static constexpr uint32_t VERSION = 3;
+	static constexpr uint64_t DATA_ALIGNMENT = 64;
+
+	static std::string GetCachePath(const std::string& sourcePath) { return sourcePath + ".meshcache"; }
+	// hash of the model and the material libraries it references, 0 when the model can't be read
+	static uint64_t HashSource(const std::string& sourcePath);
+	static bool Write(const std::string& cachePath, uint64_t sourceHash, const std::vector<MeshData>& meshes, const NodeHierarchy& nodes,
+					  const std::vector<NodeMesh>& nodeMeshes);
+
+	// maps the cache, fails when it is missing, stale or malformed
+	bool Open(const std::string& cachePath, uint64_t sourceHash);
+	void Close() { m_file.Close(); m_header = nullptr; }
+
+	uint32_t GetMeshCount() const { return m_header->m_meshCount; }
+	const MeshCacheEntry& GetMesh(uint32_t index) const;
+	const Vertex* GetVertices(const MeshCacheEntry& mesh) const;
+	const unsigned int* GetIndices(const MeshCacheEntry& mesh) const;
+	const MeshCacheTextureRef& GetTextureRef(uint32_t index) const;
+	const char* GetString(uint32_t offset) const;
+	uint32_t GetNodeCount() const { return m_header->m_nodeCount; }
+	const uint32_t* GetNodeParents() const;
+	const glm::mat4* GetNodeTransforms() const;
+	uint32_t GetNodeMeshCount() const { return m_header->m_nodeMeshCount; }
+	const NodeMesh* GetNodeMeshes() const;
+
+private:
+	static uint64_t Align(uint64_t offset) { return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1); }
+	bool Validate() const;
+
+	AssetFile m_file;
+	const MeshCacheHeader* m_header = nullptr;
+};
+
+inline uint64_t MeshCache::HashSource(const std::string& sourcePath)
+{
+	PROFILE_ZONE("Hash Model Source");
+	AssetFile source;
+	if(!source.Open(sourcePath.c_str()))
+		return 0;
+
+	uint64_t hash = HashBytes(source.GetData(), source.GetSize(), VERSION);
+
+	// obj materials live in separate files that Assimp pulls in, a change there has to invalidate too
+	const std::string directory = sourcePath.substr(0, sourcePath.find_last_of('/') + 1);
+	const char* text = reinterpret_cast<const char*>(source.GetData());
+	const char* const end = text + source.GetSize();
+	const size_t MTLLIB_LENGTH = 7;
+	while(text < end)
+	{
+		const char* lineEnd = static_cast<const char*>(std::memchr(text, '\n', end - text));
+		if(!lineEnd)
+			lineEnd = end;
+		if(lineEnd - text > static_cast<ptrdiff_t>(MTLLIB_LENGTH) && std::strncmp(text, "mtllib ", MTLLIB_LENGTH) == 0)
+		{
+			std::string library(text + MTLLIB_LENGTH, lineEnd);
+			while(!library.empty() && (library.back() == '\r' || library.back() == ' '))
+				library.pop_back();
+			AssetFile material;
+			if(material.Open((directory + library).c_str()))
+				hash = HashCombine(hash, HashBytes(material.GetData(), material.GetSize()));
+		}
+		text = lineEnd + 1;
+	}
+	return hash;
+}
+
+inline bool MeshCache::Write(const std::string& cachePath, uint64_t sourceHash, const std::vector<MeshData>& meshes, const NodeHierarchy& nodes,
+							 const std::vector<NodeMesh>& nodeMeshes)
+{
+	PROFILE_ZONE("Mesh Cache Write");
+	std::vector<MeshCacheEntry> entries(meshes.size());
+	std::vector<uint32_t> nodeParents(nodes.GetNodeCount());
+	std::vector<glm::mat4> nodeTransforms(nodes.GetNodeCount());
+	for(uint32_t i = 0; i < nodes.GetNodeCount(); i++)
+	{
+		nodeParents[i] = nodes.GetParent(i);
+		nodeTransforms[i] = nodes.GetLocalTransform(i);
+	}
+	std::vector<MeshCacheTextureRef> textureRefs;
+	std::string strings;
+	const auto addString = [&strings](const std::string& text) {
+		const uint32_t offset = static_cast<uint32_t>(strings.size());
+		strings.append(text.c_str(), text.size() + 1);
+		return offset;
+	};
+
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		const MeshData& mesh = meshes[i];
+		MeshCacheEntry& entry = entries[i];
+		entry.m_vertexCount = static_cast<uint32_t>(mesh.m_vertices.size());
+		entry.m_indexCount = static_cast<uint32_t>(mesh.m_indices.size());
+		entry.m_firstTextureRef = static_cast<uint32_t>(textureRefs.size());
+		entry.m_textureRefCount = static_cast<uint32_t>(mesh.m_textures.size());
+		glm::vec3 boundsMin, boundsMax;
+		ComputeBounds(mesh.m_vertices.data(), mesh.m_vertices.size(), boundsMin, boundsMax);
+		std::memcpy(entry.m_boundsMin, &boundsMin[0], sizeof(entry.m_boundsMin));
+		std::memcpy(entry.m_boundsMax, &boundsMax[0], sizeof(entry.m_boundsMax));
+		for(const TextureRef& texture : mesh.m_textures)
+			textureRefs.push_back({addString(texture.m_type), addString(texture.m_path)});
+	}
+
+	MeshCacheHeader header = {};
+	std::memcpy(header.m_magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.m_version = VERSION;
+	header.m_sourceHash = sourceHash;
+	header.m_vertexSize = sizeof(Vertex);
+	header.m_meshCount = static_cast<uint32_t>(entries.size());
+	header.m_nodeCount = static_cast<uint32_t>(nodeParents.size());
+	header.m_nodeMeshCount = static_cast<uint32_t>(nodeMeshes.size());
+	header.m_textureRefCount = static_cast<uint32_t>(textureRefs.size());
+	header.m_stringTableSize = static_cast<uint32_t>(strings.size());
+	header.m_meshTableOffset = sizeof(MeshCacheHeader);
+	header.m_nodeParentTableOffset = header.m_meshTableOffset + entries.size() * sizeof(MeshCacheEntry);
+	header.m_nodeTransformTableOffset = header.m_nodeParentTableOffset + nodeParents.size() * sizeof(uint32_t);
+	header.m_nodeMeshTableOffset = header.m_nodeTransformTableOffset + nodeTransforms.size() * sizeof(glm::mat4);
+	header.m_textureRefTableOffset = header.m_nodeMeshTableOffset + nodeMeshes.size() * sizeof(NodeMesh);
+	header.m_stringTableOffset = header.m_textureRefTableOffset + textureRefs.size() * sizeof(MeshCacheTextureRef);
+
+	uint64_t offset = Align(header.m_stringTableOffset + strings.size());
+	for(MeshCacheEntry& entry : entries)
+	{
+		entry.m_vertexOffset = offset;
+		offset = Align(offset + entry.m_vertexCount * sizeof(Vertex));
+		entry.m_indexOffset = offset;
+		offset = Align(offset + entry.m_indexCount * sizeof(unsigned int));
+	}
+	header.m_fileSize = offset;
+
+	// written under a temporary name and renamed, a crash mid write never leaves a cache that looks valid
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!file.is_open())
+		{
+			std::cout << "ERROR::MESH_CACHE::OPEN_FAILED " << tempPath << std::endl;
+			return false;
+		}
+
+		const char padding[DATA_ALIGNMENT] = {};
+		const auto padTo = [&file, &padding](uint64_t target) {
+			const uint64_t position = static_cast<uint64_t>(file.tellp());
+			if(target > position)
+				file.write(padding, static_cast<std::streamsize>(target - position));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+		file.write(reinterpret_cast<const char*>(nodeParents.data()), nodeParents.size() * sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(nodeTransforms.data()), nodeTransforms.size() * sizeof(glm::mat4));
+		file.write(reinterpret_cast<const char*>(nodeMeshes.data()), nodeMeshes.size() * sizeof(NodeMesh));
+		file.write(reinterpret_cast<const char*>(textureRefs.data()), textureRefs.size() * sizeof(MeshCacheTextureRef));
+		file.write(strings.data(), strings.size());
+		for(size_t i = 0; i < meshes.size(); i++)
+		{
+			padTo(entries[i].m_vertexOffset);
+			file.write(reinterpret_cast<const char*>(meshes[i].m_vertices.data()), meshes[i].m_vertices.size() * sizeof(Vertex));
+			padTo(entries[i].m_indexOffset);
+			file.write(reinterpret_cast<const char*>(meshes[i].m_indices.data()), meshes[i].m_indices.size() * sizeof(unsigned int));
+		}
+		padTo(header.m_fileSize);
+		if(!file.good())
+		{
+			std::cout << "ERROR::MESH_CACHE::WRITE_FAILED " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	if(std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::cout << "ERROR::MESH_CACHE::RENAME_FAILED " << cachePath << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+inline bool MeshCache::Open(const std::string& cachePath, uint64_t sourceHash)
+{
+	Close();
+	if(!m_file.Open(cachePath.c_str()))
+		return false;
+
+	m_header = reinterpret_cast<const MeshCacheHeader*>(m_file.GetData());
+	if(!Validate() || m_header->m_sourceHash != sourceHash)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+inline bool MeshCache::Validate() const
+{
+	const uint64_t size = m_file.GetSize();
+	if(size < sizeof(MeshCacheHeader) || std::memcmp(m_header->m_magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0
+	   || m_header->m_version != VERSION || m_header->m_vertexSize != sizeof(Vertex) || m_header->m_fileSize != size)
+		return false;
+
+	if(m_header->m_meshTableOffset + uint64_t(m_header->m_meshCount) * sizeof(MeshCacheEntry) > size
+	   || m_header->m_nodeParentTableOffset + uint64_t(m_header->m_nodeCount) * sizeof(uint32_t) > size
+	   || m_header->m_nodeTransformTableOffset + uint64_t(m_header->m_nodeCount) * sizeof(glm::mat4) > size
+	   || m_header->m_nodeMeshTableOffset + uint64_t(m_header->m_nodeMeshCount) * sizeof(NodeMesh) > size
+	   || m_header->m_textureRefTableOffset + uint64_t(m_header->m_textureRefCount) * sizeof(MeshCacheTextureRef) > size
+	   || m_header->m_stringTableOffset + m_header->m_stringTableSize > size)
+		return false;
+	// every string lookup relies on the table ending in a terminator
+	if(m_header->m_stringTableSize > 0 && m_file.GetData()[m_header->m_stringTableOffset + m_header->m_stringTableSize - 1] != '\0')
+		return false;
+
+	for(uint32_t i = 0; i < m_header->m_meshCount; i++)
+	{
+		const MeshCacheEntry& mesh = GetMesh(i);
+		if(mesh.m_vertexOffset % DATA_ALIGNMENT != 0 || mesh.m_indexOffset % DATA_ALIGNMENT != 0
+		   || mesh.m_vertexOffset + uint64_t(mesh.m_vertexCount) * sizeof(Vertex) > size
+		   || mesh.m_indexOffset + uint64_t(mesh.m_indexCount) * sizeof(unsigned int) > size
+		   || uint64_t(mesh.m_firstTextureRef) + mesh.m_textureRefCount > m_header->m_textureRefCount)
+			return false;
+	}
+	for(uint32_t i = 0; i < m_header->m_textureRefCount; i++)
+	{
+		const MeshCacheTextureRef& ref = GetTextureRef(i);
+		if(ref.m_typeOffset >= m_header->m_stringTableSize || ref.m_pathOffset >= m_header->m_stringTableSize)
+			return false;
+	}
+	// the parents are read straight into a NodeHierarchy, they have to be in its order
+	if(m_header->m_nodeParentTableOffset % alignof(uint32_t) != 0 || m_header->m_nodeTransformTableOffset % alignof(glm::mat4) != 0
+	   || m_header->m_nodeMeshTableOffset % alignof(NodeMesh) != 0 || !NodeHierarchy::IsDepthFirst(GetNodeParents(), m_header->m_nodeCount))
+		return false;
+	for(uint32_t i = 0; i < m_header->m_nodeMeshCount; i++)
+	{
+		const NodeMesh& nodeMesh = GetNodeMeshes()[i];
+		if(nodeMesh.m_node >= m_header->m_nodeCount || nodeMesh.m_mesh >= m_header->m_meshCount)
+			return false;
+	}
+	return true;
+}
+
+inline const MeshCacheEntry& MeshCache::GetMesh(uint32_t index) const
+{
+	return reinterpret_cast<const MeshCacheEntry*>(m_file.GetData() + m_header->m_meshTableOffset)[index];
+}
+
+inline const Vertex* MeshCache::GetVertices(const MeshCacheEntry& mesh) const
+{
+	return reinterpret_cast<const Vertex*>(m_file.GetData() + mesh.m_vertexOffset);
+}
+
+inline const unsigned int* MeshCache::GetIndices(const MeshCacheEntry& mesh) const
+{
+	return reinterpret_cast<const unsigned int*>(m_file.GetData() + mesh.m_indexOffset);
+}
+
+inline const MeshCacheTextureRef& MeshCache::GetTextureRef(uint32_t index) const
+{
+	return reinterpret_cast<const MeshCacheTextureRef*>(m_file.GetData() + m_header->m_textureRefTableOffset)[index];
+}
+
+inline const char* MeshCache::GetString(uint32_t offset) const
+{
+	return reinterpret_cast<const char*>(m_file.GetData() + m_header->m_stringTableOffset + offset);
+}
+
+inline const uint32_t* MeshCache::GetNodeParents() const
+{
+	return reinterpret_cast<const uint32_t*>(m_file.GetData() + m_header->m_nodeParentTableOffset);
+}
+
+inline const glm::mat4* MeshCache::GetNodeTransforms() const
+{
+	return reinterpret_cast<const glm::mat4*>(m_file.GetData() + m_header->m_nodeTransformTableOffset);
+}
+
+inline const NodeMesh* MeshCache::GetNodeMeshes() const
+{
+	return reinterpret_cast<const NodeMesh*>(m_file.GetData() + m_header->m_nodeMeshTableOffset);
+}
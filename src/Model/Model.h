@@ -3,78 +3,422 @@
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <future>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
-#include "STB/stb_image.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Render/UploadQueue.h"
+#include "../Texture/TextureCache.h"
+#include "../Tools/ThreadPool.h"
+#include "../Tools/Path.h"
+#include "AssimpFileSystem.h"
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "NodeHierarchy.h"
+#include "ObjLoader.h"
 
 class Shader;
 struct Texture;
 
+// what the obj parser reproduces, it has to produce the same meshes
+constexpr unsigned int ASSIMP_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+
+/*
+* Loading runs in two stages: importModel does all the cpu work (glTF mapping, mesh cache, or the
+* obj parser / Assimp import, conversion, texture decode) and doesn't touch GL, the upload stage
+* creates the GL objects.
+* Textures come from the global TextureCache. The ones not loaded yet are decoded on the thread
+* pool, each queued as soon as the first mesh referencing it is converted, so decoding overlaps
+* the rest of the import.
+* The constructor runs both right away, LoadAsync runs the import on the thread pool and feeds the
+* uploads through the UploadQueue a few at a time.
+* The cpu copy of the geometry is dropped once uploaded unless the GeometryPolicy keeps it (glTF
+* meshes never have one, their buffers go to the gpu as they are in the file).
+* Every mesh of the file is uploaded once however many nodes reference it. The nodes are kept as a
+* NodeHierarchy, and the world transforms of all the nodes referencing a mesh sit next to each
+* other in one instance buffer, so each mesh is a single instanced draw.
+*/
 class Model
 {
 public:
-	Model(std::string const& path)
+	Model(std::string const& path, GeometryPolicy policy = GEOMETRY_DROP_AFTER_UPLOAD) : m_geometryPolicy(policy)
 	{
 		loadModel(path);
 	}
 
+	// returns immediately, the model draws nothing until IsReady()
+	static std::shared_ptr<Model> LoadAsync(const std::string& path, GeometryPolicy policy = GEOMETRY_DROP_AFTER_UPLOAD);
+	// any thread, the Assimp import and conversion alone, without the mesh cache or textures.
+	// meshes are in the file's order, nodes and nodeMeshes say where each is drawn
+	static bool ImportAssimp(const std::string& path, std::vector<MeshData>& meshes, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes);
+	// for files without a node hierarchy (obj): every mesh once, at a single root
+	static void AddRootNode(uint32_t meshCount, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes);
+
+	// true once loading finished, also when it failed
+	bool IsReady() const { return m_isReady.load(std::memory_order_acquire); }
+	// when each loading stage ran, in CpuProfiler::NowNs. Valid once IsReady()
+	struct LoadTimes
+	{
+		uint64_t m_importStartNs = 0;
+		uint64_t m_importEndNs = 0;
+		// from the first upload to the last, frames in between included when loaded asynchronously
+		uint64_t m_uploadStartNs = 0;
+		uint64_t m_uploadEndNs = 0;
+	};
+	const LoadTimes& GetLoadTimes() const { return m_loadTimes; }
 
-	void Draw(Shader& shader);
+	// draws the model once at each of the count transforms, every mesh with a single instanced draw
+	// whose instances are all its nodes under all the transforms. The shader has to be in use and be
+	// the GetPermutation variant, uModel is set to identity
+	void Draw(Shader& shader, const glm::mat4* models, uint32_t count);
+	void Draw(Shader& shader, const glm::mat4& model) { Draw(shader, &model, 1); }
+	// ShaderMaterialFlag bits of all the meshes together, the model draws with one shader variant
+	uint32_t GetMaterialFlags() const { return m_materialFlags; }
+	// the variant Draw needs: the material flags and FEATURE_INSTANCED
+	uint32_t GetPermutation() const { return m_materialFlags | FEATURE_INSTANCED; }
+	// moving nodes with SetLocalTransform takes effect with the next RequestTextureResidency or Draw, valid once IsReady()
+	NodeHierarchy& GetNodes() { return m_nodes; }
+	// box around every instance in model space as loaded, valid once IsReady()
+	const glm::vec3& GetBoundsMin() const { return m_boundsMin; }
+	const glm::vec3& GetBoundsMax() const { return m_boundsMax; }
+	// asks for the texture levels each mesh needs at its size on screen, before drawing
+	void RequestTextureResidency(const glm::mat4& model, const StreamingView& view);
 private:
+	// cpu side results of the import stage, what the upload stage consumes
+	struct LoadData
+	{
+		uint64_t m_sourceHash = 0;
+		// kept mapped until the meshes are uploaded from it
+		MeshCache m_cache;
+		bool m_isFromCache = false;
+		// glTF is uploaded from its mapped buffer views, m_meshes then only holds the textures
+		bool m_isGltf = false;
+		GltfScene m_gltf;
+		std::vector<MeshData> m_meshes;
+		// the imported vertices and indices in m_meshes, until each is uploaded
+		TrackedAllocation m_geometryMemory;
+		NodeHierarchy m_nodes;
+		std::vector<NodeMesh> m_nodeMeshes;
+		// one per unique path referenced by the meshes
+		std::vector<TextureHandle> m_textures;
+		std::unordered_map<std::string, size_t> m_textureIndices;
+		// not valid for textures the cache already has or another load is bringing in
+		std::vector<std::future<DecodedImage>> m_decodes;
+		std::vector<DecodedImage> m_images;
+		// m_images until each is uploaded
+		TrackedAllocation m_imageMemory;
+	};
+
+	Model() = default;
+
 	// model data
 	std::vector<Mesh> meshes;
+	NodeHierarchy m_nodes;
+	// sorted by mesh, each mesh's instances are one range of m_instanceTransforms
+	std::vector<NodeMesh> m_nodeMeshes;
+	// where each mesh's range starts, one more than there are meshes
+	std::vector<uint32_t> m_meshInstanceStarts;
+	// the nodes' world transforms in m_nodeMeshes order, refilled when a node moved
+	std::vector<glm::mat4> m_instanceTransforms;
+	// the last Draw's instance transforms, each mesh's range once per transform it was drawn at. The
+	// buffer is respecified by every Draw, so a second Draw in a frame doesn't wait on the first
+	std::vector<glm::mat4> m_drawTransforms;
+	GlBuffer m_instanceBuffer{MEMORY_GPU_MESH};
+	// glTF buffer views, empty for the ones no mesh reads
+	std::vector<GlBuffer> m_buffers;
 	std::string m_directory;
-	std::vector<Texture> textures_loaded;
+	std::atomic<bool> m_isReady{false};
+	LoadTimes m_loadTimes;
+	uint32_t m_materialFlags = 0;
+	glm::vec3 m_boundsMin = glm::vec3(0.0f);
+	glm::vec3 m_boundsMax = glm::vec3(0.0f);
+	GeometryPolicy m_geometryPolicy = GEOMETRY_DROP_AFTER_UPLOAD;
 
 	void loadModel(std::string path);
-	void processNode(aiNode* node, const aiScene* scene);
-	Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-	unsigned int TextureFromFile(const char* path, const std::string& directory);
-	std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+	bool importModel(const std::string& path, LoadData& data);
+	static void flattenNodes(const aiNode* root, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes);
+	static MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+	static std::vector<TextureRef> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+	void requestTextures(const MeshData& mesh, LoadData& data);
+	void waitForTextures(LoadData& data);
+
+	void uploadTexture(LoadData& data, size_t index);
+	void uploadBuffer(LoadData& data, size_t index);
+	void uploadMesh(LoadData& data, size_t index);
+	void finishLoad(LoadData& data);
+	void updateInstances();
 };
 
-inline void Model::Draw(Shader& shader)
+inline std::shared_ptr<Model> Model::LoadAsync(const std::string& path, GeometryPolicy policy)
 {
-	for(unsigned int i = 0; i < meshes.size(); i++)
-		meshes[i].Draw(shader);
+	std::shared_ptr<Model> model(new Model());
+	model->m_geometryPolicy = policy;
+	GetThreadPool().Enqueue([model, path]() {
+		PROFILE_ZONE("Model Load");
+		std::shared_ptr<LoadData> data = std::make_shared<LoadData>();
+		model->m_loadTimes.m_importStartNs = CpuProfiler::NowNs();
+		const bool isImported = model->importModel(path, *data);
+		model->m_loadTimes.m_importEndNs = model->m_loadTimes.m_uploadStartNs = CpuProfiler::NowNs();
+		if(!isImported)
+		{
+			model->m_isReady.store(true, std::memory_order_release);
+			return;
+		}
+
+		// one task per texture and per mesh keeps each piece small enough for the frame budget,
+		// textures go first since the meshes reference them
+		UploadQueue& uploadQueue = GetUploadQueue();
+		uploadQueue.Enqueue([model]() { model->m_loadTimes.m_uploadStartNs = CpuProfiler::NowNs(); });
+		for(size_t i = 0; i < data->m_images.size(); i++)
+			uploadQueue.Enqueue([model, data, i]() { model->uploadTexture(*data, i); });
+		for(size_t i = 0; i < data->m_gltf.m_views.size(); i++)
+		{
+			if(data->m_gltf.m_views[i].m_isUsed)
+				uploadQueue.Enqueue([model, data, i]() { model->uploadBuffer(*data, i); });
+		}
+		for(size_t i = 0; i < data->m_meshes.size(); i++)
+			uploadQueue.Enqueue([model, data, i]() { model->uploadMesh(*data, i); });
+		uploadQueue.Enqueue([model, data]() { model->finishLoad(*data); });
+	});
+	return model;
 }
 
-inline void Model::loadModel(std::string path)
+inline bool Model::ImportAssimp(const std::string& path, std::vector<MeshData>& meshes, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes)
 {
 	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+	importer.SetIOHandler(new AssetIOSystem());
+	const aiScene* scene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
 	if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
 	{
 		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return false;
+	}
+	for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+		meshes.push_back(processMesh(scene->mMeshes[i], scene));
+	flattenNodes(scene->mRootNode, nodes, nodeMeshes);
+	return true;
+}
+
+inline void Model::AddRootNode(uint32_t meshCount, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes)
+{
+	const uint32_t root = nodes.AddNode(NO_PARENT_NODE, glm::mat4(1.0f));
+	for(uint32_t i = 0; i < meshCount; i++)
+		nodeMeshes.push_back({root, i});
+}
+
+inline void Model::Draw(Shader& shader, const glm::mat4* models, uint32_t count)
+{
+	if(!IsReady() || count == 0)
 		return;
+	if(m_nodes.IsDirty())
+		updateInstances();
+	// within a mesh's range the transforms are the outer loop and the mesh's nodes the inner one
+	m_drawTransforms.resize(m_instanceTransforms.size() * count);
+	glm::mat4* transform = m_drawTransforms.data();
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		for(uint32_t model = 0; model < count; model++)
+		{
+			for(uint32_t instance = m_meshInstanceStarts[i]; instance < m_meshInstanceStarts[i + 1]; instance++)
+				*transform++ = models[model] * m_instanceTransforms[instance];
+		}
 	}
-	m_directory = path.substr(0, path.find_last_of('/'));
+	m_instanceBuffer.SetData(GL_ARRAY_BUFFER, m_drawTransforms.size() * sizeof(glm::mat4), m_drawTransforms.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	processNode(scene->mRootNode, scene);
+	shader.SetMat4("uModel", glm::mat4(1.0f));
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		const uint32_t instanceCount = (m_meshInstanceStarts[i + 1] - m_meshInstanceStarts[i]) * count;
+		if(instanceCount == 0)
+			continue;
+		meshes[i].SetInstanceTransforms(m_instanceBuffer.GetId(), static_cast<size_t>(m_meshInstanceStarts[i]) * count * sizeof(glm::mat4));
+		meshes[i].Draw(shader, static_cast<GLsizei>(instanceCount));
+	}
 }
 
-inline void Model::processNode(aiNode* node, const aiScene* scene)
+inline void Model::RequestTextureResidency(const glm::mat4& model, const StreamingView& view)
 {
-	// process all the node's meshes (if any)
-	for(unsigned int i = 0; i < node->mNumMeshes; i++)
+	if(!IsReady())
+		return;
+	// runs before Draw, so nodes moved since the last frame are only up to date after this
+	if(m_nodes.IsDirty())
+		updateInstances();
+	for(const NodeMesh& nodeMesh : m_nodeMeshes)
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		const Mesh& mesh = meshes[nodeMesh.m_mesh];
+		const glm::mat4 transform = model * m_nodes.GetWorldTransform(nodeMesh.m_node);
+		const float scale =
+			std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+		const glm::vec3 center = glm::vec3(transform * glm::vec4((mesh.m_boundsMin + mesh.m_boundsMax) * 0.5f, 1.0f));
+		const float radius = glm::length(mesh.m_boundsMax - mesh.m_boundsMin) * 0.5f * scale;
+		const float screenSize = view.GetProjectedSize(center, radius);
+		if(screenSize <= 0.0f)
+			continue;
+		for(const Texture& texture : mesh.m_textures)
+			GetTextureCache().RequestResidency(texture.m_handle, screenSize);
 	}
-	// then do the same for each of its children
-	for(unsigned int i = 0; i < node->mNumChildren; i++)
+}
+
+inline void Model::loadModel(std::string path)
+{
+	PROFILE_ZONE("Model Load");
+	LoadData data;
+	m_loadTimes.m_importStartNs = CpuProfiler::NowNs();
+	const bool isImported = importModel(path, data);
+	m_loadTimes.m_importEndNs = m_loadTimes.m_uploadStartNs = CpuProfiler::NowNs();
+	if(isImported)
 	{
-		processNode(node->mChildren[i], scene);
+		for(size_t i = 0; i < data.m_images.size(); i++)
+			uploadTexture(data, i);
+		for(size_t i = 0; i < data.m_gltf.m_views.size(); i++)
+		{
+			if(data.m_gltf.m_views[i].m_isUsed)
+				uploadBuffer(data, i);
+		}
+		for(size_t i = 0; i < data.m_meshes.size(); i++)
+			uploadMesh(data, i);
 	}
+	finishLoad(data);
 }
 
-inline Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+inline bool Model::importModel(const std::string& path, LoadData& data)
 {
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	m_directory = path.substr(0, path.find_last_of('/'));
+
+	if(HasExtension(path, ".glb") || HasExtension(path, ".gltf"))
+	{
+		// nothing to cook, the buffer views already are in the layout the gpu reads
+		const GltfLoadResult result = LoadGltf(path, data.m_gltf);
+		if(result == GLTF_LOAD_FAILED)
+			return false;
+		if(result == GLTF_LOAD_OK)
+		{
+			data.m_isGltf = true;
+			m_buffers.resize(data.m_gltf.m_views.size());
+			data.m_meshes.resize(data.m_gltf.m_primitives.size());
+			for(size_t i = 0; i < data.m_meshes.size(); i++)
+			{
+				data.m_meshes[i].m_textures = data.m_gltf.m_primitives[i].m_textures;
+				requestTextures(data.m_meshes[i], data);
+			}
+			// the loader already flattened the node transforms, each instance becomes a root
+			for(const MeshInstance& instance : data.m_gltf.m_instances)
+				data.m_nodeMeshes.push_back({data.m_nodes.AddNode(NO_PARENT_NODE, instance.m_transform), instance.m_mesh});
+			waitForTextures(data);
+			return true;
+		}
+		data.m_gltf = GltfScene();
+	}
+
+	data.m_sourceHash = MeshCache::HashSource(path);
+	const std::string cachePath = MeshCache::GetCachePath(path);
+	if(data.m_sourceHash != 0 && data.m_cache.Open(cachePath, data.m_sourceHash))
+	{
+		PROFILE_ZONE("Mesh Cache Load");
+		// geometry stays in the mapping, only the texture references are copied out
+		data.m_isFromCache = true;
+		data.m_meshes.resize(data.m_cache.GetMeshCount());
+		for(uint32_t i = 0; i < data.m_cache.GetMeshCount(); i++)
+		{
+			const MeshCacheEntry& entry = data.m_cache.GetMesh(i);
+			for(uint32_t j = 0; j < entry.m_textureRefCount; j++)
+			{
+				const MeshCacheTextureRef& ref = data.m_cache.GetTextureRef(entry.m_firstTextureRef + j);
+				data.m_meshes[i].m_textures.push_back({data.m_cache.GetString(ref.m_typeOffset), data.m_cache.GetString(ref.m_pathOffset)});
+			}
+			requestTextures(data.m_meshes[i], data);
+		}
+		for(uint32_t i = 0; i < data.m_cache.GetNodeCount(); i++)
+			data.m_nodes.AddNode(data.m_cache.GetNodeParents()[i], data.m_cache.GetNodeTransforms()[i]);
+		data.m_nodeMeshes.assign(data.m_cache.GetNodeMeshes(), data.m_cache.GetNodeMeshes() + data.m_cache.GetNodeMeshCount());
+		waitForTextures(data);
+		return true;
+	}
+
+	if(HasExtension(path, ".obj"))
+	{
+		// the parallel parser is several times faster than Assimp's obj import, see --import-bench
+		if(!LoadObj(path, data.m_meshes))
+			return false;
+		for(const MeshData& mesh : data.m_meshes)
+			requestTextures(mesh, data);
+		AddRootNode(static_cast<uint32_t>(data.m_meshes.size()), data.m_nodes, data.m_nodeMeshes);
+	}
+	else
+	{
+		Assimp::Importer importer;
+		// the importer owns the handler
+		importer.SetIOHandler(new AssetIOSystem());
+		const aiScene* scene;
+		{
+			PROFILE_ZONE("Assimp Import");
+			scene = importer.ReadFile(path, ASSIMP_IMPORT_FLAGS);
+		}
+		if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+		{
+			std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+			return false;
+		}
+		// each mesh once, in the file's order, however many nodes reference it
+		for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			data.m_meshes.push_back(processMesh(scene->mMeshes[i], scene));
+			requestTextures(data.m_meshes.back(), data);
+		}
+		flattenNodes(scene->mRootNode, data.m_nodes, data.m_nodeMeshes);
+	}
+	size_t geometryBytes = 0;
+	for(const MeshData& mesh : data.m_meshes)
+		geometryBytes += mesh.m_vertices.capacity() * sizeof(Vertex) + mesh.m_indices.capacity() * sizeof(unsigned int);
+	data.m_geometryMemory = TrackedAllocation(MEMORY_CPU_GEOMETRY, geometryBytes);
+	waitForTextures(data);
+
+	// cook on first load, every later run maps the result instead of importing again
+	if(data.m_sourceHash != 0 && !data.m_meshes.empty())
+		MeshCache::Write(cachePath, data.m_sourceHash, data.m_meshes, data.m_nodes, data.m_nodeMeshes);
+	return true;
+}
 
+inline void Model::flattenNodes(const aiNode* root, NodeHierarchy& nodes, std::vector<NodeMesh>& nodeMeshes)
+{
+	// depth first, children pushed in reverse so they come out in the file's order
+	struct PendingNode
+	{
+		const aiNode* m_node;
+		uint32_t m_parent;
+	};
+	std::vector<PendingNode> pending = {{root, NO_PARENT_NODE}};
+	while(!pending.empty())
+	{
+		const PendingNode next = pending.back();
+		pending.pop_back();
+		// assimp matrices are row major
+		const aiMatrix4x4& local = next.m_node->mTransformation;
+		const uint32_t node = nodes.AddNode(next.m_parent, glm::transpose(glm::make_mat4(&local.a1)));
+		for(unsigned int i = 0; i < next.m_node->mNumMeshes; i++)
+			nodeMeshes.push_back({node, next.m_node->mMeshes[i]});
+		for(unsigned int i = next.m_node->mNumChildren; i > 0; i--)
+			pending.push_back({next.m_node->mChildren[i - 1], node});
+	}
+}
+
+inline MeshData Model::processMesh(aiMesh* mesh, const aiScene* scene)
+{
+	PROFILE_ZONE("Process Mesh");
+	MeshData data;
+	std::vector<Vertex>& vertices = data.m_vertices;
+	std::vector<unsigned int>& indices = data.m_indices;
+	std::vector<TextureRef>& textures = data.m_textures;
+
+	vertices.reserve(mesh->mNumVertices);
 	for(unsigned int i = 0; i < mesh->mNumVertices; i++)
 	{
 		// process vertex positions, normals and texture coordinates
@@ -88,6 +432,7 @@ inline Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 		vertices.push_back(vertex);
 	}
 	// process indices
+	indices.reserve(mesh->mNumFaces * 3);
 	for(unsigned int i = 0; i < mesh->mNumFaces; i++)
 	{
 		aiFace face = mesh->mFaces[i];
@@ -96,84 +441,159 @@ inline Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
 	}
 	// process material
 	aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-	std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+	std::vector<TextureRef> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
 	textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-	std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+	std::vector<TextureRef> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
 	textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
-	return Mesh(vertices, indices, textures);
+	return data;
 }
 
-inline unsigned int Model::TextureFromFile(const char* path, const std::string& directory)
+inline std::vector<TextureRef> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
 {
-	unsigned int texture;
-	glGenTextures(1, &texture);
-
-	int width, height, nrChannels;
-	std::string fileName = directory + '/' + std::string(path);
-
-	unsigned char* textureData = stbi_load(fileName.c_str(), &width, &height, &nrChannels, 0);
-	if(!textureData)
+	std::vector<TextureRef> textures;
+	for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
 	{
-		std::cout << "ERROR::STBI::LOAD at file " << fileName << std::endl;
-		return -1;
+		aiString str;
+		mat->GetTexture(type, i, &str);
+		textures.push_back({typeName, str.C_Str()});
 	}
+	return textures;
+}
 
-	GLenum format;
-	if(nrChannels == 1)
-		format = GL_RED;
-	else if(nrChannels == 3)
-		format = GL_RGB;
-	else if(nrChannels == 4)
-		format = GL_RGBA;
-	else
+inline void Model::requestTextures(const MeshData& mesh, LoadData& data)
+{
+	for(const TextureRef& texture : mesh.m_textures)
 	{
-		std::cout << "ERROR::TextureFromFile::InvalidNrChannels at file " << fileName << std::endl;
-		return -1;
+		if(data.m_textureIndices.count(texture.m_path) != 0)
+			continue;
+		data.m_textureIndices.emplace(texture.m_path, data.m_textures.size());
+
+		const TextureUsage usage = texture.m_type == "texture_normal" ? TEXTURE_USAGE_NORMAL : TEXTURE_USAGE_COLOR;
+		bool mustLoad = false;
+		TextureHandle handle = GetTextureCache().Acquire(m_directory + '/' + texture.m_path, usage, mustLoad);
+		if(mustLoad && texture.m_data)
+		{
+			// embedded in the model, read from its mapping which outlives the decode
+			const uint8_t* bytes = texture.m_data;
+			const size_t size = texture.m_size;
+			data.m_decodes.push_back(GetThreadPool().Submit([handle, bytes, size]() { return GetTextureCache().Decode(handle, bytes, size); }));
+		}
+		else if(mustLoad)
+			data.m_decodes.push_back(GetThreadPool().Submit([handle]() { return GetTextureCache().Decode(handle); }));
+		else
+			data.m_decodes.emplace_back();
+		data.m_textures.push_back(std::move(handle));
 	}
+}
 
-	glBindTexture(GL_TEXTURE_2D, texture);
+inline void Model::waitForTextures(LoadData& data)
+{
+	PROFILE_ZONE("Wait For Decode");
+	data.m_images.resize(data.m_decodes.size());
+	for(size_t i = 0; i < data.m_decodes.size(); i++)
+	{
+		if(data.m_decodes[i].valid())
+			data.m_images[i] = GetThreadPool().Wait(data.m_decodes[i]);
+	}
+	data.m_decodes.clear();
+	size_t imageBytes = 0;
+	for(const DecodedImage& image : data.m_images)
+		imageBytes += image.GetMemorySize();
+	data.m_imageMemory = TrackedAllocation(MEMORY_CPU_TEXTURE, imageBytes);
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+inline void Model::uploadTexture(LoadData& data, size_t index)
+{
+	GetTextureCache().Upload(data.m_textures[index], data.m_images[index]);
+	// the pixels aren't needed anymore once they are on the gpu
+	data.m_imageMemory.Resize(data.m_imageMemory.GetBytes() - data.m_images[index].GetMemorySize());
+	data.m_images[index] = DecodedImage();
+}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, textureData);
-	glGenerateMipmap(GL_TEXTURE_2D);
+inline void Model::uploadBuffer(LoadData& data, size_t index)
+{
+	// glTF vertex and index data goes to the gpu as it is in the file, no conversion and no copy
+	const GltfBufferView& view = data.m_gltf.m_views[index];
+	m_buffers[index] = GlBuffer(MEMORY_GPU_MESH);
+	m_buffers[index].SetData(GL_ARRAY_BUFFER, view.m_size, view.m_data, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-	stbi_image_free(textureData);
+inline void Model::uploadMesh(LoadData& data, size_t index)
+{
+	MeshData& mesh = data.m_meshes[index];
+	std::vector<Texture> textures;
+	for(const TextureRef& ref : mesh.m_textures)
+	{
+		Texture texture;
+		texture.m_handle = data.m_textures[data.m_textureIndices[ref.m_path]];
+		texture.m_type = ref.m_type;
+		texture.m_path = ref.m_path.c_str();
+		textures.push_back(texture);
+	}
 
-	return texture;
+	if(data.m_isGltf)
+	{
+		const GltfPrimitive& primitive = data.m_gltf.m_primitives[index];
+		MeshBufferLayout layout = primitive.m_layout;
+		for(VertexAttributeBinding& attribute : layout.m_attributes)
+			attribute.m_buffer = attribute.m_buffer != 0 ? m_buffers[attribute.m_buffer - 1].GetId() : 0;
+		layout.m_indexBuffer = layout.m_indexBuffer != 0 ? m_buffers[layout.m_indexBuffer - 1].GetId() : 0;
+		meshes.emplace_back(layout, textures, primitive.m_boundsMin, primitive.m_boundsMax);
+	}
+	else if(data.m_isFromCache)
+	{
+		const MeshCacheEntry& entry = data.m_cache.GetMesh(static_cast<uint32_t>(index));
+		const glm::vec3 boundsMin(entry.m_boundsMin[0], entry.m_boundsMin[1], entry.m_boundsMin[2]);
+		const glm::vec3 boundsMax(entry.m_boundsMax[0], entry.m_boundsMax[1], entry.m_boundsMax[2]);
+		meshes.emplace_back(data.m_cache.GetVertices(entry), entry.m_vertexCount, data.m_cache.GetIndices(entry), entry.m_indexCount, textures,
+							boundsMin, boundsMax, m_geometryPolicy);
+	}
+	else
+	{
+		// the mesh keeps the vectors or frees them, either way they stop being the import's
+		const size_t geometryBytes = mesh.m_vertices.capacity() * sizeof(Vertex) + mesh.m_indices.capacity() * sizeof(unsigned int);
+		meshes.emplace_back(std::move(mesh.m_vertices), std::move(mesh.m_indices), textures, m_geometryPolicy);
+		data.m_geometryMemory.Resize(data.m_geometryMemory.GetBytes() - geometryBytes);
+	}
+	m_materialFlags |= meshes.back().GetMaterialFlags();
 }
 
-inline std::vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
+inline void Model::finishLoad(LoadData& data)
 {
-	std::vector<Texture> textures;
-	for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
+	m_nodes = std::move(data.m_nodes);
+	m_nodeMeshes = std::move(data.m_nodeMeshes);
+	std::stable_sort(m_nodeMeshes.begin(), m_nodeMeshes.end(), [](const NodeMesh& a, const NodeMesh& b) { return a.m_mesh < b.m_mesh; });
+	m_meshInstanceStarts.assign(meshes.size() + 1, 0);
+	for(const NodeMesh& nodeMesh : m_nodeMeshes)
+		m_meshInstanceStarts[nodeMesh.m_mesh + 1]++;
+	for(size_t i = 1; i < m_meshInstanceStarts.size(); i++)
+		m_meshInstanceStarts[i] += m_meshInstanceStarts[i - 1];
+	updateInstances();
+
+	for(size_t i = 0; i < m_nodeMeshes.size(); i++)
 	{
-		aiString str;
-		mat->GetTexture(type, i, &str);
-		bool wasTextureLoadedBefore = false;
-		for(unsigned int j = 0; j < textures_loaded.size(); j++)
+		const Mesh& mesh = meshes[m_nodeMeshes[i].m_mesh];
+		for(int corner = 0; corner < 8; corner++)
 		{
-			if(std::strcmp(textures_loaded[j].m_path.data, str.C_Str()) == 0)
-			{
-				textures.push_back(textures_loaded[j]);
-				wasTextureLoadedBefore = true;
-				break;
-			}
-		}
-		if(!wasTextureLoadedBefore)
-		{
-			Texture texture;
-			texture.m_id = TextureFromFile(str.C_Str(), m_directory);
-			texture.m_type = typeName;
-			texture.m_path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture);
+			const glm::vec3 local(corner & 1 ? mesh.m_boundsMax.x : mesh.m_boundsMin.x, corner & 2 ? mesh.m_boundsMax.y : mesh.m_boundsMin.y,
+								  corner & 4 ? mesh.m_boundsMax.z : mesh.m_boundsMin.z);
+			const glm::vec3 position = glm::vec3(m_instanceTransforms[i] * glm::vec4(local, 1.0f));
+			m_boundsMin = i == 0 && corner == 0 ? position : glm::min(m_boundsMin, position);
+			m_boundsMax = i == 0 && corner == 0 ? position : glm::max(m_boundsMax, position);
 		}
 	}
-	return textures;
+	// the meshes are on the gpu, the mappings aren't needed anymore
+	data.m_cache.Close();
+	data.m_gltf = GltfScene();
+	m_loadTimes.m_uploadEndNs = CpuProfiler::NowNs();
+	m_isReady.store(true, std::memory_order_release);
 }
 
+inline void Model::updateInstances()
+{
+	m_nodes.Update();
+	m_instanceTransforms.resize(m_nodeMeshes.size());
+	for(size_t i = 0; i < m_nodeMeshes.size(); i++)
+		m_instanceTransforms[i] = m_nodes.GetWorldTransform(m_nodeMeshes[i].m_node);
+}
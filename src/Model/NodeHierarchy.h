@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/ThreadPool.h"
+
+// parent of the root nodes
+constexpr uint32_t NO_PARENT_NODE = UINT32_MAX;
+// hierarchies smaller than this are updated on the calling thread
+constexpr uint32_t HIERARCHY_PARALLEL_MIN_NODES = 4096;
+
+// a mesh drawn at a node, both are indices into the model's
+struct NodeMesh
+{
+	uint32_t m_node;
+	uint32_t m_mesh;
+};
+
+/*
+* A model's node tree flattened in depth first order: every node comes after its parent and the
+* nodes of a subtree are contiguous, so a single front to back pass sees each parent's world
+* transform before its children need it.
+* SetLocalTransform only marks the node dirty, Update recomputes the world transforms of the dirty
+* nodes and of everything below them. Large hierarchies are split into the nodes at the top and
+* whole subtrees under them, the top is walked first and the subtrees on the thread pool.
+*/
+class NodeHierarchy
+{
+public:
+	// parent is NO_PARENT_NODE or the last node added or one of its ancestors, NO_PARENT_NODE otherwise
+	uint32_t AddNode(uint32_t parent, const glm::mat4& localTransform);
+	void SetLocalTransform(uint32_t node, const glm::mat4& localTransform);
+	// brings the world transforms up to date, false when nothing was dirty
+	bool Update();
+
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_parents.size()); }
+	uint32_t GetParent(uint32_t node) const { return m_parents[node]; }
+	const glm::mat4& GetLocalTransform(uint32_t node) const { return m_localTransforms[node]; }
+	// valid after Update
+	const glm::mat4& GetWorldTransform(uint32_t node) const { return m_worldTransforms[node]; }
+	bool IsDirty() const { return m_isAnyDirty; }
+
+	// whether count parents (by node) describe a depth first order AddNode accepts
+	static bool IsDepthFirst(const uint32_t* parents, uint32_t count);
+
+private:
+	void updateNode(uint32_t node);
+	void partition();
+
+	// by node
+	std::vector<uint32_t> m_parents;
+	// one past the last node of each node's subtree
+	std::vector<uint32_t> m_subtreeEnds;
+	std::vector<glm::mat4> m_localTransforms;
+	std::vector<glm::mat4> m_worldTransforms;
+	// set by SetLocalTransform, spreads to the children during Update and is cleared after it
+	std::vector<uint8_t> m_isDirty;
+	bool m_isAnyDirty = false;
+
+	// the parallel split, redone when nodes were added since
+	uint32_t m_partitionNodeCount = 0;
+	std::vector<uint32_t> m_topNodes;
+	std::vector<uint32_t> m_subtreeRoots;
+};
+
+inline uint32_t NodeHierarchy::AddNode(uint32_t parent, const glm::mat4& localTransform)
+{
+	const uint32_t node = GetNodeCount();
+	// the last node is inside the parent's subtree exactly when that subtree ends at the new node
+	if(parent != NO_PARENT_NODE && (parent >= node || m_subtreeEnds[parent] != node))
+	{
+		std::cout << "ERROR::NODE_HIERARCHY::NOT_DEPTH_FIRST " << node << std::endl;
+		return NO_PARENT_NODE;
+	}
+	for(uint32_t ancestor = parent; ancestor != NO_PARENT_NODE; ancestor = m_parents[ancestor])
+		m_subtreeEnds[ancestor] = node + 1;
+	m_parents.push_back(parent);
+	m_subtreeEnds.push_back(node + 1);
+	m_localTransforms.push_back(localTransform);
+	m_worldTransforms.push_back(localTransform);
+	m_isDirty.push_back(1);
+	m_isAnyDirty = true;
+	return node;
+}
+
+inline void NodeHierarchy::SetLocalTransform(uint32_t node, const glm::mat4& localTransform)
+{
+	m_localTransforms[node] = localTransform;
+	m_isDirty[node] = 1;
+	m_isAnyDirty = true;
+}
+
+inline bool NodeHierarchy::Update()
+{
+	if(!m_isAnyDirty)
+		return false;
+	PROFILE_ZONE("Update Node Transforms");
+	const uint32_t count = GetNodeCount();
+	if(count < HIERARCHY_PARALLEL_MIN_NODES)
+	{
+		for(uint32_t node = 0; node < count; node++)
+			updateNode(node);
+	}
+	else
+	{
+		if(m_partitionNodeCount != count)
+			partition();
+		for(uint32_t node : m_topNodes)
+			updateNode(node);
+		// the subtrees share nothing but their parents in m_topNodes, already done
+		GetThreadPool().ParallelFor(static_cast<uint32_t>(m_subtreeRoots.size()), [this](uint32_t begin, uint32_t end) {
+			for(uint32_t i = begin; i < end; i++)
+			{
+				const uint32_t root = m_subtreeRoots[i];
+				for(uint32_t node = root; node < m_subtreeEnds[root]; node++)
+					updateNode(node);
+			}
+		});
+	}
+	std::fill(m_isDirty.begin(), m_isDirty.end(), 0);
+	m_isAnyDirty = false;
+	return true;
+}
+
+inline bool NodeHierarchy::IsDepthFirst(const uint32_t* parents, uint32_t count)
+{
+	std::vector<uint32_t> subtreeEnds(count);
+	for(uint32_t node = 0; node < count; node++)
+	{
+		const uint32_t parent = parents[node];
+		if(parent != NO_PARENT_NODE && (parent >= node || subtreeEnds[parent] != node))
+			return false;
+		for(uint32_t ancestor = parent; ancestor != NO_PARENT_NODE; ancestor = parents[ancestor])
+			subtreeEnds[ancestor] = node + 1;
+		subtreeEnds[node] = node + 1;
+	}
+	return true;
+}
+
+inline void NodeHierarchy::updateNode(uint32_t node)
+{
+	const uint32_t parent = m_parents[node];
+	if(parent != NO_PARENT_NODE && m_isDirty[parent])
+		m_isDirty[node] = 1;
+	if(!m_isDirty[node])
+		return;
+	m_worldTransforms[node] = parent != NO_PARENT_NODE ? m_worldTransforms[parent] * m_localTransforms[node] : m_localTransforms[node];
+}
+
+inline void NodeHierarchy::partition()
+{
+	// a few subtrees per thread, big enough to be worth handing out
+	const uint32_t count = GetNodeCount();
+	const uint32_t maxSubtreeSize = std::max(256u, count / std::max(1u, GetThreadPool().GetThreadCount() * 4));
+	m_topNodes.clear();
+	m_subtreeRoots.clear();
+	for(uint32_t node = 0; node < count;)
+	{
+		if(m_subtreeEnds[node] - node <= maxSubtreeSize)
+		{
+			m_subtreeRoots.push_back(node);
+			node = m_subtreeEnds[node];
+		}
+		else
+		{
+			m_topNodes.push_back(node);
+			node++;
+		}
+	}
+	m_partitionNodeCount = count;
+}
@@ -0,0 +1,532 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Mesh/Mesh.h"
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/ThreadPool.h"
+
+/*
+* Wavefront OBJ/MTL import without Assimp. The file is mapped and cut into line aligned chunks that
+* are parsed in parallel, each into its own attribute and face arrays. Face indices are global, so
+* they are resolved once every chunk's attribute counts are known.
+* Faces are grouped into one mesh per material. Each distinct position/uv/normal triple becomes one
+* vertex (Assimp's obj import makes a vertex per face corner instead). The output matches the
+* Assimp import flags Model used: polygons fanned into triangles, uvs flipped.
+*/
+namespace Obj
+{
+	// chunks per worker, chunks cost different amounts when faces and attributes aren't spread evenly
+	constexpr uint32_t CHUNKS_PER_THREAD = 4;
+	// below this a chunk isn't worth a job
+	constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+	constexpr uint32_t NO_INDEX = 0xFFFFFFFF;
+
+	struct Corner
+	{
+		// global and 0 based once resolved, NO_INDEX when the face doesn't give one
+		uint32_t m_index[3];
+	};
+
+	struct MaterialRun
+	{
+		// first triangle corner using the material
+		size_t m_firstCorner;
+		std::string m_name;
+	};
+
+	struct Chunk
+	{
+		const char* m_begin = nullptr;
+		const char* m_end = nullptr;
+		std::vector<glm::vec3> m_positions;
+		std::vector<glm::vec2> m_texCoords;
+		std::vector<glm::vec3> m_normals;
+		// three per triangle. Negative (relative) indices are kept relative to the chunk until the
+		// counts of the chunks before are known, m_isRelative marks them
+		std::vector<Corner> m_corners;
+		std::vector<uint8_t> m_isRelative;
+		std::vector<MaterialRun> m_materialRuns;
+		std::vector<std::string> m_materialLibraries;
+	};
+
+	struct Material
+	{
+		std::string m_diffuseMap;
+		std::string m_specularMap;
+	};
+
+	inline bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+
+	inline const char* SkipSpaces(const char* p, const char* end)
+	{
+		while(p < end && IsSpace(*p))
+			p++;
+		return p;
+	}
+
+	// eight ascii digits, read as a little endian 64 bit word (SWAR)
+	inline bool IsEightDigits(uint64_t word)
+	{
+		return ((word & 0xF0F0F0F0F0F0F0F0ULL) | (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+	}
+
+	inline uint32_t ParseEightDigits(uint64_t word)
+	{
+		word -= 0x3030303030303030ULL;
+		word = word * 10 + (word >> 8);
+		word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+		return static_cast<uint32_t>(word);
+	}
+
+	// appends the digits at p to mantissa, eight at a time while there are that many. Leading zeros
+	// don't count as significant. Digits past the 19 that fit in the mantissa are only counted
+	inline const char* ParseDigits(const char* p, const char* end, uint64_t& mantissa, int& significantCount, int& droppedCount)
+	{
+		while(end - p >= 8 && significantCount + 8 <= 19)
+		{
+			uint64_t word;
+			std::memcpy(&word, p, sizeof(word));
+			if(!IsEightDigits(word))
+				break;
+			mantissa = mantissa * 100000000ULL + ParseEightDigits(word);
+			if(mantissa != 0)
+				significantCount += 8;
+			p += 8;
+		}
+		while(p < end && *p >= '0' && *p <= '9')
+		{
+			if(significantCount < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+				if(mantissa != 0)
+					significantCount++;
+			}
+			else
+			{
+				droppedCount++;
+			}
+			p++;
+		}
+		return p;
+	}
+
+	/*
+	* Locale independent decimal float parse, much faster than strtof. The mantissa is collected as an
+	* integer and scaled once by an exact power of ten, which is exact in double for what obj files
+	* hold (up to 15 significant digits), so the float result is correctly rounded there too.
+	*/
+	inline const char* ParseFloat(const char* p, const char* end, float& value)
+	{
+		static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+											   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+		p = SkipSpaces(p, end);
+		const bool isNegative = p < end && *p == '-';
+		if(p < end && (*p == '-' || *p == '+'))
+			p++;
+
+		uint64_t mantissa = 0;
+		int significantCount = 0;
+		int droppedCount = 0;
+		const char* digits = p;
+		p = ParseDigits(p, end, mantissa, significantCount, droppedCount);
+		// integer digits that didn't fit still scale the value up
+		int exponent = droppedCount;
+		if(p < end && *p == '.')
+		{
+			// fraction digits that made it into the mantissa scale it down
+			const char* fraction = p + 1;
+			const int droppedBefore = droppedCount;
+			p = ParseDigits(fraction, end, mantissa, significantCount, droppedCount);
+			exponent -= static_cast<int>(p - fraction) - (droppedCount - droppedBefore);
+		}
+		if(p == digits)
+		{
+			value = 0.0f;
+			return p;
+		}
+		if(p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			const bool isExponentNegative = e < end && *e == '-';
+			if(e < end && (*e == '-' || *e == '+'))
+				e++;
+			int written = 0;
+			while(e < end && *e >= '0' && *e <= '9')
+			{
+				written = std::min(written * 10 + (*e - '0'), 1000);
+				e++;
+			}
+			exponent += isExponentNegative ? -written : written;
+			p = e;
+		}
+
+		double result = static_cast<double>(mantissa);
+		while(exponent > 22)
+		{
+			result *= 1e22;
+			exponent -= 22;
+		}
+		while(exponent < -22)
+		{
+			result /= 1e22;
+			exponent += 22;
+		}
+		result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+		value = static_cast<float>(isNegative ? -result : result);
+		return p;
+	}
+
+	inline const char* ParseInt(const char* p, const char* end, int64_t& value)
+	{
+		const bool isNegative = p < end && *p == '-';
+		if(p < end && (*p == '-' || *p == '+'))
+			p++;
+		int64_t result = 0;
+		while(p < end && *p >= '0' && *p <= '9')
+		{
+			result = result * 10 + (*p - '0');
+			p++;
+		}
+		value = isNegative ? -result : result;
+		return p;
+	}
+
+	// the rest of the line without surrounding spaces
+	inline std::string GetRestOfLine(const char* p, const char* end)
+	{
+		p = SkipSpaces(p, end);
+		while(end > p && (IsSpace(end[-1]) || end[-1] == '\r'))
+			end--;
+		return std::string(p, end);
+	}
+
+	inline bool StartsWith(const char* p, const char* end, const char* keyword)
+	{
+		const size_t length = std::strlen(keyword);
+		return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+	}
+
+	// one v/vt/vn corner of a face line
+	inline const char* ParseCorner(const char* p, const char* end, const Chunk& chunk, Corner& corner, uint8_t& isRelative)
+	{
+		const size_t counts[3] = {chunk.m_positions.size(), chunk.m_texCoords.size(), chunk.m_normals.size()};
+		isRelative = 0;
+		for(int i = 0; i < 3; i++)
+		{
+			corner.m_index[i] = NO_INDEX;
+			if(i > 0)
+			{
+				if(p >= end || *p != '/')
+					continue;
+				p++;
+			}
+			if(p >= end || (*p != '-' && (*p < '0' || *p > '9')))
+				continue;
+			int64_t index;
+			p = ParseInt(p, end, index);
+			if(index > 0)
+			{
+				corner.m_index[i] = static_cast<uint32_t>(index - 1);
+			}
+			else if(index < 0)
+			{
+				// may point into an earlier chunk, stored as an offset from this chunk's first element
+				corner.m_index[i] = static_cast<uint32_t>(static_cast<int64_t>(counts[i]) + index);
+				isRelative |= static_cast<uint8_t>(1 << i);
+			}
+		}
+		return p;
+	}
+
+	inline void ParseChunk(Chunk& chunk)
+	{
+		PROFILE_ZONE("Obj Parse Chunk");
+		const char* p = chunk.m_begin;
+		const char* const end = chunk.m_end;
+		while(p < end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			if(!lineEnd)
+				lineEnd = end;
+			const char* line = SkipSpaces(p, lineEnd);
+			p = lineEnd + 1;
+
+			if(lineEnd - line < 2)
+				continue;
+			if(line[0] == 'v' && IsSpace(line[1]))
+			{
+				glm::vec3 position;
+				const char* q = ParseFloat(line + 2, lineEnd, position.x);
+				q = ParseFloat(q, lineEnd, position.y);
+				ParseFloat(q, lineEnd, position.z);
+				chunk.m_positions.push_back(position);
+			}
+			else if(line[0] == 'v' && line[1] == 't' && lineEnd - line > 2 && IsSpace(line[2]))
+			{
+				glm::vec2 texCoord;
+				const char* q = ParseFloat(line + 3, lineEnd, texCoord.x);
+				ParseFloat(q, lineEnd, texCoord.y);
+				chunk.m_texCoords.push_back(texCoord);
+			}
+			else if(line[0] == 'v' && line[1] == 'n' && lineEnd - line > 2 && IsSpace(line[2]))
+			{
+				glm::vec3 normal;
+				const char* q = ParseFloat(line + 3, lineEnd, normal.x);
+				q = ParseFloat(q, lineEnd, normal.y);
+				ParseFloat(q, lineEnd, normal.z);
+				chunk.m_normals.push_back(normal);
+			}
+			else if(line[0] == 'f' && IsSpace(line[1]))
+			{
+				// polygons become a fan around the first corner
+				Corner first, previous, corner;
+				uint8_t firstRelative = 0, previousRelative = 0, relative = 0;
+				int cornerCount = 0;
+				const char* q = SkipSpaces(line + 2, lineEnd);
+				while(q < lineEnd && *q != '\r')
+				{
+					const char* next = ParseCorner(q, lineEnd, chunk, corner, relative);
+					if(next == q)
+						break;
+					q = SkipSpaces(next, lineEnd);
+					// a relative index can wrap to NO_INDEX until it is resolved
+					if(corner.m_index[0] == NO_INDEX && !(relative & 1))
+						continue;
+					if(cornerCount >= 2)
+					{
+						chunk.m_corners.insert(chunk.m_corners.end(), {first, previous, corner});
+						chunk.m_isRelative.insert(chunk.m_isRelative.end(), {firstRelative, previousRelative, relative});
+					}
+					if(cornerCount == 0)
+					{
+						first = corner;
+						firstRelative = relative;
+					}
+					previous = corner;
+					previousRelative = relative;
+					cornerCount++;
+				}
+			}
+			else if(StartsWith(line, lineEnd, "usemtl"))
+			{
+				chunk.m_materialRuns.push_back({chunk.m_corners.size(), GetRestOfLine(line + 6, lineEnd)});
+			}
+			else if(StartsWith(line, lineEnd, "mtllib"))
+			{
+				chunk.m_materialLibraries.push_back(GetRestOfLine(line + 6, lineEnd));
+			}
+		}
+	}
+
+	// texture paths are the last word of a map_ line, options like -bm 0.5 come before it
+	inline void LoadMaterials(const std::string& path, std::unordered_map<std::string, Material>& materials)
+	{
+		AssetFile file;
+		if(!file.Open(path.c_str()))
+		{
+			std::cout << "ERROR::OBJ::MATERIAL_LIBRARY_NOT_FOUND " << path << std::endl;
+			return;
+		}
+		const char* p = reinterpret_cast<const char*>(file.GetData());
+		const char* const end = p + file.GetSize();
+		Material* material = nullptr;
+		while(p < end)
+		{
+			const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+			if(!lineEnd)
+				lineEnd = end;
+			const char* line = SkipSpaces(p, lineEnd);
+			p = lineEnd + 1;
+
+			if(StartsWith(line, lineEnd, "newmtl"))
+			{
+				material = &materials[GetRestOfLine(line + 6, lineEnd)];
+				continue;
+			}
+			if(!material)
+				continue;
+			const bool isDiffuse = StartsWith(line, lineEnd, "map_Kd");
+			const bool isSpecular = StartsWith(line, lineEnd, "map_Ks");
+			if(!isDiffuse && !isSpecular)
+				continue;
+			std::string texture = GetRestOfLine(line + 6, lineEnd);
+			const size_t lastSpace = texture.find_last_of(" \t");
+			if(lastSpace != std::string::npos)
+				texture = texture.substr(lastSpace + 1);
+			(isDiffuse ? material->m_diffuseMap : material->m_specularMap) = texture;
+		}
+	}
+
+	struct VertexKey
+	{
+		uint32_t m_index[3];
+	};
+
+	// builds one mesh out of the triangle corners, one vertex per distinct index triple
+	inline void BuildMesh(const std::vector<const Corner*>& corners, const std::vector<glm::vec3>& positions,
+						  const std::vector<glm::vec2>& texCoords, const std::vector<glm::vec3>& normals, MeshData& mesh)
+	{
+		PROFILE_ZONE("Obj Build Mesh");
+		// open addressing, at most half full. Slots hold vertex index + 1, 0 is empty
+		size_t capacity = 16;
+		while(capacity < corners.size() * 2)
+			capacity *= 2;
+		std::vector<uint32_t> slots(capacity, 0);
+		std::vector<VertexKey> keys;
+		keys.reserve(corners.size() / 2);
+		mesh.m_vertices.reserve(corners.size() / 2);
+		mesh.m_indices.reserve(corners.size());
+
+		for(const Corner* corner : corners)
+		{
+			const uint32_t* index = corner->m_index;
+			uint64_t hash = index[0] * 0x9E3779B97F4A7C15ULL;
+			hash ^= (hash >> 29) + index[1] * 0xC2B2AE3D27D4EB4FULL;
+			hash ^= (hash >> 32) + index[2] * 0x165667B19E3779F9ULL;
+			size_t slot = static_cast<size_t>(hash ^ (hash >> 31)) & (capacity - 1);
+			while(slots[slot] != 0)
+			{
+				const VertexKey& key = keys[slots[slot] - 1];
+				if(key.m_index[0] == index[0] && key.m_index[1] == index[1] && key.m_index[2] == index[2])
+					break;
+				slot = (slot + 1) & (capacity - 1);
+			}
+			if(slots[slot] == 0)
+			{
+				Vertex vertex;
+				vertex.m_position = index[0] < positions.size() ? positions[index[0]] : glm::vec3(0.0f);
+				vertex.m_texCoords = index[1] < texCoords.size() ? glm::vec2(texCoords[index[1]].x, 1.0f - texCoords[index[1]].y) : glm::vec2(0.0f);
+				vertex.m_normal = index[2] < normals.size() ? normals[index[2]] : glm::vec3(0.0f);
+				mesh.m_vertices.push_back(vertex);
+				keys.push_back({{index[0], index[1], index[2]}});
+				slots[slot] = static_cast<uint32_t>(keys.size());
+			}
+			mesh.m_indices.push_back(slots[slot] - 1);
+		}
+	}
+}
+
+// any thread. meshes gets one mesh per material, texture paths relative to the obj's directory
+inline bool LoadObj(const std::string& path, std::vector<MeshData>& meshes)
+{
+	using namespace Obj;
+	PROFILE_ZONE("Obj Load");
+	AssetFile file;
+	if(!file.Open(path.c_str()))
+	{
+		std::cout << "ERROR::OBJ::FILE_NOT_FOUND " << path << std::endl;
+		return false;
+	}
+
+	// line aligned chunks, each cut starts right after a newline
+	const char* const data = reinterpret_cast<const char*>(file.GetData());
+	const char* const dataEnd = data + file.GetSize();
+	ThreadPool& pool = GetThreadPool();
+	const size_t chunkCount = std::max<size_t>(1, std::min<size_t>((pool.GetThreadCount() + 1) * CHUNKS_PER_THREAD, file.GetSize() / MIN_CHUNK_SIZE));
+	std::vector<Chunk> chunks(chunkCount);
+	const char* cut = data;
+	for(size_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].m_begin = cut;
+		const char* target = i + 1 == chunkCount ? dataEnd : data + file.GetSize() * (i + 1) / chunkCount;
+		if(target < cut)
+			target = cut;
+		const char* newline = target < dataEnd ? static_cast<const char*>(std::memchr(target, '\n', dataEnd - target)) : nullptr;
+		cut = newline ? newline + 1 : dataEnd;
+		chunks[i].m_end = cut;
+	}
+
+	pool.ParallelFor(static_cast<uint32_t>(chunkCount), [&chunks](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+			ParseChunk(chunks[i]);
+	});
+
+	// where each chunk's attributes start in the whole file
+	std::vector<size_t> firsts[3];
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec2> texCoords;
+	std::vector<glm::vec3> normals;
+	{
+		PROFILE_ZONE("Obj Merge");
+		for(Chunk& chunk : chunks)
+		{
+			firsts[0].push_back(positions.size());
+			firsts[1].push_back(texCoords.size());
+			firsts[2].push_back(normals.size());
+			positions.insert(positions.end(), chunk.m_positions.begin(), chunk.m_positions.end());
+			texCoords.insert(texCoords.end(), chunk.m_texCoords.begin(), chunk.m_texCoords.end());
+			normals.insert(normals.end(), chunk.m_normals.begin(), chunk.m_normals.end());
+		}
+	}
+	pool.ParallelFor(static_cast<uint32_t>(chunkCount), [&chunks, &firsts](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			Chunk& chunk = chunks[i];
+			for(size_t c = 0; c < chunk.m_corners.size(); c++)
+			{
+				for(int a = 0; a < 3; a++)
+				{
+					if(chunk.m_isRelative[c] & (1 << a))
+						chunk.m_corners[c].m_index[a] += static_cast<uint32_t>(firsts[a][i]);
+				}
+			}
+		}
+	});
+
+	// materials in order of first use, faces before any usemtl use the default material ""
+	std::unordered_map<std::string, Material> materials;
+	const std::string directory = path.substr(0, path.find_last_of('/') + 1);
+	std::vector<std::string> materialNames;
+	std::unordered_map<std::string, size_t> materialIndices;
+	std::vector<std::vector<const Corner*>> materialCorners;
+	std::string current;
+	for(Chunk& chunk : chunks)
+	{
+		for(const std::string& library : chunk.m_materialLibraries)
+			LoadMaterials(directory + library, materials);
+
+		size_t run = 0;
+		for(size_t c = 0; c < chunk.m_corners.size(); c++)
+		{
+			while(run < chunk.m_materialRuns.size() && chunk.m_materialRuns[run].m_firstCorner <= c)
+				current = chunk.m_materialRuns[run++].m_name;
+			auto found = materialIndices.find(current);
+			if(found == materialIndices.end())
+			{
+				found = materialIndices.emplace(current, materialNames.size()).first;
+				materialNames.push_back(current);
+				materialCorners.emplace_back();
+			}
+			materialCorners[found->second].push_back(&chunk.m_corners[c]);
+		}
+		if(!chunk.m_materialRuns.empty())
+			current = chunk.m_materialRuns.back().m_name;
+	}
+
+	meshes.resize(materialNames.size());
+	pool.ParallelFor(static_cast<uint32_t>(meshes.size()), [&](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+			BuildMesh(materialCorners[i], positions, texCoords, normals, meshes[i]);
+	});
+
+	for(size_t i = 0; i < meshes.size(); i++)
+	{
+		auto material = materials.find(materialNames[i]);
+		if(material == materials.end())
+			continue;
+		if(!material->second.m_diffuseMap.empty())
+			meshes[i].m_textures.push_back({"texture_diffuse", material->second.m_diffuseMap});
+		if(!material->second.m_specularMap.empty())
+			meshes[i].m_textures.push_back({"texture_specular", material->second.m_specularMap});
+	}
+	return true;
+}
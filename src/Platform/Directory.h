@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// true for an existing regular file, without opening it
+inline bool IsFile(const std::string& path)
+{
+#ifdef _WIN32
+	const DWORD attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat status;
+	return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+#endif
+}
+
+// appends every file below directory, recursively, as directory/sub/name with forward slashes
+inline void ListFiles(const std::string& directory, std::vector<std::string>& files)
+{
+	std::vector<std::string> pending = {directory};
+	while(!pending.empty())
+	{
+		const std::string current = pending.back();
+		pending.pop_back();
+#ifdef _WIN32
+		WIN32_FIND_DATAA found;
+		const HANDLE search = FindFirstFileA((current + "/*").c_str(), &found);
+		if(search == INVALID_HANDLE_VALUE)
+			continue;
+		do
+		{
+			const std::string name = found.cFileName;
+			if(name == "." || name == "..")
+				continue;
+			if(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				pending.push_back(current + '/' + name);
+			else
+				files.push_back(current + '/' + name);
+		} while(FindNextFileA(search, &found));
+		FindClose(search);
+#else
+		DIR* search = opendir(current.c_str());
+		if(!search)
+			continue;
+		while(const dirent* found = readdir(search))
+		{
+			const std::string name = found->d_name;
+			if(name == "." || name == "..")
+				continue;
+			struct stat status;
+			const std::string path = current + '/' + name;
+			if(stat(path.c_str(), &status) != 0)
+				continue;
+			if(S_ISDIR(status.st_mode))
+				pending.push_back(path);
+			else if(S_ISREG(status.st_mode))
+				files.push_back(path);
+		}
+		closedir(search);
+#endif
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// how much of the OS file cache DropFileCache got rid of
+enum FileCacheDrop
+{
+	FILE_CACHE_DROP_NONE,
+	// the cached pages of the files given
+	FILE_CACHE_DROP_FILES,
+	// the whole page cache, which needs root on linux
+	FILE_CACHE_DROP_SYSTEM,
+};
+
+inline const char* GetFileCacheDropName(FileCacheDrop drop)
+{
+	return drop == FILE_CACHE_DROP_SYSTEM ? "system" : drop == FILE_CACHE_DROP_FILES ? "files" : "none";
+}
+
+/*
+* Evicts files from the OS file cache, so the next read of them comes from the disk like after a
+* reboot. Drops the whole page cache where permitted, else the cached pages of each file. Pages
+* someone else has mapped or opened (on windows) stay cached.
+*/
+inline FileCacheDrop DropFileCache(const std::vector<std::string>& files)
+{
+#ifdef _WIN32
+	// opening a file unbuffered purges its cached pages, unless another handle has it open
+	bool isAnyDropped = false;
+	for(const std::string& path : files)
+	{
+		const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+		if(file == INVALID_HANDLE_VALUE)
+			continue;
+		CloseHandle(file);
+		isAnyDropped = true;
+	}
+	return isAnyDropped ? FILE_CACHE_DROP_FILES : FILE_CACHE_DROP_NONE;
+#else
+	// only clean pages are dropped
+	sync();
+#ifdef __linux__
+	if(FILE* dropCaches = std::fopen("/proc/sys/vm/drop_caches", "w"))
+	{
+		const bool isDropped = std::fputs("1\n", dropCaches) >= 0;
+		if(std::fclose(dropCaches) == 0 && isDropped)
+			return FILE_CACHE_DROP_SYSTEM;
+	}
+#endif
+	bool isAnyDropped = false;
+#ifdef POSIX_FADV_DONTNEED
+	for(const std::string& path : files)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			continue;
+		isAnyDropped |= posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+		close(fd);
+	}
+#endif
+	return isAnyDropped ? FILE_CACHE_DROP_FILES : FILE_CACHE_DROP_NONE;
+#endif
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstdio>
+#include <glad/glad.h>
+#include <iostream>
+
+#ifdef __linux__
+#include <dlfcn.h>
+#else
+#include <GLFW/glfw3.h>
+#endif
+
+/*
+* GL context without a window, for benchmarking on machines without a display.
+* On linux this is an EGL surfaceless context (EGL_MESA_platform_surfaceless), which also works
+* on Mesa's llvmpipe when there is no GPU at all. libEGL is loaded at runtime, so the game does
+* not need to link against it. Elsewhere it falls back to an invisible GLFW window.
+* Either way there is no default framebuffer to draw into, render into a RenderTarget instead.
+*/
+class HeadlessContext
+{
+public:
+	bool Create(int glMajor, int glMinor);
+	void Destroy();
+
+	// pass to gladLoadGLLoader / LoadGlExtensions
+	static GLADloadproc GetLoader();
+
+private:
+#ifdef __linux__
+	//-----minimal EGL declarations, so no EGL headers are needed
+	typedef void* EGLDisplay;
+	typedef void* EGLConfig;
+	typedef void* EGLContext;
+	typedef void* EGLSurface;
+	typedef int EGLint;
+	typedef unsigned int EGLBoolean;
+	typedef unsigned int EGLenum;
+
+	static constexpr EGLint EGL_NONE_ = 0x3038;
+	static constexpr EGLint EGL_SURFACE_TYPE_ = 0x3033;
+	static constexpr EGLint EGL_PBUFFER_BIT_ = 0x0001;
+	static constexpr EGLint EGL_RENDERABLE_TYPE_ = 0x3040;
+	static constexpr EGLint EGL_OPENGL_BIT_ = 0x0008;
+	static constexpr EGLint EGL_RED_SIZE_ = 0x3024;
+	static constexpr EGLint EGL_GREEN_SIZE_ = 0x3023;
+	static constexpr EGLint EGL_BLUE_SIZE_ = 0x3022;
+	static constexpr EGLint EGL_DEPTH_SIZE_ = 0x3025;
+	static constexpr EGLenum EGL_OPENGL_API_ = 0x30A2;
+	static constexpr EGLint EGL_CONTEXT_MAJOR_VERSION_ = 0x3098;
+	static constexpr EGLint EGL_CONTEXT_MINOR_VERSION_ = 0x30FB;
+	static constexpr EGLint EGL_CONTEXT_OPENGL_PROFILE_MASK_ = 0x30FD;
+	static constexpr EGLint EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_ = 0x0001;
+	static constexpr EGLenum EGL_PLATFORM_SURFACELESS_MESA_ = 0x31DD;
+
+	typedef void* (*PFNEGLGETPROCADDRESS)(const char* name);
+	typedef EGLDisplay (*PFNEGLGETPLATFORMDISPLAYEXT)(EGLenum platform, void* nativeDisplay, const EGLint* attribs);
+	typedef EGLBoolean (*PFNEGLINITIALIZE)(EGLDisplay display, EGLint* major, EGLint* minor);
+	typedef EGLBoolean (*PFNEGLBINDAPI)(EGLenum api);
+	typedef EGLBoolean (*PFNEGLCHOOSECONFIG)(EGLDisplay display, const EGLint* attribs, EGLConfig* configs, EGLint size, EGLint* count);
+	typedef EGLContext (*PFNEGLCREATECONTEXT)(EGLDisplay display, EGLConfig config, EGLContext share, const EGLint* attribs);
+	typedef EGLBoolean (*PFNEGLMAKECURRENT)(EGLDisplay display, EGLSurface draw, EGLSurface read, EGLContext context);
+	typedef EGLBoolean (*PFNEGLDESTROYCONTEXT)(EGLDisplay display, EGLContext context);
+	typedef EGLBoolean (*PFNEGLTERMINATE)(EGLDisplay display);
+	typedef EGLint (*PFNEGLGETERROR)();
+	//=====minimal EGL declarations
+
+	static PFNEGLGETPROCADDRESS& GetProcAddressFunction()
+	{
+		static PFNEGLGETPROCADDRESS function = nullptr;
+		return function;
+	}
+	static void* LoadProc(const char* name) { return GetProcAddressFunction()(name); }
+
+	void* m_library = nullptr;
+	EGLDisplay m_display = nullptr;
+	EGLContext m_context = nullptr;
+#else
+	GLFWwindow* m_window = nullptr;
+#endif
+};
+
+#ifdef __linux__
+
+inline bool HeadlessContext::Create(int glMajor, int glMinor)
+{
+	m_library = dlopen("libEGL.so.1", RTLD_NOW | RTLD_LOCAL);
+	if(!m_library)
+	{
+		std::cout << "ERROR::HEADLESS::LIBEGL_NOT_FOUND " << dlerror() << std::endl;
+		return false;
+	}
+
+	PFNEGLGETPROCADDRESS eglGetProcAddress = reinterpret_cast<PFNEGLGETPROCADDRESS>(dlsym(m_library, "eglGetProcAddress"));
+	PFNEGLINITIALIZE eglInitialize = reinterpret_cast<PFNEGLINITIALIZE>(dlsym(m_library, "eglInitialize"));
+	PFNEGLBINDAPI eglBindAPI = reinterpret_cast<PFNEGLBINDAPI>(dlsym(m_library, "eglBindAPI"));
+	PFNEGLCHOOSECONFIG eglChooseConfig = reinterpret_cast<PFNEGLCHOOSECONFIG>(dlsym(m_library, "eglChooseConfig"));
+	PFNEGLCREATECONTEXT eglCreateContext = reinterpret_cast<PFNEGLCREATECONTEXT>(dlsym(m_library, "eglCreateContext"));
+	PFNEGLMAKECURRENT eglMakeCurrent = reinterpret_cast<PFNEGLMAKECURRENT>(dlsym(m_library, "eglMakeCurrent"));
+	PFNEGLGETERROR eglGetError = reinterpret_cast<PFNEGLGETERROR>(dlsym(m_library, "eglGetError"));
+	if(!eglGetProcAddress || !eglInitialize || !eglBindAPI || !eglChooseConfig || !eglCreateContext || !eglMakeCurrent || !eglGetError)
+	{
+		std::cout << "ERROR::HEADLESS::LIBEGL_INCOMPLETE" << std::endl;
+		return false;
+	}
+	GetProcAddressFunction() = eglGetProcAddress;
+
+	PFNEGLGETPLATFORMDISPLAYEXT eglGetPlatformDisplayEXT = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXT>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if(!eglGetPlatformDisplayEXT)
+	{
+		std::cout << "ERROR::HEADLESS::NO_EGL_PLATFORM_DISPLAY" << std::endl;
+		return false;
+	}
+
+	m_display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA_, nullptr, nullptr);
+	EGLint eglMajor = 0, eglMinor = 0;
+	if(!m_display || !eglInitialize(m_display, &eglMajor, &eglMinor))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		return false;
+	}
+	printf("EGL version: %d.%d (surfaceless)\n", eglMajor, eglMinor);
+
+	if(!eglBindAPI(EGL_OPENGL_API_))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_BIND_API_FAILED" << std::endl;
+		return false;
+	}
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE_, EGL_PBUFFER_BIT_,
+		EGL_RENDERABLE_TYPE_, EGL_OPENGL_BIT_,
+		EGL_RED_SIZE_, 8,
+		EGL_GREEN_SIZE_, 8,
+		EGL_BLUE_SIZE_, 8,
+		EGL_DEPTH_SIZE_, 24,
+		EGL_NONE_
+	};
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if(!eglChooseConfig(m_display, configAttribs, &config, 1, &configCount) || configCount == 0)
+	{
+		std::cout << "ERROR::HEADLESS::NO_EGL_CONFIG" << std::endl;
+		return false;
+	}
+
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION_, glMajor,
+		EGL_CONTEXT_MINOR_VERSION_, glMinor,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK_, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_,
+		EGL_NONE_
+	};
+	m_context = eglCreateContext(m_display, config, nullptr, contextAttribs);
+	if(!m_context)
+	{
+		std::cout << "ERROR::HEADLESS::EGL_CREATE_CONTEXT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		return false;
+	}
+
+	// no surface at all, EGL_KHR_surfaceless_context
+	if(!eglMakeCurrent(m_display, nullptr, nullptr, m_context))
+	{
+		std::cout << "ERROR::HEADLESS::EGL_MAKE_CURRENT_FAILED 0x" << std::hex << eglGetError() << std::dec << std::endl;
+		return false;
+	}
+	return true;
+}
+
+inline void HeadlessContext::Destroy()
+{
+	if(!m_library)
+		return;
+
+	PFNEGLMAKECURRENT eglMakeCurrent = reinterpret_cast<PFNEGLMAKECURRENT>(dlsym(m_library, "eglMakeCurrent"));
+	PFNEGLDESTROYCONTEXT eglDestroyContext = reinterpret_cast<PFNEGLDESTROYCONTEXT>(dlsym(m_library, "eglDestroyContext"));
+	PFNEGLTERMINATE eglTerminate = reinterpret_cast<PFNEGLTERMINATE>(dlsym(m_library, "eglTerminate"));
+	if(m_display)
+	{
+		eglMakeCurrent(m_display, nullptr, nullptr, nullptr);
+		if(m_context)
+			eglDestroyContext(m_display, m_context);
+		eglTerminate(m_display);
+	}
+	// libEGL is intentionally not dlclose'd, the driver may still have threads running in it
+	m_context = nullptr;
+	m_display = nullptr;
+	m_library = nullptr;
+}
+
+inline GLADloadproc HeadlessContext::GetLoader()
+{
+	return reinterpret_cast<GLADloadproc>(&HeadlessContext::LoadProc);
+}
+
+#else
+
+inline bool HeadlessContext::Create(int glMajor, int glMinor)
+{
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glMajor);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glMinor);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	m_window = glfwCreateWindow(16, 16, "LearnOpenGL headless", NULL, NULL);
+	if(m_window == NULL)
+	{
+		std::cout << "ERROR::HEADLESS::HIDDEN_WINDOW_FAILED" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(m_window);
+	return true;
+}
+
+inline void HeadlessContext::Destroy()
+{
+	if(!m_window)
+		return;
+	glfwDestroyWindow(m_window);
+	glfwTerminate();
+	m_window = nullptr;
+}
+
+inline GLADloadproc HeadlessContext::GetLoader()
+{
+	return reinterpret_cast<GLADloadproc>(glfwGetProcAddress);
+}
+
+#endif
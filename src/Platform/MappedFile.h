@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+* Read only memory mapping of a whole file. The pages are shared with the OS file cache, so reading
+* a warm file costs no copy and no allocation, data can go straight from the mapping to the GPU.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+
+inline bool MappedFile::Open(const char* path)
+{
+	Close();
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(!m_mapping)
+	{
+		Close();
+		return false;
+	}
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if(!m_data)
+	{
+		std::cout << "ERROR::MAPPED_FILE::MAP_FAILED " << path << std::endl;
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+inline void MappedFile::Close()
+{
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_size = 0;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+inline bool MappedFile::Open(const char* path)
+{
+	Close();
+	const int fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat status;
+	if(fstat(fd, &status) != 0 || status.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if(data == MAP_FAILED)
+	{
+		std::cout << "ERROR::MAPPED_FILE::MAP_FAILED " << path << std::endl;
+		return false;
+	}
+	madvise(data, static_cast<size_t>(status.st_size), MADV_WILLNEED);
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+inline void MappedFile::Close()
+{
+	if(m_data)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+
+#endif
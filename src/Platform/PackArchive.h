@@ -0,0 +1,318 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/Hash.h"
+#include "../Tools/Lz4.h"
+#include "../Tools/Path.h"
+#include "../Tools/ThreadPool.h"
+#include "Directory.h"
+#include "MappedFile.h"
+
+/*
+* Many asset files in one mapped archive: one open and one mapping instead of one per file, and the
+* files of a level sit next to each other on disk.
+*
+* Layout: PackHeader, PackEntry table sorted by path hash (then path), string table of the null
+* terminated paths, then the data of every entry, each aligned to DATA_ALIGNMENT. A stored entry is
+* the file as it was, so it can be used in place straight from the mapping just like a loose mapped
+* file (mesh caches, KTX2 levels). A compressed entry is one LZ4 block of the whole file.
+* Paths are kept as the game opens them, normalized ("Assets/Models/x.obj").
+*/
+constexpr char PACK_MAGIC[4] = {'P', 'A', 'C', 'K'};
+
+enum PackCompression : uint32_t
+{
+	PACK_COMPRESSION_NONE,
+	PACK_COMPRESSION_LZ4,
+};
+
+struct PackHeader
+{
+	char m_magic[4];
+	uint32_t m_version;
+	uint32_t m_entryCount;
+	uint32_t m_stringTableSize;
+	uint64_t m_entryTableOffset;
+	uint64_t m_stringTableOffset;
+	uint64_t m_fileSize;
+};
+
+struct PackEntry
+{
+	uint64_t m_pathHash;
+	uint64_t m_offset;
+	// bytes in the archive, m_size once decompressed
+	uint64_t m_storedSize;
+	uint64_t m_size;
+	uint32_t m_pathOffset;
+	uint32_t m_compression;
+};
+
+class PackArchive
+{
+public:
+	static constexpr uint32_t VERSION = 1;
+	static constexpr uint64_t DATA_ALIGNMENT = 64;
+
+	// packs the files (paths as the game opens them, read from disk) into one archive
+	static bool Write(const std::string& archivePath, const std::vector<std::string>& paths);
+
+	// maps the archive, fails when it is missing or malformed
+	bool Open(const std::string& archivePath);
+	void Close() { m_file.Close(); m_header = nullptr; }
+
+	// nullptr when the archive doesn't have the file, path has to be normalized
+	const PackEntry* Find(const std::string& path) const;
+	// the bytes as stored, compressed or not
+	const uint8_t* GetStoredData(const PackEntry& entry) const { return m_file.GetData() + entry.m_offset; }
+
+	uint32_t GetEntryCount() const { return m_header->m_entryCount; }
+	const PackEntry& GetEntry(uint32_t index) const { return GetEntries()[index]; }
+	const char* GetPath(const PackEntry& entry) const;
+
+private:
+	static uint64_t Align(uint64_t offset) { return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1); }
+	// files read in parts (streamed texture levels) stay stored, decompressing would read them whole
+	static bool IsReadInParts(const std::string& path) { return HasExtension(path, ".ktx2"); }
+	bool Validate() const;
+	const PackEntry* GetEntries() const { return reinterpret_cast<const PackEntry*>(m_file.GetData() + m_header->m_entryTableOffset); }
+
+	MappedFile m_file;
+	const PackHeader* m_header = nullptr;
+};
+
+inline bool PackArchive::Write(const std::string& archivePath, const std::vector<std::string>& paths)
+{
+	PROFILE_ZONE("Pack Write");
+	std::vector<std::string> sortedPaths;
+	for(const std::string& path : paths)
+		sortedPaths.push_back(NormalizePath(path));
+	std::sort(sortedPaths.begin(), sortedPaths.end(), [](const std::string& a, const std::string& b) {
+		const uint64_t hashA = HashString(a);
+		const uint64_t hashB = HashString(b);
+		return hashA != hashB ? hashA < hashB : a < b;
+	});
+	sortedPaths.erase(std::unique(sortedPaths.begin(), sortedPaths.end()), sortedPaths.end());
+
+	std::vector<PackEntry> entries(sortedPaths.size());
+	std::string strings;
+	for(size_t i = 0; i < sortedPaths.size(); i++)
+	{
+		entries[i].m_pathHash = HashString(sortedPaths[i]);
+		entries[i].m_pathOffset = static_cast<uint32_t>(strings.size());
+		strings.append(sortedPaths[i].c_str(), sortedPaths[i].size() + 1);
+	}
+
+	// compression is the slow part, every file on its own worker. A file is only kept compressed
+	// when that saves at least an eighth, decompressing costs more than reading the difference
+	std::vector<std::vector<uint8_t>> compressed(sortedPaths.size());
+	std::vector<uint8_t> isReadable(sortedPaths.size(), 0);
+	GetThreadPool().ParallelFor(static_cast<uint32_t>(sortedPaths.size()), [&](uint32_t begin, uint32_t end) {
+		for(uint32_t i = begin; i < end; i++)
+		{
+			// an empty file can't be mapped, its entry is all zero sizes
+			MappedFile file;
+			if(!file.Open(sortedPaths[i].c_str()))
+			{
+				isReadable[i] = IsFile(sortedPaths[i]) ? 1 : 0;
+				continue;
+			}
+			isReadable[i] = 1;
+			entries[i].m_size = file.GetSize();
+			entries[i].m_storedSize = file.GetSize();
+			entries[i].m_compression = PACK_COMPRESSION_NONE;
+			if(IsReadInParts(sortedPaths[i]))
+				continue;
+			std::vector<uint8_t> data = Lz4Compress(file.GetData(), file.GetSize());
+			if(data.size() > file.GetSize() - file.GetSize() / 8)
+				continue;
+			entries[i].m_storedSize = data.size();
+			entries[i].m_compression = PACK_COMPRESSION_LZ4;
+			compressed[i] = std::move(data);
+		}
+	});
+	for(size_t i = 0; i < sortedPaths.size(); i++)
+	{
+		if(!isReadable[i])
+		{
+			std::cout << "ERROR::PACK::FILE_NOT_FOUND " << sortedPaths[i] << std::endl;
+			return false;
+		}
+	}
+
+	PackHeader header = {};
+	std::memcpy(header.m_magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.m_version = VERSION;
+	header.m_entryCount = static_cast<uint32_t>(entries.size());
+	header.m_stringTableSize = static_cast<uint32_t>(strings.size());
+	header.m_entryTableOffset = sizeof(PackHeader);
+	header.m_stringTableOffset = header.m_entryTableOffset + entries.size() * sizeof(PackEntry);
+	uint64_t offset = Align(header.m_stringTableOffset + strings.size());
+	for(PackEntry& entry : entries)
+	{
+		entry.m_offset = offset;
+		offset = Align(offset + entry.m_storedSize);
+	}
+	header.m_fileSize = offset;
+
+	// written under a temporary name and renamed, a crash mid write never leaves an archive that looks valid
+	const std::string tempPath = archivePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!file.is_open())
+		{
+			std::cout << "ERROR::PACK::OPEN_FAILED " << tempPath << std::endl;
+			return false;
+		}
+
+		const char padding[DATA_ALIGNMENT] = {};
+		const auto padTo = [&file, &padding](uint64_t target) {
+			const uint64_t position = static_cast<uint64_t>(file.tellp());
+			if(target > position)
+				file.write(padding, static_cast<std::streamsize>(target - position));
+		};
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry));
+		file.write(strings.data(), strings.size());
+		for(size_t i = 0; i < entries.size(); i++)
+		{
+			padTo(entries[i].m_offset);
+			if(entries[i].m_compression == PACK_COMPRESSION_LZ4)
+			{
+				file.write(reinterpret_cast<const char*>(compressed[i].data()), compressed[i].size());
+				continue;
+			}
+			MappedFile source;
+			if(entries[i].m_size > 0 && (!source.Open(sortedPaths[i].c_str()) || source.GetSize() != entries[i].m_size))
+			{
+				std::cout << "ERROR::PACK::FILE_CHANGED " << sortedPaths[i] << std::endl;
+				return false;
+			}
+			file.write(reinterpret_cast<const char*>(source.GetData()), static_cast<std::streamsize>(entries[i].m_size));
+		}
+		padTo(header.m_fileSize);
+		if(!file.good())
+		{
+			std::cout << "ERROR::PACK::WRITE_FAILED " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(archivePath.c_str());
+	if(std::rename(tempPath.c_str(), archivePath.c_str()) != 0)
+	{
+		std::cout << "ERROR::PACK::RENAME_FAILED " << archivePath << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+inline bool PackArchive::Open(const std::string& archivePath)
+{
+	Close();
+	if(!m_file.Open(archivePath.c_str()))
+	{
+		std::cout << "ERROR::PACK::FILE_NOT_FOUND " << archivePath << std::endl;
+		return false;
+	}
+	m_header = reinterpret_cast<const PackHeader*>(m_file.GetData());
+	if(!Validate())
+	{
+		std::cout << "ERROR::PACK::INVALID " << archivePath << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+inline bool PackArchive::Validate() const
+{
+	const uint64_t size = m_file.GetSize();
+	if(size < sizeof(PackHeader) || std::memcmp(m_header->m_magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || m_header->m_version != VERSION
+	   || m_header->m_fileSize != size)
+		return false;
+	if(m_header->m_entryTableOffset + uint64_t(m_header->m_entryCount) * sizeof(PackEntry) > size
+	   || m_header->m_stringTableOffset + m_header->m_stringTableSize > size)
+		return false;
+	// every path lookup relies on the table ending in a terminator
+	if(m_header->m_stringTableSize > 0 && m_file.GetData()[m_header->m_stringTableOffset + m_header->m_stringTableSize - 1] != '\0')
+		return false;
+
+	for(uint32_t i = 0; i < m_header->m_entryCount; i++)
+	{
+		const PackEntry& entry = GetEntry(i);
+		if(entry.m_offset % DATA_ALIGNMENT != 0 || entry.m_offset > size || entry.m_storedSize > size - entry.m_offset
+		   || entry.m_pathOffset >= m_header->m_stringTableSize || entry.m_compression > PACK_COMPRESSION_LZ4
+		   || (entry.m_compression == PACK_COMPRESSION_NONE && entry.m_storedSize != entry.m_size))
+			return false;
+		// Find's binary search needs the order
+		if(i > 0 && GetEntry(i - 1).m_pathHash > entry.m_pathHash)
+			return false;
+	}
+	return true;
+}
+
+inline const PackEntry* PackArchive::Find(const std::string& path) const
+{
+	if(!m_header)
+		return nullptr;
+	const uint64_t hash = HashString(path);
+	const PackEntry* const begin = GetEntries();
+	const PackEntry* const end = begin + m_header->m_entryCount;
+	const PackEntry* entry = std::lower_bound(begin, end, hash, [](const PackEntry& entry, uint64_t hash) { return entry.m_pathHash < hash; });
+	for(; entry != end && entry->m_pathHash == hash; ++entry)
+	{
+		if(path == GetPath(*entry))
+			return entry;
+	}
+	return nullptr;
+}
+
+inline const char* PackArchive::GetPath(const PackEntry& entry) const
+{
+	return reinterpret_cast<const char*>(m_file.GetData() + m_header->m_stringTableOffset + entry.m_pathOffset);
+}
+
+// packs every file below directory, except what is specific to the machine that wrote it
+inline bool PackDirectory(const std::string& directory, const std::string& archivePath)
+{
+	std::vector<std::string> files;
+	ListFiles(directory, files);
+	const std::string normalizedArchive = NormalizePath(archivePath);
+	std::vector<std::string> paths;
+	for(const std::string& file : files)
+	{
+		// program binaries only load on the driver that made them, temporaries are half written
+		if(HasExtension(file, ".programbin") || HasExtension(file, ".tmp") || NormalizePath(file) == normalizedArchive)
+			continue;
+		paths.push_back(file);
+	}
+	if(!PackArchive::Write(archivePath, paths))
+		return false;
+
+	PackArchive archive;
+	if(!archive.Open(archivePath))
+		return false;
+	uint64_t size = 0, storedSize = 0;
+	uint32_t compressedCount = 0;
+	for(uint32_t i = 0; i < archive.GetEntryCount(); i++)
+	{
+		const PackEntry& entry = archive.GetEntry(i);
+		size += entry.m_size;
+		storedSize += entry.m_storedSize;
+		compressedCount += entry.m_compression == PACK_COMPRESSION_LZ4 ? 1 : 0;
+	}
+	std::cout << "Packed " << archive.GetEntryCount() << " files (" << compressedCount << " compressed) from " << directory << " into " << archivePath
+			  << ", " << size / 1024 << " KB stored as " << storedSize / 1024 << " KB" << std::endl;
+	return true;
+}
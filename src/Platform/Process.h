@@ -0,0 +1,82 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// path of the running executable, argv0 when the OS can't tell
+inline std::string GetExecutablePath(const char* argv0)
+{
+#ifdef _WIN32
+	char path[MAX_PATH];
+	const DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+	if(length > 0 && length < MAX_PATH)
+		return std::string(path, length);
+#elif defined(__linux__)
+	char path[4096];
+	const ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+	if(length > 0 && static_cast<size_t>(length) < sizeof(path))
+		return std::string(path, static_cast<size_t>(length));
+#endif
+	return argv0;
+}
+
+// runs args[0] with the rest as its arguments and waits for it, returns its exit code or -1 when it couldn't run
+inline int RunProcess(const std::vector<std::string>& args)
+{
+	if(args.empty())
+		return -1;
+#ifdef _WIN32
+	std::string commandLine;
+	for(const std::string& arg : args)
+	{
+		if(!commandLine.empty())
+			commandLine += ' ';
+		commandLine += '"' + arg + '"';
+	}
+	STARTUPINFOA startupInfo = {};
+	startupInfo.cb = sizeof(startupInfo);
+	PROCESS_INFORMATION process = {};
+	if(!CreateProcessA(args[0].c_str(), &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &process))
+	{
+		std::cout << "ERROR::PROCESS::CREATE_FAILED " << args[0] << std::endl;
+		return -1;
+	}
+	WaitForSingleObject(process.hProcess, INFINITE);
+	DWORD exitCode = 0;
+	GetExitCodeProcess(process.hProcess, &exitCode);
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+	return static_cast<int>(exitCode);
+#else
+	std::vector<char*> argv;
+	for(const std::string& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	// whatever is buffered would otherwise be written by the child too
+	std::cout.flush();
+	const pid_t pid = fork();
+	if(pid < 0)
+	{
+		std::cout << "ERROR::PROCESS::CREATE_FAILED " << args[0] << std::endl;
+		return -1;
+	}
+	if(pid == 0)
+	{
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+	int status = 0;
+	if(waitpid(pid, &status, 0) != pid || !WIFEXITED(status))
+		return -1;
+	return WEXITSTATUS(status);
+#endif
+}
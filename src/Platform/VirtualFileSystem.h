@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../Profiling/MemoryStats.h"
+#include "../Tools/Lz4.h"
+#include "../Tools/Path.h"
+#include "Directory.h"
+#include "MappedFile.h"
+#include "PackArchive.h"
+
+/*
+* One place every asset read goes through. A path is looked up in the mounted archives first, the
+* last mounted one wins, and only then opened as a loose file, so a development tree needs no
+* archive at all and an archive can be dropped in to replace the loose files of a level.
+* Written files (caches, cooked textures) still go to disk, an archive is read only.
+*/
+class VirtualFileSystem
+{
+public:
+	// any thread, but the archive only replaces files opened after it was mounted
+	bool Mount(const std::string& archivePath);
+	// files already open from the archive keep it mapped until they close
+	bool Unmount(const std::string& archivePath);
+
+	// true when an archive has the file or it exists on disk
+	bool Exists(const std::string& path) const;
+	// the archive that has the normalized path, nullptr when none does
+	std::shared_ptr<const PackArchive> Find(const std::string& path, const PackEntry*& entry) const;
+
+private:
+	struct MountedArchive
+	{
+		std::string m_path;
+		std::shared_ptr<PackArchive> m_archive;
+	};
+
+	mutable std::mutex m_mutex;
+	std::vector<MountedArchive> m_archives;
+};
+
+inline VirtualFileSystem& GetFileSystem()
+{
+	static VirtualFileSystem fileSystem;
+	return fileSystem;
+}
+
+/*
+* Read only view of a whole file through the VirtualFileSystem, a drop in for MappedFile. A loose
+* file or a stored archive entry is mapped, costing no copy. A compressed entry is decompressed
+* into memory the file owns.
+*/
+class AssetFile
+{
+public:
+	AssetFile() = default;
+	~AssetFile() { Close(); }
+	AssetFile(const AssetFile&) = delete;
+	AssetFile& operator=(const AssetFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	bool IsOpen() const { return m_data != nullptr; }
+	const uint8_t* GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	MappedFile m_file;
+	// keeps the mapping alive while the data points into it
+	std::shared_ptr<const PackArchive> m_archive;
+	std::unique_ptr<uint8_t[]> m_decompressed;
+	TrackedAllocation m_decompressedMemory;
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+inline bool VirtualFileSystem::Mount(const std::string& archivePath)
+{
+	std::shared_ptr<PackArchive> archive = std::make_shared<PackArchive>();
+	if(!archive->Open(archivePath))
+		return false;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_archives.push_back({archivePath, std::move(archive)});
+	return true;
+}
+
+inline bool VirtualFileSystem::Unmount(const std::string& archivePath)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(auto it = m_archives.begin(); it != m_archives.end(); ++it)
+	{
+		if(it->m_path == archivePath)
+		{
+			m_archives.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool VirtualFileSystem::Exists(const std::string& path) const
+{
+	const std::string normalized = NormalizePath(path);
+	const PackEntry* entry;
+	return Find(normalized, entry) || IsFile(normalized);
+}
+
+inline std::shared_ptr<const PackArchive> VirtualFileSystem::Find(const std::string& path, const PackEntry*& entry) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(size_t i = m_archives.size(); i > 0; i--)
+	{
+		entry = m_archives[i - 1].m_archive->Find(path);
+		if(entry)
+			return m_archives[i - 1].m_archive;
+	}
+	entry = nullptr;
+	return nullptr;
+}
+
+inline bool AssetFile::Open(const char* path)
+{
+	Close();
+	const std::string normalized = NormalizePath(path);
+	const PackEntry* entry;
+	m_archive = GetFileSystem().Find(normalized, entry);
+	if(!m_archive)
+	{
+		if(!m_file.Open(normalized.c_str()))
+			return false;
+		m_data = m_file.GetData();
+		m_size = m_file.GetSize();
+		return true;
+	}
+
+	// like a loose file, an empty entry doesn't open
+	if(entry->m_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = static_cast<size_t>(entry->m_size);
+	if(entry->m_compression == PACK_COMPRESSION_NONE)
+	{
+		m_data = m_archive->GetStoredData(*entry);
+		return true;
+	}
+	m_decompressed.reset(new uint8_t[m_size]);
+	m_decompressedMemory = TrackedAllocation(MEMORY_CPU_FILE, m_size);
+	if(!Lz4Decompress(m_archive->GetStoredData(*entry), static_cast<size_t>(entry->m_storedSize), m_decompressed.get(), m_size))
+	{
+		std::cout << "ERROR::VFS::DECOMPRESS_FAILED " << normalized << std::endl;
+		Close();
+		return false;
+	}
+	m_data = m_decompressed.get();
+	return true;
+}
+
+inline void AssetFile::Close()
+{
+	m_file.Close();
+	m_archive.reset();
+	m_decompressed.reset();
+	m_decompressedMemory.Reset();
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Common.h"
+#include "FrameStats.h"
+#include "MemoryStats.h"
+#include "RenderStats.h"
+
+/*
+* Collects per-frame samples of a benchmark run and turns them into a single line json report.
+*/
+class BenchmarkReport
+{
+public:
+	void AddFrame(double cpuMs, const RenderStats& stats);
+	void AddGpuFrame(double gpuMs) { m_gpuMs.push_back(gpuMs); }
+
+	std::string ToJson(const AppSettings& settings) const;
+	// prints to stdout, and also writes to path when it isn't null
+	void Write(const AppSettings& settings, const char* path) const;
+
+	static std::string SummaryToJson(const FrameTimeSummary& summary);
+
+private:
+	std::vector<double> m_cpuMs;
+	std::vector<double> m_gpuMs;
+	uint64_t m_drawCalls = 0;
+	uint64_t m_triangles = 0;
+	uint64_t m_stateChanges = 0;
+	uint64_t m_shaderBinds = 0;
+	uint64_t m_textureBinds = 0;
+	uint64_t m_vertexArrayBinds = 0;
+	uint64_t m_uniformUpdates = 0;
+	uint64_t m_visibleObjects = 0;
+	uint64_t m_culledObjects = 0;
+};
+
+inline void BenchmarkReport::AddFrame(double cpuMs, const RenderStats& stats)
+{
+	m_cpuMs.push_back(cpuMs);
+	m_drawCalls += stats.m_drawCalls;
+	m_triangles += stats.m_triangles;
+	m_stateChanges += stats.GetStateChanges();
+	m_shaderBinds += stats.m_shaderBinds;
+	m_textureBinds += stats.m_textureBinds;
+	m_vertexArrayBinds += stats.m_vertexArrayBinds;
+	m_uniformUpdates += stats.m_uniformUpdates;
+	m_visibleObjects += stats.m_visibleObjects;
+	m_culledObjects += stats.m_culledObjects;
+}
+
+inline std::string BenchmarkReport::SummaryToJson(const FrameTimeSummary& summary)
+{
+	char json[256];
+	snprintf(json, sizeof(json), "{\"samples\":%d,\"min\":%.4f,\"mean\":%.4f,\"p50\":%.4f,\"p95\":%.4f,\"p99\":%.4f,\"max\":%.4f,\"variance\":%.6f}",
+			 summary.m_frameCount, summary.m_minMs, summary.m_meanMs, summary.m_p50Ms, summary.m_p95Ms, summary.m_p99Ms, summary.m_maxMs, summary.m_varianceMs2);
+	return json;
+}
+
+inline std::string BenchmarkReport::ToJson(const AppSettings& settings) const
+{
+	const double frames = m_cpuMs.empty() ? 1.0 : static_cast<double>(m_cpuMs.size());
+	const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+
+	char line[512];
+	std::string json = "{\"benchmark\":\"scene\"";
+	snprintf(line, sizeof(line), ",\"renderer\":\"%s\",\"gl_version\":\"%s\",\"width\":%d,\"height\":%d,\"frames\":%zu,\"container_grid\":%d,\"backpacks\":%d",
+			 renderer ? renderer : "", version ? version : "", settings.m_width, settings.m_height, m_cpuMs.size(),
+			 settings.m_containerGridSize, settings.m_backpackCount);
+	json += line;
+	json += ",\"cpu_frame_ms\":" + SummaryToJson(SummarizeFrameTimes(m_cpuMs));
+	json += ",\"gpu_frame_ms\":" + SummaryToJson(SummarizeFrameTimes(m_gpuMs));
+	snprintf(line, sizeof(line), ",\"per_frame\":{\"draw_calls\":%.1f,\"triangles\":%.1f,\"state_changes\":%.1f,\"shader_binds\":%.1f,"
+			 "\"texture_binds\":%.1f,\"vertex_array_binds\":%.1f,\"uniform_updates\":%.1f,\"visible_objects\":%.1f,\"culled_objects\":%.1f}",
+			 m_drawCalls / frames, m_triangles / frames, m_stateChanges / frames, m_shaderBinds / frames,
+			 m_textureBinds / frames, m_vertexArrayBinds / frames, m_uniformUpdates / frames, m_visibleObjects / frames, m_culledObjects / frames);
+	json += line;
+	// at the end of the run, the peaks cover loading too
+	json += ",\"memory\":" + GetMemoryStats().ToJson() + "}";
+	return json;
+}
+
+inline void BenchmarkReport::Write(const AppSettings& settings, const char* path) const
+{
+	const std::string json = ToJson(settings);
+	std::cout << json << std::endl;
+
+	if(!path)
+		return;
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_OPEN_FAILED " << path << std::endl;
+		return;
+	}
+	file << json << '\n';
+}
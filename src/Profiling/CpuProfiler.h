@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CPU_PROFILER_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_PROFILER_HAS_TSC
+#endif
+
+/*
+* Always-on CPU profiler.
+* Every thread records finished zones into its own ring buffer (single writer, no locks),
+* so a zone costs two clock reads and one 32 byte store. Buffers register themselves in a
+* lock-free list the first time a thread opens a zone. WriteChromeTrace() snapshots the last
+* EVENTS_PER_THREAD zones of every thread into a Chrome trace / Perfetto compatible json.
+* On x86 zones are timed with the TSC, which is converted to nanoseconds only when read.
+*
+* define CPU_PROFILER_DISABLED to compile all zones out.
+*/
+
+struct CpuZoneEvent
+{
+	const char* m_name;
+	uint64_t m_startTicks;
+	uint64_t m_endTicks;
+	uint32_t m_depth;
+};
+
+class CpuProfiler
+{
+public:
+	//------settings
+	static constexpr uint32_t EVENTS_PER_THREAD = 1 << 16; // must be a power of two
+	//=====settings
+
+	struct ThreadBuffer
+	{
+		CpuZoneEvent m_events[EVENTS_PER_THREAD];
+		std::atomic<uint64_t> m_writeIndex{0};
+		uint32_t m_depth = 0;
+		uint32_t m_threadIndex = 0;
+		char m_name[32] = {};
+		ThreadBuffer* m_next = nullptr;
+	};
+
+	static uint64_t NowTicks();
+	// nanoseconds since the profiler started
+	static uint64_t TicksToNs(uint64_t ticks);
+	// read from the steady clock, monotonic and without any calibration
+	static uint64_t NowNs();
+	// calibrated once, on first use
+	static double GetNsPerTick();
+
+	static ThreadBuffer& GetThreadBuffer();
+	static void SetThreadName(const char* name);
+
+	// copies the recorded events of all threads, skipping any that were overwritten while copying
+	static void Snapshot(std::vector<std::pair<const ThreadBuffer*, std::vector<CpuZoneEvent>>>& out);
+	static bool WriteChromeTrace(const char* path);
+
+private:
+	static std::atomic<ThreadBuffer*>& GetThreadListHead();
+	static std::atomic<uint32_t>& GetThreadCount();
+
+	struct Epoch
+	{
+		std::chrono::steady_clock::time_point m_time;
+		uint64_t m_ticks;
+	};
+	static const Epoch& GetEpoch();
+	static double MeasureNsPerTick();
+	// text as a quoted JSON string, names are free form and may hold quotes or backslashes
+	static void WriteJsonString(std::ostream& out, const char* text);
+};
+
+/*
+* RAII zone, use through the PROFILE_ZONE macro.
+* name must outlive the profiler (string literals).
+*/
+class CpuZone
+{
+public:
+	explicit CpuZone(const char* name);
+	~CpuZone();
+
+private:
+	CpuProfiler::ThreadBuffer& m_buffer;
+	const char* m_name;
+	uint64_t m_startTicks;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifndef CPU_PROFILER_DISABLED
+#define PROFILE_ZONE(name) CpuZone PROFILE_CONCAT(cpuZone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+inline uint64_t CpuProfiler::NowTicks()
+{
+#ifdef CPU_PROFILER_HAS_TSC
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline const CpuProfiler::Epoch& CpuProfiler::GetEpoch()
+{
+	static const Epoch epoch = {std::chrono::steady_clock::now(), NowTicks()};
+	return epoch;
+}
+
+inline uint64_t CpuProfiler::NowNs()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - GetEpoch().m_time).count());
+}
+
+inline double CpuProfiler::GetNsPerTick()
+{
+	// a ratio changing between calls would make converted times jump back and forth
+	static const double nsPerTick = MeasureNsPerTick();
+	return nsPerTick;
+}
+
+inline double CpuProfiler::MeasureNsPerTick()
+{
+#ifdef CPU_PROFILER_HAS_TSC
+	// against the steady clock over everything since startup, the later the first use the more precise
+	const Epoch& epoch = GetEpoch();
+	const uint64_t ticks = NowTicks();
+	const double elapsedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - epoch.m_time).count();
+	if(ticks <= epoch.m_ticks || elapsedNs < 1000000.0)
+	{
+		// too early to tell, measure a short interval instead
+		const auto start = std::chrono::steady_clock::now();
+		const uint64_t startTicks = NowTicks();
+		while(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(2))
+		{
+		}
+		const double intervalNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		return intervalNs / static_cast<double>(NowTicks() - startTicks);
+	}
+	return elapsedNs / static_cast<double>(ticks - epoch.m_ticks);
+#else
+	return 1.0;
+#endif
+}
+
+inline uint64_t CpuProfiler::TicksToNs(uint64_t ticks)
+{
+	const uint64_t epochTicks = GetEpoch().m_ticks;
+	if(ticks <= epochTicks)
+		return 0;
+	return static_cast<uint64_t>((ticks - epochTicks) * GetNsPerTick());
+}
+
+inline std::atomic<CpuProfiler::ThreadBuffer*>& CpuProfiler::GetThreadListHead()
+{
+	static std::atomic<ThreadBuffer*> head{nullptr};
+	return head;
+}
+
+inline std::atomic<uint32_t>& CpuProfiler::GetThreadCount()
+{
+	static std::atomic<uint32_t> count{0};
+	return count;
+}
+
+inline CpuProfiler::ThreadBuffer& CpuProfiler::GetThreadBuffer()
+{
+	// buffers are never freed, the list head keeps them reachable for the whole process
+	thread_local ThreadBuffer* buffer = nullptr;
+	if(buffer)
+		return *buffer;
+
+	GetEpoch();
+	buffer = new ThreadBuffer();
+	buffer->m_threadIndex = GetThreadCount().fetch_add(1);
+	snprintf(buffer->m_name, sizeof(buffer->m_name), "Thread %u", buffer->m_threadIndex);
+
+	std::atomic<ThreadBuffer*>& head = GetThreadListHead();
+	buffer->m_next = head.load(std::memory_order_relaxed);
+	while(!head.compare_exchange_weak(buffer->m_next, buffer, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+	return *buffer;
+}
+
+inline void CpuProfiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+	snprintf(buffer.m_name, sizeof(buffer.m_name), "%s", name);
+}
+
+inline void CpuProfiler::Snapshot(std::vector<std::pair<const ThreadBuffer*, std::vector<CpuZoneEvent>>>& out)
+{
+	out.clear();
+	for(ThreadBuffer* buffer = GetThreadListHead().load(std::memory_order_acquire); buffer; buffer = buffer->m_next)
+	{
+		const uint64_t end = buffer->m_writeIndex.load(std::memory_order_acquire);
+		const uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+
+		std::vector<CpuZoneEvent> events;
+		events.reserve(static_cast<size_t>(end - begin));
+		for(uint64_t i = begin; i < end; i++)
+			events.push_back(buffer->m_events[i & (EVENTS_PER_THREAD - 1)]);
+
+		// the owning thread kept writing while we copied, drop what it may have overwritten
+		const uint64_t endAfterCopy = buffer->m_writeIndex.load(std::memory_order_acquire);
+		const uint64_t firstValid = endAfterCopy > EVENTS_PER_THREAD ? endAfterCopy - EVENTS_PER_THREAD : 0;
+		if(firstValid > begin)
+			events.erase(events.begin(), events.begin() + static_cast<size_t>(std::min(firstValid - begin, end - begin)));
+
+		out.emplace_back(buffer, std::move(events));
+	}
+}
+
+inline bool CpuProfiler::WriteChromeTrace(const char* path)
+{
+	std::vector<std::pair<const ThreadBuffer*, std::vector<CpuZoneEvent>>> threads;
+	Snapshot(threads);
+
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::CPU_PROFILER::TRACE_OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	const uint64_t epochTicks = GetEpoch().m_ticks;
+	const double nsPerTick = GetNsPerTick();
+
+	size_t eventCount = 0;
+	char line[256];
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool isFirst = true;
+	for(const auto& thread : threads)
+	{
+		snprintf(line, sizeof(line), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", isFirst ? "" : ",\n",
+				 thread.first->m_threadIndex);
+		file << line;
+		WriteJsonString(file, thread.first->m_name);
+		file << "}}";
+		isFirst = false;
+
+		for(const CpuZoneEvent& event : thread.second)
+		{
+			if(event.m_startTicks < epochTicks)
+				continue;
+			// trace event timestamps are in microseconds, keep the nanoseconds as fractions
+			const double startUs = (event.m_startTicks - epochTicks) * nsPerTick / 1000.0;
+			const double durationUs = (event.m_endTicks - event.m_startTicks) * nsPerTick / 1000.0;
+			file << ",\n{\"ph\":\"X\",\"name\":";
+			WriteJsonString(file, event.m_name);
+			snprintf(line, sizeof(line), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}}", thread.first->m_threadIndex,
+					 startUs, durationUs, event.m_depth);
+			file << line;
+		}
+		eventCount += thread.second.size();
+	}
+	file << "\n]}\n";
+
+	std::cout << "CPU trace with " << eventCount << " zones written to " << path << std::endl;
+	return true;
+}
+
+inline void CpuProfiler::WriteJsonString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for(const char* c = text; *c != '\0'; c++)
+	{
+		if(*c == '"' || *c == '\\')
+		{
+			out << '\\' << *c;
+		}
+		else if(static_cast<unsigned char>(*c) < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(*c));
+			out << escaped;
+		}
+		else
+		{
+			out << *c;
+		}
+	}
+	out << '"';
+}
+
+inline CpuZone::CpuZone(const char* name)
+	: m_buffer(CpuProfiler::GetThreadBuffer()), m_name(name)
+{
+	m_buffer.m_depth++;
+	m_startTicks = CpuProfiler::NowTicks();
+}
+
+inline CpuZone::~CpuZone()
+{
+	const uint64_t endTicks = CpuProfiler::NowTicks();
+	m_buffer.m_depth--;
+
+	const uint64_t index = m_buffer.m_writeIndex.load(std::memory_order_relaxed);
+	CpuZoneEvent& event = m_buffer.m_events[index & (CpuProfiler::EVENTS_PER_THREAD - 1)];
+	event.m_name = m_name;
+	event.m_startTicks = m_startTicks;
+	event.m_endTicks = endTicks;
+	event.m_depth = m_buffer.m_depth;
+	m_buffer.m_writeIndex.store(index + 1, std::memory_order_release);
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Tools/DebugOverlay.h"
+#include "CpuProfiler.h"
+
+struct FrameTimeSummary
+{
+	int m_frameCount = 0;
+	double m_minMs = 0.0;
+	double m_meanMs = 0.0;
+	double m_p50Ms = 0.0;
+	double m_p95Ms = 0.0;
+	double m_p99Ms = 0.0;
+	double m_maxMs = 0.0;
+	double m_varianceMs2 = 0.0;
+};
+
+// p in [0, 1], nearest rank on already sorted samples
+inline double FrameTimePercentile(const std::vector<double>& sorted, double p);
+inline FrameTimeSummary SummarizeFrameTimes(std::vector<double> samples);
+
+struct HitchPhase
+{
+	const char* m_name;
+	double m_ms;
+	double m_medianMs;
+};
+
+struct Hitch
+{
+	uint64_t m_frameIndex;
+	double m_timeSeconds;
+	double m_frameMs;
+	double m_medianMs;
+	// phases that took noticeably longer than usual, worst first
+	std::vector<HitchPhase> m_phases;
+};
+
+/*
+* Rolling frame-time statistics over the last WINDOW_SIZE frames.
+* Phase times come from the CPU profiler: every zone that is a direct child of the zone that
+* is open when BeginFrame() is called counts as a phase of that frame. A frame longer than
+* m_hitchFactor times the rolling median is a hitch, and keeps the phases that spiked with it.
+*/
+class FrameStats
+{
+public:
+	void BeginFrame();
+	void EndFrame(double frameMs);
+
+	void SetHitchFactor(double factor) { m_hitchFactor = factor; }
+	const FrameTimeSummary& GetSummary() const { return m_summary; }
+	const std::vector<Hitch>& GetHitches() const { return m_hitches; }
+
+	// writes one record every intervalSeconds; json lines when the path ends in .json, csv otherwise
+	bool OpenLog(const char* path, double intervalSeconds);
+	void DrawOverlay(DebugOverlay& overlay) const;
+
+private:
+	//------settings
+	static constexpr int WINDOW_SIZE = 600;
+	// percentiles and medians are recomputed every this many frames
+	static constexpr int SUMMARY_INTERVAL = 30;
+	static constexpr size_t MAX_HITCHES = 64;
+	// a phase only counts as spiked when it is also this much slower in absolute terms
+	const double PHASE_SPIKE_MIN_MS = 0.5;
+	//=====settings
+
+	struct Phase
+	{
+		const char* m_name;
+		double m_history[WINDOW_SIZE] = {};
+		double m_currentMs = 0.0;
+		double m_medianMs = 0.0;
+		bool m_wasSeen = false;
+	};
+
+	double m_hitchFactor = 2.0;
+	double m_frameMs[WINDOW_SIZE] = {};
+	int m_writeIndex = 0;
+	int m_sampleCount = 0;
+	uint64_t m_frameIndex = 0;
+	FrameTimeSummary m_summary;
+	std::vector<Phase> m_phases;
+	std::vector<Hitch> m_hitches;
+	size_t m_totalHitchCount = 0;
+
+	uint64_t m_frameFirstEvent = 0;
+	uint32_t m_frameDepth = 0;
+
+	std::ofstream m_log;
+	bool m_isJsonLog = false;
+	double m_logInterval = 0.0;
+	double m_nextLogTime = 0.0;
+	size_t m_hitchesLogged = 0;
+
+	void CollectPhases();
+	Phase& GetPhase(const char* name);
+	void UpdateSummary();
+	void WriteLog(double nowSeconds);
+};
+
+inline void FrameStats::BeginFrame()
+{
+	const CpuProfiler::ThreadBuffer& buffer = CpuProfiler::GetThreadBuffer();
+	m_frameFirstEvent = buffer.m_writeIndex.load(std::memory_order_relaxed);
+	m_frameDepth = buffer.m_depth;
+}
+
+inline FrameStats::Phase& FrameStats::GetPhase(const char* name)
+{
+	for(Phase& phase : m_phases)
+	{
+		if(phase.m_name == name || std::strcmp(phase.m_name, name) == 0)
+			return phase;
+	}
+	m_phases.emplace_back();
+	m_phases.back().m_name = name;
+	return m_phases.back();
+}
+
+inline void FrameStats::CollectPhases()
+{
+	for(Phase& phase : m_phases)
+	{
+		phase.m_currentMs = 0.0;
+		phase.m_wasSeen = false;
+	}
+
+	const CpuProfiler::ThreadBuffer& buffer = CpuProfiler::GetThreadBuffer();
+	const uint64_t end = buffer.m_writeIndex.load(std::memory_order_relaxed);
+	uint64_t begin = m_frameFirstEvent;
+	if(end - begin > CpuProfiler::EVENTS_PER_THREAD)
+		begin = end - CpuProfiler::EVENTS_PER_THREAD;
+
+	const double nsPerTick = CpuProfiler::GetNsPerTick();
+	for(uint64_t i = begin; i < end; i++)
+	{
+		const CpuZoneEvent& event = buffer.m_events[i & (CpuProfiler::EVENTS_PER_THREAD - 1)];
+		if(event.m_depth != m_frameDepth)
+			continue;
+		Phase& phase = GetPhase(event.m_name);
+		phase.m_currentMs += (event.m_endTicks - event.m_startTicks) * nsPerTick / 1000000.0;
+		phase.m_wasSeen = true;
+	}
+
+	const int slot = m_writeIndex;
+	for(Phase& phase : m_phases)
+		phase.m_history[slot] = phase.m_currentMs;
+}
+
+inline void FrameStats::EndFrame(double frameMs)
+{
+	CollectPhases();
+
+	m_frameMs[m_writeIndex] = frameMs;
+	m_writeIndex = (m_writeIndex + 1) % WINDOW_SIZE;
+	// not std::min, binding WINDOW_SIZE to a reference needs a definition C++14 headers can't have
+	if(m_sampleCount < WINDOW_SIZE)
+		m_sampleCount++;
+
+	if(m_frameIndex % SUMMARY_INTERVAL == 0 || m_sampleCount < SUMMARY_INTERVAL)
+		UpdateSummary();
+
+	//-----hitch detection
+	// wait for a few frames of history, the first frames after loading are always slow
+	if(m_sampleCount >= SUMMARY_INTERVAL && frameMs > m_hitchFactor * m_summary.m_p50Ms)
+	{
+		Hitch hitch;
+		hitch.m_frameIndex = m_frameIndex;
+		hitch.m_timeSeconds = CpuProfiler::NowNs() / 1000000000.0;
+		hitch.m_frameMs = frameMs;
+		hitch.m_medianMs = m_summary.m_p50Ms;
+		for(const Phase& phase : m_phases)
+		{
+			if(!phase.m_wasSeen)
+				continue;
+			const bool isSpike = phase.m_currentMs > m_hitchFactor * phase.m_medianMs
+				&& phase.m_currentMs - phase.m_medianMs > PHASE_SPIKE_MIN_MS;
+			if(isSpike)
+				hitch.m_phases.push_back({phase.m_name, phase.m_currentMs, phase.m_medianMs});
+		}
+		std::sort(hitch.m_phases.begin(), hitch.m_phases.end(), [](const HitchPhase& a, const HitchPhase& b)
+		{
+			return a.m_ms - a.m_medianMs > b.m_ms - b.m_medianMs;
+		});
+
+		if(m_hitches.size() >= MAX_HITCHES)
+		{
+			m_hitches.erase(m_hitches.begin());
+			m_hitchesLogged = m_hitchesLogged > 0 ? m_hitchesLogged - 1 : 0;
+		}
+		m_hitches.push_back(hitch);
+		m_totalHitchCount++;
+	}
+	//=====hitch detection
+
+	m_frameIndex++;
+
+	if(m_log.is_open())
+	{
+		const double nowSeconds = CpuProfiler::NowNs() / 1000000000.0;
+		if(nowSeconds >= m_nextLogTime)
+		{
+			WriteLog(nowSeconds);
+			m_nextLogTime = nowSeconds + m_logInterval;
+		}
+	}
+}
+
+inline double FrameTimePercentile(const std::vector<double>& sorted, double p)
+{
+	if(sorted.empty())
+		return 0.0;
+	// nearest rank
+	const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+	return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+inline FrameTimeSummary SummarizeFrameTimes(std::vector<double> samples)
+{
+	FrameTimeSummary summary;
+	if(samples.empty())
+		return summary;
+	std::sort(samples.begin(), samples.end());
+
+	double sum = 0.0;
+	for(double ms : samples)
+		sum += ms;
+	const double mean = sum / samples.size();
+	double squaredError = 0.0;
+	for(double ms : samples)
+		squaredError += (ms - mean) * (ms - mean);
+
+	summary.m_frameCount = static_cast<int>(samples.size());
+	summary.m_minMs = samples.front();
+	summary.m_maxMs = samples.back();
+	summary.m_meanMs = mean;
+	summary.m_p50Ms = FrameTimePercentile(samples, 0.50);
+	summary.m_p95Ms = FrameTimePercentile(samples, 0.95);
+	summary.m_p99Ms = FrameTimePercentile(samples, 0.99);
+	summary.m_varianceMs2 = squaredError / samples.size();
+	return summary;
+}
+
+inline void FrameStats::UpdateSummary()
+{
+	m_summary = SummarizeFrameTimes(std::vector<double>(m_frameMs, m_frameMs + m_sampleCount));
+
+	for(Phase& phase : m_phases)
+	{
+		std::vector<double> phaseSorted(phase.m_history, phase.m_history + m_sampleCount);
+		std::nth_element(phaseSorted.begin(), phaseSorted.begin() + phaseSorted.size() / 2, phaseSorted.end());
+		phase.m_medianMs = phaseSorted.empty() ? 0.0 : phaseSorted[phaseSorted.size() / 2];
+	}
+}
+
+inline bool FrameStats::OpenLog(const char* path, double intervalSeconds)
+{
+	m_log.open(path, std::ios::out | std::ios::trunc);
+	if(!m_log.is_open())
+	{
+		std::cout << "ERROR::FRAME_STATS::LOG_OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+
+	const size_t length = std::strlen(path);
+	m_isJsonLog = length >= 5 && std::strcmp(path + length - 5, ".json") == 0;
+	m_logInterval = intervalSeconds;
+	m_nextLogTime = CpuProfiler::NowNs() / 1000000000.0 + intervalSeconds;
+	if(!m_isJsonLog)
+		m_log << "time_s,frames,min_ms,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,variance_ms2,hitches,worst_hitch_phase\n";
+	return true;
+}
+
+inline void FrameStats::WriteLog(double nowSeconds)
+{
+	UpdateSummary();
+	const FrameTimeSummary& s = m_summary;
+	char line[512];
+
+	if(!m_isJsonLog)
+	{
+		// only the worst phase of the worst new hitch fits in a csv row
+		const char* worstPhase = "";
+		double worstMs = 0.0;
+		for(size_t i = m_hitchesLogged; i < m_hitches.size(); i++)
+		{
+			if(m_hitches[i].m_frameMs > worstMs)
+			{
+				worstMs = m_hitches[i].m_frameMs;
+				worstPhase = m_hitches[i].m_phases.empty() ? "unknown" : m_hitches[i].m_phases[0].m_name;
+			}
+		}
+		snprintf(line, sizeof(line), "%.3f,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.4f,%zu,%s\n",
+				 nowSeconds, s.m_frameCount, s.m_minMs, s.m_meanMs, s.m_p50Ms, s.m_p95Ms, s.m_p99Ms, s.m_maxMs,
+				 s.m_varianceMs2, m_hitches.size() - m_hitchesLogged, worstPhase);
+		m_log << line;
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "{\"time_s\":%.3f,\"frames\":%d,\"min_ms\":%.3f,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p95_ms\":%.3f,"
+				 "\"p99_ms\":%.3f,\"max_ms\":%.3f,\"variance_ms2\":%.4f,\"hitches\":[",
+				 nowSeconds, s.m_frameCount, s.m_minMs, s.m_meanMs, s.m_p50Ms, s.m_p95Ms, s.m_p99Ms, s.m_maxMs, s.m_varianceMs2);
+		m_log << line;
+		for(size_t i = m_hitchesLogged; i < m_hitches.size(); i++)
+		{
+			const Hitch& hitch = m_hitches[i];
+			snprintf(line, sizeof(line), "%s{\"frame\":%llu,\"time_s\":%.3f,\"frame_ms\":%.3f,\"median_ms\":%.3f,\"phases\":[",
+					 i == m_hitchesLogged ? "" : ",", static_cast<unsigned long long>(hitch.m_frameIndex), hitch.m_timeSeconds, hitch.m_frameMs, hitch.m_medianMs);
+			m_log << line;
+			for(size_t p = 0; p < hitch.m_phases.size(); p++)
+			{
+				snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ms\":%.3f,\"median_ms\":%.3f}",
+						 p == 0 ? "" : ",", hitch.m_phases[p].m_name, hitch.m_phases[p].m_ms, hitch.m_phases[p].m_medianMs);
+				m_log << line;
+			}
+			m_log << "]}";
+		}
+		m_log << "]}\n";
+	}
+	m_log.flush();
+	m_hitchesLogged = m_hitches.size();
+}
+
+inline void FrameStats::DrawOverlay(DebugOverlay& overlay) const
+{
+	const FrameTimeSummary& s = m_summary;
+	char line[160];
+	snprintf(line, sizeof(line), "CPU frame %6.2f ms mean  %5.1f fps  sd %5.2f ms", s.m_meanMs, s.m_meanMs > 0.0 ? 1000.0 / s.m_meanMs : 0.0, std::sqrt(s.m_varianceMs2));
+	overlay.AddLine(line, glm::vec3(0.4f, 0.8f, 1.0f));
+	snprintf(line, sizeof(line), "  min %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f", s.m_minMs, s.m_p50Ms, s.m_p95Ms, s.m_p99Ms, s.m_maxMs);
+	overlay.AddLine(line);
+
+	if(m_hitches.empty())
+		return;
+	const Hitch& last = m_hitches.back();
+	snprintf(line, sizeof(line), "  hitches %zu, last %.2f ms (%.1fx median) at frame %llu", m_totalHitchCount, last.m_frameMs,
+			 last.m_medianMs > 0.0 ? last.m_frameMs / last.m_medianMs : 0.0, static_cast<unsigned long long>(last.m_frameIndex));
+	overlay.AddLine(line, glm::vec3(1.0f, 0.6f, 0.3f));
+	for(size_t i = 0; i < last.m_phases.size() && i < 3; i++)
+	{
+		snprintf(line, sizeof(line), "    %s %.2f ms (median %.2f)", last.m_phases[i].m_name, last.m_phases[i].m_ms, last.m_phases[i].m_medianMs);
+		overlay.AddLine(line, glm::vec3(1.0f, 0.6f, 0.3f));
+	}
+}
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Tools/DebugOverlay.h"
+#include "../Tools/GlExtensions.h"
+
+struct GpuScopeResult
+{
+	const char* m_name;
+	int m_depth;
+	double m_gpuMs;
+	// pipeline statistics, only gathered for top level scopes and only when supported
+	bool m_hasStatistics;
+	GLuint64 m_verticesSubmitted;
+	GLuint64 m_primitivesSubmitted;
+	GLuint64 m_fragmentInvocations;
+};
+
+/*
+* Scoped GPU timing based on GL_TIMESTAMP queries.
+* Queries are kept for FRAME_LATENCY frames before they are read back, so reading a result
+* never waits on the GPU; results therefore describe the frame that was submitted
+* FRAME_LATENCY - 1 frames ago.
+*/
+class GpuProfiler
+{
+public:
+	void Init();
+	void Delete();
+
+	void BeginFrame();
+	void EndFrame();
+
+	void PushScope(const char* name);
+	void PopScope();
+
+	// results of the most recent frame that finished on the GPU
+	const std::vector<GpuScopeResult>& GetResults() const { return m_results; }
+	double GetFrameGpuMs() const { return m_frameGpuMs; }
+	// index of the frame GetResults() describes, changes whenever a newer frame got resolved
+	uint64_t GetResultFrameIndex() const { return m_resultFrameIndex; }
+
+	bool OpenCsvLog(const char* path);
+	void DrawOverlay(DebugOverlay& overlay) const;
+
+private:
+	//------settings
+	static constexpr int FRAME_LATENCY = 3;
+	static constexpr int MAX_SCOPES = 64;
+	static constexpr int STATISTIC_COUNT = 3;
+	const GLenum STATISTIC_TARGETS[STATISTIC_COUNT] = {
+		GL_VERTICES_SUBMITTED_ARB,
+		GL_PRIMITIVES_SUBMITTED_ARB,
+		GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+	};
+	//=====settings
+
+	struct Scope
+	{
+		const char* m_name;
+		int m_depth;
+		bool m_hasStatistics;
+	};
+
+	struct FrameQueries
+	{
+		GLuint m_timestamps[MAX_SCOPES * 2];
+		GLuint m_statistics[MAX_SCOPES][STATISTIC_COUNT];
+		Scope m_scopes[MAX_SCOPES];
+		int m_scopeCount = 0;
+		// the query that was issued last, once it is available every other one is as well
+		GLuint m_lastQuery = 0;
+		bool m_isPending = false;
+		uint64_t m_frameIndex = 0;
+	};
+
+	FrameQueries m_frames[FRAME_LATENCY];
+	int m_currentFrame = 0;
+	uint64_t m_frameIndex = 0;
+	bool m_isInitialized = false;
+
+	// indices into the current frame's scopes of the scopes that are still open
+	int m_openScopes[MAX_SCOPES];
+	int m_openScopeCount = 0;
+	int m_droppedScopeCount = 0;
+
+	std::vector<GpuScopeResult> m_results;
+	double m_frameGpuMs = 0.0;
+	uint64_t m_resultFrameIndex = UINT64_MAX;
+	std::ofstream m_csv;
+
+	bool TryResolve(FrameQueries& frame);
+};
+
+/*
+* RAII helper, use through the GPU_SCOPE macro.
+*/
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, const char* name) : m_profiler(profiler) { m_profiler.PushScope(name); }
+	~GpuScope() { m_profiler.PopScope(); }
+
+private:
+	GpuProfiler& m_profiler;
+};
+
+#define GPU_SCOPE_CONCAT_(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT_(a, b)
+#define GPU_SCOPE(profiler, name) GpuScope GPU_SCOPE_CONCAT(gpuScope_, __LINE__)(profiler, name)
+
+inline void GpuProfiler::Init()
+{
+	for(FrameQueries& frame : m_frames)
+	{
+		glGenQueries(MAX_SCOPES * 2, frame.m_timestamps);
+		if(GetGlExtensions().m_hasPipelineStatistics)
+			glGenQueries(MAX_SCOPES * STATISTIC_COUNT, &frame.m_statistics[0][0]);
+	}
+	m_isInitialized = true;
+}
+
+inline void GpuProfiler::Delete()
+{
+	if(!m_isInitialized)
+		return;
+
+	for(FrameQueries& frame : m_frames)
+	{
+		glDeleteQueries(MAX_SCOPES * 2, frame.m_timestamps);
+		if(GetGlExtensions().m_hasPipelineStatistics)
+			glDeleteQueries(MAX_SCOPES * STATISTIC_COUNT, &frame.m_statistics[0][0]);
+	}
+	if(m_csv.is_open())
+		m_csv.close();
+	m_isInitialized = false;
+}
+
+inline void GpuProfiler::BeginFrame()
+{
+	if(!m_isInitialized)
+		return;
+
+	FrameQueries& frame = m_frames[m_currentFrame];
+	// the slot is about to be reused; only happens when the GPU is more than FRAME_LATENCY frames behind
+	if(frame.m_isPending && !TryResolve(frame))
+		std::cout << "WARNING::GPU_PROFILER::DROPPED_FRAME " << frame.m_frameIndex << std::endl;
+
+	frame.m_scopeCount = 0;
+	frame.m_isPending = false;
+	frame.m_frameIndex = m_frameIndex;
+	m_openScopeCount = 0;
+}
+
+inline void GpuProfiler::EndFrame()
+{
+	if(!m_isInitialized)
+		return;
+
+	while(m_openScopeCount > 0)
+		PopScope();
+
+	m_frames[m_currentFrame].m_isPending = true;
+	m_currentFrame = (m_currentFrame + 1) % FRAME_LATENCY;
+	m_frameIndex++;
+
+	// oldest first, so the results always end up describing the newest finished frame
+	for(int i = 0; i < FRAME_LATENCY; i++)
+	{
+		FrameQueries& frame = m_frames[(m_currentFrame + i) % FRAME_LATENCY];
+		if(frame.m_isPending)
+			TryResolve(frame);
+	}
+}
+
+inline void GpuProfiler::PushScope(const char* name)
+{
+	const GlExtensions& ext = GetGlExtensions();
+	if(ext.m_hasKhrDebug)
+		ext.PushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+	if(!m_isInitialized)
+		return;
+
+	FrameQueries& frame = m_frames[m_currentFrame];
+	if(frame.m_scopeCount >= MAX_SCOPES)
+	{
+		// still keep track of the nesting so PopScope stays balanced
+		m_openScopes[m_openScopeCount++] = -1;
+		m_droppedScopeCount++;
+		return;
+	}
+
+	const int index = frame.m_scopeCount++;
+	Scope& scope = frame.m_scopes[index];
+	scope.m_name = name;
+	scope.m_depth = m_openScopeCount;
+	// statistics queries can't be nested, so only the outermost scopes get them
+	scope.m_hasStatistics = ext.m_hasPipelineStatistics && m_openScopeCount == 0;
+
+	m_openScopes[m_openScopeCount++] = index;
+
+	glQueryCounter(frame.m_timestamps[index * 2], GL_TIMESTAMP);
+	if(scope.m_hasStatistics)
+	{
+		for(int s = 0; s < STATISTIC_COUNT; s++)
+			glBeginQuery(STATISTIC_TARGETS[s], frame.m_statistics[index][s]);
+	}
+}
+
+inline void GpuProfiler::PopScope()
+{
+	const GlExtensions& ext = GetGlExtensions();
+	if(ext.m_hasKhrDebug)
+		ext.PopDebugGroup();
+
+	if(!m_isInitialized || m_openScopeCount == 0)
+		return;
+
+	const int index = m_openScopes[--m_openScopeCount];
+	if(index < 0)
+		return;
+
+	FrameQueries& frame = m_frames[m_currentFrame];
+	if(frame.m_scopes[index].m_hasStatistics)
+	{
+		for(int s = 0; s < STATISTIC_COUNT; s++)
+			glEndQuery(STATISTIC_TARGETS[s]);
+	}
+	glQueryCounter(frame.m_timestamps[index * 2 + 1], GL_TIMESTAMP);
+	frame.m_lastQuery = frame.m_timestamps[index * 2 + 1];
+}
+
+inline bool GpuProfiler::TryResolve(FrameQueries& frame)
+{
+	if(frame.m_scopeCount == 0)
+	{
+		frame.m_isPending = false;
+		return true;
+	}
+
+	GLint isAvailable = 0;
+	glGetQueryObjectiv(frame.m_lastQuery, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+	if(!isAvailable)
+		return false;
+
+	m_results.clear();
+	m_frameGpuMs = 0.0;
+	m_resultFrameIndex = frame.m_frameIndex;
+	for(int i = 0; i < frame.m_scopeCount; i++)
+	{
+		const Scope& scope = frame.m_scopes[i];
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(frame.m_timestamps[i * 2], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.m_timestamps[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+		GpuScopeResult result = {};
+		result.m_name = scope.m_name;
+		result.m_depth = scope.m_depth;
+		result.m_gpuMs = (end - begin) / 1000000.0;
+		result.m_hasStatistics = scope.m_hasStatistics;
+		if(scope.m_hasStatistics)
+		{
+			glGetQueryObjectui64v(frame.m_statistics[i][0], GL_QUERY_RESULT, &result.m_verticesSubmitted);
+			glGetQueryObjectui64v(frame.m_statistics[i][1], GL_QUERY_RESULT, &result.m_primitivesSubmitted);
+			glGetQueryObjectui64v(frame.m_statistics[i][2], GL_QUERY_RESULT, &result.m_fragmentInvocations);
+		}
+		if(scope.m_depth == 0)
+			m_frameGpuMs += result.m_gpuMs;
+		m_results.push_back(result);
+
+		if(m_csv.is_open())
+		{
+			m_csv << frame.m_frameIndex << ',' << result.m_name << ',' << result.m_depth << ',' << result.m_gpuMs << ','
+				<< result.m_verticesSubmitted << ',' << result.m_primitivesSubmitted << ',' << result.m_fragmentInvocations << '\n';
+		}
+	}
+
+	frame.m_isPending = false;
+	return true;
+}
+
+inline bool GpuProfiler::OpenCsvLog(const char* path)
+{
+	m_csv.open(path, std::ios::out | std::ios::trunc);
+	if(!m_csv.is_open())
+	{
+		std::cout << "ERROR::GPU_PROFILER::CSV_OPEN_FAILED " << path << std::endl;
+		return false;
+	}
+	m_csv << "frame,scope,depth,gpu_ms,vertices_submitted,primitives_submitted,fragment_invocations\n";
+	return true;
+}
+
+inline void GpuProfiler::DrawOverlay(DebugOverlay& overlay) const
+{
+	char line[128];
+	snprintf(line, sizeof(line), "GPU %6.3f ms", m_frameGpuMs);
+	overlay.AddLine(line, glm::vec3(0.4f, 1.0f, 0.4f));
+	for(const GpuScopeResult& result : m_results)
+	{
+		if(result.m_hasStatistics)
+		{
+			snprintf(line, sizeof(line), "%*s%-12s %6.3f ms  %8llu prims %10llu frags", result.m_depth * 2 + 2, "", result.m_name, result.m_gpuMs,
+					 static_cast<unsigned long long>(result.m_primitivesSubmitted), static_cast<unsigned long long>(result.m_fragmentInvocations));
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "%*s%-12s %6.3f ms", result.m_depth * 2 + 2, "", result.m_name, result.m_gpuMs);
+		}
+		overlay.AddLine(line);
+	}
+	if(m_droppedScopeCount > 0)
+	{
+		snprintf(line, sizeof(line), "  %d scopes over MAX_SCOPES dropped", m_droppedScopeCount);
+		overlay.AddLine(line, glm::vec3(1.0f, 0.4f, 0.4f));
+	}
+}
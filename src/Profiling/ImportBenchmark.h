@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Model/Model.h"
+#include "../Model/ObjLoader.h"
+#include "BenchmarkReport.h"
+#include "FrameStats.h"
+
+// imports per importer, the first of each also pays for the cold file cache
+constexpr int IMPORT_BENCHMARK_RUNS = 5;
+
+struct ImportBenchmarkResult
+{
+	std::vector<double> m_ms;
+	size_t m_meshCount = 0;
+	size_t m_vertexCount = 0;
+	size_t m_indexCount = 0;
+};
+
+template<typename F>
+inline ImportBenchmarkResult RunImport(const std::string& path, F import)
+{
+	ImportBenchmarkResult result;
+	for(int run = 0; run < IMPORT_BENCHMARK_RUNS; run++)
+	{
+		std::vector<MeshData> meshes;
+		const auto start = std::chrono::steady_clock::now();
+		if(!import(path, meshes))
+			break;
+		result.m_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+		result.m_meshCount = meshes.size();
+		result.m_vertexCount = result.m_indexCount = 0;
+		for(const MeshData& mesh : meshes)
+		{
+			result.m_vertexCount += mesh.m_vertices.size();
+			result.m_indexCount += mesh.m_indices.size();
+		}
+	}
+	return result;
+}
+
+/*
+* Imports an obj model with Assimp and with the obj parser, the file to MeshData each time (no mesh
+* cache, no textures), and prints a single line json report. Also written to reportPath unless null.
+*/
+inline void RunImportBenchmark(const std::string& path, const char* reportPath)
+{
+	const ImportBenchmarkResult assimp = RunImport(path, [](const std::string& modelPath, std::vector<MeshData>& meshes) {
+		// the node hierarchy is part of what Assimp imports, the obj parser has none to compare with
+		NodeHierarchy nodes;
+		std::vector<NodeMesh> nodeMeshes;
+		return Model::ImportAssimp(modelPath, meshes, nodes, nodeMeshes);
+	});
+	const ImportBenchmarkResult obj = RunImport(path, LoadObj);
+
+	auto resultToJson = [](const ImportBenchmarkResult& result) {
+		char counts[128];
+		snprintf(counts, sizeof(counts), ",\"meshes\":%zu,\"vertices\":%zu,\"indices\":%zu}", result.m_meshCount, result.m_vertexCount, result.m_indexCount);
+		return "{\"ms\":" + BenchmarkReport::SummaryToJson(SummarizeFrameTimes(result.m_ms)) + counts;
+	};
+	const double assimpMs = SummarizeFrameTimes(assimp.m_ms).m_p50Ms;
+	const double objMs = SummarizeFrameTimes(obj.m_ms).m_p50Ms;
+	char speedup[64];
+	snprintf(speedup, sizeof(speedup), ",\"p50_speedup\":%.2f}", objMs > 0.0 ? assimpMs / objMs : 0.0);
+	const std::string json = "{\"benchmark\":\"import\",\"path\":\"" + path + "\",\"threads\":" + std::to_string(GetThreadPool().GetThreadCount() + 1)
+		+ ",\"assimp\":" + resultToJson(assimp) + ",\"obj\":" + resultToJson(obj) + speedup;
+	std::cout << json << std::endl;
+
+	if(!reportPath)
+		return;
+	std::ofstream file(reportPath, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_OPEN_FAILED " << reportPath << std::endl;
+		return;
+	}
+	file << json << '\n';
+}
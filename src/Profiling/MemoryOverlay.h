@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+
+#include "../Tools/DebugOverlay.h"
+#include "MemoryStats.h"
+
+// live bytes by category against the budgets, apart from MemoryStats so that one stays free of GL
+inline void DrawMemoryOverlay(const MemoryStats& stats, DebugOverlay& overlay)
+{
+	const glm::vec3 HEADER_COLOR(0.6f, 1.0f, 0.6f);
+	const glm::vec3 OVER_BUDGET_COLOR(1.0f, 0.3f, 0.3f);
+	constexpr double MB = 1024.0 * 1024.0;
+	char line[160];
+	const size_t gpuBytes = stats.GetGpuBytes();
+	const size_t cpuBytes = stats.GetCpuBytes();
+	const size_t gpuBudget = stats.GetGpuBudget();
+	const size_t cpuBudget = stats.GetCpuBudget();
+	if(gpuBudget > 0)
+		snprintf(line, sizeof(line), "GPU memory %7.1f MB of %.0f MB", gpuBytes / MB, gpuBudget / MB);
+	else
+		snprintf(line, sizeof(line), "GPU memory %7.1f MB", gpuBytes / MB);
+	overlay.AddLine(line, gpuBudget > 0 && gpuBytes > gpuBudget ? OVER_BUDGET_COLOR : HEADER_COLOR);
+	for(uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+	{
+		const MemoryCategory category = static_cast<MemoryCategory>(i);
+		if(category == MEMORY_FIRST_CPU_CATEGORY)
+		{
+			if(cpuBudget > 0)
+				snprintf(line, sizeof(line), "CPU memory %7.1f MB of %.0f MB", cpuBytes / MB, cpuBudget / MB);
+			else
+				snprintf(line, sizeof(line), "CPU memory %7.1f MB", cpuBytes / MB);
+			overlay.AddLine(line, cpuBudget > 0 && cpuBytes > cpuBudget ? OVER_BUDGET_COLOR : HEADER_COLOR);
+		}
+		// categories that never held anything only take up lines
+		if(stats.GetPeakBytes(category) == 0)
+			continue;
+		snprintf(line, sizeof(line), "  %-18s %7.1f MB  peak %7.1f MB", GetMemoryCategoryName(category), stats.GetLiveBytes(category) / MB,
+				 stats.GetPeakBytes(category) / MB);
+		overlay.AddLine(line);
+	}
+}
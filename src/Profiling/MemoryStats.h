@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// what live memory is counted as, the gpu ones first
+enum MemoryCategory : uint32_t
+{
+	// vertex and index buffers
+	MEMORY_GPU_MESH,
+	MEMORY_GPU_TEXTURE,
+	MEMORY_GPU_RENDER_TARGET,
+	// pixel unpack buffers of the PixelBufferPool
+	MEMORY_GPU_STAGING,
+	// debug overlay and the like
+	MEMORY_GPU_OTHER,
+	// vertices and indices, imported but not uploaded yet or kept (GEOMETRY_KEEP)
+	MEMORY_CPU_GEOMETRY,
+	// decoded pixels on their way to the gpu
+	MEMORY_CPU_TEXTURE,
+	// decompressed archive entries
+	MEMORY_CPU_FILE,
+	MEMORY_CATEGORY_COUNT,
+	MEMORY_FIRST_CPU_CATEGORY = MEMORY_CPU_GEOMETRY,
+};
+
+inline const char* GetMemoryCategoryName(MemoryCategory category)
+{
+	static const char* const NAMES[MEMORY_CATEGORY_COUNT] = {"gpu mesh", "gpu texture", "gpu render target", "gpu staging", "gpu other",
+															  "cpu geometry", "cpu texture", "cpu file"};
+	return category < MEMORY_CATEGORY_COUNT ? NAMES[category] : "unknown";
+}
+
+inline bool IsGpuMemory(MemoryCategory category)
+{
+	return category < MEMORY_FIRST_CPU_CATEGORY;
+}
+
+/*
+* Live and peak bytes per MemoryCategory, updated by whatever owns the memory: the tracked GL
+* objects (GlBuffer, RenderTarget, the TextureCache) and TrackedAllocation for cpu memory.
+* Counters are atomic, allocations are counted from any thread.
+* The gpu and the cpu side each have an optional budget, going over it warns once until usage
+* drops back under it. Whatever is still live at shutdown is reported as leaked. See
+* DrawMemoryOverlay for the overlay.
+*/
+class MemoryStats
+{
+public:
+	void Allocate(MemoryCategory category, size_t bytes);
+	void Free(MemoryCategory category, size_t bytes);
+
+	size_t GetLiveBytes(MemoryCategory category) const { return m_categories[category].m_liveBytes.load(std::memory_order_relaxed); }
+	size_t GetPeakBytes(MemoryCategory category) const { return m_categories[category].m_peakBytes.load(std::memory_order_relaxed); }
+	size_t GetGpuBytes() const;
+	size_t GetCpuBytes() const;
+
+	// 0 is unlimited
+	void SetGpuBudget(size_t bytes) { m_gpuBudget = bytes; }
+	void SetCpuBudget(size_t bytes) { m_cpuBudget = bytes; }
+	size_t GetGpuBudget() const { return m_gpuBudget; }
+	size_t GetCpuBudget() const { return m_cpuBudget; }
+
+	// {"gpu_mesh":{"live":bytes,"peak":bytes},...}
+	std::string ToJson() const;
+	// after everything was released, prints the categories still holding memory. False when any does
+	bool ReportLeaks() const;
+
+private:
+	struct Category
+	{
+		std::atomic<size_t> m_liveBytes{0};
+		std::atomic<size_t> m_peakBytes{0};
+	};
+
+	void CheckBudget(bool isGpu);
+
+	Category m_categories[MEMORY_CATEGORY_COUNT];
+	size_t m_gpuBudget = 0;
+	size_t m_cpuBudget = 0;
+	std::atomic<bool> m_isGpuOverBudget{false};
+	std::atomic<bool> m_isCpuOverBudget{false};
+};
+
+inline MemoryStats& GetMemoryStats()
+{
+	static MemoryStats stats;
+	return stats;
+}
+
+/*
+* Counts cpu memory someone owns against a category for as long as it lives, e.g. next to the
+* vector holding it. Move only, like the memory it stands for.
+*/
+class TrackedAllocation
+{
+public:
+	TrackedAllocation() = default;
+	TrackedAllocation(MemoryCategory category, size_t bytes) : m_category(category), m_bytes(bytes) { GetMemoryStats().Allocate(m_category, m_bytes); }
+	~TrackedAllocation() { Reset(); }
+	TrackedAllocation(TrackedAllocation&& other) noexcept : m_category(other.m_category), m_bytes(std::exchange(other.m_bytes, 0)) {}
+	TrackedAllocation& operator=(TrackedAllocation&& other) noexcept
+	{
+		if(this != &other)
+		{
+			Reset();
+			m_category = other.m_category;
+			m_bytes = std::exchange(other.m_bytes, 0);
+		}
+		return *this;
+	}
+	TrackedAllocation(const TrackedAllocation&) = delete;
+	TrackedAllocation& operator=(const TrackedAllocation&) = delete;
+
+	// when the memory it stands for grows or shrinks
+	void Resize(size_t bytes)
+	{
+		if(bytes > m_bytes)
+			GetMemoryStats().Allocate(m_category, bytes - m_bytes);
+		else
+			GetMemoryStats().Free(m_category, m_bytes - bytes);
+		m_bytes = bytes;
+	}
+	void Reset() { Resize(0); }
+	size_t GetBytes() const { return m_bytes; }
+
+private:
+	MemoryCategory m_category = MEMORY_CPU_GEOMETRY;
+	size_t m_bytes = 0;
+};
+
+inline void MemoryStats::Allocate(MemoryCategory category, size_t bytes)
+{
+	if(bytes == 0)
+		return;
+	Category& counter = m_categories[category];
+	const size_t live = counter.m_liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	size_t peak = counter.m_peakBytes.load(std::memory_order_relaxed);
+	while(live > peak && !counter.m_peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{
+	}
+	CheckBudget(IsGpuMemory(category));
+}
+
+inline void MemoryStats::Free(MemoryCategory category, size_t bytes)
+{
+	if(bytes == 0)
+		return;
+	m_categories[category].m_liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+	CheckBudget(IsGpuMemory(category));
+}
+
+inline size_t MemoryStats::GetGpuBytes() const
+{
+	size_t bytes = 0;
+	for(uint32_t i = 0; i < MEMORY_FIRST_CPU_CATEGORY; i++)
+		bytes += GetLiveBytes(static_cast<MemoryCategory>(i));
+	return bytes;
+}
+
+inline size_t MemoryStats::GetCpuBytes() const
+{
+	size_t bytes = 0;
+	for(uint32_t i = MEMORY_FIRST_CPU_CATEGORY; i < MEMORY_CATEGORY_COUNT; i++)
+		bytes += GetLiveBytes(static_cast<MemoryCategory>(i));
+	return bytes;
+}
+
+inline void MemoryStats::CheckBudget(bool isGpu)
+{
+	const size_t budget = isGpu ? m_gpuBudget : m_cpuBudget;
+	if(budget == 0)
+		return;
+	const size_t bytes = isGpu ? GetGpuBytes() : GetCpuBytes();
+	std::atomic<bool>& isOverBudget = isGpu ? m_isGpuOverBudget : m_isCpuOverBudget;
+	// only the crossing warns, not every allocation above the budget
+	if(isOverBudget.exchange(bytes > budget, std::memory_order_relaxed) || bytes <= budget)
+		return;
+	char line[128];
+	std::snprintf(line, sizeof(line), "WARNING::MEMORY::OVER_BUDGET %s %.1f MB of %.1f MB\n", isGpu ? "gpu" : "cpu", bytes / (1024.0 * 1024.0),
+				  budget / (1024.0 * 1024.0));
+	std::cout << line << std::flush;
+}
+
+inline std::string MemoryStats::ToJson() const
+{
+	std::string json = "{";
+	for(uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+	{
+		const MemoryCategory category = static_cast<MemoryCategory>(i);
+		std::string key = GetMemoryCategoryName(category);
+		for(char& c : key)
+			c = c == ' ' ? '_' : c;
+		char entry[128];
+		std::snprintf(entry, sizeof(entry), "%s\"%s\":{\"live\":%zu,\"peak\":%zu}", i > 0 ? "," : "", key.c_str(), GetLiveBytes(category),
+					  GetPeakBytes(category));
+		json += entry;
+	}
+	return json + "}";
+}
+
+inline bool MemoryStats::ReportLeaks() const
+{
+	bool hasLeaks = false;
+	for(uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+	{
+		const MemoryCategory category = static_cast<MemoryCategory>(i);
+		if(GetLiveBytes(category) == 0)
+			continue;
+		std::cout << "WARNING::MEMORY::LEAK " << GetMemoryCategoryName(category) << " " << GetLiveBytes(category) << " bytes" << std::endl;
+		hasLeaks = true;
+	}
+	return !hasLeaks;
+}
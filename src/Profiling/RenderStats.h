@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+* Per-frame counters of the GL work we submit, reset by the main loop at the start of every frame.
+* State changes are everything that rebinds or updates pipeline state between draws.
+*/
+struct RenderStats
+{
+	uint32_t m_drawCalls = 0;
+	uint64_t m_triangles = 0;
+	uint32_t m_shaderBinds = 0;
+	uint32_t m_textureBinds = 0;
+	uint32_t m_vertexArrayBinds = 0;
+	uint32_t m_uniformUpdates = 0;
+	// scene renderables inside and outside the view
+	uint32_t m_visibleObjects = 0;
+	uint32_t m_culledObjects = 0;
+
+	uint32_t GetStateChanges() const { return m_shaderBinds + m_textureBinds + m_vertexArrayBinds + m_uniformUpdates; }
+	void Reset() { *this = RenderStats(); }
+};
+
+inline RenderStats& GetRenderStats()
+{
+	static RenderStats stats;
+	return stats;
+}
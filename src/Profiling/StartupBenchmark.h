@@ -0,0 +1,158 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../Platform/Directory.h"
+#include "../Platform/FileCache.h"
+#include "../Platform/Process.h"
+#include "../Tools/Json.h"
+#include "BenchmarkReport.h"
+#include "FrameStats.h"
+
+// where each run leaves its StartupTimer report for the benchmark to read
+constexpr const char* STARTUP_RUN_REPORT_PATH = "startup_run.json";
+
+// samples of every phase, load and milestone, by group and name in the order the runs report them
+struct StartupSamples
+{
+	struct Samples
+	{
+		std::string m_group;
+		std::string m_name;
+		std::vector<double> m_ms;
+	};
+	std::vector<Samples> m_samples;
+
+	void Add(const char* group, const std::string& name, double ms)
+	{
+		for(Samples& samples : m_samples)
+		{
+			if(samples.m_group == group && samples.m_name == name)
+			{
+				samples.m_ms.push_back(ms);
+				return;
+			}
+		}
+		m_samples.push_back({group, name, {ms}});
+	}
+
+	// a run's report, false when it can't be read
+	bool AddRun(const char* path)
+	{
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		const std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		JsonValue report;
+		if(text.empty() || !JsonValue::Parse(text.data(), text.size(), report))
+			return false;
+
+		Add("", "pre_main", report["pre_main_ms"].GetNumber(0.0));
+		for(const char* group : {"phases", "loads"})
+		{
+			for(const std::pair<std::string, JsonValue>& span : report[group].GetMembers())
+				Add(group, span.first, span.second["ms"].GetNumber(0.0));
+		}
+		for(const std::pair<std::string, JsonValue>& milestone : report["milestones"].GetMembers())
+			Add("milestones", milestone.first, milestone.second.GetNumber(0.0));
+		return true;
+	}
+
+	// {"pre_main":summary,"phases":{"name":summary,...},"loads":{...},"milestones":{...}}
+	std::string ToJson() const
+	{
+		std::string json = "{\"pre_main\":" + GroupToJson("", "pre_main");
+		for(const char* group : {"phases", "loads", "milestones"})
+			json += ",\"" + std::string(group) + "\":{" + GroupToJson(group, nullptr) + "}";
+		return json + "}";
+	}
+
+private:
+	// the members of a group, or the summary of the one sample named name
+	std::string GroupToJson(const char* group, const char* name) const
+	{
+		std::string json;
+		for(const Samples& samples : m_samples)
+		{
+			if(samples.m_group != group)
+				continue;
+			const std::string summary = BenchmarkReport::SummaryToJson(SummarizeFrameTimes(samples.m_ms));
+			if(name)
+				return samples.m_name == name ? summary : json;
+			json += (json.empty() ? "\"" : ",\"") + samples.m_name + "\":" + summary;
+		}
+		return json;
+	}
+};
+
+/*
+* Starts this executable runs times cold and runs times warm, alternating, each with the command
+* line it was given plus --startup-only, and prints the distribution of every startup phase, load and
+* milestone as a single line json report. Also written to reportPath unless null.
+* Cold runs drop the OS file cache of the assets, shaders and the executable first (see
+* DropFileCache, the report says how much could be dropped). Warm runs follow a run that read it all.
+* The cooked texture, mesh and program binary caches are left as they are in both.
+*/
+inline bool RunStartupBenchmark(int argc, char* argv[], int runs, const char* reportPath)
+{
+	std::vector<std::string> args = {GetExecutablePath(argv[0])};
+	for(int i = 1; i < argc; i++)
+	{
+		// the benchmark's own arguments and the ones each run gets below
+		if(std::strcmp(argv[i], "--startup-bench") == 0 || std::strcmp(argv[i], "--report") == 0 || std::strcmp(argv[i], "--startup-report") == 0)
+			i++;
+		else if(std::strcmp(argv[i], "--startup-only") != 0)
+			args.push_back(argv[i]);
+	}
+	args.push_back("--startup-only");
+	args.push_back("--startup-report");
+	args.push_back(STARTUP_RUN_REPORT_PATH);
+
+	std::vector<std::string> files;
+	ListFiles("Assets", files);
+	ListFiles("src/Shaders", files);
+	for(const char* archive : GetAppSettings().m_archivePaths)
+		files.push_back(archive);
+	files.push_back(args[0]);
+
+	StartupSamples cold;
+	StartupSamples warm;
+	FileCacheDrop drop = FILE_CACHE_DROP_SYSTEM;
+	for(int run = 0; run < runs; run++)
+	{
+		for(StartupSamples* samples : {&cold, &warm})
+		{
+			if(samples == &cold)
+				drop = std::min(drop, DropFileCache(files));
+			std::remove(STARTUP_RUN_REPORT_PATH);
+			const int exitCode = RunProcess(args);
+			if(exitCode != 0 || !samples->AddRun(STARTUP_RUN_REPORT_PATH))
+			{
+				std::cout << "ERROR::BENCHMARK::STARTUP_RUN_FAILED " << exitCode << std::endl;
+				std::remove(STARTUP_RUN_REPORT_PATH);
+				return false;
+			}
+		}
+	}
+	std::remove(STARTUP_RUN_REPORT_PATH);
+
+	const std::string json = "{\"benchmark\":\"startup\",\"runs\":" + std::to_string(runs) + ",\"cache_drop\":\"" + GetFileCacheDropName(drop)
+		+ "\",\"cold_ms\":" + cold.ToJson() + ",\"warm_ms\":" + warm.ToJson() + "}";
+	std::cout << json << std::endl;
+
+	if(!reportPath)
+		return true;
+	std::ofstream file(reportPath, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_OPEN_FAILED " << reportPath << std::endl;
+		return false;
+	}
+	file << json << '\n';
+	return true;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "CpuProfiler.h"
+
+/*
+* Where startup time goes, from process start to the first presented frames. The main thread runs
+* through consecutive phases (window, GLAD, shader submits, ...), work running next to them on other
+* threads, like model imports, is added as spans, and milestones mark points such as the first
+* presented frame. Times are in CpuProfiler::NowNs, reported in ms since the process was created,
+* so the time the OS took before main is part of it.
+* Main thread only.
+*/
+class StartupTimer
+{
+public:
+	// first thing in main
+	void Begin();
+	// ends the phase before it, if any
+	void BeginPhase(const char* name);
+	void EndPhase();
+	// work that ran anywhere, in CpuProfiler::NowNs
+	void AddSpan(const char* name, uint64_t startNs, uint64_t endNs);
+	void MarkMilestone(const char* name);
+	bool HasMilestone(const char* name) const;
+
+	// {"benchmark":"startup","pre_main_ms":ms,"phases":{"name":{"start_ms":ms,"ms":ms},...},"loads":{...},"milestones":{"name":ms,...}}
+	std::string ToJson() const;
+	// prints to stdout, and also writes to path when it isn't null
+	void Write(const char* path) const;
+
+	// 0 when the OS can't tell. Only as precise as the OS keeps the creation time, on linux that
+	// is a clock tick (usually 10ms)
+	static uint64_t GetProcessAgeNs();
+
+private:
+	struct Span
+	{
+		const char* m_name;
+		uint64_t m_startNs;
+		uint64_t m_endNs;
+	};
+
+	double ToMs(uint64_t ns) const { return ns > m_mainStartNs ? (ns - m_mainStartNs + m_preMainNs) * 1e-6 : m_preMainNs * 1e-6; }
+	std::string SpansToJson(const std::vector<Span>& spans) const;
+
+	uint64_t m_mainStartNs = 0;
+	uint64_t m_preMainNs = 0;
+	std::vector<Span> m_phases;
+	bool m_isPhaseOpen = false;
+	std::vector<Span> m_spans;
+	std::vector<std::pair<const char*, uint64_t>> m_milestones;
+};
+
+inline StartupTimer& GetStartupTimer()
+{
+	static StartupTimer timer;
+	return timer;
+}
+
+inline uint64_t StartupTimer::GetProcessAgeNs()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user, now;
+	if(!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+	GetSystemTimePreciseAsFileTime(&now);
+	const uint64_t creationTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+	const uint64_t nowTime = (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+	// 100ns units
+	return nowTime > creationTime ? (nowTime - creationTime) * 100 : 0;
+#elif defined(__linux__)
+	// the 22nd field is the start time in clock ticks since boot, after the command name in
+	// parentheses, which may contain anything
+	char stat[1024];
+	FILE* file = std::fopen("/proc/self/stat", "r");
+	if(!file)
+		return 0;
+	const size_t size = std::fread(stat, 1, sizeof(stat) - 1, file);
+	std::fclose(file);
+	stat[size] = '\0';
+	const char* field = std::strrchr(stat, ')');
+	unsigned long long startTicks = 0;
+	if(!field || std::sscanf(field + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &startTicks) != 1)
+		return 0;
+	timespec now;
+	if(clock_gettime(CLOCK_BOOTTIME, &now) != 0)
+		return 0;
+	const uint64_t startNs = static_cast<uint64_t>(startTicks) * 1000000000ull / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+	const uint64_t nowNs = static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+	return nowNs > startNs ? nowNs - startNs : 0;
+#else
+	return 0;
+#endif
+}
+
+inline void StartupTimer::Begin()
+{
+	m_mainStartNs = CpuProfiler::NowNs();
+	m_preMainNs = GetProcessAgeNs();
+}
+
+inline void StartupTimer::BeginPhase(const char* name)
+{
+	EndPhase();
+	const uint64_t now = CpuProfiler::NowNs();
+	m_phases.push_back({name, now, now});
+	m_isPhaseOpen = true;
+}
+
+inline void StartupTimer::EndPhase()
+{
+	if(!m_isPhaseOpen)
+		return;
+	m_phases.back().m_endNs = CpuProfiler::NowNs();
+	m_isPhaseOpen = false;
+}
+
+inline void StartupTimer::AddSpan(const char* name, uint64_t startNs, uint64_t endNs)
+{
+	m_spans.push_back({name, startNs, endNs});
+}
+
+inline void StartupTimer::MarkMilestone(const char* name)
+{
+	if(!HasMilestone(name))
+		m_milestones.emplace_back(name, CpuProfiler::NowNs());
+}
+
+inline bool StartupTimer::HasMilestone(const char* name) const
+{
+	for(const std::pair<const char*, uint64_t>& milestone : m_milestones)
+	{
+		if(std::strcmp(milestone.first, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+inline std::string StartupTimer::SpansToJson(const std::vector<Span>& spans) const
+{
+	std::string json = "{";
+	for(size_t i = 0; i < spans.size(); i++)
+	{
+		char entry[192];
+		snprintf(entry, sizeof(entry), "%s\"%s\":{\"start_ms\":%.3f,\"ms\":%.3f}", i > 0 ? "," : "", spans[i].m_name, ToMs(spans[i].m_startNs),
+				 spans[i].m_endNs > spans[i].m_startNs ? (spans[i].m_endNs - spans[i].m_startNs) * 1e-6 : 0.0);
+		json += entry;
+	}
+	return json + "}";
+}
+
+inline std::string StartupTimer::ToJson() const
+{
+	char line[128];
+	snprintf(line, sizeof(line), "{\"benchmark\":\"startup\",\"pre_main_ms\":%.3f", m_preMainNs * 1e-6);
+	std::string json = line;
+	json += ",\"phases\":" + SpansToJson(m_phases);
+	json += ",\"loads\":" + SpansToJson(m_spans);
+	json += ",\"milestones\":{";
+	for(size_t i = 0; i < m_milestones.size(); i++)
+	{
+		snprintf(line, sizeof(line), "%s\"%s\":%.3f", i > 0 ? "," : "", m_milestones[i].first, ToMs(m_milestones[i].second));
+		json += line;
+	}
+	return json + "}}";
+}
+
+inline void StartupTimer::Write(const char* path) const
+{
+	const std::string json = ToJson();
+	std::cout << json << std::endl;
+
+	if(!path)
+		return;
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if(!file.is_open())
+	{
+		std::cout << "ERROR::BENCHMARK::REPORT_OPEN_FAILED " << path << std::endl;
+		return;
+	}
+	file << json << '\n';
+}
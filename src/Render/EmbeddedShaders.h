@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+
+// a shader source compiled into the executable, m_path as the game names the file
+struct EmbeddedShader
+{
+	const char* m_path;
+	const char* m_source;
+};
+
+#ifdef EMBED_SHADERS
+// EmbeddedShaders.generated.h is written by the EmbedShaders target in learnOpenGL.vcxproj before
+// compiling, one {path, raw string} entry per file in src/Shaders. MSVC caps a single string
+// literal at 16380 characters, a longer shader would need splitting
+constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+#include "../Shaders/EmbeddedShaders.generated.h"
+};
+#endif
+
+// nullptr when the file wasn't embedded, or the build embeds nothing
+inline const char* FindEmbeddedShader(const std::string& path)
+{
+#ifdef EMBED_SHADERS
+	for(const EmbeddedShader& shader : EMBEDDED_SHADERS)
+	{
+		if(path == shader.m_path)
+			return shader.m_source;
+	}
+#else
+	(void)path;
+#endif
+	return nullptr;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <utility>
+
+#include "../Profiling/MemoryStats.h"
+
+/*
+* A GL buffer object that counts its storage against a MemoryCategory and is deleted with the
+* object. Move only. GL thread only, including the destructor.
+*/
+class GlBuffer
+{
+public:
+	GlBuffer() = default;
+	explicit GlBuffer(MemoryCategory category) : m_category(category) {}
+	~GlBuffer() { Delete(); }
+	GlBuffer(GlBuffer&& other) noexcept
+		: m_id(std::exchange(other.m_id, 0)), m_size(std::exchange(other.m_size, 0)), m_category(other.m_category)
+	{
+	}
+	GlBuffer& operator=(GlBuffer&& other) noexcept
+	{
+		if(this != &other)
+		{
+			Delete();
+			m_id = std::exchange(other.m_id, 0);
+			m_size = std::exchange(other.m_size, 0);
+			m_category = other.m_category;
+		}
+		return *this;
+	}
+	GlBuffer(const GlBuffer&) = delete;
+	GlBuffer& operator=(const GlBuffer&) = delete;
+
+	// creates the buffer on first use and (re)allocates its storage, leaves it bound to target
+	void SetData(GLenum target, size_t size, const void* data, GLenum usage);
+	void Delete();
+
+	unsigned int GetId() const { return m_id; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	unsigned int m_id = 0;
+	size_t m_size = 0;
+	MemoryCategory m_category = MEMORY_GPU_OTHER;
+};
+
+inline void GlBuffer::SetData(GLenum target, size_t size, const void* data, GLenum usage)
+{
+	if(m_id == 0)
+		glGenBuffers(1, &m_id);
+	glBindBuffer(target, m_id);
+	glBufferData(target, static_cast<GLsizeiptr>(size), data, usage);
+	GetMemoryStats().Free(m_category, m_size);
+	GetMemoryStats().Allocate(m_category, size);
+	m_size = size;
+}
+
+inline void GlBuffer::Delete()
+{
+	if(m_id == 0)
+		return;
+	glDeleteBuffers(1, &m_id);
+	GetMemoryStats().Free(m_category, m_size);
+	m_id = 0;
+	m_size = 0;
+}
+
+// a vertex array object deleted with the object, it has no storage of its own to count
+class GlVertexArray
+{
+public:
+	GlVertexArray() = default;
+	~GlVertexArray() { Delete(); }
+	GlVertexArray(GlVertexArray&& other) noexcept : m_id(std::exchange(other.m_id, 0)) {}
+	GlVertexArray& operator=(GlVertexArray&& other) noexcept
+	{
+		if(this != &other)
+		{
+			Delete();
+			m_id = std::exchange(other.m_id, 0);
+		}
+		return *this;
+	}
+	GlVertexArray(const GlVertexArray&) = delete;
+	GlVertexArray& operator=(const GlVertexArray&) = delete;
+
+	// creates it on first use
+	void Bind()
+	{
+		if(m_id == 0)
+			glGenVertexArrays(1, &m_id);
+		glBindVertexArray(m_id);
+	}
+	void Delete()
+	{
+		if(m_id != 0)
+			glDeleteVertexArrays(1, &m_id);
+		m_id = 0;
+	}
+
+	unsigned int GetId() const { return m_id; }
+
+private:
+	unsigned int m_id = 0;
+};
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <memory>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Profiling/MemoryStats.h"
+
+// staging memory the pool may hold, larger uploads don't go through it
+constexpr size_t PIXEL_BUFFER_POOL_SIZE = 64 * 1024 * 1024;
+// buffer sizes are rounded up to this, so a buffer fits the next few levels too
+constexpr size_t PIXEL_BUFFER_GRANULARITY = 64 * 1024;
+
+// a pixel unpack buffer, mapped between Acquire and BeginUpload
+struct PixelBuffer
+{
+	unsigned int m_id = 0;
+	size_t m_capacity = 0;
+	// where to write while mapped, any thread may do so
+	uint8_t* m_data = nullptr;
+	// the copy into the texture may still be running until this signals
+	GLsync m_fence = nullptr;
+	bool m_isAcquired = false;
+};
+
+/*
+* Staging buffers for asynchronous texture uploads. A buffer is mapped on the GL thread and filled
+* from any thread, so texture data goes straight from its source (e.g. a mapped file) into memory
+* the driver can DMA from. Uploading from it then only queues the copy instead of stalling the GL
+* thread on a copy out of client memory. A fence after the upload tells when the buffer can be
+* mapped again.
+*/
+class PixelBufferPool
+{
+public:
+	// GL thread only. Returns a mapped buffer of at least size bytes, nullptr while every buffer
+	// is still busy and the pool is full
+	PixelBuffer* Acquire(size_t size);
+	// GL thread only. Unmaps the buffer and binds it to GL_PIXEL_UNPACK_BUFFER, texture uploads
+	// then take offsets into it instead of pointers
+	void BeginUpload(PixelBuffer* buffer);
+	// GL thread only, after the uploads. Unbinds and fences the buffer
+	void EndUpload(PixelBuffer* buffer);
+	// GL thread only, releases a buffer that ended up not being uploaded from
+	void Cancel(PixelBuffer* buffer);
+
+	void Delete();
+
+	size_t GetSize() const { return m_size; }
+
+private:
+	bool IsIdle(PixelBuffer& buffer);
+	void Map(PixelBuffer& buffer, size_t size);
+
+	std::vector<std::unique_ptr<PixelBuffer>> m_buffers;
+	size_t m_size = 0;
+};
+
+inline PixelBufferPool& GetPixelBufferPool()
+{
+	static PixelBufferPool pool;
+	return pool;
+}
+
+inline bool PixelBufferPool::IsIdle(PixelBuffer& buffer)
+{
+	if(buffer.m_isAcquired)
+		return false;
+	if(buffer.m_fence)
+	{
+		const GLenum result = glClientWaitSync(buffer.m_fence, 0, 0);
+		if(result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			return false;
+		glDeleteSync(buffer.m_fence);
+		buffer.m_fence = nullptr;
+	}
+	return true;
+}
+
+inline void PixelBufferPool::Map(PixelBuffer& buffer, size_t size)
+{
+	// the fence has passed, so nothing can still be reading the old contents
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.m_id);
+	buffer.m_data = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(size),
+															GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	buffer.m_isAcquired = true;
+}
+
+inline PixelBuffer* PixelBufferPool::Acquire(size_t size)
+{
+	if(size == 0 || size > PIXEL_BUFFER_POOL_SIZE)
+		return nullptr;
+
+	PROFILE_ZONE("Pixel Buffer Acquire");
+	// the smallest idle buffer that fits, else the biggest idle one to grow
+	PixelBuffer* best = nullptr;
+	PixelBuffer* growable = nullptr;
+	for(std::unique_ptr<PixelBuffer>& buffer : m_buffers)
+	{
+		if(!IsIdle(*buffer))
+			continue;
+		if(buffer->m_capacity >= size)
+		{
+			if(!best || buffer->m_capacity < best->m_capacity)
+				best = buffer.get();
+		}
+		else if(!growable || buffer->m_capacity > growable->m_capacity)
+		{
+			growable = buffer.get();
+		}
+	}
+
+	if(!best)
+	{
+		const size_t capacity = (size + PIXEL_BUFFER_GRANULARITY - 1) / PIXEL_BUFFER_GRANULARITY * PIXEL_BUFFER_GRANULARITY;
+		if(m_size + capacity <= PIXEL_BUFFER_POOL_SIZE)
+		{
+			m_buffers.emplace_back(new PixelBuffer());
+			best = m_buffers.back().get();
+			glGenBuffers(1, &best->m_id);
+		}
+		else if(growable && m_size - growable->m_capacity + capacity <= PIXEL_BUFFER_POOL_SIZE)
+		{
+			best = growable;
+		}
+		else
+		{
+			return nullptr;
+		}
+		m_size += capacity - best->m_capacity;
+		GetMemoryStats().Free(MEMORY_GPU_STAGING, best->m_capacity);
+		GetMemoryStats().Allocate(MEMORY_GPU_STAGING, capacity);
+		best->m_capacity = capacity;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, best->m_id);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, GL_STREAM_DRAW);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+
+	Map(*best, size);
+	if(!best->m_data)
+	{
+		best->m_isAcquired = false;
+		return nullptr;
+	}
+	return best;
+}
+
+inline void PixelBufferPool::BeginUpload(PixelBuffer* buffer)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->m_id);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	buffer->m_data = nullptr;
+}
+
+inline void PixelBufferPool::EndUpload(PixelBuffer* buffer)
+{
+	// every other upload passes client pointers, which would be taken as offsets with a buffer bound
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	buffer->m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	buffer->m_isAcquired = false;
+}
+
+inline void PixelBufferPool::Cancel(PixelBuffer* buffer)
+{
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer->m_id);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	buffer->m_data = nullptr;
+	buffer->m_isAcquired = false;
+}
+
+inline void PixelBufferPool::Delete()
+{
+	for(std::unique_ptr<PixelBuffer>& buffer : m_buffers)
+	{
+		if(buffer->m_fence)
+			glDeleteSync(buffer->m_fence);
+		glDeleteBuffers(1, &buffer->m_id);
+	}
+	m_buffers.clear();
+	GetMemoryStats().Free(MEMORY_GPU_STAGING, m_size);
+	m_size = 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <glad/glad.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Platform/MappedFile.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/GlExtensions.h"
+#include "../Tools/Hash.h"
+
+constexpr char PROGRAM_BINARY_MAGIC[4] = {'P', 'R', 'G', 'B'};
+
+struct ProgramBinaryHeader
+{
+	char m_magic[4];
+	uint32_t m_version;
+	uint64_t m_key;
+	uint32_t m_binaryFormat;
+	uint32_t m_binarySize;
+};
+
+/*
+* Linked programs saved with glGetProgramBinary and loaded back with glProgramBinary on later runs,
+* so startup skips compiling and linking.
+* A binary is only valid for the exact sources and driver it came from: the key hashes the final
+* sources (defines are part of them) together with the GL vendor, renderer and version strings.
+* The file is <vertex source>.<variant>.programbin, variant hashing the fragment path and the
+* defines, so every variant keeps its own binary. A stale key or a binary the driver rejects
+* (e.g. after a driver update with the same version string) just means compiling again.
+*/
+class ProgramBinaryCache
+{
+public:
+	// bump whenever the file layout changes
+	static constexpr uint32_t VERSION = 1;
+
+	static bool IsSupported() { return GetGlExtensions().m_hasProgramBinary; }
+
+	static std::string GetCachePath(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines);
+	// GL thread only, needs a current context for the driver strings
+	static uint64_t GetKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// GL thread only. Returns the linked program, 0 when there is no usable binary
+	static unsigned int Load(const std::string& cachePath, uint64_t key);
+	// GL thread only. program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	static bool Write(const std::string& cachePath, uint64_t key, unsigned int program);
+};
+
+inline std::string ProgramBinaryCache::GetCachePath(const std::string& vertexPath, const std::string& fragmentPath, const std::string& defines)
+{
+	char variant[17];
+	std::snprintf(variant, sizeof(variant), "%016llx", static_cast<unsigned long long>(HashString(defines, HashString(fragmentPath))));
+	return vertexPath + "." + variant + ".programbin";
+}
+
+inline uint64_t ProgramBinaryCache::GetKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t key = HashString(vertexSource);
+	key = HashCombine(key, HashString(fragmentSource));
+	for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+	{
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		key = HashCombine(key, HashString(value ? value : ""));
+	}
+	return HashCombine(key, VERSION);
+}
+
+inline unsigned int ProgramBinaryCache::Load(const std::string& cachePath, uint64_t key)
+{
+	if(!IsSupported())
+		return 0;
+
+	MappedFile file;
+	if(!file.Open(cachePath.c_str()))
+		return 0;
+
+	PROFILE_ZONE("Program Binary Load");
+	ProgramBinaryHeader header;
+	if(file.GetSize() < sizeof(header))
+		return 0;
+	std::memcpy(&header, file.GetData(), sizeof(header));
+	if(std::memcmp(header.m_magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC)) != 0 || header.m_version != VERSION || header.m_key != key
+	   || header.m_binarySize > file.GetSize() - sizeof(header))
+		return 0;
+
+	const unsigned int program = glCreateProgram();
+	GetGlExtensions().ProgramBinary(program, header.m_binaryFormat, file.GetData() + sizeof(header), static_cast<GLsizei>(header.m_binarySize));
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if(!success)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+inline bool ProgramBinaryCache::Write(const std::string& cachePath, uint64_t key, unsigned int program)
+{
+	if(!IsSupported())
+		return false;
+
+	PROFILE_ZONE("Program Binary Write");
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0)
+		return false;
+	std::vector<char> binary(static_cast<size_t>(length));
+	GLenum binaryFormat = 0;
+	GLsizei written = 0;
+	GetGlExtensions().GetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+	if(written <= 0)
+		return false;
+
+	ProgramBinaryHeader header = {};
+	std::memcpy(header.m_magic, PROGRAM_BINARY_MAGIC, sizeof(PROGRAM_BINARY_MAGIC));
+	header.m_version = VERSION;
+	header.m_key = key;
+	header.m_binaryFormat = binaryFormat;
+	header.m_binarySize = static_cast<uint32_t>(written);
+
+	// written under a temporary name and renamed, a crash mid write never leaves a binary that looks valid
+	const std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!file.is_open())
+		{
+			std::cout << "ERROR::PROGRAM_BINARY::OPEN_FAILED " << tempPath << std::endl;
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(binary.data(), written);
+		if(!file.good())
+		{
+			std::cout << "ERROR::PROGRAM_BINARY::WRITE_FAILED " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(cachePath.c_str());
+	if(std::rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		std::cout << "ERROR::PROGRAM_BINARY::RENAME_FAILED " << cachePath << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <iostream>
+
+#include "../Profiling/MemoryStats.h"
+
+/*
+* Offscreen framebuffer with a color and a depth renderbuffer, counted as MEMORY_GPU_RENDER_TARGET.
+*/
+class RenderTarget
+{
+public:
+	bool Create(int width, int height);
+	void Delete();
+
+	void Bind() const;
+	static void Unbind();
+
+	int GetWidth() const { return m_width; }
+	int GetHeight() const { return m_height; }
+
+private:
+	unsigned int m_fbo = 0;
+	unsigned int m_colorRbo = 0;
+	unsigned int m_depthRbo = 0;
+	int m_width = 0;
+	int m_height = 0;
+	size_t m_size = 0;
+};
+
+inline bool RenderTarget::Create(int width, int height)
+{
+	m_width = width;
+	m_height = height;
+
+	glGenFramebuffers(1, &m_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+	glGenRenderbuffers(1, &m_colorRbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_colorRbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorRbo);
+
+	glGenRenderbuffers(1, &m_depthRbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthRbo);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	// RGBA8 and D24S8, both 4 bytes a pixel
+	m_size = static_cast<size_t>(width) * static_cast<size_t>(height) * 8;
+	GetMemoryStats().Allocate(MEMORY_GPU_RENDER_TARGET, m_size);
+
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if(status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "ERROR::RENDER_TARGET::INCOMPLETE 0x" << std::hex << status << std::dec << std::endl;
+		return false;
+	}
+	return true;
+}
+
+inline void RenderTarget::Delete()
+{
+	glDeleteFramebuffers(1, &m_fbo);
+	glDeleteRenderbuffers(1, &m_colorRbo);
+	glDeleteRenderbuffers(1, &m_depthRbo);
+	m_fbo = m_colorRbo = m_depthRbo = 0;
+	GetMemoryStats().Free(MEMORY_GPU_RENDER_TARGET, m_size);
+	m_size = 0;
+}
+
+inline void RenderTarget::Bind() const
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glViewport(0, 0, m_width, m_height);
+}
+
+inline void RenderTarget::Unbind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
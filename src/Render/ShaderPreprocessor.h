@@ -0,0 +1,149 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../Platform/VirtualFileSystem.h"
+#include "../Tools/Hash.h"
+#include "../Tools/Path.h"
+#include "EmbeddedShaders.h"
+
+// a file a shader was built from, with the hash of the text that went in
+struct ShaderDependency
+{
+	std::string m_path;
+	uint64_t m_hash = 0;
+};
+
+// the embedded copy when the build has one, else the file through the VirtualFileSystem. False when neither exists
+inline bool ReadShaderSource(const std::string& path, std::string& source)
+{
+	const std::string normalized = NormalizePath(path);
+	if(const char* embedded = FindEmbeddedShader(normalized))
+	{
+		source = embedded;
+		return true;
+	}
+
+	AssetFile file;
+	if(!file.Open(normalized.c_str()))
+		return false;
+	source.assign(reinterpret_cast<const char*>(file.GetData()), file.GetSize());
+	return true;
+}
+
+// true when any of the files now reads differently from when the shader was built
+inline bool HaveShaderSourcesChanged(const std::vector<ShaderDependency>& dependencies)
+{
+	for(const ShaderDependency& dependency : dependencies)
+	{
+		std::string source;
+		if(!ReadShaderSource(dependency.m_path, source) || HashString(source) != dependency.m_hash)
+			return true;
+	}
+	return false;
+}
+
+namespace ShaderPreprocessorDetail
+{
+	// the name in a #include "name" line, empty for any other line
+	inline std::string GetIncludeName(const std::string& line)
+	{
+		size_t i = line.find_first_not_of(" \t");
+		if(i == std::string::npos || line[i] != '#')
+			return "";
+		i = line.find_first_not_of(" \t", i + 1);
+		if(i == std::string::npos || line.compare(i, 7, "include") != 0)
+			return "";
+		const size_t begin = line.find('"', i + 7);
+		const size_t end = begin == std::string::npos ? std::string::npos : line.find('"', begin + 1);
+		if(end == std::string::npos)
+			return "";
+		return line.substr(begin + 1, end - begin - 1);
+	}
+
+	inline bool IsVersionLine(const std::string& line)
+	{
+		const size_t i = line.find_first_not_of(" \t");
+		return i != std::string::npos && line.compare(i, 8, "#version") == 0;
+	}
+
+	inline bool ProcessFile(const std::string& path, const std::string& defines, std::string& output, std::vector<ShaderDependency>& dependencies)
+	{
+		std::string source;
+		if(!ReadShaderSource(path, source))
+		{
+			std::cout << "ERROR::SHADER_PREPROCESSOR::FILE_NOT_FOUND " << path << std::endl;
+			return false;
+		}
+		const size_t fileIndex = dependencies.size();
+		dependencies.push_back({path, HashString(source)});
+
+		const std::string directory = path.find('/') == std::string::npos ? "" : path.substr(0, path.rfind('/') + 1);
+		std::istringstream lines(source);
+		std::string line;
+		int lineNumber = 0;
+		while(std::getline(lines, line))
+		{
+			lineNumber++;
+			if(!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			if(IsVersionLine(line))
+			{
+				if(fileIndex != 0)
+				{
+					std::cout << "ERROR::SHADER_PREPROCESSOR::VERSION_IN_INCLUDE " << path << std::endl;
+					return false;
+				}
+				output += line + "\n" + defines;
+				output += "#line " + std::to_string(lineNumber + 1) + " 0\n";
+				continue;
+			}
+
+			const std::string include = GetIncludeName(line);
+			if(include.empty())
+			{
+				output += line + "\n";
+				continue;
+			}
+
+			// each file goes in once, which also stops include cycles
+			const std::string includePath = NormalizePath(directory + include);
+			bool isIncluded = false;
+			for(const ShaderDependency& dependency : dependencies)
+				isIncluded = isIncluded || dependency.m_path == includePath;
+			if(!isIncluded)
+			{
+				output += "#line 1 " + std::to_string(dependencies.size()) + "\n";
+				if(!ProcessFile(includePath, defines, output, dependencies))
+				{
+					std::cout << "ERROR::SHADER_PREPROCESSOR::INCLUDED_FROM " << path << "(" << lineNumber << ")" << std::endl;
+					return false;
+				}
+			}
+			output += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+		}
+		return true;
+	}
+}
+
+/*
+* Resolves #include "file" (relative to the including file) and puts one #define per entry of
+* defines ("NAME" or "NAME VALUE") right after #version.
+* dependencies gets every file read, in order, so a change to any of them can be detected. The
+* output keeps each file's lines apart with #line: a compile error at "2(14)" is line 14 of
+* dependencies[2].
+*/
+inline bool PreprocessShader(const std::string& path, const std::vector<std::string>& defines, std::string& output, std::vector<ShaderDependency>& dependencies)
+{
+	std::string defineLines;
+	for(const std::string& define : defines)
+		defineLines += "#define " + define + "\n";
+
+	output.clear();
+	dependencies.clear();
+	return ShaderPreprocessorDetail::ProcessFile(NormalizePath(path), defineLines, output, dependencies);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Shader.h"
+
+/*
+* A permutation key is a material part (low 16 bits, what the material has) and a feature part
+* (high 16 bits, what the pass asks for). Each set flag becomes a #define of the same name.
+*/
+enum ShaderMaterialFlag : uint32_t
+{
+	MATERIAL_DIFFUSE_MAP = 1 << 0,
+	MATERIAL_SPECULAR_MAP = 1 << 1,
+};
+
+enum ShaderFeatureFlag : uint32_t
+{
+	// blends a second texture over the first, by uMix
+	FEATURE_TEXTURE_MIX = 1 << 16,
+	// multiplies in a model space transform per instance, from attributes 3 to 6 (see Mesh::SetInstanceTransforms)
+	FEATURE_INSTANCED = 1 << 17,
+};
+
+inline std::vector<std::string> GetShaderDefines(uint32_t permutation)
+{
+	struct FlagName
+	{
+		uint32_t m_flag;
+		const char* m_define;
+	};
+	static const FlagName FLAG_NAMES[] = {
+		{MATERIAL_DIFFUSE_MAP, "MATERIAL_DIFFUSE_MAP"},
+		{MATERIAL_SPECULAR_MAP, "MATERIAL_SPECULAR_MAP"},
+		{FEATURE_TEXTURE_MIX, "FEATURE_TEXTURE_MIX"},
+		{FEATURE_INSTANCED, "FEATURE_INSTANCED"},
+	};
+
+	std::vector<std::string> defines;
+	for(const FlagName& name : FLAG_NAMES)
+	{
+		if(permutation & name.m_flag)
+			defines.push_back(name.m_define);
+	}
+	return defines;
+}
+
+/*
+* Every permutation of one vertex/fragment pair. Nothing compiles up front: a variant is built (or
+* loaded from its program binary) the first time Get asks for it and kept from then on, so only
+* the permutations actually drawn cost anything.
+* Prepare starts the variants known to be needed soon without waiting on them. Submitted together,
+* the driver compiles them in parallel while loading goes on, and Get only waits for what is
+* still running when the variant is first drawn.
+*/
+class ShaderVariants
+{
+public:
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath)
+		: m_vertexPath(vertexPath), m_fragmentPath(fragmentPath)
+	{
+	}
+
+	// GL thread only. Starts building the variant unless it was already, never waits
+	void Prepare(uint32_t permutation);
+	// GL thread only, never waits. False while the variant is compiling, or wasn't prepared
+	bool IsReady(uint32_t permutation) const;
+	// GL thread only, waits when the variant isn't built yet. The reference stays valid until
+	// ReloadChanged drops the variant or Delete
+	Shader& Get(uint32_t permutation);
+
+	// GL thread only. Drops the variants whose source files (includes too) changed since they were
+	// built, they build again on their next Get. Returns how many were dropped
+	size_t ReloadChanged();
+
+	size_t GetVariantCount() const { return m_variants.size(); }
+
+	void Delete();
+
+private:
+	std::string m_vertexPath;
+	std::string m_fragmentPath;
+	std::unordered_map<uint32_t, std::unique_ptr<Shader>> m_variants;
+};
+
+inline void ShaderVariants::Prepare(uint32_t permutation)
+{
+	std::unique_ptr<Shader>& shader = m_variants[permutation];
+	if(!shader)
+		shader = Shader::CompileAsync(m_vertexPath.c_str(), m_fragmentPath.c_str(), GetShaderDefines(permutation));
+}
+
+inline bool ShaderVariants::IsReady(uint32_t permutation) const
+{
+	auto found = m_variants.find(permutation);
+	return found != m_variants.end() && found->second->IsReady();
+}
+
+inline Shader& ShaderVariants::Get(uint32_t permutation)
+{
+	std::unique_ptr<Shader>& shader = m_variants[permutation];
+	if(!shader)
+	{
+		PROFILE_ZONE("Shader Variant Build");
+		shader = Shader::CompileAsync(m_vertexPath.c_str(), m_fragmentPath.c_str(), GetShaderDefines(permutation));
+	}
+	shader->Finish();
+	return *shader;
+}
+
+inline size_t ShaderVariants::ReloadChanged()
+{
+	size_t dropped = 0;
+	for(auto it = m_variants.begin(); it != m_variants.end();)
+	{
+		if(!HaveShaderSourcesChanged(it->second->m_dependencies))
+		{
+			++it;
+			continue;
+		}
+		it->second->Delete();
+		it = m_variants.erase(it);
+		dropped++;
+	}
+	return dropped;
+}
+
+inline void ShaderVariants::Delete()
+{
+	for(auto& variant : m_variants)
+		variant.second->Delete();
+	m_variants.clear();
+}
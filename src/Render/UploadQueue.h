@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/MpscQueue.h"
+
+/*
+* GL work handed over from worker threads. Any thread can Enqueue, the GL thread runs the tasks
+* once per frame in Process, stopping when the frame's time budget is used up, so a big load is
+* spread over several frames instead of stalling one.
+*/
+class UploadQueue
+{
+public:
+	using Task = std::function<void()>;
+
+	void Enqueue(Task task);
+
+	// GL thread only. Runs at least one task per call, so progress is made even if a single task is over budget
+	uint32_t Process(double budgetMs);
+	// GL thread only. Runs everything queued so far
+	uint32_t Flush();
+
+	uint32_t GetPendingCount() const { return m_pendingCount.load(std::memory_order_relaxed); }
+
+private:
+	MpscQueue<Task> m_tasks;
+	std::atomic<uint32_t> m_pendingCount{0};
+};
+
+inline UploadQueue& GetUploadQueue()
+{
+	static UploadQueue queue;
+	return queue;
+}
+
+inline void UploadQueue::Enqueue(Task task)
+{
+	m_pendingCount.fetch_add(1, std::memory_order_relaxed);
+	m_tasks.Push(std::move(task));
+}
+
+inline uint32_t UploadQueue::Process(double budgetMs)
+{
+	PROFILE_ZONE("Upload Queue");
+	const uint64_t startNs = CpuProfiler::NowNs();
+	const uint64_t budgetNs = static_cast<uint64_t>(budgetMs * 1e6);
+
+	uint32_t executed = 0;
+	Task task;
+	while(m_tasks.Pop(task))
+	{
+		task();
+		task = nullptr;
+		executed++;
+		m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+		if(CpuProfiler::NowNs() - startNs >= budgetNs)
+			break;
+	}
+	return executed;
+}
+
+inline uint32_t UploadQueue::Flush()
+{
+	uint32_t executed = 0;
+	Task task;
+	while(m_tasks.Pop(task))
+	{
+		task();
+		task = nullptr;
+		executed++;
+		m_pendingCount.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return executed;
+}
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "SparseSet.h"
+
+// index into the scene's slots, the generation tells a destroyed entity from a later one reusing its index
+struct Entity
+{
+	uint32_t m_index = UINT32_MAX;
+	uint32_t m_generation = 0;
+};
+
+struct BoundingSphere
+{
+	glm::vec3 m_center = glm::vec3(0.0f);
+	float m_radius = 0.0f;
+
+	static BoundingSphere FromBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		return {(boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f};
+	}
+};
+
+// a point light at its entity's position
+struct Light
+{
+	glm::vec3 m_color = glm::vec3(1.0f);
+	float m_intensity = 1.0f;
+	// no light beyond this distance
+	float m_range = 10.0f;
+};
+
+// position, rotation and scale of each entity, one column each, and the world matrices made from them
+struct TransformStorage
+{
+	SparseSet m_set;
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::quat> m_rotations;
+	std::vector<glm::vec3> m_scales;
+	// written by UpdateTransforms
+	std::vector<glm::mat4> m_worldMatrices;
+	// the world matrix and the bounds are out of date, cleared once UpdateScene caught up
+	std::vector<uint8_t> m_isDirty;
+
+	void Add(uint32_t entity, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	void Remove(uint32_t entity);
+};
+
+// what each entity is drawn with and its bounds, one column each
+struct RenderableStorage
+{
+	SparseSet m_set;
+	// index of the SceneRenderer drawable
+	std::vector<uint32_t> m_drawables;
+	std::vector<BoundingSphere> m_localBounds;
+	// written by UpdateBounds, the local bounds without a transform
+	std::vector<BoundingSphere> m_worldBounds;
+
+	void Add(uint32_t entity, uint32_t drawable, const BoundingSphere& localBounds);
+	void Remove(uint32_t entity);
+};
+
+/*
+* Entities and their components, each component type in columns of its own in sparse set order
+* (see SparseSet). Systems walk the columns front to back instead of visiting objects, see
+* SceneSystems.h for the updates and the culling and SceneRenderer for drawing.
+* Components reference nothing but entity indices and drawables, so adding and destroying entities
+* only moves plain data around.
+*/
+class Scene
+{
+public:
+	Entity CreateEntity();
+	// removes all its components, its index is reused by a later entity
+	void DestroyEntity(Entity entity);
+	bool IsAlive(Entity entity) const { return entity.m_index < m_generations.size() && m_generations[entity.m_index] == entity.m_generation; }
+	uint32_t GetEntityCount() const { return static_cast<uint32_t>(m_generations.size() - m_freeIndices.size()); }
+
+	void AddTransform(Entity entity, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+					  const glm::vec3& scale = glm::vec3(1.0f));
+	void SetPosition(Entity entity, const glm::vec3& position);
+	void SetRotation(Entity entity, const glm::quat& rotation);
+	void SetScale(Entity entity, const glm::vec3& scale);
+
+	// bounds in the entity's local space
+	void AddRenderable(Entity entity, uint32_t drawable, const BoundingSphere& localBounds);
+	// for every entity drawn with drawable, e.g. once a model finished loading
+	void SetDrawableBounds(uint32_t drawable, const BoundingSphere& localBounds);
+
+	void AddLight(Entity entity, const Light& light);
+
+	TransformStorage& GetTransforms() { return m_transforms; }
+	RenderableStorage& GetRenderables() { return m_renderables; }
+	ComponentStorage<Light>& GetLights() { return m_lights; }
+
+private:
+	uint32_t FindTransform(Entity entity) const { return IsAlive(entity) ? m_transforms.m_set.Find(entity.m_index) : INVALID_SLOT; }
+	void MarkDirty(uint32_t entity);
+
+	// by entity index
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_freeIndices;
+
+	TransformStorage m_transforms;
+	RenderableStorage m_renderables;
+	ComponentStorage<Light> m_lights;
+};
+
+inline void TransformStorage::Add(uint32_t entity, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	uint32_t slot = m_set.Find(entity);
+	if(slot == INVALID_SLOT)
+	{
+		slot = m_set.Insert(entity);
+		m_positions.emplace_back();
+		m_rotations.emplace_back();
+		m_scales.emplace_back();
+		m_worldMatrices.emplace_back();
+		m_isDirty.emplace_back();
+	}
+	m_positions[slot] = position;
+	m_rotations[slot] = rotation;
+	m_scales[slot] = scale;
+	m_isDirty[slot] = 1;
+}
+
+inline void TransformStorage::Remove(uint32_t entity)
+{
+	if(!m_set.Contains(entity))
+		return;
+	const uint32_t slot = m_set.Remove(entity);
+	SwapRemove(m_positions, slot);
+	SwapRemove(m_rotations, slot);
+	SwapRemove(m_scales, slot);
+	SwapRemove(m_worldMatrices, slot);
+	SwapRemove(m_isDirty, slot);
+}
+
+inline void RenderableStorage::Add(uint32_t entity, uint32_t drawable, const BoundingSphere& localBounds)
+{
+	uint32_t slot = m_set.Find(entity);
+	if(slot == INVALID_SLOT)
+	{
+		slot = m_set.Insert(entity);
+		m_drawables.emplace_back();
+		m_localBounds.emplace_back();
+		m_worldBounds.emplace_back();
+	}
+	m_drawables[slot] = drawable;
+	m_localBounds[slot] = m_worldBounds[slot] = localBounds;
+}
+
+inline void RenderableStorage::Remove(uint32_t entity)
+{
+	if(!m_set.Contains(entity))
+		return;
+	const uint32_t slot = m_set.Remove(entity);
+	SwapRemove(m_drawables, slot);
+	SwapRemove(m_localBounds, slot);
+	SwapRemove(m_worldBounds, slot);
+}
+
+inline Entity Scene::CreateEntity()
+{
+	Entity entity;
+	if(!m_freeIndices.empty())
+	{
+		entity.m_index = m_freeIndices.back();
+		m_freeIndices.pop_back();
+	}
+	else
+	{
+		entity.m_index = static_cast<uint32_t>(m_generations.size());
+		m_generations.push_back(0);
+	}
+	entity.m_generation = m_generations[entity.m_index];
+	return entity;
+}
+
+inline void Scene::DestroyEntity(Entity entity)
+{
+	if(!IsAlive(entity))
+		return;
+	m_transforms.Remove(entity.m_index);
+	m_renderables.Remove(entity.m_index);
+	m_lights.Remove(entity.m_index);
+	m_generations[entity.m_index]++;
+	m_freeIndices.push_back(entity.m_index);
+}
+
+inline void Scene::AddTransform(Entity entity, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	if(IsAlive(entity))
+		m_transforms.Add(entity.m_index, position, rotation, scale);
+}
+
+inline void Scene::MarkDirty(uint32_t entity)
+{
+	const uint32_t slot = m_transforms.m_set.Find(entity);
+	if(slot != INVALID_SLOT)
+		m_transforms.m_isDirty[slot] = 1;
+}
+
+inline void Scene::SetPosition(Entity entity, const glm::vec3& position)
+{
+	const uint32_t slot = FindTransform(entity);
+	if(slot == INVALID_SLOT)
+		return;
+	m_transforms.m_positions[slot] = position;
+	m_transforms.m_isDirty[slot] = 1;
+}
+
+inline void Scene::SetRotation(Entity entity, const glm::quat& rotation)
+{
+	const uint32_t slot = FindTransform(entity);
+	if(slot == INVALID_SLOT)
+		return;
+	m_transforms.m_rotations[slot] = rotation;
+	m_transforms.m_isDirty[slot] = 1;
+}
+
+inline void Scene::SetScale(Entity entity, const glm::vec3& scale)
+{
+	const uint32_t slot = FindTransform(entity);
+	if(slot == INVALID_SLOT)
+		return;
+	m_transforms.m_scales[slot] = scale;
+	m_transforms.m_isDirty[slot] = 1;
+}
+
+inline void Scene::AddRenderable(Entity entity, uint32_t drawable, const BoundingSphere& localBounds)
+{
+	if(!IsAlive(entity))
+		return;
+	m_renderables.Add(entity.m_index, drawable, localBounds);
+	// the world bounds follow with the next update
+	MarkDirty(entity.m_index);
+}
+
+inline void Scene::SetDrawableBounds(uint32_t drawable, const BoundingSphere& localBounds)
+{
+	for(uint32_t slot = 0; slot < m_renderables.m_set.GetSize(); slot++)
+	{
+		if(m_renderables.m_drawables[slot] != drawable)
+			continue;
+		m_renderables.m_localBounds[slot] = m_renderables.m_worldBounds[slot] = localBounds;
+		MarkDirty(m_renderables.m_set.GetEntities()[slot]);
+	}
+}
+
+inline void Scene::AddLight(Entity entity, const Light& light)
+{
+	if(IsAlive(entity))
+		m_lights.Add(entity.m_index, light);
+}
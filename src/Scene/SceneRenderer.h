@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../Model/Model.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Profiling/GpuProfiler.h"
+#include "../Profiling/RenderStats.h"
+#include "../Render/ShaderVariants.h"
+#include "../Texture/TextureCache.h"
+#include "Scene.h"
+#include "SceneSystems.h"
+
+// something renderables are drawn with: a model, or a vertex array with its textures
+struct Drawable
+{
+	// gpu profiler scope of its draws
+	const char* m_name = "";
+	ShaderVariants* m_shaders = nullptr;
+	// variant of m_shaders to draw with, models use their own (Model::GetPermutation) instead
+	uint32_t m_permutation = 0;
+
+	std::shared_ptr<Model> m_model;
+
+	// without a model: a non indexed triangle list, texture i bound to unit i as uTexture<i>
+	unsigned int m_vertexArray = 0;
+	GLsizei m_vertexCount = 0;
+	std::vector<TextureHandle> m_textures;
+};
+
+/*
+* Draws the renderables of a Scene. Culls their world bounds against the view, then buckets the
+* visible ones by drawable, so each drawable binds its shader, textures and vertex arrays once. A
+* vertex array only sets the model matrix per renderable, a model draws each of its meshes once,
+* instanced over all of the drawable's renderables. Texture residency is asked for once per
+* drawable, for its renderable largest on screen.
+* The scene has to be updated (UpdateScene) before.
+*/
+class SceneRenderer
+{
+public:
+	uint32_t AddDrawable(Drawable drawable);
+	Drawable& GetDrawable(uint32_t drawable) { return m_drawables[drawable]; }
+
+	void Render(Scene& scene, const glm::mat4& view, const glm::mat4& projection, const StreamingView& streamingView, GpuProfiler& gpuProfiler);
+
+	// slots of the lights that reached into the view last frame, for whatever shades with them
+	const std::vector<uint32_t>& GetVisibleLights() const { return m_visibleLights; }
+
+	// drops the drawables and whatever models and textures they hold, the vertex arrays are the caller's
+	void Clear() { m_drawables.clear(); }
+
+private:
+	// one drawable's group of m_drawOrder
+	struct DrawRange
+	{
+		const RenderableStorage& m_renderables;
+		const TransformStorage& m_transforms;
+		const uint32_t* m_begin;
+		const uint32_t* m_end;
+
+		const glm::mat4& GetWorldMatrix(uint32_t slot) const;
+		// the renderable largest on screen, nullptr when all are behind the camera
+		const uint32_t* FindLargest(const StreamingView& view, float& size) const;
+	};
+
+	void DrawModel(const Drawable& drawable, Shader& shader, const DrawRange& range, const StreamingView& view);
+	static void DrawVertexArray(const Drawable& drawable, Shader& shader, const DrawRange& range, const StreamingView& view);
+
+	std::vector<Drawable> m_drawables;
+
+	// per frame scratch space, kept to not reallocate
+	std::vector<uint8_t> m_visibility;
+	std::vector<uint32_t> m_visibleSlots;
+	// renderable slots of the visible ones, grouped by drawable
+	std::vector<uint32_t> m_drawOrder;
+	// where each drawable's group starts in m_drawOrder, one more than there are drawables
+	std::vector<uint32_t> m_drawableStarts;
+	// and where it ends
+	std::vector<uint32_t> m_drawableEnds;
+	// world matrices of one model drawable's renderables
+	std::vector<glm::mat4> m_modelMatrices;
+	std::vector<uint32_t> m_visibleLights;
+};
+
+inline uint32_t SceneRenderer::AddDrawable(Drawable drawable)
+{
+	m_drawables.push_back(std::move(drawable));
+	return static_cast<uint32_t>(m_drawables.size() - 1);
+}
+
+inline const glm::mat4& SceneRenderer::DrawRange::GetWorldMatrix(uint32_t slot) const
+{
+	static const glm::mat4 identity(1.0f);
+	const uint32_t transform = m_transforms.m_set.Find(m_renderables.m_set.GetEntities()[slot]);
+	return transform != INVALID_SLOT ? m_transforms.m_worldMatrices[transform] : identity;
+}
+
+inline const uint32_t* SceneRenderer::DrawRange::FindLargest(const StreamingView& view, float& size) const
+{
+	const uint32_t* largest = nullptr;
+	size = 0.0f;
+	for(const uint32_t* slot = m_begin; slot != m_end; slot++)
+	{
+		const BoundingSphere& bounds = m_renderables.m_worldBounds[*slot];
+		const float slotSize = view.GetProjectedSize(bounds.m_center, bounds.m_radius);
+		if(slotSize > size)
+		{
+			size = slotSize;
+			largest = slot;
+		}
+	}
+	return largest;
+}
+
+inline void SceneRenderer::Render(Scene& scene, const glm::mat4& view, const glm::mat4& projection, const StreamingView& streamingView,
+								  GpuProfiler& gpuProfiler)
+{
+	PROFILE_ZONE("Draw Scene");
+	const Frustum frustum(projection * view);
+	const RenderableStorage& renderables = scene.GetRenderables();
+	const TransformStorage& transforms = scene.GetTransforms();
+
+	m_visibleSlots.clear();
+	CullRenderables(renderables, frustum, m_visibility, m_visibleSlots);
+	m_visibleLights.clear();
+	CullLights(scene.GetLights(), transforms, frustum, m_visibleLights);
+	RenderStats& renderStats = GetRenderStats();
+	renderStats.m_visibleObjects += static_cast<uint32_t>(m_visibleSlots.size());
+	renderStats.m_culledObjects += renderables.m_set.GetSize() - static_cast<uint32_t>(m_visibleSlots.size());
+
+	// counting sort by drawable, the renderables keep their slot order within a group
+	m_drawableStarts.assign(m_drawables.size() + 1, 0);
+	for(uint32_t slot : m_visibleSlots)
+		m_drawableStarts[renderables.m_drawables[slot] + 1]++;
+	for(size_t i = 1; i < m_drawableStarts.size(); i++)
+		m_drawableStarts[i] += m_drawableStarts[i - 1];
+	m_drawableEnds.assign(m_drawableStarts.begin(), m_drawableStarts.end() - 1);
+	m_drawOrder.resize(m_visibleSlots.size());
+	for(uint32_t slot : m_visibleSlots)
+		m_drawOrder[m_drawableEnds[renderables.m_drawables[slot]]++] = slot;
+
+	for(uint32_t i = 0; i < m_drawables.size(); i++)
+	{
+		const Drawable& drawable = m_drawables[i];
+		const DrawRange range = {renderables, transforms, m_drawOrder.data() + m_drawableStarts[i], m_drawOrder.data() + m_drawableEnds[i]};
+		if(range.m_begin == range.m_end || (drawable.m_model && !drawable.m_model->IsReady()))
+			continue;
+
+		GPU_SCOPE(gpuProfiler, drawable.m_name);
+		Shader& shader = drawable.m_shaders->Get(drawable.m_model ? drawable.m_model->GetPermutation() : drawable.m_permutation);
+		shader.Use();
+		shader.SetMat4("uView", view);
+		shader.SetMat4("uProjection", projection);
+		if(drawable.m_model)
+			DrawModel(drawable, shader, range, streamingView);
+		else
+			DrawVertexArray(drawable, shader, range, streamingView);
+	}
+}
+
+inline void SceneRenderer::DrawModel(const Drawable& drawable, Shader& shader, const DrawRange& range, const StreamingView& view)
+{
+	// the largest instance on screen decides which texture levels the model needs
+	float size = 0.0f;
+	if(const uint32_t* largest = range.FindLargest(view, size))
+		drawable.m_model->RequestTextureResidency(range.GetWorldMatrix(*largest), view);
+
+	m_modelMatrices.clear();
+	for(const uint32_t* slot = range.m_begin; slot != range.m_end; slot++)
+		m_modelMatrices.push_back(range.GetWorldMatrix(*slot));
+	drawable.m_model->Draw(shader, m_modelMatrices.data(), static_cast<uint32_t>(m_modelMatrices.size()));
+}
+
+inline void SceneRenderer::DrawVertexArray(const Drawable& drawable, Shader& shader, const DrawRange& range, const StreamingView& view)
+{
+	float size = 0.0f;
+	range.FindLargest(view, size);
+	RenderStats& renderStats = GetRenderStats();
+	shader.BindTextureUnits(static_cast<uint32_t>(drawable.m_textures.size()));
+	for(size_t i = 0; i < drawable.m_textures.size(); i++)
+	{
+		GetTextureCache().RequestResidency(drawable.m_textures[i], size);
+		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i));
+		glBindTexture(GL_TEXTURE_2D, drawable.m_textures[i].GetId());
+	}
+	renderStats.m_textureBinds += static_cast<uint32_t>(drawable.m_textures.size());
+	glBindVertexArray(drawable.m_vertexArray);
+	renderStats.m_vertexArrayBinds++;
+
+	// looked up once instead of per renderable
+	const GLint modelLocation = shader.GetUniformLocation("uModel");
+	for(const uint32_t* slot = range.m_begin; slot != range.m_end; slot++)
+	{
+		glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(range.GetWorldMatrix(*slot)));
+		glDrawArrays(GL_TRIANGLES, 0, drawable.m_vertexCount);
+	}
+	const uint32_t count = static_cast<uint32_t>(range.m_end - range.m_begin);
+	renderStats.m_uniformUpdates += count;
+	renderStats.m_drawCalls += count;
+	renderStats.m_triangles += static_cast<uint64_t>(count) * static_cast<uint64_t>(drawable.m_vertexCount / 3);
+
+	glBindVertexArray(0);
+	for(size_t i = drawable.m_textures.size(); i > 0; i--)
+	{
+		glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(i - 1));
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/ThreadPool.h"
+#include "Scene.h"
+
+// columns shorter than this are walked on the calling thread, handing them out costs more
+constexpr uint32_t SCENE_PARALLEL_MIN_COUNT = 4096;
+
+// runs function(begin, end) over [0, count), on the thread pool when there is enough to do
+template<typename F>
+inline void ForEachRange(uint32_t count, F function)
+{
+	if(count < SCENE_PARALLEL_MIN_COUNT)
+		function(0, count);
+	else
+		GetThreadPool().ParallelFor(count, function);
+}
+
+// the six planes of a view projection, normals pointing inside
+struct Frustum
+{
+	glm::vec4 m_planes[6];
+
+	explicit Frustum(const glm::mat4& viewProjection)
+	{
+		// rows of the matrix, glm stores columns
+		glm::vec4 rows[4];
+		for(int i = 0; i < 4; i++)
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		for(int i = 0; i < 3; i++)
+		{
+			m_planes[i * 2] = rows[3] + rows[i];
+			m_planes[i * 2 + 1] = rows[3] - rows[i];
+		}
+		for(glm::vec4& plane : m_planes)
+			plane /= glm::length(glm::vec3(plane));
+	}
+
+	// also true for spheres only touching it
+	bool IsVisible(const BoundingSphere& sphere) const
+	{
+		for(const glm::vec4& plane : m_planes)
+		{
+			if(glm::dot(glm::vec3(plane), sphere.m_center) + plane.w < -sphere.m_radius)
+				return false;
+		}
+		return true;
+	}
+};
+
+// world matrices of the transforms that changed
+inline void UpdateTransforms(TransformStorage& transforms)
+{
+	PROFILE_ZONE("Update Transforms");
+	ForEachRange(transforms.m_set.GetSize(), [&transforms](uint32_t begin, uint32_t end) {
+		for(uint32_t slot = begin; slot < end; slot++)
+		{
+			if(!transforms.m_isDirty[slot])
+				continue;
+			const glm::mat4 translation = glm::translate(glm::mat4(1.0f), transforms.m_positions[slot]);
+			transforms.m_worldMatrices[slot] = glm::scale(translation * glm::mat4_cast(transforms.m_rotations[slot]), transforms.m_scales[slot]);
+		}
+	});
+}
+
+// world bounds of the renderables whose transform changed, after UpdateTransforms
+inline void UpdateBounds(const TransformStorage& transforms, RenderableStorage& renderables)
+{
+	PROFILE_ZONE("Update Bounds");
+	ForEachRange(renderables.m_set.GetSize(), [&transforms, &renderables](uint32_t begin, uint32_t end) {
+		const std::vector<uint32_t>& entities = renderables.m_set.GetEntities();
+		for(uint32_t slot = begin; slot < end; slot++)
+		{
+			const uint32_t transform = transforms.m_set.Find(entities[slot]);
+			if(transform == INVALID_SLOT || !transforms.m_isDirty[transform])
+				continue;
+			const glm::mat4& world = transforms.m_worldMatrices[transform];
+			const BoundingSphere& local = renderables.m_localBounds[slot];
+			// the largest scale axis keeps the sphere around everything
+			const float scale = std::max(glm::length(glm::vec3(world[0])), std::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+			renderables.m_worldBounds[slot] = {glm::vec3(world * glm::vec4(local.m_center, 1.0f)), local.m_radius * scale};
+		}
+	});
+}
+
+// brings world matrices and bounds up to date with whatever changed since the last update
+inline void UpdateScene(Scene& scene)
+{
+	TransformStorage& transforms = scene.GetTransforms();
+	UpdateTransforms(transforms);
+	UpdateBounds(transforms, scene.GetRenderables());
+	std::fill(transforms.m_isDirty.begin(), transforms.m_isDirty.end(), 0);
+}
+
+// appends the slots of the renderables inside the frustum to visibleSlots, in slot order.
+// visibility is scratch space, kept by the caller so it doesn't reallocate every frame
+inline void CullRenderables(const RenderableStorage& renderables, const Frustum& frustum, std::vector<uint8_t>& visibility,
+							std::vector<uint32_t>& visibleSlots)
+{
+	PROFILE_ZONE("Cull Renderables");
+	const uint32_t count = renderables.m_set.GetSize();
+	visibility.resize(count);
+	ForEachRange(count, [&](uint32_t begin, uint32_t end) {
+		for(uint32_t slot = begin; slot < end; slot++)
+			visibility[slot] = frustum.IsVisible(renderables.m_worldBounds[slot]);
+	});
+	for(uint32_t slot = 0; slot < count; slot++)
+	{
+		if(visibility[slot])
+			visibleSlots.push_back(slot);
+	}
+}
+
+// appends the slots of the lights reaching into the frustum to visibleSlots
+inline void CullLights(ComponentStorage<Light>& lights, const TransformStorage& transforms, const Frustum& frustum,
+					   std::vector<uint32_t>& visibleSlots)
+{
+	PROFILE_ZONE("Cull Lights");
+	const std::vector<uint32_t>& entities = lights.GetSet().GetEntities();
+	for(uint32_t slot = 0; slot < entities.size(); slot++)
+	{
+		const uint32_t transform = transforms.m_set.Find(entities[slot]);
+		if(transform == INVALID_SLOT)
+			continue;
+		const BoundingSphere reach = {glm::vec3(transforms.m_worldMatrices[transform][3]), lights.GetComponents()[slot].m_range};
+		if(frustum.IsVisible(reach))
+			visibleSlots.push_back(slot);
+	}
+}
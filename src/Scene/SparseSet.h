@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// slot of an entity that isn't in the set
+constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+/*
+* Maps entity indices to dense slots 0..size-1 and back. Component storages keep one or more
+* columns (vectors) in the dense order, so systems walk them front to back without gaps, and an
+* entity's slot is found with one lookup. Removing moves the last slot into the freed one, the
+* columns have to do the same (see SwapRemove).
+*/
+class SparseSet
+{
+public:
+	// the new slot is the last one, the columns push_back
+	uint32_t Insert(uint32_t entity);
+	// returns the freed slot, the columns SwapRemove it
+	uint32_t Remove(uint32_t entity);
+	// INVALID_SLOT when the entity isn't in the set
+	uint32_t Find(uint32_t entity) const { return entity < m_slots.size() ? m_slots[entity] : INVALID_SLOT; }
+	bool Contains(uint32_t entity) const { return Find(entity) != INVALID_SLOT; }
+
+	// entity index of every slot
+	const std::vector<uint32_t>& GetEntities() const { return m_entities; }
+	uint32_t GetSize() const { return static_cast<uint32_t>(m_entities.size()); }
+
+private:
+	// by entity index
+	std::vector<uint32_t> m_slots;
+	// by slot
+	std::vector<uint32_t> m_entities;
+};
+
+// the column side of SparseSet::Remove
+template<typename T>
+inline void SwapRemove(std::vector<T>& column, uint32_t slot)
+{
+	if(slot + 1 < column.size())
+		column[slot] = std::move(column.back());
+	column.pop_back();
+}
+
+// a component type stored as a single column
+template<typename T>
+class ComponentStorage
+{
+public:
+	// replaces the entity's component if it already has one
+	T& Add(uint32_t entity, const T& component)
+	{
+		const uint32_t slot = m_set.Find(entity);
+		if(slot != INVALID_SLOT)
+			return m_components[slot] = component;
+		m_set.Insert(entity);
+		m_components.push_back(component);
+		return m_components.back();
+	}
+	void Remove(uint32_t entity)
+	{
+		if(m_set.Contains(entity))
+			SwapRemove(m_components, m_set.Remove(entity));
+	}
+	// nullptr when the entity doesn't have one
+	T* Get(uint32_t entity)
+	{
+		const uint32_t slot = m_set.Find(entity);
+		return slot != INVALID_SLOT ? &m_components[slot] : nullptr;
+	}
+
+	const SparseSet& GetSet() const { return m_set; }
+	std::vector<T>& GetComponents() { return m_components; }
+	const std::vector<T>& GetComponents() const { return m_components; }
+
+private:
+	SparseSet m_set;
+	std::vector<T> m_components;
+};
+
+inline uint32_t SparseSet::Insert(uint32_t entity)
+{
+	if(entity >= m_slots.size())
+		m_slots.resize(entity + 1, INVALID_SLOT);
+	m_slots[entity] = static_cast<uint32_t>(m_entities.size());
+	m_entities.push_back(entity);
+	return m_slots[entity];
+}
+
+inline uint32_t SparseSet::Remove(uint32_t entity)
+{
+	const uint32_t slot = m_slots[entity];
+	const uint32_t last = m_entities.back();
+	m_entities[slot] = last;
+	m_slots[last] = slot;
+	m_entities.pop_back();
+	m_slots[entity] = INVALID_SLOT;
+	return slot;
+}
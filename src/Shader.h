@@ -4,30 +4,55 @@
 
 #include <glad/glad.h>
 
-#include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
-#include <sstream>
+#include <memory>
 #include <string>
+#include <vector>
 
+#include "Profiling/CpuProfiler.h"
+#include "Profiling/RenderStats.h"
+#include "Render/ProgramBinaryCache.h"
+#include "Render/ShaderPreprocessor.h"
 
 class Shader
 {
 public:
 	// the program ID
-	unsigned int ID;
+	unsigned int ID = 0;
+	// every source file that went in, includes too
+	std::vector<ShaderDependency> m_dependencies;
+
+	// constructor reads and builds the shader, or loads the program binary cached by an earlier run.
+	// Each define ("NAME" or "NAME VALUE") is added after #version
+	Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines = std::vector<std::string>());
+	// starts compiling and linking and returns without asking for the result, so the driver can work
+	// on it (on its own threads with KHR_parallel_shader_compile) while the caller submits more
+	static std::unique_ptr<Shader> CompileAsync(const char* vertexPath, const char* fragmentPath,
+												const std::vector<std::string>& defines = std::vector<std::string>());
+
+	// never waits. Always true without KHR_parallel_shader_compile, there is no way to ask then
+	bool IsReady() const;
+	// waits for the compile if it is still running, then reports errors and caches the binary.
+	// Use does it on its own
+	void Finish();
 
-	// constructor reads and builds the shader
-	Shader(const char* vertexPath, const char* fragmentPath);
 	// use/activate the shader
 	void Use()
 	{
+		if(m_isPending)
+			Finish();
 		glUseProgram(ID);
+		GetRenderStats().m_shaderBinds++;
 	}
 
 	void Delete()
 	{
+		// still attached when the compile was never finished, deleting the program frees them
+		glDeleteShader(m_vertexShader);
+		glDeleteShader(m_fragmentShader);
 		glDeleteProgram(ID);
+		m_isPending = false;
 	}
 
 	// utility uniform functions
@@ -38,89 +63,159 @@ public:
 	void SetBool(const std::string& name, bool value) const
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+		GetRenderStats().m_uniformUpdates++;
 	}
 	void SetInt(const std::string& name, int value) const
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+		GetRenderStats().m_uniformUpdates++;
 	}
 	void SetFloat(const std::string& name, float value) const
 	{
 		glUniform1f(GetUniformLocation(name), value);
+		GetRenderStats().m_uniformUpdates++;
 	}
 	void SetMat4(const std::string& name, glm::mat4 value) const
 	{
 		glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
+		GetRenderStats().m_uniformUpdates++;
+	}
+	// points the samplers uTexture0 to uTexture<count - 1> at texture units 0 to count - 1, the shader
+	// has to be in use. That is program state, so only units not set by an earlier call cost anything
+	void BindTextureUnits(uint32_t count)
+	{
+		for(; m_boundTextureUnitCount < count; m_boundTextureUnitCount++)
+			SetInt("uTexture" + std::to_string(m_boundTextureUnitCount), static_cast<int>(m_boundTextureUnitCount));
+	}
+	// texture unit the named sampler reads from, the next free one is given to it and set on its first
+	// use by the program. The shader has to be in use. Not for programs using BindTextureUnits
+	GLuint GetSamplerUnit(const std::string& name)
+	{
+		for(size_t unit = 0; unit < m_samplerUnits.size(); unit++)
+		{
+			if(m_samplerUnits[unit] == name)
+				return static_cast<GLuint>(unit);
+		}
+		m_samplerUnits.push_back(name);
+		SetInt(name, static_cast<int>(m_samplerUnits.size() - 1));
+		return static_cast<GLuint>(m_samplerUnits.size() - 1);
 	}
 
+private:
+	Shader() = default;
+
+	void submit(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines);
+
+	// set between submit and Finish when the program wasn't loaded from a binary
+	bool m_isPending = false;
+	unsigned int m_vertexShader = 0;
+	unsigned int m_fragmentShader = 0;
+	size_t m_vertexFileCount = 0;
+	std::string m_cachePath;
+	uint64_t m_cacheKey = 0;
+	// see BindTextureUnits
+	uint32_t m_boundTextureUnitCount = 0;
+	// sampler names by texture unit, see GetSamplerUnit
+	std::vector<std::string> m_samplerUnits;
 };
 
-inline Shader::Shader(const char* vertexPath, const char* fragmentPath)
+inline Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+{
+	submit(vertexPath, fragmentPath, defines);
+	Finish();
+}
+
+inline std::unique_ptr<Shader> Shader::CompileAsync(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
+{
+	std::unique_ptr<Shader> shader(new Shader());
+	shader->submit(vertexPath, fragmentPath, defines);
+	return shader;
+}
+
+inline void Shader::submit(const char* vertexPath, const char* fragmentPath, const std::vector<std::string>& defines)
 {
-	// 1. retrieve the vertex/fragment source code from filePath
+	// 1. retrieve the vertex/fragment source code, includes resolved and defines added
 	std::string vertexCode;
 	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	try
-	{
-		// open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-		// read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch(std::ifstream::failure e)
-	{
+	std::vector<ShaderDependency> fragmentDependencies;
+	if(!PreprocessShader(vertexPath, defines, vertexCode, m_dependencies) || !PreprocessShader(fragmentPath, defines, fragmentCode, fragmentDependencies))
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-	}
+	m_vertexFileCount = m_dependencies.size();
+	m_dependencies.insert(m_dependencies.end(), fragmentDependencies.begin(), fragmentDependencies.end());
+
+	// 2. reuse the program linked by an earlier run when sources and driver are unchanged
+	std::string defineKey;
+	for(const std::string& define : defines)
+		defineKey += define + "\n";
+	m_cachePath = ProgramBinaryCache::GetCachePath(vertexPath, fragmentPath, defineKey);
+	m_cacheKey = ProgramBinaryCache::GetKey(vertexCode, fragmentCode);
+	ID = ProgramBinaryCache::Load(m_cachePath, m_cacheKey);
+	if(ID != 0)
+		return;
+
+	PROFILE_ZONE("Shader Submit");
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// 2. compile shaders
-	unsigned int vertex, fragment;
+	// 3. compile and link, the statuses are only asked for in Finish so nothing here waits on the driver
+	m_vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(m_vertexShader, 1, &vShaderCode, NULL);
+	glCompileShader(m_vertexShader);
+
+	m_fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(m_fragmentShader, 1, &fShaderCode, NULL);
+	glCompileShader(m_fragmentShader);
+
+	// shader Program
+	ID = glCreateProgram();
+	glAttachShader(ID, m_vertexShader);
+	glAttachShader(ID, m_fragmentShader);
+	if(ProgramBinaryCache::IsSupported())
+		GetGlExtensions().ProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(ID);
+	m_isPending = true;
+}
+
+inline bool Shader::IsReady() const
+{
+	if(!m_isPending || !GetGlExtensions().m_hasParallelShaderCompile)
+		return true;
+	int isComplete = 0;
+	glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &isComplete);
+	return isComplete != 0;
+}
+
+inline void Shader::Finish()
+{
+	if(!m_isPending)
+		return;
+	m_isPending = false;
+
+	PROFILE_ZONE("Shader Compile Wait");
 	int success;
 	char infoLog[512];
 
-	// vertex Shader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
 	// print compile errors if any
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(m_vertexShader, GL_COMPILE_STATUS, &success);
 	if(!success)
 	{
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(m_vertexShader, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		// the numbers before the line numbers are indices into the files that went in
+		for(size_t i = 0; i < m_vertexFileCount; i++)
+			std::cout << i << ": " << m_dependencies[i].m_path << std::endl;
 	}
 
 	// similar for Fragment Shader
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	// print compile errors if any
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(m_fragmentShader, GL_COMPILE_STATUS, &success);
 	if(!success)
 	{
-		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+		glGetShaderInfoLog(m_fragmentShader, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+		for(size_t i = m_vertexFileCount; i < m_dependencies.size(); i++)
+			std::cout << i - m_vertexFileCount << ": " << m_dependencies[i].m_path << std::endl;
 	}
 
-	// shader Program
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
 	// print linking errors if any
 	glGetProgramiv(ID, GL_LINK_STATUS, &success);
 	if(!success)
@@ -130,8 +225,13 @@ inline Shader::Shader(const char* vertexPath, const char* fragmentPath)
 	}
 
 	// delete the shaders as they're linked into our program now and no longer necessary
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDeleteShader(m_vertexShader);
+	glDeleteShader(m_fragmentShader);
+	m_vertexShader = 0;
+	m_fragmentShader = 0;
+
+	if(success)
+		ProgramBinaryCache::Write(m_cachePath, m_cacheKey, ID);
 }
 
 
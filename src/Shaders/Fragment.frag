@@ -1,7 +1,6 @@
 #version 330 core
 
 // in
-in vec3 ioColor;
 in vec2 ioTexCoord;
 
 // out
@@ -9,11 +8,16 @@ out vec4 FragColor;
 
 // uniform
 uniform sampler2D uTexture0;
+#ifdef FEATURE_TEXTURE_MIX
 uniform sampler2D uTexture1;
 uniform float uMix = 0.5;
+#endif
 
 void main()
 {
-    FragColor = texture(uTexture0, ioTexCoord) * vec4(ioColor,1.0);
+#ifdef FEATURE_TEXTURE_MIX
     FragColor = mix(texture(uTexture0, ioTexCoord),texture(uTexture1, vec2(ioTexCoord.x,1.0-ioTexCoord.y)),uMix);
+#else
+    FragColor = texture(uTexture0, ioTexCoord);
+#endif
 }
\ No newline at end of file
@@ -7,11 +7,15 @@ in vec2 ioTexCoord;
 out vec4 FragColor;
 
 // uniform
+#ifdef MATERIAL_DIFFUSE_MAP
 uniform sampler2D texture_diffuse1;
-uniform sampler2D texture_specular1;
+#endif
 
 void main()
 {
-    //FragColor = vec4(ioTexCoord,0,0);
+#ifdef MATERIAL_DIFFUSE_MAP
     FragColor = texture(texture_diffuse1, ioTexCoord);
+#else
+    FragColor = vec4(1.0);
+#endif
 }
\ No newline at end of file
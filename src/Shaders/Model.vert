@@ -8,13 +8,10 @@ layout (location = 2) in vec2 iTexCoord;
 // out
 out vec2 ioTexCoord;
 
-// uniform
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProjection;
+#include "Transform.glsl"
 
 void main()
 {
-   gl_Position = uProjection * uView * uModel * vec4(iPos, 1.0);
+   gl_Position = TransformPosition(iPos);
    ioTexCoord = iTexCoord;
 }
\ No newline at end of file
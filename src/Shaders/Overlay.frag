@@ -0,0 +1,16 @@
+#version 330 core
+
+// in
+in vec2 ioTexCoord;
+in vec4 ioColor;
+
+// out
+out vec4 FragColor;
+
+// uniform
+uniform sampler2D uFont;
+
+void main()
+{
+    FragColor = vec4(ioColor.rgb, ioColor.a * texture(uFont, ioTexCoord).r);
+}
\ No newline at end of file
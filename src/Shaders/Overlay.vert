@@ -0,0 +1,22 @@
+#version 330 core
+
+// in
+layout (location = 0) in vec2 iPos;
+layout (location = 1) in vec2 iTexCoord;
+layout (location = 2) in vec4 iColor;
+
+// out
+out vec2 ioTexCoord;
+out vec4 ioColor;
+
+// uniform
+uniform vec2 uScreenSize;
+
+void main()
+{
+   // pixel coordinates with the origin at the top left
+   vec2 ndc = iPos / uScreenSize * 2.0 - 1.0;
+   gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+   ioTexCoord = iTexCoord;
+   ioColor = iColor;
+}
\ No newline at end of file
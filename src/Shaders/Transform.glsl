@@ -0,0 +1,20 @@
+// model, view and projection shared by the scene shaders
+
+// uniform
+uniform mat4 uModel;
+uniform mat4 uView;
+uniform mat4 uProjection;
+
+#ifdef FEATURE_INSTANCED
+// in
+layout (location = 3) in mat4 iInstanceTransform;
+#endif
+
+vec4 TransformPosition(vec3 position)
+{
+#ifdef FEATURE_INSTANCED
+    return uProjection * uView * uModel * iInstanceTransform * vec4(position, 1.0);
+#else
+    return uProjection * uView * uModel * vec4(position, 1.0);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,476 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/ThreadPool.h"
+#include "TextureFormat.h"
+
+/*
+* CPU encoders for BC1, BC3, BC4, BC5 and BC7, used when textures are cooked.
+* Every block takes its endpoints from the principal axis of its pixels (the line through colour
+* space that fits them best), refines them once by least squares on the chosen indices and keeps
+* whichever encodes with less error. Index search tests 4 pixels at a time with SSE2.
+* BC7 only uses mode 6 (one subset, rgba endpoints, 4 bit indices): smooth gradients and alpha come
+* out well, blocks mixing several unrelated colours lose the most against a full mode search.
+*/
+namespace BlockCompression
+{
+	// a 4x4 block with one array per channel, so 4 pixels fill an SSE register
+	struct Block
+	{
+		alignas(16) float m_channels[4][16];
+	};
+
+	// share of the second endpoint in each palette entry
+	constexpr float BC1_WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+	constexpr int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+	inline float Clamp255(float value)
+	{
+		return std::min(std::max(value, 0.0f), 255.0f);
+	}
+
+	// edge blocks repeat the last row and column
+	inline void LoadBlock(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, uint32_t blockX, uint32_t blockY, Block& block)
+	{
+		for(uint32_t y = 0; y < 4; y++)
+		{
+			const uint32_t pixelY = std::min(blockY * 4 + y, height - 1);
+			for(uint32_t x = 0; x < 4; x++)
+			{
+				const uint32_t pixelX = std::min(blockX * 4 + x, width - 1);
+				const uint8_t* pixel = pixels + (size_t(pixelY) * width + pixelX) * channels;
+				const uint32_t i = y * 4 + x;
+				for(uint32_t c = 0; c < 4; c++)
+					block.m_channels[c][i] = channels == 1 ? (c == 3 ? 255.0f : pixel[0]) : pixel[c];
+			}
+		}
+	}
+
+	// nearest palette entry for each pixel over channelCount channels from firstChannel on,
+	// returns the summed squared error
+	inline float FindIndices(const Block& block, int firstChannel, int channelCount, const float (*palette)[4], int paletteSize, uint8_t indices[16])
+	{
+		float totalError = 0.0f;
+#ifdef BLOCK_COMPRESSION_SSE2
+		for(int group = 0; group < 16; group += 4)
+		{
+			__m128 bestError = _mm_set1_ps(1e30f);
+			__m128 bestIndex = _mm_setzero_ps();
+			for(int p = 0; p < paletteSize; p++)
+			{
+				__m128 error = _mm_setzero_ps();
+				for(int c = 0; c < channelCount; c++)
+				{
+					const __m128 delta = _mm_sub_ps(_mm_load_ps(&block.m_channels[firstChannel + c][group]), _mm_set1_ps(palette[p][c]));
+					error = _mm_add_ps(error, _mm_mul_ps(delta, delta));
+				}
+				const __m128 isBetter = _mm_cmplt_ps(error, bestError);
+				bestError = _mm_min_ps(error, bestError);
+				bestIndex = _mm_or_ps(_mm_and_ps(isBetter, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(isBetter, bestIndex));
+			}
+
+			alignas(16) float errors[4];
+			alignas(16) float best[4];
+			_mm_store_ps(errors, bestError);
+			_mm_store_ps(best, bestIndex);
+			for(int i = 0; i < 4; i++)
+			{
+				indices[group + i] = static_cast<uint8_t>(best[i]);
+				totalError += errors[i];
+			}
+		}
+#else
+		for(int i = 0; i < 16; i++)
+		{
+			float bestError = 1e30f;
+			for(int p = 0; p < paletteSize; p++)
+			{
+				float error = 0.0f;
+				for(int c = 0; c < channelCount; c++)
+				{
+					const float delta = block.m_channels[firstChannel + c][i] - palette[p][c];
+					error += delta * delta;
+				}
+				if(error < bestError)
+				{
+					bestError = error;
+					indices[i] = static_cast<uint8_t>(p);
+				}
+			}
+			totalError += bestError;
+		}
+#endif
+		return totalError;
+	}
+
+	// endpoints at the extremes of the pixels projected on their principal axis
+	inline void ComputeEndpoints(const Block& block, int channelCount, float e0[4], float e1[4])
+	{
+		float mean[4] = {};
+		for(int c = 0; c < channelCount; c++)
+		{
+			for(int i = 0; i < 16; i++)
+				mean[c] += block.m_channels[c][i];
+			mean[c] /= 16.0f;
+		}
+
+		float covariance[4][4] = {};
+		for(int i = 0; i < 16; i++)
+		{
+			for(int a = 0; a < channelCount; a++)
+			{
+				for(int b = 0; b < channelCount; b++)
+					covariance[a][b] += (block.m_channels[a][i] - mean[a]) * (block.m_channels[b][i] - mean[b]);
+			}
+		}
+
+		// power iteration, starting from the channel that varies the most
+		int start = 0;
+		for(int c = 1; c < channelCount; c++)
+		{
+			if(covariance[c][c] > covariance[start][start])
+				start = c;
+		}
+		float axis[4] = {};
+		for(int c = 0; c < channelCount; c++)
+			axis[c] = covariance[start][c];
+		for(int iteration = 0; iteration < 8; iteration++)
+		{
+			float next[4] = {};
+			float length = 0.0f;
+			for(int a = 0; a < channelCount; a++)
+			{
+				for(int b = 0; b < channelCount; b++)
+					next[a] += covariance[a][b] * axis[b];
+				length += next[a] * next[a];
+			}
+			length = std::sqrt(length);
+			// a flat block has no axis, both endpoints end up on the mean
+			if(length < 1e-6f)
+			{
+				std::fill(axis, axis + 4, 0.0f);
+				break;
+			}
+			for(int c = 0; c < channelCount; c++)
+				axis[c] = next[c] / length;
+		}
+
+		float minT = 0.0f;
+		float maxT = 0.0f;
+		for(int i = 0; i < 16; i++)
+		{
+			float t = 0.0f;
+			for(int c = 0; c < channelCount; c++)
+				t += (block.m_channels[c][i] - mean[c]) * axis[c];
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+		for(int c = 0; c < channelCount; c++)
+		{
+			e0[c] = Clamp255(mean[c] + minT * axis[c]);
+			e1[c] = Clamp255(mean[c] + maxT * axis[c]);
+		}
+	}
+
+	// least squares endpoints for the chosen indices, false when the indices don't constrain both
+	inline bool RefineEndpoints(const Block& block, int channelCount, const uint8_t indices[16], const float* weights, float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float ax[4] = {};
+		float bx[4] = {};
+		for(int i = 0; i < 16; i++)
+		{
+			const float b = weights[indices[i]];
+			const float a = 1.0f - b;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for(int c = 0; c < channelCount; c++)
+			{
+				ax[c] += a * block.m_channels[c][i];
+				bx[c] += b * block.m_channels[c][i];
+			}
+		}
+
+		const float determinant = aa * bb - ab * ab;
+		if(std::fabs(determinant) < 1e-6f)
+			return false;
+		for(int c = 0; c < channelCount; c++)
+		{
+			e0[c] = Clamp255((bb * ax[c] - ab * bx[c]) / determinant);
+			e1[c] = Clamp255((aa * bx[c] - ab * ax[c]) / determinant);
+		}
+		return true;
+	}
+
+	//----------BC1
+	inline uint16_t QuantizeRgb565(const float color[3])
+	{
+		const int r = std::min(static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f), 31);
+		const int g = std::min(static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f), 63);
+		const int b = std::min(static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f), 31);
+		return static_cast<uint16_t>(r << 11 | g << 5 | b);
+	}
+
+	inline void ExpandRgb565(uint16_t packed, float color[3])
+	{
+		const int r = packed >> 11 & 31;
+		const int g = packed >> 5 & 63;
+		const int b = packed & 31;
+		color[0] = static_cast<float>(r << 3 | r >> 2);
+		color[1] = static_cast<float>(g << 2 | g >> 4);
+		color[2] = static_cast<float>(b << 3 | b >> 2);
+	}
+
+	// quantizes e0 and e1 and writes the block, they come back as stored and indices refers to them
+	inline float WriteBc1(const Block& block, float e0[4], float e1[4], uint8_t out[8], uint8_t indices[16])
+	{
+		uint16_t c0 = QuantizeRgb565(e0);
+		uint16_t c1 = QuantizeRgb565(e1);
+		// the 4 colour mode needs c0 > c1. Equal endpoints are a flat block, index 0 is exact there
+		if(c0 < c1)
+			std::swap(c0, c1);
+		ExpandRgb565(c0, e0);
+		ExpandRgb565(c1, e1);
+
+		float palette[4][4] = {};
+		for(int i = 0; i < 4; i++)
+		{
+			for(int c = 0; c < 3; c++)
+				palette[i][c] = e0[c] + (e1[c] - e0[c]) * BC1_WEIGHTS[i];
+		}
+		const float error = FindIndices(block, 0, 3, palette, c0 == c1 ? 1 : 4, indices);
+
+		uint32_t bits = 0;
+		for(int i = 0; i < 16; i++)
+			bits |= uint32_t(indices[i]) << (2 * i);
+		out[0] = static_cast<uint8_t>(c0);
+		out[1] = static_cast<uint8_t>(c0 >> 8);
+		out[2] = static_cast<uint8_t>(c1);
+		out[3] = static_cast<uint8_t>(c1 >> 8);
+		for(int i = 0; i < 4; i++)
+			out[4 + i] = static_cast<uint8_t>(bits >> (8 * i));
+		return error;
+	}
+
+	inline void EncodeBc1Block(const Block& block, uint8_t out[8])
+	{
+		float e0[4], e1[4];
+		uint8_t indices[16];
+		ComputeEndpoints(block, 3, e0, e1);
+		const float error = WriteBc1(block, e0, e1, out, indices);
+		if(error > 0.0f && RefineEndpoints(block, 3, indices, BC1_WEIGHTS, e0, e1))
+		{
+			uint8_t refined[8];
+			if(WriteBc1(block, e0, e1, refined, indices) < error)
+				std::memcpy(out, refined, sizeof(refined));
+		}
+	}
+	//==========BC1
+
+	//----------BC4
+	// one channel of the block, also the alpha of BC3 and both halves of BC5
+	inline void EncodeBc4Block(const Block& block, int channel, uint8_t out[8])
+	{
+		float low = 255.0f;
+		float high = 0.0f;
+		for(int i = 0; i < 16; i++)
+		{
+			low = std::min(low, block.m_channels[channel][i]);
+			high = std::max(high, block.m_channels[channel][i]);
+		}
+		// c0 > c1 selects the 8 value mode, c0 == c1 is a flat block and index 0 is exact
+		const int c0 = static_cast<int>(high + 0.5f);
+		const int c1 = static_cast<int>(low + 0.5f);
+
+		float palette[8][4] = {};
+		palette[0][0] = static_cast<float>(c0);
+		palette[1][0] = static_cast<float>(c1);
+		for(int i = 2; i < 8; i++)
+			palette[i][0] = ((8 - i) * c0 + (i - 1) * c1) / 7.0f;
+		uint8_t indices[16] = {};
+		if(c0 != c1)
+			FindIndices(block, channel, 1, palette, 8, indices);
+
+		uint64_t bits = 0;
+		for(int i = 0; i < 16; i++)
+			bits |= uint64_t(indices[i]) << (3 * i);
+		out[0] = static_cast<uint8_t>(c0);
+		out[1] = static_cast<uint8_t>(c1);
+		for(int i = 0; i < 6; i++)
+			out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+	//==========BC4
+
+	//----------BC7
+	// mode 6 endpoints are 7 bits per channel plus a lowest bit (p-bit) shared by the channels
+	inline void QuantizeBc7Endpoint(const float endpoint[4], int quantized[4], int& pBit)
+	{
+		float bestError = 1e30f;
+		for(int p = 0; p < 2; p++)
+		{
+			int candidate[4];
+			float error = 0.0f;
+			for(int c = 0; c < 4; c++)
+			{
+				candidate[c] = std::min(std::max(static_cast<int>((endpoint[c] - p) * 0.5f + 0.5f), 0), 127);
+				const float delta = static_cast<float>(candidate[c] << 1 | p) - endpoint[c];
+				error += delta * delta;
+			}
+			if(error < bestError)
+			{
+				bestError = error;
+				pBit = p;
+				std::copy(candidate, candidate + 4, quantized);
+			}
+		}
+	}
+
+	struct BitWriter
+	{
+		uint8_t* m_data;
+		uint32_t m_position = 0;
+
+		void Write(uint32_t value, uint32_t bitCount)
+		{
+			for(uint32_t i = 0; i < bitCount; i++, m_position++)
+			{
+				if(value >> i & 1)
+					m_data[m_position >> 3] |= static_cast<uint8_t>(1 << (m_position & 7));
+			}
+		}
+	};
+
+	// same contract as WriteBc1
+	inline float WriteBc7Mode6(const Block& block, float e0[4], float e1[4], uint8_t out[16], uint8_t indices[16])
+	{
+		int q0[4], q1[4];
+		int p0 = 0, p1 = 0;
+		QuantizeBc7Endpoint(e0, q0, p0);
+		QuantizeBc7Endpoint(e1, q1, p1);
+
+		float palette[16][4];
+		for(int c = 0; c < 4; c++)
+		{
+			const int v0 = q0[c] << 1 | p0;
+			const int v1 = q1[c] << 1 | p1;
+			e0[c] = static_cast<float>(v0);
+			e1[c] = static_cast<float>(v1);
+			for(int i = 0; i < 16; i++)
+				palette[i][c] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * v0 + BC7_WEIGHTS[i] * v1 + 32) >> 6);
+		}
+		const float error = FindIndices(block, 0, 4, palette, 16, indices);
+
+		// the first index is stored without its top bit, swapping the endpoints mirrors the palette
+		if(indices[0] >= 8)
+		{
+			std::swap(q0, q1);
+			std::swap(p0, p1);
+			for(int c = 0; c < 4; c++)
+				std::swap(e0[c], e1[c]);
+			for(int i = 0; i < 16; i++)
+				indices[i] = static_cast<uint8_t>(15 - indices[i]);
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter bits{out};
+		bits.Write(1 << 6, 7);
+		for(int c = 0; c < 4; c++)
+		{
+			bits.Write(q0[c], 7);
+			bits.Write(q1[c], 7);
+		}
+		bits.Write(p0, 1);
+		bits.Write(p1, 1);
+		bits.Write(indices[0], 3);
+		for(int i = 1; i < 16; i++)
+			bits.Write(indices[i], 4);
+		return error;
+	}
+
+	inline void EncodeBc7Block(const Block& block, uint8_t out[16])
+	{
+		float e0[4], e1[4];
+		uint8_t indices[16];
+		ComputeEndpoints(block, 4, e0, e1);
+		const float error = WriteBc7Mode6(block, e0, e1, out, indices);
+
+		float weights[16];
+		for(int i = 0; i < 16; i++)
+			weights[i] = BC7_WEIGHTS[i] / 64.0f;
+		if(error > 0.0f && RefineEndpoints(block, 4, indices, weights, e0, e1))
+		{
+			uint8_t refined[16];
+			if(WriteBc7Mode6(block, e0, e1, refined, indices) < error)
+				std::memcpy(out, refined, sizeof(refined));
+		}
+	}
+	//==========BC7
+
+	inline void EncodeBlock(TextureFormat format, const Block& block, uint8_t* out)
+	{
+		switch(format)
+		{
+			case TEXTURE_FORMAT_BC1:
+				EncodeBc1Block(block, out);
+				break;
+			case TEXTURE_FORMAT_BC3:
+				EncodeBc4Block(block, 3, out);
+				EncodeBc1Block(block, out + 8);
+				break;
+			case TEXTURE_FORMAT_BC4:
+				EncodeBc4Block(block, 0, out);
+				break;
+			case TEXTURE_FORMAT_BC5:
+				EncodeBc4Block(block, 0, out);
+				EncodeBc4Block(block, 1, out + 8);
+				break;
+			case TEXTURE_FORMAT_BC7:
+				EncodeBc7Block(block, out);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+// pixels holds width * height * channels bytes with 1 or 4 channels, a single channel is read as
+// grey. The block rows are spread over the thread pool
+inline std::vector<uint8_t> CompressImage(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t channels, TextureFormat format)
+{
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	const uint32_t blockSize = GetFormatBlockSize(format);
+	std::vector<uint8_t> blocks(size_t(blocksX) * blocksY * blockSize);
+	if(blocks.empty() || !IsBlockCompressed(format))
+		return blocks;
+
+	uint8_t* const output = blocks.data();
+	const auto compressRows = [=](uint32_t firstRow, uint32_t endRow) {
+		PROFILE_ZONE("Block Compress");
+		BlockCompression::Block block;
+		for(uint32_t blockY = firstRow; blockY < endRow; blockY++)
+		{
+			for(uint32_t blockX = 0; blockX < blocksX; blockX++)
+			{
+				BlockCompression::LoadBlock(pixels, width, height, channels, blockX, blockY, block);
+				BlockCompression::EncodeBlock(format, block, output + (size_t(blockY) * blocksX + blockX) * blockSize);
+			}
+		}
+	};
+
+	GetThreadPool().ParallelFor(blocksY, compressRows);
+	return blocks;
+}
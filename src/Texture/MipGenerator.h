@@ -0,0 +1,273 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/ThreadPool.h"
+
+enum MipFilter : uint32_t
+{
+	// average of the source pixels under each destination pixel, blurs the least but aliases fine detail
+	MIP_FILTER_BOX = 0,
+	// Kaiser windowed sinc over 3 destination pixels each side, keeps levels sharp without aliasing
+	MIP_FILTER_KAISER = 1,
+};
+
+// how the channels are treated while filtering
+enum MipContent : uint32_t
+{
+	// every channel filtered as stored
+	MIP_CONTENT_DATA = 0,
+	// rgb is sRGB encoded and filtered in linear space, alpha is linear
+	MIP_CONTENT_SRGB_COLOR = 1,
+	// tangent space normals in rgb, renormalized after filtering
+	MIP_CONTENT_NORMAL = 2,
+};
+
+/*
+* Builds the next smaller mip level on the CPU, so cooked textures carry their whole chain and
+* loading never runs glGenerateMipmap. The filter is separable: each source row is filtered
+* horizontally (an SSE register per rgba pixel), then the rows under a destination row are
+* combined vertically (4 floats per SSE op). Destination rows are spread over the thread pool,
+* each range only keeps the few horizontally filtered rows its vertical taps need.
+* Odd sizes are handled exactly, the filter footprint is scaled to the real size ratio.
+*/
+namespace MipGeneration
+{
+	constexpr float KAISER_WIDTH = 3.0f;
+	constexpr float KAISER_ALPHA = 4.0f;
+
+	// weights of the source pixels for every destination pixel along one axis
+	struct FilterTaps
+	{
+		uint32_t m_tapCount = 0;
+		// first source pixel of each destination pixel, may lie outside the image and gets clamped
+		std::vector<int32_t> m_first;
+		// m_tapCount weights per destination pixel
+		std::vector<float> m_weights;
+	};
+
+	struct ColorTables
+	{
+		float m_srgbToLinear[256];
+		// linear value halfway between sRGB codes k and k + 1
+		float m_srgbThresholds[255];
+	};
+
+	inline float SrgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	inline const ColorTables& GetColorTables()
+	{
+		static const ColorTables tables = []() {
+			ColorTables result;
+			for(int i = 0; i < 256; i++)
+				result.m_srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+			for(int i = 0; i < 255; i++)
+				result.m_srgbThresholds[i] = SrgbToLinear((i + 0.5f) / 255.0f);
+			return result;
+		}();
+		return tables;
+	}
+
+	// rounds in sRGB space, the same as encoding exactly and rounding
+	inline uint8_t LinearToSrgb8(const ColorTables& tables, float value)
+	{
+		return static_cast<uint8_t>(std::upper_bound(tables.m_srgbThresholds, tables.m_srgbThresholds + 255, value) - tables.m_srgbThresholds);
+	}
+
+	inline uint8_t ToUnorm8(float value)
+	{
+		return static_cast<uint8_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	inline float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		for(int k = 1; k < 20; k++)
+		{
+			term *= (x * 0.5f / k) * (x * 0.5f / k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	// x in destination pixels
+	inline float Kaiser(float x)
+	{
+		const float ratio = x / KAISER_WIDTH;
+		if(ratio <= -1.0f || ratio >= 1.0f)
+			return 0.0f;
+		const float pi = 3.14159265358979f;
+		const float sinc = std::fabs(x) < 1e-6f ? 1.0f : std::sin(pi * x) / (pi * x);
+		return sinc * BesselI0(KAISER_ALPHA * std::sqrt(1.0f - ratio * ratio)) / BesselI0(KAISER_ALPHA);
+	}
+
+	inline FilterTaps BuildTaps(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter)
+	{
+		const float scale = static_cast<float>(sourceSize) / destinationSize;
+		// half the footprint, in source pixels
+		const float radius = (filter == MIP_FILTER_BOX ? 0.5f : KAISER_WIDTH) * scale;
+
+		FilterTaps taps;
+		taps.m_tapCount = static_cast<uint32_t>(std::ceil(radius * 2.0f)) + 1;
+		taps.m_first.resize(destinationSize);
+		taps.m_weights.resize(size_t(destinationSize) * taps.m_tapCount);
+		for(uint32_t i = 0; i < destinationSize; i++)
+		{
+			const float center = (i + 0.5f) * scale;
+			const int32_t first = static_cast<int32_t>(std::floor(center - radius));
+			float* weights = &taps.m_weights[size_t(i) * taps.m_tapCount];
+			float sum = 0.0f;
+			for(uint32_t k = 0; k < taps.m_tapCount; k++)
+			{
+				const float pixelStart = static_cast<float>(first + static_cast<int32_t>(k));
+				if(filter == MIP_FILTER_BOX)
+					weights[k] = std::max(0.0f, std::min(pixelStart + 1.0f, center + radius) - std::max(pixelStart, center - radius));
+				else
+					weights[k] = Kaiser((pixelStart + 0.5f - center) / scale);
+				sum += weights[k];
+			}
+			for(uint32_t k = 0; k < taps.m_tapCount; k++)
+				weights[k] /= sum;
+			taps.m_first[i] = first;
+		}
+		return taps;
+	}
+
+	inline uint32_t ClampIndex(int32_t index, uint32_t size)
+	{
+		return static_cast<uint32_t>(std::min(std::max(index, 0), static_cast<int32_t>(size) - 1));
+	}
+
+	// one source row to linear floats, then filtered down to the destination width
+	inline void FilterRow(const uint8_t* source, uint32_t width, uint32_t channels, MipContent content, const FilterTaps& taps,
+						  std::vector<float>& linear, float* destination)
+	{
+		const ColorTables& tables = GetColorTables();
+		const size_t valueCount = size_t(width) * channels;
+		for(size_t i = 0; i < valueCount; i++)
+		{
+			const bool isColor = content == MIP_CONTENT_SRGB_COLOR && channels == 4 && i % 4 != 3;
+			linear[i] = isColor ? tables.m_srgbToLinear[source[i]] : source[i] / 255.0f;
+		}
+
+		const uint32_t destinationWidth = static_cast<uint32_t>(taps.m_first.size());
+		for(uint32_t x = 0; x < destinationWidth; x++)
+		{
+			const float* weights = &taps.m_weights[size_t(x) * taps.m_tapCount];
+#ifdef MIP_GENERATOR_SSE2
+			if(channels == 4)
+			{
+				__m128 sum = _mm_setzero_ps();
+				for(uint32_t k = 0; k < taps.m_tapCount; k++)
+				{
+					const uint32_t sourceX = ClampIndex(taps.m_first[x] + static_cast<int32_t>(k), width);
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(&linear[size_t(sourceX) * 4])));
+				}
+				_mm_storeu_ps(destination + size_t(x) * 4, sum);
+				continue;
+			}
+#endif
+			for(uint32_t c = 0; c < channels; c++)
+			{
+				float sum = 0.0f;
+				for(uint32_t k = 0; k < taps.m_tapCount; k++)
+				{
+					const uint32_t sourceX = ClampIndex(taps.m_first[x] + static_cast<int32_t>(k), width);
+					sum += weights[k] * linear[size_t(sourceX) * channels + c];
+				}
+				destination[size_t(x) * channels + c] = sum;
+			}
+		}
+	}
+
+	inline void EncodeRow(const float* source, uint32_t width, uint32_t channels, MipContent content, uint8_t* destination)
+	{
+		const ColorTables& tables = GetColorTables();
+		for(uint32_t x = 0; x < width; x++)
+		{
+			const float* pixel = source + size_t(x) * channels;
+			uint8_t* out = destination + size_t(x) * channels;
+			if(content == MIP_CONTENT_NORMAL && channels >= 3)
+			{
+				float normal[3] = {pixel[0] * 2.0f - 1.0f, pixel[1] * 2.0f - 1.0f, pixel[2] * 2.0f - 1.0f};
+				const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				for(uint32_t c = 0; c < 3; c++)
+					out[c] = ToUnorm8(length > 1e-6f ? normal[c] / length * 0.5f + 0.5f : pixel[c]);
+				for(uint32_t c = 3; c < channels; c++)
+					out[c] = ToUnorm8(pixel[c]);
+				continue;
+			}
+			for(uint32_t c = 0; c < channels; c++)
+			{
+				const bool isColor = content == MIP_CONTENT_SRGB_COLOR && channels == 4 && c != 3;
+				out[c] = isColor ? LinearToSrgb8(tables, pixel[c]) : ToUnorm8(pixel[c]);
+			}
+		}
+	}
+}
+
+inline uint32_t GetNextMipSize(uint32_t size)
+{
+	return std::max(size / 2, 1u);
+}
+
+// source is width * height * channels bytes, destination gets the next level down
+inline void GenerateMipLevel(const uint8_t* source, uint32_t width, uint32_t height, uint32_t channels, MipContent content, MipFilter filter,
+							 uint8_t* destination)
+{
+	PROFILE_ZONE("Generate Mip Level");
+	using namespace MipGeneration;
+	const uint32_t nextWidth = GetNextMipSize(width);
+	const uint32_t nextHeight = GetNextMipSize(height);
+	const FilterTaps horizontal = BuildTaps(width, nextWidth, filter);
+	const FilterTaps vertical = BuildTaps(height, nextHeight, filter);
+	const size_t rowSize = size_t(nextWidth) * channels;
+
+	GetThreadPool().ParallelFor(nextHeight, [&](uint32_t firstRow, uint32_t endRow) {
+		// horizontally filtered source rows, the slot of a row is its index modulo the tap count.
+		// The rows under one destination row are consecutive, so they never share a slot
+		const uint32_t slotCount = vertical.m_tapCount;
+		std::vector<float> slots(slotCount * rowSize);
+		std::vector<int64_t> slotRows(slotCount, -1);
+		std::vector<float> linear(size_t(width) * channels);
+		std::vector<float> row(rowSize);
+		for(uint32_t y = firstRow; y < endRow; y++)
+		{
+			std::fill(row.begin(), row.end(), 0.0f);
+			const float* weights = &vertical.m_weights[size_t(y) * vertical.m_tapCount];
+			for(uint32_t k = 0; k < vertical.m_tapCount; k++)
+			{
+				const uint32_t sourceY = ClampIndex(vertical.m_first[y] + static_cast<int32_t>(k), height);
+				float* slot = &slots[(sourceY % slotCount) * rowSize];
+				if(slotRows[sourceY % slotCount] != sourceY)
+				{
+					FilterRow(source + size_t(sourceY) * width * channels, width, channels, content, horizontal, linear, slot);
+					slotRows[sourceY % slotCount] = sourceY;
+				}
+
+				size_t i = 0;
+#ifdef MIP_GENERATOR_SSE2
+				const __m128 weight = _mm_set1_ps(weights[k]);
+				for(; i + 4 <= rowSize; i += 4)
+					_mm_storeu_ps(&row[i], _mm_add_ps(_mm_loadu_ps(&row[i]), _mm_mul_ps(weight, _mm_loadu_ps(slot + i))));
+#endif
+				for(; i < rowSize; i++)
+					row[i] += weights[k] * slot[i];
+			}
+			EncodeRow(row.data(), nextWidth, channels, content, destination + size_t(y) * rowSize);
+		}
+	});
+}
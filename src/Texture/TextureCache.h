@@ -0,0 +1,613 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Profiling/MemoryStats.h"
+#include "../Render/PixelBufferPool.h"
+#include "../Render/UploadQueue.h"
+#include "../Tools/Hash.h"
+#include "../Tools/Path.h"
+#include "../Tools/ThreadPool.h"
+#include "TextureContainer.h"
+#include "TextureCook.h"
+#include "TextureLoader.h"
+#include "TextureStreaming.h"
+
+class TextureCache;
+
+/*
+* Reference to a texture owned by the TextureCache. The texture stays alive while any handle to it
+* exists. GetId() is 0 until the texture is uploaded, so a handle can be stored (and drawn with)
+* before loading finishes.
+*/
+class TextureHandle
+{
+public:
+	TextureHandle() = default;
+	TextureHandle(const TextureHandle& other);
+	TextureHandle(TextureHandle&& other) noexcept;
+	TextureHandle& operator=(TextureHandle other) noexcept;
+	~TextureHandle();
+
+	bool IsValid() const { return m_entry != nullptr; }
+	unsigned int GetId() const;
+	const std::string& GetPath() const;
+
+private:
+	friend class TextureCache;
+	struct Entry;
+	explicit TextureHandle(Entry* entry) : m_entry(entry) {}
+
+	Entry* m_entry = nullptr;
+};
+
+/*
+* Process wide registry of loaded textures, so each image is decoded and uploaded once no matter
+* how many models use it.
+* Entries are found by normalized path. Before decoding, the file's content hash is checked too:
+* a different path with identical bytes aliases the texture already loaded instead of decoding again.
+* Textures nobody holds a handle to are deleted by Update after EVICT_AFTER_FRAMES frames, which
+* keeps a model that is unloaded and loaded again right after from re-decoding everything.
+* KTX2 and DDS files are uploaded as they are. Other images are cooked (TextureCook) to their
+* full mip chain, block compressed unless disabled, the first time and the cooked file is loaded
+* after that.
+* Textures read from a container (cooked or authored) start with only their small levels. Draw
+* code reports how big each texture is on screen (RequestResidency) and Update streams in the finer
+* levels by that priority, evicting the least recently used ones when the budget is full. See
+* TextureResidency. Streamed levels are read straight into PixelBufferPool staging buffers, so
+* uploading them never stalls on a copy from client memory.
+*/
+class TextureCache
+{
+public:
+	static constexpr uint32_t EVICT_AFTER_FRAMES = 60;
+
+	~TextureCache();
+
+	// any thread. mustLoad is set when the caller is the first to ask for this path and has to
+	// run Decode and Upload, everyone else just keeps the handle. The usage of the first caller wins
+	TextureHandle Acquire(const std::string& path, TextureUsage usage, bool& mustLoad);
+
+	// any thread. Returns the pixels to Upload, or an invalid image when the file's content is
+	// already loaded under another path (or the file can't be decoded)
+	DecodedImage Decode(const TextureHandle& handle);
+	// the same for an image that isn't a file of its own, e.g. embedded in a model. The handle's
+	// path only names it, for the cache and the cooked file
+	DecodedImage Decode(const TextureHandle& handle, const uint8_t* data, size_t size);
+
+	// GL thread only
+	void Upload(const TextureHandle& handle, const DecodedImage& image);
+	// GL thread only, Acquire and a blocking Decode and Upload when the texture isn't cached yet
+	TextureHandle Load(const std::string& path, TextureUsage usage);
+	// GL thread only, once per frame. Streams texture levels and deletes textures unused for more
+	// than evictAfterFrames updates. 0 only evicts, e.g. at shutdown, it starts no level loads
+	void Update(uint32_t evictAfterFrames = EVICT_AFTER_FRAMES);
+
+	// GL thread only, while drawing. screenSize is the texture's projected size in pixels
+	void RequestResidency(const TextureHandle& handle, float screenSize);
+	// GL thread only. 0 streams in every level of every texture and never evicts
+	void SetStreamingBudget(size_t bytes) { m_streamingBudget = bytes; }
+	// GL thread only, bytes of all uploaded levels
+	size_t GetResidentBytes() const { return m_residentBytes; }
+
+	size_t GetTextureCount() const;
+
+	// set before loading, textures already loaded keep what they were cooked with
+	void SetCookSettings(const TextureCookSettings& settings);
+	TextureCookSettings GetCookSettings() const;
+
+private:
+	friend class TextureHandle;
+	using Entry = TextureHandle::Entry;
+
+	static void AddRef(Entry* entry);
+	static void Release(Entry* entry);
+	bool LinkToContent(Entry* entry, uint64_t contentHash);
+
+	void UpdateStreaming();
+	Entry* FindStreamingVictim(const Entry* requester) const;
+	void EvictLevel(Entry* entry);
+	bool StartLevelLoad(Entry* entry);
+	void FinishLevelLoad(Entry* entry, uint32_t level, PixelBuffer* staging, const std::vector<uint8_t>& data, bool isRead);
+	void ForgetStreamed(Entry* entry);
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<std::string, std::unique_ptr<Entry>> m_byPath;
+	std::unordered_map<uint64_t, Entry*> m_byContent;
+	TextureCookSettings m_cookSettings;
+
+	// streaming, GL thread only
+	size_t m_streamingBudget = 0;
+	size_t m_residentBytes = 0;
+	// levels being read, already counted against the budget
+	size_t m_loadingBytes = 0;
+	uint32_t m_loadingCount = 0;
+	uint64_t m_frame = 0;
+	std::vector<Entry*> m_streamed;
+};
+
+struct TextureHandle::Entry
+{
+	std::string m_path;
+	TextureUsage m_usage = TEXTURE_USAGE_COLOR;
+	std::atomic<uint32_t> m_refCount{0};
+	std::atomic<unsigned int> m_id{0};
+	uint64_t m_contentHash = 0;
+	bool m_hasContentHash = false;
+	// set when another entry has the same content, this entry then only keeps a reference to it
+	std::atomic<Entry*> m_alias{nullptr};
+	// Update calls since the last handle went away
+	uint32_t m_unusedFrames = 0;
+	// GL thread only. Bytes uploaded, and the streaming state when only some levels are
+	size_t m_residentBytes = 0;
+	std::unique_ptr<TextureResidency> m_residency;
+};
+
+inline TextureCache& GetTextureCache()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+//----------TextureHandle
+inline TextureHandle::TextureHandle(const TextureHandle& other)
+	: m_entry(other.m_entry)
+{
+	if(m_entry)
+		TextureCache::AddRef(m_entry);
+}
+
+inline TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+	: m_entry(other.m_entry)
+{
+	other.m_entry = nullptr;
+}
+
+inline TextureHandle& TextureHandle::operator=(TextureHandle other) noexcept
+{
+	std::swap(m_entry, other.m_entry);
+	return *this;
+}
+
+inline TextureHandle::~TextureHandle()
+{
+	if(m_entry)
+		TextureCache::Release(m_entry);
+}
+
+inline unsigned int TextureHandle::GetId() const
+{
+	if(!m_entry)
+		return 0;
+	const Entry* alias = m_entry->m_alias.load(std::memory_order_acquire);
+	const Entry* entry = alias ? alias : m_entry;
+	return entry->m_id.load(std::memory_order_acquire);
+}
+
+inline const std::string& TextureHandle::GetPath() const
+{
+	static const std::string EMPTY;
+	return m_entry ? m_entry->m_path : EMPTY;
+}
+//==========TextureHandle
+
+//----------TextureCache
+inline TextureCache::~TextureCache()
+{
+	// the GL context is gone by the time statics are destroyed, the driver frees the textures with it
+	m_byContent.clear();
+	m_byPath.clear();
+}
+
+inline void TextureCache::AddRef(Entry* entry)
+{
+	entry->m_refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void TextureCache::Release(Entry* entry)
+{
+	entry->m_refCount.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+inline TextureHandle TextureCache::Acquire(const std::string& path, TextureUsage usage, bool& mustLoad)
+{
+	const std::string key = NormalizePath(path);
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::unique_ptr<Entry>& slot = m_byPath[key];
+	mustLoad = slot == nullptr;
+	if(mustLoad)
+	{
+		slot.reset(new Entry());
+		slot->m_path = key;
+		slot->m_usage = usage;
+	}
+	slot->m_unusedFrames = 0;
+	AddRef(slot.get());
+	return TextureHandle(slot.get());
+}
+
+inline bool TextureCache::LinkToContent(Entry* entry, uint64_t contentHash)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	entry->m_contentHash = contentHash;
+	entry->m_hasContentHash = true;
+
+	auto it = m_byContent.find(contentHash);
+	if(it != m_byContent.end() && it->second != entry)
+	{
+		AddRef(it->second);
+		entry->m_alias.store(it->second, std::memory_order_release);
+		return true;
+	}
+	m_byContent[contentHash] = entry;
+	return false;
+}
+
+inline DecodedImage TextureCache::Decode(const TextureHandle& handle)
+{
+	DecodedImage image;
+	if(!handle.IsValid())
+		return image;
+
+	AssetFile file;
+	if(!file.Open(handle.GetPath().c_str()))
+	{
+		std::cout << "ERROR::TEXTURE_CACHE::OPEN_FAILED " << handle.GetPath() << std::endl;
+		return image;
+	}
+	return Decode(handle, file.GetData(), file.GetSize());
+}
+
+inline DecodedImage TextureCache::Decode(const TextureHandle& handle, const uint8_t* data, size_t size)
+{
+	DecodedImage image;
+	if(!handle.IsValid())
+		return image;
+
+	uint64_t contentHash;
+	{
+		PROFILE_ZONE("Texture Hash");
+		contentHash = HashBytes(data, size);
+	}
+	if(LinkToContent(handle.m_entry, contentHash))
+		return image;
+
+	const std::string& path = handle.GetPath();
+	if(IsTextureContainer(data, size))
+	{
+		if(ReadTextureContainer(data, size, path, image) && !IsTextureFormatSupported(image.m_format))
+		{
+			std::cout << "ERROR::TEXTURE_CACHE::UNSUPPORTED_FORMAT " << GetTextureFormatName(image.m_format) << " " << path << std::endl;
+			image = DecodedImage();
+		}
+		return image;
+	}
+
+	const TextureCookSettings settings = GetCookSettings();
+	const TextureUsage usage = handle.m_entry->m_usage;
+	const std::string cookedPath = TextureCook::GetCookedPath(path);
+	const uint64_t cookKey = TextureCook::GetCookKey(contentHash, usage, settings);
+	if(TextureCook::Load(cookedPath, cookKey, image))
+		return image;
+
+	if(!DecodeImageFromMemory(data, size, path, image))
+		return image;
+
+	// cooked once here, later runs load the result. If cooking fails the driver generates the mips
+	const TextureFormat format = TextureCook::ChooseFormat(image, usage, settings);
+	DecodedImage cooked;
+	if(!TextureCook::Cook(image, usage, format, settings.m_mipFilter, cooked))
+		return image;
+	// read back from the file it was written to, so its levels can be streamed like on later runs
+	DecodedImage written;
+	if(TextureCook::Write(cookedPath, cookKey, cooked) && TextureCook::Load(cookedPath, cookKey, written))
+		return written;
+	return cooked;
+}
+
+inline void TextureCache::Upload(const TextureHandle& handle, const DecodedImage& image)
+{
+	if(!handle.IsValid() || handle.m_entry->m_alias.load(std::memory_order_acquire) || !image.IsValid())
+		return;
+
+	Entry* entry = handle.m_entry;
+	const uint32_t firstLevel = !image.m_levelFile.empty() ? GetStreamingTailLevel(image.m_levels) : 0;
+	entry->m_id.store(UploadTexture(image, firstLevel), std::memory_order_release);
+	if(image.m_pixels)
+	{
+		// plus a third for the generated mips
+		entry->m_residentBytes = GetLevelSize(image.m_format, image.m_width, image.m_height) * 4 / 3;
+	}
+	for(uint32_t level = firstLevel; level < image.m_levels.size(); level++)
+		entry->m_residentBytes += image.m_levels[level].m_size;
+	m_residentBytes += entry->m_residentBytes;
+	GetMemoryStats().Allocate(MEMORY_GPU_TEXTURE, entry->m_residentBytes);
+	if(firstLevel == 0)
+		return;
+
+	entry->m_residency.reset(new TextureResidency());
+	TextureResidency& residency = *entry->m_residency;
+	residency.m_levelFile = image.m_levelFile;
+	residency.m_format = image.m_format;
+	residency.m_levels = image.m_levels;
+	residency.m_residentLevel = firstLevel;
+	residency.m_tailLevel = firstLevel;
+	residency.m_desiredLevel = firstLevel;
+	m_streamed.push_back(entry);
+}
+
+inline TextureHandle TextureCache::Load(const std::string& path, TextureUsage usage)
+{
+	bool mustLoad = false;
+	TextureHandle handle = Acquire(path, usage, mustLoad);
+	if(mustLoad)
+		Upload(handle, Decode(handle));
+	return handle;
+}
+
+inline void TextureCache::SetCookSettings(const TextureCookSettings& settings)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cookSettings = settings;
+}
+
+inline TextureCookSettings TextureCache::GetCookSettings() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_cookSettings;
+}
+
+inline void TextureCache::RequestResidency(const TextureHandle& handle, float screenSize)
+{
+	if(!handle.IsValid())
+		return;
+	Entry* alias = handle.m_entry->m_alias.load(std::memory_order_acquire);
+	Entry* entry = alias ? alias : handle.m_entry;
+	if(!entry->m_residency)
+		return;
+
+	TextureResidency& residency = *entry->m_residency;
+	if(residency.m_lastUsedFrame != m_frame)
+	{
+		residency.m_lastUsedFrame = m_frame;
+		residency.m_screenSize = 0.0f;
+	}
+	residency.m_screenSize = std::max(residency.m_screenSize, screenSize);
+}
+
+inline void TextureCache::UpdateStreaming()
+{
+	if(m_streamed.empty())
+		return;
+
+	PROFILE_ZONE("Texture Streaming");
+	// only textures drawn last frame ask for levels, the others keep theirs until they are the least
+	// recently used. Without a budget every texture wants all its levels
+	const bool isUnlimited = m_streamingBudget == 0;
+	std::vector<Entry*> requests;
+	for(Entry* entry : m_streamed)
+	{
+		// nobody holds it anymore, it is only waiting to be evicted
+		if(entry->m_refCount.load(std::memory_order_acquire) == 0)
+			continue;
+		TextureResidency& residency = *entry->m_residency;
+		if(isUnlimited)
+			residency.m_desiredLevel = 0;
+		else if(residency.m_lastUsedFrame == m_frame)
+			residency.m_desiredLevel = GetDesiredLevel(residency, residency.m_screenSize);
+		else
+			continue;
+		if(!residency.m_isLoading && !residency.m_hasFailed && residency.m_desiredLevel < residency.m_residentLevel)
+			requests.push_back(entry);
+	}
+	// the biggest on screen first, weighted by how many levels it is missing
+	auto getPriority = [](const Entry* entry) {
+		const TextureResidency& residency = *entry->m_residency;
+		return residency.m_screenSize * (residency.m_residentLevel - residency.m_desiredLevel);
+	};
+	std::sort(requests.begin(), requests.end(), [&](const Entry* a, const Entry* b) { return getPriority(a) > getPriority(b); });
+
+	for(Entry* entry : requests)
+	{
+		if(m_loadingCount >= MAX_STREAMING_LOADS)
+			break;
+		const TextureResidency& residency = *entry->m_residency;
+		const size_t cost = residency.m_levels[residency.m_residentLevel - 1].m_size;
+		while(!isUnlimited && m_residentBytes + m_loadingBytes + cost > m_streamingBudget)
+		{
+			Entry* victim = FindStreamingVictim(entry);
+			if(!victim)
+				break;
+			EvictLevel(victim);
+		}
+		// everything left is needed as much as this, the requests after it need it even less
+		if(!isUnlimited && m_residentBytes + m_loadingBytes + cost > m_streamingBudget)
+			break;
+		// no staging buffer free, the ones in flight come back once their uploads are done
+		if(!StartLevelLoad(entry))
+			break;
+	}
+}
+
+// least recently drawn first, a texture drawn last frame only gives back levels finer than it needs
+inline TextureCache::Entry* TextureCache::FindStreamingVictim(const Entry* requester) const
+{
+	Entry* victim = nullptr;
+	for(Entry* entry : m_streamed)
+	{
+		const TextureResidency& residency = *entry->m_residency;
+		if(entry == requester || residency.m_isLoading || residency.m_residentLevel >= residency.m_tailLevel)
+			continue;
+		const bool isInUse = residency.m_lastUsedFrame == m_frame;
+		if(isInUse && residency.m_residentLevel >= residency.m_desiredLevel)
+			continue;
+		if(!victim || residency.m_lastUsedFrame < victim->m_residency->m_lastUsedFrame)
+			victim = entry;
+	}
+	return victim;
+}
+
+inline void TextureCache::EvictLevel(Entry* entry)
+{
+	TextureResidency& residency = *entry->m_residency;
+	const uint32_t level = residency.m_residentLevel;
+	glBindTexture(GL_TEXTURE_2D, entry->m_id.load(std::memory_order_relaxed));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level + 1));
+	ReleaseTextureLevel(residency.m_format, level);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	residency.m_residentLevel++;
+	entry->m_residentBytes -= residency.m_levels[level].m_size;
+	m_residentBytes -= residency.m_levels[level].m_size;
+	GetMemoryStats().Free(MEMORY_GPU_TEXTURE, residency.m_levels[level].m_size);
+}
+
+inline bool TextureCache::StartLevelLoad(Entry* entry)
+{
+	TextureResidency& residency = *entry->m_residency;
+	const uint32_t level = residency.m_residentLevel - 1;
+	const TextureLevel info = residency.m_levels[level];
+	// read straight into a staging buffer, only levels too big for the pool go through client memory
+	PixelBuffer* staging = GetPixelBufferPool().Acquire(info.m_size);
+	if(!staging && info.m_size <= PIXEL_BUFFER_POOL_SIZE)
+		return false;
+
+	residency.m_isLoading = true;
+	m_loadingCount++;
+	m_loadingBytes += info.m_size;
+
+	// the handle keeps the entry alive until the level is uploaded
+	AddRef(entry);
+	TextureHandle handle(entry);
+	const std::string path = residency.m_levelFile;
+	GetThreadPool().Enqueue([this, handle, path, info, level, staging]() {
+		std::vector<uint8_t> data;
+		bool isRead;
+		if(staging)
+		{
+			isRead = ReadTextureLevel(path, info, staging->m_data);
+		}
+		else
+		{
+			data = ReadTextureLevel(path, info);
+			isRead = !data.empty();
+		}
+		GetUploadQueue().Enqueue([this, handle, level, staging, isRead, data = std::move(data)]() {
+			FinishLevelLoad(handle.m_entry, level, staging, data, isRead);
+		});
+	});
+	return true;
+}
+
+inline void TextureCache::FinishLevelLoad(Entry* entry, uint32_t level, PixelBuffer* staging, const std::vector<uint8_t>& data, bool isRead)
+{
+	TextureResidency& residency = *entry->m_residency;
+	const TextureLevel& info = residency.m_levels[level];
+	residency.m_isLoading = false;
+	m_loadingCount--;
+	m_loadingBytes -= info.m_size;
+	if(!isRead)
+	{
+		if(staging)
+			GetPixelBufferPool().Cancel(staging);
+		residency.m_hasFailed = true;
+		return;
+	}
+
+	PROFILE_ZONE("Texture Level Upload");
+	glBindTexture(GL_TEXTURE_2D, entry->m_id.load(std::memory_order_relaxed));
+	if(staging)
+	{
+		// the data pointer is an offset into the bound buffer, the copy runs after this returns
+		GetPixelBufferPool().BeginUpload(staging);
+		UploadTextureLevel(residency.m_format, level, info, nullptr);
+		GetPixelBufferPool().EndUpload(staging);
+	}
+	else
+	{
+		UploadTextureLevel(residency.m_format, level, info, data.data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	residency.m_residentLevel = level;
+	entry->m_residentBytes += info.m_size;
+	m_residentBytes += info.m_size;
+	GetMemoryStats().Allocate(MEMORY_GPU_TEXTURE, info.m_size);
+}
+
+inline void TextureCache::ForgetStreamed(Entry* entry)
+{
+	m_residentBytes -= entry->m_residentBytes;
+	GetMemoryStats().Free(MEMORY_GPU_TEXTURE, entry->m_residentBytes);
+	if(entry->m_residency)
+		m_streamed.erase(std::find(m_streamed.begin(), m_streamed.end(), entry));
+}
+
+inline void TextureCache::Update(uint32_t evictAfterFrames)
+{
+	if(evictAfterFrames != 0)
+		UpdateStreaming();
+	m_frame++;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	bool hasEvicted;
+	do
+	{
+		hasEvicted = false;
+		for(auto it = m_byPath.begin(); it != m_byPath.end();)
+		{
+			Entry* entry = it->second.get();
+			if(entry->m_refCount.load(std::memory_order_acquire) != 0)
+			{
+				entry->m_unusedFrames = 0;
+				++it;
+				continue;
+			}
+			if(entry->m_unusedFrames++ < evictAfterFrames)
+			{
+				++it;
+				continue;
+			}
+
+			Entry* alias = entry->m_alias.load(std::memory_order_acquire);
+			if(alias)
+			{
+				Release(alias);
+			}
+			else
+			{
+				const unsigned int id = entry->m_id.load(std::memory_order_relaxed);
+				if(id != 0)
+					glDeleteTextures(1, &id);
+				ForgetStreamed(entry);
+			}
+			if(entry->m_hasContentHash)
+			{
+				auto content = m_byContent.find(entry->m_contentHash);
+				if(content != m_byContent.end() && content->second == entry)
+					m_byContent.erase(content);
+			}
+			it = m_byPath.erase(it);
+			hasEvicted = true;
+		}
+		// evicting an alias can leave its target unused, without a delay that target goes in the same call
+	} while(hasEvicted && evictAfterFrames == 0);
+}
+
+inline size_t TextureCache::GetTextureCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_byPath.size();
+}
+//==========TextureCache
@@ -0,0 +1,475 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+#include "TextureFormat.h"
+#include "TextureLoader.h"
+
+/*
+* KTX2 and DDS files holding a 2D texture with its mip chain, in one of the TextureFormats.
+* Only plain 2D textures are read: no arrays, cube maps, 3D textures or KTX2 supercompression
+* (Basis, zstd). The rows are uploaded in the order they are stored.
+* KTX2 is also what cooked textures are written as, with the cook key in the key/value data.
+*/
+
+//----------KTX2
+constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header
+{
+	uint8_t m_identifier[12];
+	uint32_t m_vkFormat;
+	uint32_t m_typeSize;
+	uint32_t m_pixelWidth;
+	uint32_t m_pixelHeight;
+	uint32_t m_pixelDepth;
+	uint32_t m_layerCount;
+	uint32_t m_faceCount;
+	uint32_t m_levelCount;
+	uint32_t m_supercompressionScheme;
+	uint32_t m_dfdByteOffset;
+	uint32_t m_dfdByteLength;
+	uint32_t m_kvdByteOffset;
+	uint32_t m_kvdByteLength;
+	uint64_t m_sgdByteOffset;
+	uint64_t m_sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+// follows the header, one per level with level 0 first
+struct Ktx2LevelIndex
+{
+	uint64_t m_byteOffset;
+	uint64_t m_byteLength;
+	uint64_t m_uncompressedByteLength;
+};
+
+// what the data format descriptor says about each format, see the Khronos Data Format spec
+struct Ktx2FormatInfo
+{
+	TextureFormat m_format;
+	uint32_t m_vkFormat;
+	uint32_t m_colorModel;
+	uint32_t m_sampleCount;
+	// channel id, bit offset and bit length of each sample
+	uint32_t m_samples[4][3];
+};
+
+constexpr Ktx2FormatInfo KTX2_FORMATS[] = {
+	{TEXTURE_FORMAT_R8, 9, 1, 1, {{0, 0, 8}}},
+	{TEXTURE_FORMAT_RGBA8, 37, 1, 4, {{0, 0, 8}, {1, 8, 8}, {2, 16, 8}, {15, 24, 8}}},
+	{TEXTURE_FORMAT_BC1, 131, 128, 1, {{0, 0, 64}}},
+	{TEXTURE_FORMAT_BC3, 137, 130, 2, {{15, 0, 64}, {0, 64, 64}}},
+	{TEXTURE_FORMAT_BC4, 139, 131, 1, {{0, 0, 64}}},
+	{TEXTURE_FORMAT_BC5, 141, 132, 2, {{0, 0, 64}, {1, 64, 64}}},
+	{TEXTURE_FORMAT_BC7, 145, 134, 1, {{0, 0, 128}}},
+};
+
+inline TextureFormat GetFormatFromVkFormat(uint32_t vkFormat)
+{
+	// the sRGB variants are sampled like every other texture here, without conversion
+	switch(vkFormat)
+	{
+		case 9: return TEXTURE_FORMAT_R8;
+		case 37:
+		case 43: return TEXTURE_FORMAT_RGBA8;
+		case 131:
+		case 132: return TEXTURE_FORMAT_BC1;
+		case 137:
+		case 138: return TEXTURE_FORMAT_BC3;
+		case 139: return TEXTURE_FORMAT_BC4;
+		case 141: return TEXTURE_FORMAT_BC5;
+		case 145:
+		case 146: return TEXTURE_FORMAT_BC7;
+		default: return TEXTURE_FORMAT_UNKNOWN;
+	}
+}
+
+inline bool IsKtx2(const uint8_t* data, size_t size)
+{
+	return size >= sizeof(Ktx2Header) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+// path is where data was read from, kept so single levels can be read again for streaming
+inline bool ReadKtx2(const uint8_t* data, size_t size, const std::string& path, DecodedImage& image)
+{
+	PROFILE_ZONE("KTX2 Read");
+	if(!IsKtx2(data, size))
+		return false;
+
+	Ktx2Header header;
+	std::memcpy(&header, data, sizeof(header));
+	const TextureFormat format = GetFormatFromVkFormat(header.m_vkFormat);
+	if(format == TEXTURE_FORMAT_UNKNOWN || header.m_supercompressionScheme != 0 || header.m_pixelDepth != 0 || header.m_layerCount > 1
+	   || header.m_faceCount != 1 || header.m_pixelWidth == 0 || header.m_pixelHeight == 0)
+	{
+		std::cout << "ERROR::KTX2::UNSUPPORTED " << path << " vkFormat " << header.m_vkFormat << std::endl;
+		return false;
+	}
+
+	// 0 levels asks the loader to generate the mips, there is one stored level then
+	const uint32_t levelCount = header.m_levelCount > 0 ? header.m_levelCount : 1;
+	if(levelCount > 32 || sizeof(Ktx2Header) + uint64_t(levelCount) * sizeof(Ktx2LevelIndex) > size)
+	{
+		std::cout << "ERROR::KTX2::MALFORMED " << path << std::endl;
+		return false;
+	}
+
+	image.m_width = static_cast<int>(header.m_pixelWidth);
+	image.m_height = static_cast<int>(header.m_pixelHeight);
+	image.m_channels = format == TEXTURE_FORMAT_R8 || format == TEXTURE_FORMAT_BC4 ? 1 : 4;
+	image.m_format = format;
+	image.m_levelFile = path;
+	image.m_levels.resize(levelCount);
+	for(uint32_t level = 0; level < levelCount; level++)
+	{
+		Ktx2LevelIndex index;
+		std::memcpy(&index, data + sizeof(Ktx2Header) + level * sizeof(Ktx2LevelIndex), sizeof(index));
+		TextureLevel& info = image.m_levels[level];
+		info.m_width = std::max(header.m_pixelWidth >> level, 1u);
+		info.m_height = std::max(header.m_pixelHeight >> level, 1u);
+		info.m_size = GetLevelSize(format, info.m_width, info.m_height);
+		if(index.m_byteLength != info.m_size || index.m_byteOffset > size || index.m_byteLength > size - index.m_byteOffset)
+		{
+			std::cout << "ERROR::KTX2::MALFORMED " << path << " level " << level << std::endl;
+			image = DecodedImage();
+			return false;
+		}
+		info.m_offset = image.m_levelData.size();
+		info.m_fileOffset = index.m_byteOffset;
+		image.m_levelData.insert(image.m_levelData.end(), data + index.m_byteOffset, data + index.m_byteOffset + index.m_byteLength);
+	}
+	return true;
+}
+
+// value of a key in the key/value data, false when the key isn't there
+inline bool FindKtx2Value(const uint8_t* data, size_t size, const char* key, std::string& value)
+{
+	if(!IsKtx2(data, size))
+		return false;
+	Ktx2Header header;
+	std::memcpy(&header, data, sizeof(header));
+	if(uint64_t(header.m_kvdByteOffset) + header.m_kvdByteLength > size)
+		return false;
+
+	const size_t keyLength = std::strlen(key);
+	const uint8_t* entry = data + header.m_kvdByteOffset;
+	const uint8_t* const end = entry + header.m_kvdByteLength;
+	while(end - entry >= 4)
+	{
+		uint32_t length;
+		std::memcpy(&length, entry, sizeof(length));
+		entry += sizeof(length);
+		if(length > static_cast<size_t>(end - entry))
+			return false;
+		// the key is null terminated, the value is whatever follows it
+		if(length > keyLength && std::memcmp(entry, key, keyLength + 1) == 0)
+		{
+			value.assign(reinterpret_cast<const char*>(entry) + keyLength + 1, length - keyLength - 1);
+			return true;
+		}
+		entry += (length + 3) & ~3u;
+	}
+	return false;
+}
+
+// keyValues must be sorted by key. Written under a temporary name and renamed, like the mesh cache
+inline bool WriteKtx2(const std::string& path, const DecodedImage& image, const std::vector<std::pair<std::string, std::string>>& keyValues)
+{
+	PROFILE_ZONE("KTX2 Write");
+	const Ktx2FormatInfo* info = nullptr;
+	for(const Ktx2FormatInfo& candidate : KTX2_FORMATS)
+	{
+		if(candidate.m_format == image.m_format)
+			info = &candidate;
+	}
+	if(!info || image.m_levels.empty())
+		return false;
+
+	// data format descriptor: total size, then one basic descriptor block
+	std::vector<uint32_t> dfd;
+	const bool isCompressed = IsBlockCompressed(image.m_format);
+	const uint32_t blockDimension = isCompressed ? 3 : 0;
+	dfd.push_back(0);
+	dfd.push_back(0);
+	dfd.push_back(2 | (24 + 16 * info->m_sampleCount) << 16);
+	// colour model, BT.709 primaries, linear transfer, straight alpha
+	dfd.push_back(info->m_colorModel | 1 << 8 | 1 << 16);
+	dfd.push_back(blockDimension | blockDimension << 8);
+	dfd.push_back(GetFormatBlockSize(image.m_format));
+	dfd.push_back(0);
+	for(uint32_t i = 0; i < info->m_sampleCount; i++)
+	{
+		const uint32_t* sample = info->m_samples[i];
+		dfd.push_back(sample[1] | (sample[2] - 1) << 16 | sample[0] << 24);
+		dfd.push_back(0);
+		dfd.push_back(0);
+		dfd.push_back(isCompressed ? 0xFFFFFFFFu : (1u << sample[2]) - 1);
+	}
+	dfd[0] = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+	std::string kvd;
+	for(const std::pair<std::string, std::string>& keyValue : keyValues)
+	{
+		const uint32_t length = static_cast<uint32_t>(keyValue.first.size() + 1 + keyValue.second.size());
+		kvd.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		kvd.append(keyValue.first.c_str(), keyValue.first.size() + 1);
+		kvd.append(keyValue.second);
+		kvd.resize((kvd.size() + 3) & ~size_t(3), '\0');
+	}
+
+	const uint32_t levelCount = static_cast<uint32_t>(image.m_levels.size());
+	Ktx2Header header = {};
+	std::memcpy(header.m_identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.m_vkFormat = info->m_vkFormat;
+	header.m_typeSize = 1;
+	header.m_pixelWidth = static_cast<uint32_t>(image.m_width);
+	header.m_pixelHeight = static_cast<uint32_t>(image.m_height);
+	header.m_faceCount = 1;
+	header.m_levelCount = levelCount;
+	header.m_dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex));
+	header.m_dfdByteLength = dfd[0];
+	header.m_kvdByteOffset = kvd.empty() ? 0 : header.m_dfdByteOffset + header.m_dfdByteLength;
+	header.m_kvdByteLength = static_cast<uint32_t>(kvd.size());
+
+	// levels are stored smallest first, each aligned to the block size
+	const uint64_t alignment = std::max(GetFormatBlockSize(image.m_format), 4u);
+	std::vector<Ktx2LevelIndex> levelIndex(levelCount);
+	uint64_t offset = header.m_dfdByteOffset + header.m_dfdByteLength + header.m_kvdByteLength;
+	for(uint32_t level = levelCount; level-- > 0;)
+	{
+		offset = (offset + alignment - 1) / alignment * alignment;
+		levelIndex[level].m_byteOffset = offset;
+		levelIndex[level].m_byteLength = image.m_levels[level].m_size;
+		levelIndex[level].m_uncompressedByteLength = image.m_levels[level].m_size;
+		offset += image.m_levels[level].m_size;
+	}
+
+	const std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!file.is_open())
+		{
+			std::cout << "ERROR::KTX2::OPEN_FAILED " << tempPath << std::endl;
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(Ktx2LevelIndex));
+		file.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+		file.write(kvd.data(), kvd.size());
+		const char padding[16] = {};
+		for(uint32_t level = levelCount; level-- > 0;)
+		{
+			const uint64_t position = static_cast<uint64_t>(file.tellp());
+			file.write(padding, static_cast<std::streamsize>(levelIndex[level].m_byteOffset - position));
+			file.write(reinterpret_cast<const char*>(image.m_levelData.data() + image.m_levels[level].m_offset), image.m_levels[level].m_size);
+		}
+		if(!file.good())
+		{
+			std::cout << "ERROR::KTX2::WRITE_FAILED " << tempPath << std::endl;
+			return false;
+		}
+	}
+
+	std::remove(path.c_str());
+	if(std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::cout << "ERROR::KTX2::RENAME_FAILED " << path << std::endl;
+		std::remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+//==========KTX2
+
+//----------DDS
+constexpr uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+constexpr uint32_t DDS_FLAG_MIPMAP_COUNT = 0x20000;
+constexpr uint32_t DDS_PIXEL_ALPHA = 0x1;
+constexpr uint32_t DDS_PIXEL_FOURCC = 0x4;
+constexpr uint32_t DDS_PIXEL_RGB = 0x40;
+constexpr uint32_t DDS_PIXEL_LUMINANCE = 0x20000;
+constexpr uint32_t DDS_CAPS2_CUBEMAP = 0x200;
+constexpr uint32_t DDS_CAPS2_VOLUME = 0x200000;
+constexpr uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+constexpr uint32_t DDS_MISC_TEXTURECUBE = 0x4;
+
+struct DdsPixelFormat
+{
+	uint32_t m_size;
+	uint32_t m_flags;
+	uint32_t m_fourCC;
+	uint32_t m_rgbBitCount;
+	uint32_t m_rBitMask;
+	uint32_t m_gBitMask;
+	uint32_t m_bBitMask;
+	uint32_t m_aBitMask;
+};
+
+struct DdsHeader
+{
+	uint32_t m_size;
+	uint32_t m_flags;
+	uint32_t m_height;
+	uint32_t m_width;
+	uint32_t m_pitchOrLinearSize;
+	uint32_t m_depth;
+	uint32_t m_mipMapCount;
+	uint32_t m_reserved1[11];
+	DdsPixelFormat m_pixelFormat;
+	uint32_t m_caps;
+	uint32_t m_caps2;
+	uint32_t m_caps3;
+	uint32_t m_caps4;
+	uint32_t m_reserved2;
+};
+static_assert(sizeof(DdsHeader) == 124, "DDS header layout");
+
+// follows DdsHeader when the four character code is "DX10"
+struct DdsHeaderDx10
+{
+	uint32_t m_dxgiFormat;
+	uint32_t m_resourceDimension;
+	uint32_t m_miscFlag;
+	uint32_t m_arraySize;
+	uint32_t m_miscFlags2;
+};
+
+constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+inline TextureFormat GetFormatFromDxgiFormat(uint32_t dxgiFormat)
+{
+	switch(dxgiFormat)
+	{
+		case 28:
+		case 29: return TEXTURE_FORMAT_RGBA8;
+		case 61: return TEXTURE_FORMAT_R8;
+		case 71:
+		case 72: return TEXTURE_FORMAT_BC1;
+		case 77:
+		case 78: return TEXTURE_FORMAT_BC3;
+		case 80: return TEXTURE_FORMAT_BC4;
+		case 83: return TEXTURE_FORMAT_BC5;
+		case 98:
+		case 99: return TEXTURE_FORMAT_BC7;
+		default: return TEXTURE_FORMAT_UNKNOWN;
+	}
+}
+
+inline TextureFormat GetFormatFromDdsPixelFormat(const DdsPixelFormat& pixelFormat)
+{
+	if(pixelFormat.m_flags & DDS_PIXEL_FOURCC)
+	{
+		switch(pixelFormat.m_fourCC)
+		{
+			case MakeFourCC('D', 'X', 'T', '1'): return TEXTURE_FORMAT_BC1;
+			case MakeFourCC('D', 'X', 'T', '5'): return TEXTURE_FORMAT_BC3;
+			case MakeFourCC('A', 'T', 'I', '1'):
+			case MakeFourCC('B', 'C', '4', 'U'): return TEXTURE_FORMAT_BC4;
+			case MakeFourCC('A', 'T', 'I', '2'):
+			case MakeFourCC('B', 'C', '5', 'U'): return TEXTURE_FORMAT_BC5;
+			default: return TEXTURE_FORMAT_UNKNOWN;
+		}
+	}
+	// uncompressed data is only taken when its byte order already matches what GL gets
+	if((pixelFormat.m_flags & DDS_PIXEL_RGB) && pixelFormat.m_rgbBitCount == 32 && pixelFormat.m_rBitMask == 0xFF
+	   && pixelFormat.m_gBitMask == 0xFF00 && pixelFormat.m_bBitMask == 0xFF0000
+	   && (!(pixelFormat.m_flags & DDS_PIXEL_ALPHA) || pixelFormat.m_aBitMask == 0xFF000000))
+		return TEXTURE_FORMAT_RGBA8;
+	if((pixelFormat.m_flags & (DDS_PIXEL_LUMINANCE | DDS_PIXEL_RGB)) && pixelFormat.m_rgbBitCount == 8 && pixelFormat.m_rBitMask == 0xFF)
+		return TEXTURE_FORMAT_R8;
+	return TEXTURE_FORMAT_UNKNOWN;
+}
+
+inline bool IsDds(const uint8_t* data, size_t size)
+{
+	uint32_t magic = 0;
+	if(size >= sizeof(magic) + sizeof(DdsHeader))
+		std::memcpy(&magic, data, sizeof(magic));
+	return magic == DDS_MAGIC;
+}
+
+inline bool ReadDds(const uint8_t* data, size_t size, const std::string& path, DecodedImage& image)
+{
+	PROFILE_ZONE("DDS Read");
+	if(!IsDds(data, size))
+		return false;
+
+	DdsHeader header;
+	std::memcpy(&header, data + sizeof(uint32_t), sizeof(header));
+	size_t offset = sizeof(uint32_t) + sizeof(DdsHeader);
+	TextureFormat format = TEXTURE_FORMAT_UNKNOWN;
+	bool isPlain2D = !(header.m_caps2 & (DDS_CAPS2_CUBEMAP | DDS_CAPS2_VOLUME));
+	if((header.m_pixelFormat.m_flags & DDS_PIXEL_FOURCC) && header.m_pixelFormat.m_fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		DdsHeaderDx10 dx10;
+		if(size < offset + sizeof(dx10))
+			return false;
+		std::memcpy(&dx10, data + offset, sizeof(dx10));
+		offset += sizeof(dx10);
+		format = GetFormatFromDxgiFormat(dx10.m_dxgiFormat);
+		isPlain2D = isPlain2D && dx10.m_resourceDimension == DDS_DIMENSION_TEXTURE2D && dx10.m_arraySize <= 1
+					&& !(dx10.m_miscFlag & DDS_MISC_TEXTURECUBE);
+	}
+	else
+	{
+		format = GetFormatFromDdsPixelFormat(header.m_pixelFormat);
+	}
+	if(format == TEXTURE_FORMAT_UNKNOWN || !isPlain2D || header.m_width == 0 || header.m_height == 0)
+	{
+		std::cout << "ERROR::DDS::UNSUPPORTED " << path << std::endl;
+		return false;
+	}
+
+	// levels follow each other largest first, exactly the layout of m_levelData
+	const uint32_t levelCount = (header.m_flags & DDS_FLAG_MIPMAP_COUNT) && header.m_mipMapCount > 0 ? std::min(header.m_mipMapCount, 32u) : 1;
+	image.m_width = static_cast<int>(header.m_width);
+	image.m_height = static_cast<int>(header.m_height);
+	image.m_channels = format == TEXTURE_FORMAT_R8 || format == TEXTURE_FORMAT_BC4 ? 1 : 4;
+	image.m_format = format;
+	image.m_levelFile = path;
+	image.m_levels.resize(levelCount);
+	size_t levelOffset = 0;
+	for(uint32_t level = 0; level < levelCount; level++)
+	{
+		TextureLevel& info = image.m_levels[level];
+		info.m_width = std::max(header.m_width >> level, 1u);
+		info.m_height = std::max(header.m_height >> level, 1u);
+		info.m_size = GetLevelSize(format, info.m_width, info.m_height);
+		info.m_offset = levelOffset;
+		info.m_fileOffset = offset + levelOffset;
+		levelOffset += info.m_size;
+	}
+	if(levelOffset > size - offset)
+	{
+		std::cout << "ERROR::DDS::MALFORMED " << path << std::endl;
+		image = DecodedImage();
+		return false;
+	}
+	image.m_levelData.assign(data + offset, data + offset + levelOffset);
+	return true;
+}
+//==========DDS
+
+inline bool IsTextureContainer(const uint8_t* data, size_t size)
+{
+	return IsKtx2(data, size) || IsDds(data, size);
+}
+
+inline bool ReadTextureContainer(const uint8_t* data, size_t size, const std::string& path, DecodedImage& image)
+{
+	return IsKtx2(data, size) ? ReadKtx2(data, size, path, image) : ReadDds(data, size, path, image);
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Tools/Hash.h"
+#include "BlockCompression.h"
+#include "MipGenerator.h"
+#include "TextureContainer.h"
+#include "TextureFormat.h"
+#include "TextureLoader.h"
+
+// what a texture holds, decides the format it is cooked to
+enum TextureUsage : uint32_t
+{
+	TEXTURE_USAGE_COLOR = 0,
+	// tangent space normals, only x and y are kept (BC5) and z has to be rebuilt when sampling
+	TEXTURE_USAGE_NORMAL = 1,
+};
+
+// key/value entry of the cooked KTX2 holding the cook key
+constexpr char TEXTURE_COOK_KEY[] = "learnOpenGL.cookKey";
+
+// part of the cook key, changing a setting redoes the cooked files
+struct TextureCookSettings
+{
+	// off stores the mip chain as R8/RGBA8
+	bool m_isCompressionEnabled = true;
+	MipFilter m_mipFilter = MIP_FILTER_KAISER;
+};
+
+/*
+* Turns a decoded source image into what the GPU samples directly: the full mip chain, built on
+* the CPU (MipGenerator) and block compressed, written next to the source as <source>.cooked.ktx2
+* and loaded from there on later runs, so loading is a plain upload.
+* Single channel images become BC4, normal maps BC5, colour BC1, or BC7 (BC3 without BPTC) when
+* it has alpha. Without a format the GPU can sample, or with compression off, the chain is stored
+* as R8/RGBA8.
+* Colour mips are filtered in linear space, single channel images are treated as data and normal
+* maps are renormalized.
+* The cooked file carries a key built from the source content hash, the usage, the settings and
+* VERSION and is only used while that still matches.
+*/
+class TextureCook
+{
+public:
+	// bump whenever the encoders or the mip generation change, old cooked files then get redone
+	static constexpr uint32_t VERSION = 2;
+
+	static std::string GetCookedPath(const std::string& sourcePath) { return sourcePath + ".cooked.ktx2"; }
+	static uint64_t GetCookKey(uint64_t contentHash, TextureUsage usage, const TextureCookSettings& settings);
+
+	static TextureFormat ChooseFormat(const DecodedImage& source, TextureUsage usage, const TextureCookSettings& settings);
+	// builds the mip chain of an stb decoded image and converts every level to format
+	static bool Cook(const DecodedImage& source, TextureUsage usage, TextureFormat format, MipFilter filter, DecodedImage& cooked);
+	static bool Write(const std::string& cookedPath, uint64_t cookKey, const DecodedImage& cooked);
+	// fails when the cooked file is missing, stale or in a format this GPU can't sample
+	static bool Load(const std::string& cookedPath, uint64_t cookKey, DecodedImage& cooked);
+
+private:
+	static bool HasAlpha(const DecodedImage& source);
+};
+
+inline uint64_t TextureCook::GetCookKey(uint64_t contentHash, TextureUsage usage, const TextureCookSettings& settings)
+{
+	uint64_t key = HashCombine(contentHash, VERSION);
+	key = HashCombine(key, usage);
+	key = HashCombine(key, settings.m_isCompressionEnabled);
+	return HashCombine(key, settings.m_mipFilter);
+}
+
+inline TextureFormat TextureCook::ChooseFormat(const DecodedImage& source, TextureUsage usage, const TextureCookSettings& settings)
+{
+	const TextureFormat uncompressed = source.m_channels == 1 ? TEXTURE_FORMAT_R8 : TEXTURE_FORMAT_RGBA8;
+	if(!settings.m_isCompressionEnabled)
+		return uncompressed;
+	if(source.m_channels == 1)
+		return TEXTURE_FORMAT_BC4;
+	if(usage == TEXTURE_USAGE_NORMAL)
+		return TEXTURE_FORMAT_BC5;
+
+	const TextureFormat preferred = HasAlpha(source) ? TEXTURE_FORMAT_BC7 : TEXTURE_FORMAT_BC1;
+	const TextureFormat fallback = preferred == TEXTURE_FORMAT_BC7 ? TEXTURE_FORMAT_BC3 : TEXTURE_FORMAT_BC7;
+	if(IsTextureFormatSupported(preferred))
+		return preferred;
+	if(IsTextureFormatSupported(fallback))
+		return fallback;
+	return uncompressed;
+}
+
+inline bool TextureCook::Cook(const DecodedImage& source, TextureUsage usage, TextureFormat format, MipFilter filter, DecodedImage& cooked)
+{
+	if(!source.m_pixels || format == TEXTURE_FORMAT_UNKNOWN)
+		return false;
+
+	PROFILE_ZONE("Texture Cook");
+	const uint32_t channels = static_cast<uint32_t>(source.m_channels);
+	uint32_t width = static_cast<uint32_t>(source.m_width);
+	uint32_t height = static_cast<uint32_t>(source.m_height);
+	cooked = DecodedImage();
+	cooked.m_width = source.m_width;
+	cooked.m_height = source.m_height;
+	cooked.m_channels = source.m_channels;
+	cooked.m_format = format;
+
+	MipContent content = MIP_CONTENT_SRGB_COLOR;
+	if(channels == 1)
+		content = MIP_CONTENT_DATA;
+	else if(usage == TEXTURE_USAGE_NORMAL)
+		content = MIP_CONTENT_NORMAL;
+
+	// level 0 converts straight from the source, the smaller levels ping pong between two buffers
+	const uint8_t* pixels = source.m_pixels.get();
+	std::vector<uint8_t> levelBuffers[2];
+	int nextBuffer = 0;
+	while(true)
+	{
+		TextureLevel level;
+		level.m_width = width;
+		level.m_height = height;
+		level.m_offset = cooked.m_levelData.size();
+		if(IsBlockCompressed(format))
+		{
+			const std::vector<uint8_t> blocks = CompressImage(pixels, width, height, channels, format);
+			cooked.m_levelData.insert(cooked.m_levelData.end(), blocks.begin(), blocks.end());
+		}
+		else
+		{
+			cooked.m_levelData.insert(cooked.m_levelData.end(), pixels, pixels + size_t(width) * height * channels);
+		}
+		level.m_size = cooked.m_levelData.size() - level.m_offset;
+		cooked.m_levels.push_back(level);
+		if(width == 1 && height == 1)
+			break;
+
+		const uint32_t nextWidth = GetNextMipSize(width);
+		const uint32_t nextHeight = GetNextMipSize(height);
+		std::vector<uint8_t>& next = levelBuffers[nextBuffer];
+		next.resize(size_t(nextWidth) * nextHeight * channels);
+		GenerateMipLevel(pixels, width, height, channels, content, filter, next.data());
+		pixels = next.data();
+		nextBuffer ^= 1;
+		width = nextWidth;
+		height = nextHeight;
+	}
+	return true;
+}
+
+inline bool TextureCook::Write(const std::string& cookedPath, uint64_t cookKey, const DecodedImage& cooked)
+{
+	// sorted by key as KTX2 requires
+	const std::vector<std::pair<std::string, std::string>> keyValues = {
+		{"KTXwriter", "learnOpenGL TextureCook"},
+		{TEXTURE_COOK_KEY, std::string(reinterpret_cast<const char*>(&cookKey), sizeof(cookKey))},
+	};
+	return WriteKtx2(cookedPath, cooked, keyValues);
+}
+
+inline bool TextureCook::Load(const std::string& cookedPath, uint64_t cookKey, DecodedImage& cooked)
+{
+	AssetFile file;
+	if(!file.Open(cookedPath.c_str()))
+		return false;
+
+	std::string value;
+	uint64_t storedKey = 0;
+	if(!FindKtx2Value(file.GetData(), file.GetSize(), TEXTURE_COOK_KEY, value) || value.size() != sizeof(storedKey))
+		return false;
+	std::memcpy(&storedKey, value.data(), sizeof(storedKey));
+	if(storedKey != cookKey)
+		return false;
+
+	if(!ReadKtx2(file.GetData(), file.GetSize(), cookedPath, cooked))
+		return false;
+	// cooked on a machine with other formats available
+	if(!IsTextureFormatSupported(cooked.m_format))
+	{
+		cooked = DecodedImage();
+		return false;
+	}
+	return true;
+}
+
+inline bool TextureCook::HasAlpha(const DecodedImage& source)
+{
+	if(source.m_channels != 4 || !source.m_pixels)
+		return false;
+	const uint8_t* pixels = source.m_pixels.get();
+	const size_t pixelCount = size_t(source.m_width) * source.m_height;
+	for(size_t i = 0; i < pixelCount; i++)
+	{
+		if(pixels[i * 4 + 3] != 255)
+			return true;
+	}
+	return false;
+}
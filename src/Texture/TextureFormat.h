@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+
+#include "../Tools/GlExtensions.h"
+
+/*
+* Formats a texture can be stored and uploaded in. The BC formats encode blocks of 4x4 pixels in
+* 8 bytes (BC1, BC4) or 16 bytes (BC3, BC5, BC7), a quarter to an eighth of RGBA8, and the GPU
+* samples them as they are.
+*/
+enum TextureFormat : uint32_t
+{
+	TEXTURE_FORMAT_UNKNOWN = 0,
+	TEXTURE_FORMAT_R8,
+	TEXTURE_FORMAT_RGBA8,
+	// rgb, no alpha
+	TEXTURE_FORMAT_BC1,
+	// BC1 colour + BC4 alpha
+	TEXTURE_FORMAT_BC3,
+	// one channel
+	TEXTURE_FORMAT_BC4,
+	// two BC4 channels, tangent space normal xy
+	TEXTURE_FORMAT_BC5,
+	// rgba, better quality than BC1/BC3 at the size of BC3
+	TEXTURE_FORMAT_BC7,
+};
+
+inline bool IsBlockCompressed(TextureFormat format)
+{
+	return format >= TEXTURE_FORMAT_BC1;
+}
+
+// bytes per 4x4 block for the BC formats, per pixel for the others
+inline uint32_t GetFormatBlockSize(TextureFormat format)
+{
+	switch(format)
+	{
+		case TEXTURE_FORMAT_R8: return 1;
+		case TEXTURE_FORMAT_RGBA8: return 4;
+		case TEXTURE_FORMAT_BC1:
+		case TEXTURE_FORMAT_BC4: return 8;
+		case TEXTURE_FORMAT_BC3:
+		case TEXTURE_FORMAT_BC5:
+		case TEXTURE_FORMAT_BC7: return 16;
+		default: return 0;
+	}
+}
+
+// bytes of one mip level
+inline size_t GetLevelSize(TextureFormat format, uint32_t width, uint32_t height)
+{
+	if(IsBlockCompressed(format))
+	{
+		width = (width + 3) / 4;
+		height = (height + 3) / 4;
+	}
+	return size_t(width) * height * GetFormatBlockSize(format);
+}
+
+inline GLenum GetGlInternalFormat(TextureFormat format)
+{
+	switch(format)
+	{
+		case TEXTURE_FORMAT_R8: return GL_R8;
+		case TEXTURE_FORMAT_RGBA8: return GL_RGBA8;
+		case TEXTURE_FORMAT_BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case TEXTURE_FORMAT_BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		case TEXTURE_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+		case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+		case TEXTURE_FORMAT_BC7: return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+		default: return 0;
+	}
+}
+
+// needs LoadGlExtensions to have run, safe from any thread after that
+inline bool IsTextureFormatSupported(TextureFormat format)
+{
+	const GlExtensions& ext = GetGlExtensions();
+	switch(format)
+	{
+		case TEXTURE_FORMAT_R8:
+		case TEXTURE_FORMAT_RGBA8:
+		case TEXTURE_FORMAT_BC4:
+		case TEXTURE_FORMAT_BC5: return true;
+		case TEXTURE_FORMAT_BC1:
+		case TEXTURE_FORMAT_BC3: return ext.m_hasS3tc;
+		case TEXTURE_FORMAT_BC7: return ext.m_hasBptc;
+		default: return false;
+	}
+}
+
+inline const char* GetTextureFormatName(TextureFormat format)
+{
+	switch(format)
+	{
+		case TEXTURE_FORMAT_R8: return "R8";
+		case TEXTURE_FORMAT_RGBA8: return "RGBA8";
+		case TEXTURE_FORMAT_BC1: return "BC1";
+		case TEXTURE_FORMAT_BC3: return "BC3";
+		case TEXTURE_FORMAT_BC4: return "BC4";
+		case TEXTURE_FORMAT_BC5: return "BC5";
+		case TEXTURE_FORMAT_BC7: return "BC7";
+		default: return "Unknown";
+	}
+}
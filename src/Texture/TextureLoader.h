@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <glad/glad.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "STB/stb_image.h"
+#include "../Platform/VirtualFileSystem.h"
+#include "../Profiling/CpuProfiler.h"
+#include "../Profiling/MemoryStats.h"
+#include "TextureFormat.h"
+
+/*
+* Texture loading split in a cpu half (DecodeImage, safe on any thread) and a GL half (UploadTexture,
+* GL thread only), so decoding can run on workers.
+* Decoded images are always R8 or RGBA8: the conversion happens on the decoding thread and the
+* driver never has to repack 3 channel rows on the GL thread.
+* Cooked and container textures (KTX2/DDS) come with all their mip levels instead, usually block
+* compressed, and are uploaded level by level.
+*/
+struct TextureLevel
+{
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	// into DecodedImage::m_levelData
+	size_t m_offset = 0;
+	size_t m_size = 0;
+	// into DecodedImage::m_levelFile
+	uint64_t m_fileOffset = 0;
+};
+
+struct DecodedImage
+{
+	struct PixelDeleter
+	{
+		void operator()(unsigned char* pixels) const { stbi_image_free(pixels); }
+	};
+
+	int m_width = 0;
+	int m_height = 0;
+	// 1 or 4
+	int m_channels = 0;
+	TextureFormat m_format = TEXTURE_FORMAT_UNKNOWN;
+	// stb decoded base level, the driver generates the mips
+	std::unique_ptr<unsigned char, PixelDeleter> m_pixels;
+	// every mip level back to back, largest first, when there are no m_pixels
+	std::vector<uint8_t> m_levelData;
+	std::vector<TextureLevel> m_levels;
+	// container the levels were read from, empty when they only exist in memory
+	std::string m_levelFile;
+
+	bool IsValid() const { return m_pixels != nullptr || !m_levels.empty(); }
+	// bytes of pixel data held, for MemoryStats
+	size_t GetMemorySize() const { return (m_pixels ? size_t(m_width) * m_height * m_channels : 0) + m_levelData.capacity(); }
+};
+
+// path is only used for error messages
+inline bool DecodeImageFromMemory(const unsigned char* data, size_t size, const std::string& path, DecodedImage& image)
+{
+	PROFILE_ZONE("Texture Decode");
+	int fileChannels = 0;
+	if(!stbi_info_from_memory(data, static_cast<int>(size), &image.m_width, &image.m_height, &fileChannels))
+	{
+		std::cout << "ERROR::STBI::LOAD at file " << path << " " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+
+	// single channel stays R8, grey+alpha and rgb are expanded by stb while decoding
+	image.m_channels = fileChannels == 1 ? 1 : 4;
+	image.m_format = image.m_channels == 1 ? TEXTURE_FORMAT_R8 : TEXTURE_FORMAT_RGBA8;
+	image.m_pixels.reset(stbi_load_from_memory(data, static_cast<int>(size), &image.m_width, &image.m_height, &fileChannels, image.m_channels));
+	if(!image.m_pixels)
+	{
+		std::cout << "ERROR::STBI::LOAD at file " << path << " " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+inline bool DecodeImage(const std::string& path, DecodedImage& image)
+{
+	AssetFile file;
+	if(!file.Open(path.c_str()))
+	{
+		std::cout << "ERROR::STBI::LOAD at file " << path << std::endl;
+		return false;
+	}
+	return DecodeImageFromMemory(file.GetData(), file.GetSize(), path, image);
+}
+
+// GL thread only, with the texture bound to GL_TEXTURE_2D
+inline void UploadTextureLevel(TextureFormat format, uint32_t level, const TextureLevel& info, const uint8_t* data)
+{
+	const GLenum internalFormat = GetGlInternalFormat(format);
+	if(IsBlockCompressed(format))
+	{
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, info.m_width, info.m_height, 0, static_cast<GLsizei>(info.m_size), data);
+		return;
+	}
+	// R8 rows aren't 4 byte aligned unless the width is
+	const bool isSingleChannel = format == TEXTURE_FORMAT_R8;
+	if(isSingleChannel)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, info.m_width, info.m_height, 0, isSingleChannel ? GL_RED : GL_RGBA,
+				 GL_UNSIGNED_BYTE, data);
+	if(isSingleChannel)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+// GL thread only, with the texture bound. Redefines the level as empty so the driver can free it,
+// GL_TEXTURE_BASE_LEVEL has to be above it already
+inline void ReleaseTextureLevel(TextureFormat format, uint32_t level)
+{
+	const GLenum internalFormat = GetGlInternalFormat(format);
+	if(IsBlockCompressed(format))
+		glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, 0, 0, 0, 0, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), internalFormat, 0, 0, 0, format == TEXTURE_FORMAT_R8 ? GL_RED : GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+// GL thread only, the format must be supported (IsTextureFormatSupported). Returns 0 for an invalid image.
+// For streaming, levels finer than firstLevel are left undefined and sampling starts at firstLevel
+inline unsigned int UploadTexture(const DecodedImage& image, uint32_t firstLevel = 0)
+{
+	if(!image.IsValid())
+		return 0;
+
+	PROFILE_ZONE("Texture Upload");
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	if(image.m_pixels)
+	{
+		TextureLevel base;
+		base.m_width = static_cast<uint32_t>(image.m_width);
+		base.m_height = static_cast<uint32_t>(image.m_height);
+		UploadTextureLevel(image.m_format, 0, base, image.m_pixels.get());
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	else
+	{
+		firstLevel = std::min(firstLevel, static_cast<uint32_t>(image.m_levels.size() - 1));
+		for(uint32_t level = firstLevel; level < image.m_levels.size(); level++)
+			UploadTextureLevel(image.m_format, level, image.m_levels[level], image.m_levelData.data() + image.m_levels[level].m_offset);
+		// a lone uncompressed level gets generated mips, otherwise sampling stops at the last level given
+		if(image.m_levels.size() == 1 && !IsBlockCompressed(image.m_format))
+			glGenerateMipmap(GL_TEXTURE_2D);
+		else
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(image.m_levels.size() - 1));
+		if(firstLevel > 0)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(firstLevel));
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Platform/VirtualFileSystem.h"
+#include "TextureFormat.h"
+#include "TextureLoader.h"
+
+// levels this size and smaller are uploaded with the texture and never evicted
+constexpr uint32_t STREAMING_TAIL_SIZE = 128;
+// level reads in flight at once, each is one level of one texture
+constexpr uint32_t MAX_STREAMING_LOADS = 4;
+
+/*
+* Where the camera is, as far as streaming cares: how many pixels something covers on screen.
+*/
+struct StreamingView
+{
+	StreamingView(const glm::vec3& position, const glm::vec3& front, float fovYDegrees, int viewportHeight);
+
+	// diameter in pixels of a sphere, 0 when it is behind the camera
+	float GetProjectedSize(const glm::vec3& center, float radius) const;
+
+	glm::vec3 m_position;
+	glm::vec3 m_front;
+	// pixels one world unit covers at distance 1
+	float m_pixelScale;
+};
+
+/*
+* Streaming state of a texture uploaded with only its small levels. The finer levels are read
+* back from the container file one at a time when the texture is drawn big enough to need them,
+* and given back (LRU) when the budget is needed for something else.
+* The texture keeps mutable per level storage: a level that isn't resident is redefined as
+* empty, so the driver really frees it. GL_TEXTURE_BASE_LEVEL clamps sampling to what is resident.
+*/
+struct TextureResidency
+{
+	std::string m_levelFile;
+	TextureFormat m_format = TEXTURE_FORMAT_UNKNOWN;
+	std::vector<TextureLevel> m_levels;
+	// finest level uploaded, the texture's GL_TEXTURE_BASE_LEVEL
+	uint32_t m_residentLevel = 0;
+	// this level and the smaller ones stay resident
+	uint32_t m_tailLevel = 0;
+	uint32_t m_desiredLevel = 0;
+	// largest projected size requested during m_lastUsedFrame
+	float m_screenSize = 0.0f;
+	uint64_t m_lastUsedFrame = 0;
+	bool m_isLoading = false;
+	// a level couldn't be read, the texture stays as it is
+	bool m_hasFailed = false;
+};
+
+inline StreamingView::StreamingView(const glm::vec3& position, const glm::vec3& front, float fovYDegrees, int viewportHeight)
+	: m_position(position), m_front(front)
+{
+	m_pixelScale = viewportHeight * 0.5f / std::tan(glm::radians(fovYDegrees) * 0.5f);
+}
+
+inline float StreamingView::GetProjectedSize(const glm::vec3& center, float radius) const
+{
+	constexpr float MIN_DISTANCE = 0.1f;
+	const glm::vec3 toCenter = center - m_position;
+	if(glm::dot(toCenter, m_front) < -radius)
+		return 0.0f;
+	const float distance = std::max(glm::length(toCenter) - radius, MIN_DISTANCE);
+	return 2.0f * radius * m_pixelScale / distance;
+}
+
+// first level of the always resident tail, 0 when the whole texture is small enough
+inline uint32_t GetStreamingTailLevel(const std::vector<TextureLevel>& levels)
+{
+	for(uint32_t level = 0; level < levels.size(); level++)
+	{
+		if(std::max(levels[level].m_width, levels[level].m_height) <= STREAMING_TAIL_SIZE)
+			return level;
+	}
+	return levels.empty() ? 0 : static_cast<uint32_t>(levels.size() - 1);
+}
+
+// level with about one texel per pixel when the texture covers screenSize pixels
+inline uint32_t GetDesiredLevel(const TextureResidency& residency, float screenSize)
+{
+	if(screenSize <= 0.0f)
+		return residency.m_tailLevel;
+	const float texels = static_cast<float>(std::max(residency.m_levels[0].m_width, residency.m_levels[0].m_height));
+	const float level = std::floor(std::log2(texels / screenSize));
+	return level <= 0.0f ? 0 : std::min(static_cast<uint32_t>(level), residency.m_tailLevel);
+}
+
+// any thread, copies the level into destination (level.m_size bytes, e.g. a mapped PixelBuffer)
+inline bool ReadTextureLevel(const std::string& path, const TextureLevel& level, uint8_t* destination)
+{
+	PROFILE_ZONE("Texture Level Read");
+	AssetFile file;
+	if(!file.Open(path.c_str()) || level.m_fileOffset > file.GetSize() || level.m_size > file.GetSize() - level.m_fileOffset)
+	{
+		std::cout << "ERROR::TEXTURE_STREAMING::READ_FAILED " << path << std::endl;
+		return false;
+	}
+	std::memcpy(destination, file.GetData() + level.m_fileOffset, level.m_size);
+	return true;
+}
+
+// any thread, data is empty when the file can't be read
+inline std::vector<uint8_t> ReadTextureLevel(const std::string& path, const TextureLevel& level)
+{
+	std::vector<uint8_t> data(level.m_size);
+	if(!ReadTextureLevel(path, level, data.data()))
+		data.clear();
+	return data;
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "../Profiling/MemoryStats.h"
+#include "../Render/GlBuffer.h"
+#include "../Shader.h"
+#include "DebugFont.h"
+
+/*
+* Minimal screen-space text overlay for debug/profiling output.
+* Lines are collected during the frame with AddLine() and drawn (then cleared) by Render().
+*/
+class DebugOverlay
+{
+public:
+	void Init();
+	void Delete();
+
+	void Toggle() { m_isVisible = !m_isVisible; }
+	bool IsVisible() const { return m_isVisible; }
+
+	void AddLine(const std::string& text, glm::vec3 color = glm::vec3(1.0f));
+	void Render();
+
+private:
+	//------settings
+	const int SCALE = 2;
+	const int MARGIN = 8;
+	const int CELL_WIDTH = DEBUG_FONT_GLYPH_WIDTH + 1;
+	const int CELL_HEIGHT = DEBUG_FONT_GLYPH_HEIGHT + 2;
+	const glm::vec4 BACKGROUND_COLOR = glm::vec4(0.0f, 0.0f, 0.0f, 0.6f);
+	// the atlas has one extra, fully filled cell after the glyphs, used for solid quads
+	const int SOLID_CELL = DEBUG_FONT_CHAR_COUNT;
+	//=====settings
+
+	struct Line
+	{
+		std::string m_text;
+		glm::vec3 m_color;
+	};
+
+	bool m_isVisible = true;
+	Shader* m_shader = nullptr;
+	GlVertexArray m_vertexArray;
+	GlBuffer m_vertexBuffer{MEMORY_GPU_OTHER};
+	unsigned int m_fontTexture = 0;
+	size_t m_fontTextureSize = 0;
+	std::vector<Line> m_lines;
+	std::vector<float> m_vertices;
+
+	void PushQuad(float x, float y, float w, float h, int cell, glm::vec4 color);
+};
+
+inline void DebugOverlay::Init()
+{
+	m_shader = new Shader("src/Shaders/Overlay.vert", "src/Shaders/Overlay.frag");
+
+	//-----font atlas
+	const int atlasWidth = (DEBUG_FONT_CHAR_COUNT + 1) * CELL_WIDTH;
+	const int atlasHeight = CELL_HEIGHT;
+	std::vector<unsigned char> atlas(atlasWidth * atlasHeight, 0);
+	for(int c = 0; c < DEBUG_FONT_CHAR_COUNT; c++)
+	{
+		for(int x = 0; x < DEBUG_FONT_GLYPH_WIDTH; x++)
+		{
+			for(int y = 0; y < DEBUG_FONT_GLYPH_HEIGHT; y++)
+			{
+				if(DEBUG_FONT[c][x] & (1 << y))
+					atlas[y * atlasWidth + c * CELL_WIDTH + x] = 255;
+			}
+		}
+	}
+	for(int x = 0; x < CELL_WIDTH; x++)
+		for(int y = 0; y < CELL_HEIGHT; y++)
+			atlas[y * atlasWidth + SOLID_CELL * CELL_WIDTH + x] = 255;
+
+	glGenTextures(1, &m_fontTexture);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_fontTextureSize = atlas.size();
+	GetMemoryStats().Allocate(MEMORY_GPU_OTHER, m_fontTextureSize);
+	//=====font atlas
+
+	//-----buffers
+	m_vertexArray.Bind();
+	// storage comes with the first frame's vertices
+	m_vertexBuffer.SetData(GL_ARRAY_BUFFER, 0, nullptr, GL_STREAM_DRAW);
+
+	constexpr GLsizei stride = 8 * sizeof(float);
+	// position
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	// texture coords
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(2 * sizeof(float)));
+	// color
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(4 * sizeof(float)));
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	//=====buffers
+}
+
+inline void DebugOverlay::Delete()
+{
+	m_vertexArray.Delete();
+	m_vertexBuffer.Delete();
+	glDeleteTextures(1, &m_fontTexture);
+	GetMemoryStats().Free(MEMORY_GPU_OTHER, m_fontTextureSize);
+	m_fontTextureSize = 0;
+	if(m_shader)
+	{
+		m_shader->Delete();
+		delete m_shader;
+		m_shader = nullptr;
+	}
+}
+
+inline void DebugOverlay::AddLine(const std::string& text, glm::vec3 color)
+{
+	m_lines.push_back({text, color});
+}
+
+inline void DebugOverlay::PushQuad(float x, float y, float w, float h, int cell, glm::vec4 color)
+{
+	const float cellCount = static_cast<float>(DEBUG_FONT_CHAR_COUNT + 1);
+	const float u0 = cell / cellCount;
+	const float u1 = (cell + static_cast<float>(DEBUG_FONT_GLYPH_WIDTH + (cell == SOLID_CELL)) / CELL_WIDTH) / cellCount;
+	const float v1 = static_cast<float>(DEBUG_FONT_GLYPH_HEIGHT) / CELL_HEIGHT;
+
+	const float corners[6][4] = {
+		{x,     y,     u0, 0.0f},
+		{x + w, y,     u1, 0.0f},
+		{x + w, y + h, u1, v1},
+		{x + w, y + h, u1, v1},
+		{x,     y + h, u0, v1},
+		{x,     y,     u0, 0.0f},
+	};
+	for(const auto& corner : corners)
+	{
+		m_vertices.insert(m_vertices.end(), corner, corner + 4);
+		m_vertices.insert(m_vertices.end(), {color.r, color.g, color.b, color.a});
+	}
+}
+
+inline void DebugOverlay::Render()
+{
+	if(!m_isVisible || m_lines.empty())
+	{
+		m_lines.clear();
+		return;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	const float glyphW = static_cast<float>(DEBUG_FONT_GLYPH_WIDTH * SCALE);
+	const float glyphH = static_cast<float>(DEBUG_FONT_GLYPH_HEIGHT * SCALE);
+	const float advanceX = static_cast<float>(CELL_WIDTH * SCALE);
+	const float advanceY = static_cast<float>(CELL_HEIGHT * SCALE);
+
+	size_t longestLine = 0;
+	for(const Line& line : m_lines)
+		longestLine = std::max(longestLine, line.m_text.size());
+
+	m_vertices.clear();
+	PushQuad(static_cast<float>(MARGIN / 2), static_cast<float>(MARGIN / 2),
+			 longestLine * advanceX + MARGIN, m_lines.size() * advanceY + MARGIN,
+			 SOLID_CELL, BACKGROUND_COLOR);
+
+	float y = static_cast<float>(MARGIN);
+	for(const Line& line : m_lines)
+	{
+		float x = static_cast<float>(MARGIN);
+		for(char c : line.m_text)
+		{
+			const int cell = c - DEBUG_FONT_FIRST_CHAR;
+			if(cell > 0 && cell < DEBUG_FONT_CHAR_COUNT)
+				PushQuad(x, y, glyphW, glyphH, cell, glm::vec4(line.m_color, 1.0f));
+			x += advanceX;
+		}
+		y += advanceY;
+	}
+	m_lines.clear();
+
+	//-----draw
+	const GLboolean wasDepthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	m_shader->Use();
+	glUniform2f(m_shader->GetUniformLocation("uScreenSize"), static_cast<float>(viewport[2]), static_cast<float>(viewport[3]));
+	m_shader->SetInt("uFont", 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_fontTexture);
+
+	m_vertexArray.Bind();
+	m_vertexBuffer.SetData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), m_vertices.data(), GL_STREAM_DRAW);
+	glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(m_vertices.size() / 8));
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glDisable(GL_BLEND);
+	if(wasDepthTestEnabled)
+		glEnable(GL_DEPTH_TEST);
+	//=====draw
+}
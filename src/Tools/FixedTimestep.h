@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+* Accumulator for running the simulation at a fixed rate, independent of the render frame rate.
+* Every frame Advance() adds the frame's duration and returns how many fixed steps to run, which
+* is 0 on frames faster than the step and several when the frame rate drops below the simulation
+* rate. The leftover time, as GetAlpha(), is how far rendering should interpolate from the previous
+* simulated state to the current one.
+* Steps per frame are capped so a long stall (loading, breakpoint) doesn't make the following frames
+* spend all their time catching up, the time beyond the cap is dropped.
+*/
+class FixedTimestep
+{
+public:
+	static constexpr int MAX_STEPS_PER_FRAME_DEFAULT = 8;
+
+	explicit FixedTimestep(double stepSeconds, int maxStepsPerFrame = MAX_STEPS_PER_FRAME_DEFAULT);
+
+	int Advance(double frameSeconds);
+
+	float GetStep() const { return static_cast<float>(m_step); }
+	float GetAlpha() const { return static_cast<float>(m_accumulator / m_step); }
+
+	uint64_t GetStepCount() const { return m_stepCount; }
+	double GetDroppedSeconds() const { return m_droppedSeconds; }
+
+private:
+	double m_step;
+	int m_maxStepsPerFrame;
+	// double, a float accumulator drifts noticeably after a few minutes of 1/60 steps
+	double m_accumulator = 0.0;
+
+	uint64_t m_stepCount = 0;
+	double m_droppedSeconds = 0.0;
+};
+
+inline FixedTimestep::FixedTimestep(double stepSeconds, int maxStepsPerFrame)
+	: m_step(stepSeconds > 0.0 ? stepSeconds : 1.0 / 60.0)
+	, m_maxStepsPerFrame(maxStepsPerFrame > 0 ? maxStepsPerFrame : 1)
+{
+}
+
+inline int FixedTimestep::Advance(double frameSeconds)
+{
+	if(frameSeconds > 0.0)
+		m_accumulator += frameSeconds;
+
+	int steps = 0;
+	while(m_accumulator >= m_step && steps < m_maxStepsPerFrame)
+	{
+		m_accumulator -= m_step;
+		steps++;
+	}
+
+	if(m_accumulator >= m_step)
+	{
+		// over the cap, keep the fraction so interpolation stays smooth and drop whole steps
+		const double extraSteps = static_cast<double>(static_cast<uint64_t>(m_accumulator / m_step));
+		m_droppedSeconds += extraSteps * m_step;
+		m_accumulator -= extraSteps * m_step;
+	}
+
+	m_stepCount += steps;
+	return steps;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstring>
+#include <glad/glad.h>
+#include <iostream>
+
+/*
+* glad is generated for core 3.3 without any extensions, so everything newer than that
+* (debug groups, pipeline statistics, ...) is loaded here by hand and is only used when
+* the driver reports the extension.
+*/
+
+//-----KHR_debug
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+//=====KHR_debug
+
+//-----ARB_pipeline_statistics_query
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB 0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB 0x82F7
+//=====ARB_pipeline_statistics_query
+
+//-----EXT_texture_compression_s3tc
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+//=====EXT_texture_compression_s3tc
+
+//-----ARB_texture_compression_bptc
+#define GL_COMPRESSED_RGBA_BPTC_UNORM_ARB 0x8E8C
+//=====ARB_texture_compression_bptc
+
+//-----ARB_get_program_binary
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+//=====ARB_get_program_binary
+
+//-----KHR_parallel_shader_compile
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+//=====KHR_parallel_shader_compile
+
+struct GlExtensions
+{
+	bool m_hasKhrDebug = false;
+	bool m_hasPipelineStatistics = false;
+	// BC1/BC3 and BC7, BC4/BC5 (RGTC) are core since 3.0
+	bool m_hasS3tc = false;
+	bool m_hasBptc = false;
+	// and the driver offers at least one binary format
+	bool m_hasProgramBinary = false;
+	// GL_COMPLETION_STATUS_KHR can be polled, compiles and links run on driver threads
+	bool m_hasParallelShaderCompile = false;
+
+	PFNGLPUSHDEBUGGROUPPROC PushDebugGroup = nullptr;
+	PFNGLPOPDEBUGGROUPPROC PopDebugGroup = nullptr;
+	PFNGLGETPROGRAMBINARYPROC GetProgramBinary = nullptr;
+	PFNGLPROGRAMBINARYPROC ProgramBinary = nullptr;
+	PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = nullptr;
+	PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads = nullptr;
+};
+
+inline GlExtensions& GetGlExtensions()
+{
+	static GlExtensions extensions;
+	return extensions;
+}
+
+inline bool IsGlExtensionSupported(const char* name)
+{
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for(GLint i = 0; i < extensionCount; i++)
+	{
+		const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if(extension && std::strcmp(extension, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+// must be called after glad has been loaded, with the same loader
+inline void LoadGlExtensions(GLADloadproc load)
+{
+	GlExtensions& ext = GetGlExtensions();
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	const bool isGl41 = major > 4 || (major == 4 && minor >= 1);
+	const bool isGl42 = major > 4 || (major == 4 && minor >= 2);
+	const bool isGl43 = major > 4 || (major == 4 && minor >= 3);
+	const bool isGl46 = major > 4 || (major == 4 && minor >= 6);
+
+	if(isGl43 || IsGlExtensionSupported("GL_KHR_debug"))
+	{
+		ext.PushDebugGroup = reinterpret_cast<PFNGLPUSHDEBUGGROUPPROC>(load("glPushDebugGroup"));
+		ext.PopDebugGroup = reinterpret_cast<PFNGLPOPDEBUGGROUPPROC>(load("glPopDebugGroup"));
+		ext.m_hasKhrDebug = ext.PushDebugGroup && ext.PopDebugGroup;
+	}
+
+	ext.m_hasPipelineStatistics = isGl46 || IsGlExtensionSupported("GL_ARB_pipeline_statistics_query");
+
+	ext.m_hasS3tc = IsGlExtensionSupported("GL_EXT_texture_compression_s3tc");
+	ext.m_hasBptc = isGl42 || IsGlExtensionSupported("GL_ARB_texture_compression_bptc");
+
+	if(isGl41 || IsGlExtensionSupported("GL_ARB_get_program_binary"))
+	{
+		ext.GetProgramBinary = reinterpret_cast<PFNGLGETPROGRAMBINARYPROC>(load("glGetProgramBinary"));
+		ext.ProgramBinary = reinterpret_cast<PFNGLPROGRAMBINARYPROC>(load("glProgramBinary"));
+		ext.ProgramParameteri = reinterpret_cast<PFNGLPROGRAMPARAMETERIPROC>(load("glProgramParameteri"));
+		GLint formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		ext.m_hasProgramBinary = ext.GetProgramBinary && ext.ProgramBinary && ext.ProgramParameteri && formatCount > 0;
+	}
+
+	// the ARB version is the same extension under another name
+	if(IsGlExtensionSupported("GL_KHR_parallel_shader_compile"))
+		ext.MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsKHR"));
+	else if(IsGlExtensionSupported("GL_ARB_parallel_shader_compile"))
+		ext.MaxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(load("glMaxShaderCompilerThreadsARB"));
+	ext.m_hasParallelShaderCompile = ext.MaxShaderCompilerThreads != nullptr;
+	// let the driver use as many compiler threads as it wants
+	if(ext.m_hasParallelShaderCompile)
+		ext.MaxShaderCompilerThreads(0xFFFFFFFF);
+
+	std::cout << "GL extensions: KHR_debug=" << ext.m_hasKhrDebug
+		<< " ARB_pipeline_statistics_query=" << ext.m_hasPipelineStatistics
+		<< " EXT_texture_compression_s3tc=" << ext.m_hasS3tc
+		<< " ARB_texture_compression_bptc=" << ext.m_hasBptc
+		<< " ARB_get_program_binary=" << ext.m_hasProgramBinary
+		<< " KHR_parallel_shader_compile=" << ext.m_hasParallelShaderCompile << std::endl;
+}
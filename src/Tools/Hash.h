@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/*
+* 64 bit non-cryptographic content hash (XXH64), used to key cooked and cached assets on their source.
+* Runs at memory speed, so hashing a source file costs far less than parsing it.
+*/
+namespace Hash
+{
+	constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+	constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+	constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ULL;
+
+	inline uint64_t RotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+	inline uint64_t Read64(const uint8_t* bytes)
+	{
+		uint64_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t Read32(const uint8_t* bytes)
+	{
+		uint32_t value;
+		std::memcpy(&value, bytes, sizeof(value));
+		return value;
+	}
+
+	inline uint64_t Round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * PRIME2;
+		accumulator = RotateLeft(accumulator, 31);
+		return accumulator * PRIME1;
+	}
+
+	inline uint64_t MergeRound(uint64_t accumulator, uint64_t value)
+	{
+		accumulator ^= Round(0, value);
+		return accumulator * PRIME1 + PRIME4;
+	}
+}
+
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+{
+	using namespace Hash;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	const uint8_t* const end = bytes + size;
+	uint64_t hash;
+
+	if(size >= 32)
+	{
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		const uint8_t* const limit = end - 32;
+		do
+		{
+			v1 = Round(v1, Read64(bytes));
+			v2 = Round(v2, Read64(bytes + 8));
+			v3 = Round(v3, Read64(bytes + 16));
+			v4 = Round(v4, Read64(bytes + 24));
+			bytes += 32;
+		} while(bytes <= limit);
+
+		hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) + RotateLeft(v4, 18);
+		hash = MergeRound(hash, v1);
+		hash = MergeRound(hash, v2);
+		hash = MergeRound(hash, v3);
+		hash = MergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + PRIME5;
+	}
+
+	hash += static_cast<uint64_t>(size);
+
+	while(bytes + 8 <= end)
+	{
+		hash ^= Round(0, Read64(bytes));
+		hash = RotateLeft(hash, 27) * PRIME1 + PRIME4;
+		bytes += 8;
+	}
+	if(bytes + 4 <= end)
+	{
+		hash ^= static_cast<uint64_t>(Read32(bytes)) * PRIME1;
+		hash = RotateLeft(hash, 23) * PRIME2 + PRIME3;
+		bytes += 4;
+	}
+	while(bytes < end)
+	{
+		hash ^= (*bytes) * PRIME5;
+		hash = RotateLeft(hash, 11) * PRIME1;
+		bytes++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME2;
+	hash ^= hash >> 29;
+	hash *= PRIME3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+inline uint64_t HashString(const std::string& text, uint64_t seed = 0)
+{
+	return HashBytes(text.data(), text.size(), seed);
+}
+
+// order dependent combination, for keys built from several hashes
+inline uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+	return Hash::MergeRound(seed ^ Hash::PRIME5, value);
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+enum JsonType
+{
+	JSON_NULL,
+	JSON_BOOL,
+	JSON_NUMBER,
+	JSON_STRING,
+	JSON_ARRAY,
+	JSON_OBJECT,
+};
+
+/*
+* Minimal JSON document, enough for asset descriptions like glTF. Lookups never fail: a missing
+* member or element is a null value, so optional fields read as their default:
+*   json["accessors"][2]["count"].GetUint(0)
+*/
+class JsonValue
+{
+public:
+	JsonType GetType() const { return m_type; }
+	bool IsNull() const { return m_type == JSON_NULL; }
+	bool IsNumber() const { return m_type == JSON_NUMBER; }
+	bool IsString() const { return m_type == JSON_STRING; }
+	bool IsArray() const { return m_type == JSON_ARRAY; }
+	bool IsObject() const { return m_type == JSON_OBJECT; }
+
+	bool GetBool(bool fallback) const { return m_type == JSON_BOOL ? m_bool : fallback; }
+	double GetNumber(double fallback) const { return m_type == JSON_NUMBER ? m_number : fallback; }
+	int64_t GetInt(int64_t fallback) const { return m_type == JSON_NUMBER ? static_cast<int64_t>(m_number) : fallback; }
+	uint32_t GetUint(uint32_t fallback) const { return m_type == JSON_NUMBER && m_number >= 0.0 ? static_cast<uint32_t>(m_number) : fallback; }
+	const std::string& GetString() const { return m_string; }
+
+	// elements of an array, members of an object, 0 for anything else
+	size_t GetSize() const { return m_type == JSON_ARRAY ? m_elements.size() : m_type == JSON_OBJECT ? m_members.size() : 0; }
+	// any integer type, a plain size_t overload would make a literal 0 ambiguous with the key one
+	template<typename Index, typename = typename std::enable_if<std::is_integral<Index>::value>::type>
+	const JsonValue& operator[](Index index) const
+	{
+		return m_type == JSON_ARRAY && index >= 0 && static_cast<size_t>(index) < m_elements.size() ? m_elements[static_cast<size_t>(index)] : GetNull();
+	}
+	const JsonValue& operator[](const char* key) const;
+	bool HasMember(const char* key) const { return !(*this)[key].IsNull(); }
+	const std::vector<std::pair<std::string, JsonValue>>& GetMembers() const { return m_members; }
+
+	// the whole text has to be one value, surrounding whitespace aside
+	static bool Parse(const char* text, size_t size, JsonValue& value);
+
+private:
+	static const JsonValue& GetNull()
+	{
+		static const JsonValue null;
+		return null;
+	}
+
+	static const char* SkipWhitespace(const char* p, const char* end);
+	static const char* ParseValue(const char* p, const char* end, JsonValue& value, int depth);
+	static const char* ParseString(const char* p, const char* end, std::string& string);
+
+	JsonType m_type = JSON_NULL;
+	bool m_bool = false;
+	double m_number = 0.0;
+	std::string m_string;
+	std::vector<JsonValue> m_elements;
+	std::vector<std::pair<std::string, JsonValue>> m_members;
+};
+
+inline const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if(m_type != JSON_OBJECT)
+		return GetNull();
+	for(const std::pair<std::string, JsonValue>& member : m_members)
+	{
+		if(member.first == key)
+			return member.second;
+	}
+	return GetNull();
+}
+
+inline const char* JsonValue::SkipWhitespace(const char* p, const char* end)
+{
+	while(p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+		p++;
+	return p;
+}
+
+// p is just past the opening quote, returns past the closing one, nullptr when malformed
+inline const char* JsonValue::ParseString(const char* p, const char* end, std::string& string)
+{
+	string.clear();
+	while(p < end && *p != '"')
+	{
+		if(*p != '\\')
+		{
+			string += *p++;
+			continue;
+		}
+		if(++p >= end)
+			return nullptr;
+		const char escape = *p++;
+		switch(escape)
+		{
+		case '"': string += '"'; break;
+		case '\\': string += '\\'; break;
+		case '/': string += '/'; break;
+		case 'b': string += '\b'; break;
+		case 'f': string += '\f'; break;
+		case 'n': string += '\n'; break;
+		case 'r': string += '\r'; break;
+		case 't': string += '\t'; break;
+		case 'u':
+		{
+			if(end - p < 4)
+				return nullptr;
+			const std::string hex(p, p + 4);
+			uint32_t codePoint = static_cast<uint32_t>(std::strtoul(hex.c_str(), nullptr, 16));
+			p += 4;
+			// a surrogate pair is one code point
+			if(codePoint >= 0xD800 && codePoint < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+			{
+				const std::string low(p + 2, p + 6);
+				codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (static_cast<uint32_t>(std::strtoul(low.c_str(), nullptr, 16)) - 0xDC00);
+				p += 6;
+			}
+			// utf-8
+			if(codePoint < 0x80)
+			{
+				string += static_cast<char>(codePoint);
+			}
+			else if(codePoint < 0x800)
+			{
+				string += static_cast<char>(0xC0 | (codePoint >> 6));
+				string += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else if(codePoint < 0x10000)
+			{
+				string += static_cast<char>(0xE0 | (codePoint >> 12));
+				string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				string += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			else
+			{
+				string += static_cast<char>(0xF0 | (codePoint >> 18));
+				string += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+				string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+				string += static_cast<char>(0x80 | (codePoint & 0x3F));
+			}
+			break;
+		}
+		default:
+			return nullptr;
+		}
+	}
+	return p < end ? p + 1 : nullptr;
+}
+
+inline const char* JsonValue::ParseValue(const char* p, const char* end, JsonValue& value, int depth)
+{
+	// deeper than any real document, stops a malicious one from overflowing the stack
+	constexpr int MAX_DEPTH = 128;
+	p = SkipWhitespace(p, end);
+	if(p >= end || depth > MAX_DEPTH)
+		return nullptr;
+
+	if(*p == '{')
+	{
+		value.m_type = JSON_OBJECT;
+		p = SkipWhitespace(p + 1, end);
+		if(p < end && *p == '}')
+			return p + 1;
+		while(p < end)
+		{
+			if(*p != '"')
+				return nullptr;
+			value.m_members.emplace_back();
+			p = ParseString(p + 1, end, value.m_members.back().first);
+			p = p ? SkipWhitespace(p, end) : nullptr;
+			if(!p || p >= end || *p != ':')
+				return nullptr;
+			p = ParseValue(p + 1, end, value.m_members.back().second, depth + 1);
+			p = p ? SkipWhitespace(p, end) : nullptr;
+			if(!p || p >= end)
+				return nullptr;
+			if(*p == '}')
+				return p + 1;
+			if(*p != ',')
+				return nullptr;
+			p = SkipWhitespace(p + 1, end);
+		}
+		return nullptr;
+	}
+	if(*p == '[')
+	{
+		value.m_type = JSON_ARRAY;
+		p = SkipWhitespace(p + 1, end);
+		if(p < end && *p == ']')
+			return p + 1;
+		while(p < end)
+		{
+			value.m_elements.emplace_back();
+			p = ParseValue(p, end, value.m_elements.back(), depth + 1);
+			p = p ? SkipWhitespace(p, end) : nullptr;
+			if(!p || p >= end)
+				return nullptr;
+			if(*p == ']')
+				return p + 1;
+			if(*p != ',')
+				return nullptr;
+			p++;
+		}
+		return nullptr;
+	}
+	if(*p == '"')
+	{
+		value.m_type = JSON_STRING;
+		return ParseString(p + 1, end, value.m_string);
+	}
+	if(end - p >= 4 && std::strncmp(p, "true", 4) == 0)
+	{
+		value.m_type = JSON_BOOL;
+		value.m_bool = true;
+		return p + 4;
+	}
+	if(end - p >= 5 && std::strncmp(p, "false", 5) == 0)
+	{
+		value.m_type = JSON_BOOL;
+		return p + 5;
+	}
+	if(end - p >= 4 && std::strncmp(p, "null", 4) == 0)
+		return p + 4;
+
+	// strtod needs a terminated string, numbers are short
+	const char* numberEnd = p;
+	while(numberEnd < end && *numberEnd != '\0' && std::strchr("+-0123456789.eE", *numberEnd))
+		numberEnd++;
+	if(numberEnd == p)
+		return nullptr;
+	const std::string number(p, numberEnd);
+	value.m_type = JSON_NUMBER;
+	value.m_number = std::strtod(number.c_str(), nullptr);
+	return numberEnd;
+}
+
+inline bool JsonValue::Parse(const char* text, size_t size, JsonValue& value)
+{
+	value = JsonValue();
+	const char* end = text + size;
+	const char* p = ParseValue(text, end, value, 0);
+	return p && SkipWhitespace(p, end) == end;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+* LZ4 block format (no frame, no checksums), compatible with LZ4_compress_default and
+* LZ4_decompress_safe. The compressor is the plain greedy single hash table one: compression speed
+* matters little since archives are built offline, decompression runs at memory speed either way.
+*/
+namespace Lz4
+{
+	constexpr size_t MIN_MATCH = 4;
+	// the format ends every block with at least this many literals
+	constexpr size_t LAST_LITERALS = 5;
+	// no match may start closer than this to the end of the input
+	constexpr size_t MATCH_FIND_LIMIT = 12;
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr uint32_t HASH_BITS = 16;
+
+	inline uint32_t Read32(const uint8_t* p)
+	{
+		uint32_t value;
+		std::memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	inline uint32_t HashSequence(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	// lengths of 15 and above continue in bytes of 255 and a final smaller one
+	inline void WriteLength(std::vector<uint8_t>& output, size_t length)
+	{
+		for(; length >= 255; length -= 255)
+			output.push_back(255);
+		output.push_back(static_cast<uint8_t>(length));
+	}
+
+	inline void WriteSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+	{
+		const size_t matchCode = matchLength - MIN_MATCH;
+		const uint8_t token = static_cast<uint8_t>(((literalCount < 15 ? literalCount : 15) << 4) | (matchLength == 0 ? 0 : matchCode < 15 ? matchCode : 15));
+		output.push_back(token);
+		if(literalCount >= 15)
+			WriteLength(output, literalCount - 15);
+		output.insert(output.end(), literals, literals + literalCount);
+		if(matchLength == 0)
+			return;
+		output.push_back(static_cast<uint8_t>(offset & 0xFF));
+		output.push_back(static_cast<uint8_t>(offset >> 8));
+		if(matchCode >= 15)
+			WriteLength(output, matchCode - 15);
+	}
+
+	// reads a length continuation, false when it runs past the end
+	inline bool ReadLength(const uint8_t*& p, const uint8_t* end, size_t& length)
+	{
+		uint8_t byte;
+		do
+		{
+			if(p >= end)
+				return false;
+			byte = *p++;
+			length += byte;
+		} while(byte == 255);
+		return true;
+	}
+}
+
+// never fails, incompressible input comes out slightly larger than it went in
+inline std::vector<uint8_t> Lz4Compress(const uint8_t* input, size_t size)
+{
+	using namespace Lz4;
+	std::vector<uint8_t> output;
+	output.reserve(size + size / 255 + 16);
+
+	size_t anchor = 0;
+	if(size > MATCH_FIND_LIMIT)
+	{
+		// positions + 1, 0 is empty
+		std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+		const size_t matchEndLimit = size - LAST_LITERALS;
+		size_t position = 0;
+		// the step grows while nothing matches, incompressible data is skipped through quickly
+		size_t misses = 0;
+		while(position + MATCH_FIND_LIMIT <= size)
+		{
+			const uint32_t sequence = Read32(input + position);
+			uint32_t& slot = table[HashSequence(sequence)];
+			const size_t candidate = slot;
+			slot = static_cast<uint32_t>(position + 1);
+			if(candidate == 0 || position - (candidate - 1) > MAX_OFFSET || Read32(input + candidate - 1) != sequence)
+			{
+				position += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			const size_t match = candidate - 1;
+			size_t length = MIN_MATCH;
+			while(position + length < matchEndLimit && input[match + length] == input[position + length])
+				length++;
+			WriteSequence(output, input + anchor, position - anchor, position - match, length);
+			position += length;
+			anchor = position;
+		}
+	}
+	WriteSequence(output, input + anchor, size - anchor, 0, 0);
+	return output;
+}
+
+// output has to be exactly as large as the original data, false for anything malformed
+inline bool Lz4Decompress(const uint8_t* input, size_t inputSize, uint8_t* output, size_t outputSize)
+{
+	using namespace Lz4;
+	const uint8_t* p = input;
+	const uint8_t* const end = input + inputSize;
+	uint8_t* out = output;
+	uint8_t* const outEnd = output + outputSize;
+	while(p < end)
+	{
+		const uint8_t token = *p++;
+		size_t literalCount = token >> 4;
+		if(literalCount == 15 && !ReadLength(p, end, literalCount))
+			return false;
+		if(literalCount > static_cast<size_t>(end - p) || literalCount > static_cast<size_t>(outEnd - out))
+			return false;
+		std::memcpy(out, p, literalCount);
+		p += literalCount;
+		out += literalCount;
+		// the last sequence has no match
+		if(p == end)
+			break;
+
+		if(end - p < 2)
+			return false;
+		const size_t offset = p[0] | (p[1] << 8);
+		p += 2;
+		size_t length = token & 15;
+		if(length == 15 && !ReadLength(p, end, length))
+			return false;
+		length += MIN_MATCH;
+		if(offset == 0 || offset > static_cast<size_t>(out - output) || length > static_cast<size_t>(outEnd - out))
+			return false;
+		// overlapping copies repeat the last offset bytes, which a byte at a time copy does by itself
+		const uint8_t* match = out - offset;
+		if(offset >= length)
+		{
+			std::memcpy(out, match, length);
+			out += length;
+		}
+		else
+		{
+			for(size_t i = 0; i < length; i++)
+				*out++ = *match++;
+		}
+	}
+	return out == outEnd;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/*
+* Unbounded lock-free queue with any number of producers and a single consumer (D. Vyukov's
+* node based MPSC queue). Push is one atomic exchange, so producers never wait on each other or
+* on the consumer. Pop must only ever be called from one thread.
+*/
+template<typename T>
+class MpscQueue
+{
+public:
+	MpscQueue();
+	~MpscQueue();
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	void Push(T value);
+	// returns false when empty, or when a producer is halfway through a push
+	bool Pop(T& value);
+
+private:
+	struct Node
+	{
+		std::atomic<Node*> m_next{nullptr};
+		T m_value;
+	};
+
+	// producers append at the head, the consumer takes from the tail, which always points at an already consumed node
+	std::atomic<Node*> m_head;
+	Node* m_tail;
+};
+
+template<typename T>
+inline MpscQueue<T>::MpscQueue()
+{
+	Node* stub = new Node();
+	m_head.store(stub, std::memory_order_relaxed);
+	m_tail = stub;
+}
+
+template<typename T>
+inline MpscQueue<T>::~MpscQueue()
+{
+	T value;
+	while(Pop(value))
+	{
+	}
+	delete m_tail;
+}
+
+template<typename T>
+inline void MpscQueue<T>::Push(T value)
+{
+	Node* node = new Node();
+	node->m_value = std::move(value);
+	Node* previous = m_head.exchange(node, std::memory_order_acq_rel);
+	previous->m_next.store(node, std::memory_order_release);
+}
+
+template<typename T>
+inline bool MpscQueue<T>::Pop(T& value)
+{
+	Node* tail = m_tail;
+	Node* next = tail->m_next.load(std::memory_order_acquire);
+	if(!next)
+		return false;
+
+	value = std::move(next->m_value);
+	next->m_value = T();
+	m_tail = next;
+	delete tail;
+	return true;
+}
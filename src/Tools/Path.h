@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cctype>
+#include <string>
+#include <vector>
+
+/*
+* Lexical path normalization: forward slashes, no empty or "." segments, ".." folded into its parent.
+* Different spellings of the same file ("Assets/./a.png", "Assets\\b/../a.png") map to one string,
+* so it can be used as a lookup key. Doesn't touch the file system, symlinks are not resolved.
+*/
+inline std::string NormalizePath(const std::string& path)
+{
+	const bool isAbsolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+	std::vector<std::string> segments;
+	std::string segment;
+	for(size_t i = 0; i <= path.size(); i++)
+	{
+		const char c = i < path.size() ? path[i] : '/';
+		if(c != '/' && c != '\\')
+		{
+			segment += c;
+			continue;
+		}
+
+		if(segment == "..")
+		{
+			if(!segments.empty() && segments.back() != "..")
+				segments.pop_back();
+			else if(!isAbsolute)
+				segments.push_back(segment);
+		}
+		else if(!segment.empty() && segment != ".")
+		{
+			segments.push_back(segment);
+		}
+		segment.clear();
+	}
+
+	std::string normalized = isAbsolute ? "/" : "";
+	for(size_t i = 0; i < segments.size(); i++)
+	{
+		if(i > 0)
+			normalized += '/';
+		normalized += segments[i];
+	}
+	return normalized;
+}
+
+// true when path ends with extension (e.g. ".obj"), ignoring ascii case
+inline bool HasExtension(const std::string& path, const std::string& extension)
+{
+	if(path.size() < extension.size())
+		return false;
+	const size_t offset = path.size() - extension.size();
+	for(size_t i = 0; i < extension.size(); i++)
+	{
+		if(std::tolower(static_cast<unsigned char>(path[offset + i])) != std::tolower(static_cast<unsigned char>(extension[i])))
+			return false;
+	}
+	return true;
+}
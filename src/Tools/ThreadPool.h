@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../Profiling/CpuProfiler.h"
+
+/*
+* Fixed set of worker threads running queued jobs, for cpu work that must not stall the frame
+* (asset import, decoding, cooking). Jobs must not touch GL, hand GL work to the UploadQueue.
+*/
+class ThreadPool
+{
+public:
+	// 0 uses one thread per core, minus the main thread
+	explicit ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool() { Shutdown(); }
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void Enqueue(std::function<void()> job);
+
+	template<typename F>
+	auto Submit(F&& function) -> std::future<decltype(function())>;
+
+	// runs one queued job on the calling thread, false when there was none
+	bool RunPendingJob();
+	// waits for a job's result. A worker runs other queued jobs meanwhile, so jobs waiting on jobs
+	// can't deadlock even when every worker is busy waiting. Any other thread (the frame's) just
+	// blocks, a queued job it picked up could take far longer than the one it waits for
+	template<typename T>
+	T Wait(std::future<T>& future);
+	// runs function(begin, end) over ranges covering [0, count) on the workers and the calling
+	// thread, returns once all of them are done. The caller only ever runs ranges of its own
+	template<typename F>
+	void ParallelFor(uint32_t count, F function);
+
+	// finishes the queued jobs and joins the workers, later jobs run on the calling thread
+	void Shutdown();
+
+	unsigned int GetThreadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+
+private:
+	void WorkerLoop(unsigned int index);
+	// set on the threads running WorkerLoop
+	static bool& IsWorkerThread()
+	{
+		thread_local bool isWorker = false;
+		return isWorker;
+	}
+
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_isStopping = false;
+};
+
+inline ThreadPool& GetThreadPool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+inline ThreadPool::ThreadPool(unsigned int threadCount)
+{
+	if(threadCount == 0)
+	{
+		const unsigned int cores = std::thread::hardware_concurrency();
+		threadCount = cores > 1 ? cores - 1 : 1;
+	}
+	m_threads.reserve(threadCount);
+	for(unsigned int i = 0; i < threadCount; i++)
+		m_threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+inline void ThreadPool::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!m_isStopping)
+		{
+			m_jobs.push_back(std::move(job));
+			m_condition.notify_one();
+			return;
+		}
+	}
+	job();
+}
+
+template<typename F>
+inline auto ThreadPool::Submit(F&& function) -> std::future<decltype(function())>
+{
+	using Result = decltype(function());
+	// std::function needs a copyable callable, packaged_task isn't
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+	std::future<Result> future = task->get_future();
+	Enqueue([task]() { (*task)(); });
+	return future;
+}
+
+inline bool ThreadPool::RunPendingJob()
+{
+	std::function<void()> job;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_jobs.empty())
+			return false;
+		job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+	}
+	job();
+	return true;
+}
+
+template<typename T>
+inline T ThreadPool::Wait(std::future<T>& future)
+{
+	while(future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		// nothing left to help with means the job is already running somewhere else
+		if(!IsWorkerThread() || !RunPendingJob())
+		{
+			future.wait();
+			break;
+		}
+	}
+	return future.get();
+}
+
+template<typename F>
+inline void ThreadPool::ParallelFor(uint32_t count, F function)
+{
+	if(count == 0)
+		return;
+	// a few ranges per worker keeps them all busy when some ranges are cheaper than others
+	const uint32_t rangeCount = std::min(count, std::max(1u, GetThreadCount() * 4));
+	const uint32_t rangeSize = (count + rangeCount - 1) / rangeCount;
+	// the caller and the helper jobs claim ranges from one counter until none are left. A helper
+	// that only starts after that claims nothing, so it never touches function once this returned
+	struct Ranges
+	{
+		std::atomic<uint32_t> m_next{0};
+		uint32_t m_doneCount = 0;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+	};
+	std::shared_ptr<Ranges> ranges = std::make_shared<Ranges>();
+	F* body = &function;
+	auto runRanges = [ranges, body, rangeCount, rangeSize, count]() {
+		uint32_t doneCount = 0;
+		for(uint32_t range = ranges->m_next++; range < rangeCount; range = ranges->m_next++, doneCount++)
+			(*body)(range * rangeSize, std::min((range + 1) * rangeSize, count));
+		if(doneCount == 0)
+			return;
+		std::lock_guard<std::mutex> lock(ranges->m_mutex);
+		ranges->m_doneCount += doneCount;
+		if(ranges->m_doneCount == rangeCount)
+			ranges->m_condition.notify_all();
+	};
+	const uint32_t helperCount = std::min(GetThreadCount(), rangeCount - 1);
+	for(uint32_t i = 0; i < helperCount; i++)
+		Enqueue(runRanges);
+	runRanges();
+	// whatever is left is running on a worker right now
+	std::unique_lock<std::mutex> lock(ranges->m_mutex);
+	ranges->m_condition.wait(lock, [&ranges, rangeCount]() { return ranges->m_doneCount == rangeCount; });
+}
+
+inline void ThreadPool::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_isStopping)
+			return;
+		m_isStopping = true;
+	}
+	m_condition.notify_all();
+	for(std::thread& thread : m_threads)
+		thread.join();
+	m_threads.clear();
+}
+
+inline void ThreadPool::WorkerLoop(unsigned int index)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "Worker %u", index);
+	CpuProfiler::SetThreadName(name);
+	IsWorkerThread() = true;
+
+	while(true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+			if(m_jobs.empty())
+				return;
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		job();
+	}
+}
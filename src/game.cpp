@@ -1,15 +1,25 @@
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <type_traits>
 
 #include "Common.h"
 #include "Shader.h"
 #include "STB/stb_image.h"
+#include "Tools/DebugOverlay.h"
+#include "Tools/FixedTimestep.h"
 #include "Tools/GlCheckError.h"
+#include "Tools/GlExtensions.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -17,35 +27,98 @@
 
 #include "Camera/FPSCamera.h"
 #include "Camera/FreeFlyCamera.h"
+#include "Camera/InputRecording.h"
+#include "Camera/ScriptedCamera.h"
 
 #include "Model/Model.h"
+#include "Platform/HeadlessContext.h"
+#include "Platform/PackArchive.h"
+#include "Platform/VirtualFileSystem.h"
+#include "Profiling/BenchmarkReport.h"
+#include "Profiling/CpuProfiler.h"
+#include "Profiling/FrameStats.h"
+#include "Profiling/GpuProfiler.h"
+#include "Profiling/ImportBenchmark.h"
+#include "Profiling/MemoryOverlay.h"
+#include "Profiling/MemoryStats.h"
+#include "Profiling/RenderStats.h"
+#include "Profiling/StartupBenchmark.h"
+#include "Profiling/StartupTimer.h"
+#include "Render/RenderTarget.h"
+#include "Render/ShaderVariants.h"
+#include "Render/UploadQueue.h"
+#include "Scene/Scene.h"
+#include "Scene/SceneRenderer.h"
+#include "Scene/SceneSystems.h"
+#include "Texture/TextureCache.h"
 
 Camera* m_camera = nullptr;
+DebugOverlay m_overlay;
+InputRecorder m_inputRecorder;
+InputReplayer m_inputReplayer;
+bool m_isReplayingInput = false;
+bool m_isShaderReloadRequested = false;
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
 	glViewport(0, 0, width, height);
+	if(width > 0 && height > 0)
+	{
+		GetAppSettings().m_width = width;
+		GetAppSettings().m_height = height;
+	}
 }
 
 void processInput(GLFWwindow* window)
 {
+	PROFILE_ZONE("Input");
 	glfwSetWindowShouldClose(window, glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS);
-	m_camera->ProcessInput(window);
+	if(m_isReplayingInput)
+		return;
+
+	const uint32_t keyStates = m_camera->PollKeyStates(window);
+	m_inputRecorder.RecordKeyStates(keyStates);
+	m_camera->SetKeyStates(keyStates);
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
+	if(m_isReplayingInput)
+		return;
+
+	m_inputRecorder.RecordMouse(xpos, ypos);
 	m_camera->MouseCallback(xpos, ypos);
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+	if(action == GLFW_PRESS && key == GLFW_KEY_F1)
+	{
+		m_overlay.Toggle();
+		return;
+	}
+	if(action == GLFW_PRESS && key == GLFW_KEY_F2)
+	{
+		CpuProfiler::WriteChromeTrace("cpu_trace.json");
+		return;
+	}
+	if(action == GLFW_PRESS && key == GLFW_KEY_F5)
+	{
+		m_isShaderReloadRequested = true;
+		return;
+	}
+
+	if(m_isReplayingInput)
+		return;
+
 	if(action == GLFW_PRESS)
 	{
+		m_inputRecorder.RecordKeyDown(key);
 		m_camera->KeyDown(key);
 	}
 	if(action == GLFW_RELEASE)
 	{
+		m_inputRecorder.RecordKeyUp(key);
 		m_camera->KeyUp(key);
 	}
 }
@@ -62,6 +135,7 @@ GLFWwindow* WindowSetup()
 	SetWindowPos(GetConsoleWindow(), HWND_TOP, 0, 0, 700, 1000, 0);
 #endif
 
+	GetStartupTimer().BeginPhase("context");
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -69,7 +143,8 @@ GLFWwindow* WindowSetup()
 	glfwWindowHint(GLFW_POSITION_X, 700);
 	glfwWindowHint(GLFW_POSITION_Y, 100);
 
-	GLFWwindow* window = glfwCreateWindow(SCRWIDTH, SCRHEIGHT, "LearnOpenGL", NULL, NULL);
+	const AppSettings& settings = GetAppSettings();
+	GLFWwindow* window = glfwCreateWindow(settings.m_width, settings.m_height, "LearnOpenGL", NULL, NULL);
 	if(window == NULL)
 	{
 		std::cout << "Failed to create GLFW window" << std::endl;
@@ -85,17 +160,19 @@ GLFWwindow* WindowSetup()
 	*/
 	glfwSetWindowPos(window, 0, 50);
 	glfwShowWindow(window);
-	glfwSetWindowSize(window, SCRWIDTH, SCRHEIGHT);
+	glfwSetWindowSize(window, settings.m_width, settings.m_height);
 	glfwSetWindowPos(window, 0, 50);
 #endif // defined(__linux__) && !defined(FULLSCREEN)
 
+	GetStartupTimer().BeginPhase("glad");
 	if(!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
 	{
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return nullptr;
 	}
+	LoadGlExtensions((GLADloadproc)glfwGetProcAddress);
 
-	glViewport(0, 0, SCRWIDTH, SCRHEIGHT);
+	glViewport(0, 0, settings.m_width, settings.m_height);
 
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
@@ -112,7 +189,7 @@ GLFWwindow* WindowSetup()
 	return window;
 }
 
-void MakeContainer(Shader& shader, unsigned int* vao, unsigned int* vbo, unsigned int* texture0, unsigned int* texture1)
+void MakeContainer(unsigned int* vao, unsigned int* vbo, TextureHandle* texture0, TextureHandle* texture1)
 {
 	//----------objects initialization
 	//-----points
@@ -171,61 +248,30 @@ void MakeContainer(Shader& shader, unsigned int* vao, unsigned int* vbo, unsigne
 	};
 	//=====points
 
-	unsigned int containerTexture;
-	glGenTextures(1, &containerTexture);
-	*texture0 = containerTexture;
-
-	unsigned int awesomefaceTexture;
-	glGenTextures(1, &awesomefaceTexture);
-	*texture1 = awesomefaceTexture;
-	//=====
-
-	//-----
-	glBindTexture(GL_TEXTURE_2D, containerTexture);
-	float borderColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	int width, height, nrChannels;
-
-	unsigned char* containerTextureData = stbi_load("Assets/container.jpg", &width, &height, &nrChannels, 0);
-	if(!containerTextureData)
+	// cooked with their mip chains like the model textures, nothing is generated here
+	*texture0 = GetTextureCache().Load("Assets/container.jpg", TEXTURE_USAGE_COLOR);
+	*texture1 = GetTextureCache().Load("Assets/awesomeface.png", TEXTURE_USAGE_COLOR);
+	if(texture0->GetId() == 0 || texture1->GetId() == 0)
 	{
-		std::cout << "ERROR::STBI::LOAD Failed to load texture: Assets/container.jpg" << std::endl;
+		std::cout << "ERROR::CONTAINER::TEXTURE_LOAD_FAILED" << std::endl;
 	}
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, containerTextureData);
-	glCheckError();
-	glGenerateMipmap(GL_TEXTURE_2D);
 	//=====
 
 	//-----
-	glBindTexture(GL_TEXTURE_2D, awesomefaceTexture);
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	unsigned char* awesomefaceTextureData = stbi_load("Assets/awesomeface.png", &width, &height, &nrChannels, 0);
-	if(!awesomefaceTextureData)
+	float borderColor[] = {1.0f, 1.0f, 0.0f, 1.0f};
+	for(const TextureHandle* texture : {texture0, texture1})
 	{
-		std::cout << "ERROR::STBI::LOAD Failed to load texture: Assets/awesomeface.png" << std::endl;
+		glBindTexture(GL_TEXTURE_2D, texture->GetId());
+		glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	}
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, awesomefaceTextureData);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	//=====
-
-	//-----
-	shader.Use();
-	shader.SetInt("uTexture0", 0);
-	shader.SetInt("uTexture1", 1);
+	glCheckError();
 	//=====
 
 	glBindTexture(GL_TEXTURE_2D, 0);
-	stbi_image_free(containerTextureData);
 
 	//-----Initialization
 	unsigned int VAO;
@@ -257,24 +303,262 @@ void MakeContainer(Shader& shader, unsigned int* vao, unsigned int* vbo, unsigne
 	//==========objects initialization
 }
 
+// the containers on a grid and the backpacks in a row along -x behind the first one, returns the backpacks' drawable
+uint32_t MakeScene(Scene& scene, SceneRenderer& renderer, ShaderVariants& containerShaders, unsigned int containerVao, const TextureHandle& texture0,
+				   const TextureHandle& texture1, ShaderVariants& modelShaders, const std::shared_ptr<Model>& backpack)
+{
+	const AppSettings& settings = GetAppSettings();
+
+	Drawable container;
+	container.m_name = "Container";
+	container.m_shaders = &containerShaders;
+	container.m_permutation = FEATURE_TEXTURE_MIX;
+	container.m_vertexArray = containerVao;
+	container.m_vertexCount = 36;
+	container.m_textures = {texture0, texture1};
+	const uint32_t containerDrawable = renderer.AddDrawable(container);
+	// half the diagonal of the unit cube
+	const BoundingSphere containerBounds = {glm::vec3(0.0f), 0.87f};
+	const int gridSize = settings.m_containerGridSize;
+	const int gridHalf = gridSize / 2;
+	for(int i = -gridHalf; i < gridSize - gridHalf; i++)
+	{
+		for(int j = -gridHalf; j < gridSize - gridHalf; j++)
+		{
+			const Entity entity = scene.CreateEntity();
+			scene.AddTransform(entity, glm::vec3(j, 0, i));
+			scene.AddRenderable(entity, containerDrawable, containerBounds);
+		}
+	}
+
+	Drawable model;
+	model.m_name = "Backpack";
+	model.m_shaders = &modelShaders;
+	model.m_model = backpack;
+	const uint32_t backpackDrawable = renderer.AddDrawable(model);
+	for(int i = 0; i < settings.m_backpackCount; i++)
+	{
+		const Entity entity = scene.CreateEntity();
+		scene.AddTransform(entity, glm::vec3(-2 - 2 * i, 2, -2), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.5f));
+		// no size until the model loaded, see Scene::SetDrawableBounds
+		scene.AddRenderable(entity, backpackDrawable, BoundingSphere());
+	}
+	return backpackDrawable;
+}
+
+bool HeadlessSetup(HeadlessContext& context)
+{
+	GetStartupTimer().BeginPhase("context");
+	if(!context.Create(3, 3))
+		return false;
+
+	GetStartupTimer().BeginPhase("glad");
+	if(!gladLoadGLLoader(HeadlessContext::GetLoader()))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return false;
+	}
+	LoadGlExtensions(HeadlessContext::GetLoader());
+
+	printf("OpenGL version: %s\n", glGetString(GL_VERSION));
+	printf("OpenGL renderer: %s\n", glGetString(GL_RENDERER));
+	return true;
+}
+
+// a numeric flag's value, at least minimum (more than it when isMinimumExclusive). Anything else,
+// text that isn't a number included, is reported and leaves value as it was
+template<typename T>
+void ParseNumber(const char* flag, const char* text, T minimum, T& value, bool isMinimumExclusive = false)
+{
+	char* end = nullptr;
+	const double number = std::strtod(text, &end);
+	const bool isRepresentable =
+		number <= std::numeric_limits<T>::max() && (std::is_floating_point<T>::value || number == std::floor(number));
+	if(end == text || *end != '\0' || !std::isfinite(number) || !isRepresentable || number < minimum || (isMinimumExclusive && number == minimum))
+	{
+		std::cout << "ERROR::COMMAND_LINE::INVALID_VALUE " << flag << " " << text << std::endl;
+		return;
+	}
+	value = static_cast<T>(number);
+}
+
+void ParseCommandLine(int argc, char* argv[], AppSettings& settings)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		const char* flag = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if(std::strcmp(argv[i], "--headless") == 0)
+			settings.m_isHeadless = true;
+		else if(std::strcmp(argv[i], "--scripted-camera") == 0)
+			settings.m_useScriptedCamera = true;
+		else if(std::strcmp(argv[i], "--frames") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 1, settings.m_benchmarkFrames);
+		else if(std::strcmp(argv[i], "--sim-rate") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 1, settings.m_simulationRate);
+		else if(std::strcmp(argv[i], "--delta-time") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0f, settings.m_benchmarkDeltaTime);
+		else if(std::strcmp(argv[i], "--width") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 1, settings.m_width);
+		else if(std::strcmp(argv[i], "--height") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 1, settings.m_height);
+		else if(std::strcmp(argv[i], "--grid") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0, settings.m_containerGridSize);
+		else if(std::strcmp(argv[i], "--backpacks") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0, settings.m_backpackCount);
+		else if(std::strcmp(argv[i], "--import-bench") == 0 && hasValue)
+			settings.m_importBenchmarkPath = argv[++i];
+		else if(std::strcmp(argv[i], "--startup-bench") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 1, settings.m_startupBenchmarkRuns);
+		else if(std::strcmp(argv[i], "--startup-only") == 0)
+			settings.m_isStartupOnly = true;
+		else if(std::strcmp(argv[i], "--archive") == 0 && hasValue)
+			settings.m_archivePaths.push_back(argv[++i]);
+		else if(std::strcmp(argv[i], "--pack") == 0 && i + 2 < argc)
+		{
+			settings.m_packDirectory = argv[++i];
+			settings.m_packOutputPath = argv[++i];
+		}
+		else if(std::strcmp(argv[i], "--report") == 0 && hasValue)
+			settings.m_reportPath = argv[++i];
+		else if(std::strcmp(argv[i], "--startup-report") == 0 && hasValue)
+			settings.m_startupReportPath = argv[++i];
+		else if(std::strcmp(argv[i], "--gpu-csv") == 0 && hasValue)
+			settings.m_gpuCsvPath = argv[++i];
+		else if(std::strcmp(argv[i], "--cpu-trace") == 0 && hasValue)
+			settings.m_cpuTracePath = argv[++i];
+		else if(std::strcmp(argv[i], "--frame-stats") == 0 && hasValue)
+			settings.m_frameStatsPath = argv[++i];
+		else if(std::strcmp(argv[i], "--upload-budget") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0, settings.m_uploadBudgetMs);
+		else if(std::strcmp(argv[i], "--texture-budget") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0, settings.m_textureBudgetMb);
+		else if(std::strcmp(argv[i], "--gpu-budget") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0, settings.m_gpuMemoryBudgetMb);
+		else if(std::strcmp(argv[i], "--cpu-budget") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0, settings.m_cpuMemoryBudgetMb);
+		else if(std::strcmp(argv[i], "--no-texture-compression") == 0)
+			settings.m_compressTextures = false;
+		else if(std::strcmp(argv[i], "--mip-filter") == 0 && hasValue)
+			settings.m_useBoxMipFilter = std::strcmp(argv[++i], "box") == 0;
+		else if(std::strcmp(argv[i], "--hitch-factor") == 0 && hasValue)
+		{
+			// 1 or less would count every frame as a hitch
+			ParseNumber(flag, argv[++i], 1.0, settings.m_hitchFactor, true);
+		}
+		else if(std::strcmp(argv[i], "--record-input") == 0 && hasValue)
+			settings.m_inputRecordPath = argv[++i];
+		else if(std::strcmp(argv[i], "--replay-input") == 0 && hasValue)
+			settings.m_inputReplayPath = argv[++i];
+		else if(std::strcmp(argv[i], "--replay-delta-time") == 0 && hasValue)
+			ParseNumber(flag, argv[++i], 0.0f, settings.m_replayDeltaTime);
+		else
+			std::cout << "WARNING::COMMAND_LINE::UNKNOWN_ARGUMENT " << argv[i] << std::endl;
+	}
+	// a replayed recording drives the regular camera, otherwise headless runs follow the scripted path
+	if(settings.m_isHeadless && !settings.m_inputReplayPath)
+		settings.m_useScriptedCamera = true;
+}
+
 int main(int argc, char* argv[])
 {
+	StartupTimer& startupTimer = GetStartupTimer();
+	startupTimer.Begin();
+	startupTimer.BeginPhase("init");
 	printf("Hello world\n");
+	CpuProfiler::SetThreadName("Main");
+
+	AppSettings& settings = GetAppSettings();
+	ParseCommandLine(argc, argv, settings);
+	const bool isHeadless = settings.m_isHeadless;
 
-	GLFWwindow* window = WindowSetup();
-	if(window == nullptr) return -1;
+	// no window or context needed to pack, the loose files go in as they are
+	if(settings.m_packDirectory)
+		return PackDirectory(settings.m_packDirectory, settings.m_packOutputPath) ? 0 : -1;
+	// before anything loads, every loader reads through the file system
+	for(const char* archive : settings.m_archivePaths)
+		GetFileSystem().Mount(archive);
 
+	// no window or context needed, the importers don't touch GL
+	if(settings.m_importBenchmarkPath)
+	{
+		RunImportBenchmark(settings.m_importBenchmarkPath, settings.m_reportPath);
+		return 0;
+	}
+	// each run is a process of its own, this one only starts them
+	if(settings.m_startupBenchmarkRuns > 0)
+		return RunStartupBenchmark(argc, argv, settings.m_startupBenchmarkRuns, settings.m_reportPath) ? 0 : -1;
+
+	GLFWwindow* window = nullptr;
+	HeadlessContext headlessContext;
+	RenderTarget renderTarget;
+	if(isHeadless)
+	{
+		if(!HeadlessSetup(headlessContext)) return -1;
+		if(!renderTarget.Create(settings.m_width, settings.m_height)) return -1;
+		renderTarget.Bind();
+	}
+	else
+	{
+		window = WindowSetup();
+		if(window == nullptr) return -1;
+	}
+
+	startupTimer.BeginPhase("setup");
 	int nrAttributes;
 	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &nrAttributes);
 	std::cout << "Maximum nr of vertex attributes supported: " << nrAttributes << std::endl;
 
-	m_camera = new FPSCamera();
+	if(settings.m_useScriptedCamera)
+		m_camera = new ScriptedCamera();
+	else
+		m_camera = new FPSCamera();
+
+	if(settings.m_inputReplayPath)
+	{
+		if(!m_inputReplayer.Open(settings.m_inputReplayPath)) return -1;
+		m_inputReplayer.SetFixedDeltaTime(settings.m_replayDeltaTime);
+		m_isReplayingInput = true;
+	}
+	else if(settings.m_inputRecordPath)
+	{
+		m_inputRecorder.Open(settings.m_inputRecordPath);
+	}
+
+	if(!isHeadless)
+		m_overlay.Init();
+	GpuProfiler gpuProfiler;
+	gpuProfiler.Init();
+	if(settings.m_gpuCsvPath)
+		gpuProfiler.OpenCsvLog(settings.m_gpuCsvPath);
+	FrameStats frameStats;
+	if(settings.m_frameStatsPath)
+		frameStats.OpenLog(settings.m_frameStatsPath, 10.0);
+	frameStats.SetHitchFactor(settings.m_hitchFactor);
+	BenchmarkReport report;
 
 	stbi_set_flip_vertically_on_load(true);
 
-	unsigned int VAO, VBO, texture0, texture1;
-	Shader containerShader = Shader("src/Shaders/Vertex.vert", "src/Shaders/Fragment.frag");
-	MakeContainer(containerShader, &VAO, &VBO, &texture0, &texture1);
+	TextureCookSettings cookSettings;
+	cookSettings.m_isCompressionEnabled = settings.m_compressTextures;
+	cookSettings.m_mipFilter = settings.m_useBoxMipFilter ? MIP_FILTER_BOX : MIP_FILTER_KAISER;
+	GetTextureCache().SetCookSettings(cookSettings);
+	GetTextureCache().SetStreamingBudget(static_cast<size_t>(settings.m_textureBudgetMb * 1024.0 * 1024.0));
+	GetMemoryStats().SetGpuBudget(static_cast<size_t>(settings.m_gpuMemoryBudgetMb * 1024.0 * 1024.0));
+	GetMemoryStats().SetCpuBudget(static_cast<size_t>(settings.m_cpuMemoryBudgetMb * 1024.0 * 1024.0));
+
+	startupTimer.BeginPhase("shader_submit");
+	unsigned int VAO, VBO;
+	TextureHandle texture0, texture1;
+	// variants compile on first use, or load from their program binary
+	ShaderVariants containerShaders("src/Shaders/Vertex.vert", "src/Shaders/Fragment.frag");
+	ShaderVariants modelShaders("src/Shaders/Model.vert", "src/Shaders/Model.frag");
+	// submitted before the loading below, the driver compiles them meanwhile. The backpack's
+	// material only has diffuse maps
+	containerShaders.Prepare(FEATURE_TEXTURE_MIX);
+	modelShaders.Prepare(MATERIAL_DIFFUSE_MAP | FEATURE_INSTANCED);
+	startupTimer.BeginPhase("container");
+	MakeContainer(&VAO, &VBO, &texture0, &texture1);
 
 	//----------other options
 	// Wireframe
@@ -284,91 +568,232 @@ int main(int argc, char* argv[])
 	glEnable(GL_DEPTH_TEST);
 	//==========other options
 
-	Shader backpackShader = Shader("src/Shaders/Model.vert", "src/Shaders/Model.frag");
-	Model* backpack = new Model("Assets/Models/Backpack/backpack.obj");
+	std::shared_ptr<Model> backpack = Model::LoadAsync("Assets/Models/Backpack/backpack.obj");
+	if(isHeadless)
+	{
+		startupTimer.BeginPhase("wait_for_assets");
+		// benchmark frames have to draw the same scene every run, so don't start until it is loaded
+		PROFILE_ZONE("Wait For Assets");
+		while(!backpack->IsReady())
+		{
+			if(GetUploadQueue().Flush() == 0)
+				std::this_thread::yield();
+		}
+	}
+
+	Scene scene;
+	SceneRenderer sceneRenderer;
+	const uint32_t backpackDrawable = MakeScene(scene, sceneRenderer, containerShaders, VAO, texture0, texture1, modelShaders, backpack);
+	bool hasBackpackBounds = false;
+
+	// headless frames are never presented, so the cpu could queue up an unbounded amount of work,
+	// keep at most HEADLESS_FRAMES_IN_FLIGHT frames ahead of the gpu like a swap chain would
+	constexpr int HEADLESS_FRAMES_IN_FLIGHT = 2;
+	GLsync frameFences[HEADLESS_FRAMES_IN_FLIGHT] = {};
 
 	float deltaTime = 0;
+	FixedTimestep simulationClock(1.0 / settings.m_simulationRate);
+	CameraState previousCameraState = m_camera->GetState();
+	uint64_t lastGpuResultFrame = UINT64_MAX;
+	int frameIndex = 0;
 	constexpr glm::mat4 identity = glm::mat4(1.0f);
-	glm::mat4 model = identity;
 	glm::mat4 view = identity;
 	glm::mat4 projection = identity;
-	while(!glfwWindowShouldClose(window))
+	startupTimer.BeginPhase("first_frame");
+	// a replay ends the run when the recording runs out, headless or not
+	while((isHeadless ? frameIndex < settings.m_benchmarkFrames : !glfwWindowShouldClose(window))
+		  && !(m_isReplayingInput && m_inputReplayer.IsFinished()))
 	{
-		const double frameStartTime = glfwGetTime();
+		const uint64_t frameStartNs = CpuProfiler::NowNs();
+		PROFILE_ZONE("Frame");
+		frameStats.BeginFrame();
+		GetRenderStats().Reset();
 
-		processInput(window);
+		if(!isHeadless)
+			processInput(window);
 
 		//--View
 		view = identity;
-		m_camera->Update(deltaTime);
-		glm::vec3 cameraPos, cameraFront, cameraUp;
-		m_camera->GetCameraProperties(cameraPos, cameraFront, cameraUp);
-		view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
+		{
+			PROFILE_ZONE("Camera Update");
+			// a fixed step keeps the benchmark path identical between runs, whatever the frame rate
+			float frameDeltaTime = isHeadless ? settings.m_benchmarkDeltaTime : deltaTime;
+			if(m_isReplayingInput)
+				frameDeltaTime = m_inputReplayer.ReplayFrame(*m_camera);
+			else
+				m_inputRecorder.RecordFrame(frameDeltaTime);
+
+			// the camera only moves in fixed steps, several per frame when rendering falls behind
+			const int stepCount = simulationClock.Advance(frameDeltaTime);
+			for(int step = 0; step < stepCount; step++)
+			{
+				previousCameraState = m_camera->GetState();
+				m_camera->Update(simulationClock.GetStep());
+			}
+		}
+		const CameraState cameraState = InterpolateCameraState(previousCameraState, m_camera->GetState(), simulationClock.GetAlpha());
+		view = glm::lookAt(cameraState.m_pos, cameraState.m_pos + cameraState.m_front, cameraState.m_up);
 		//==View
 
 		//==Projection
 		projection = identity;
-		projection = glm::perspective(glm::radians(m_camera->GetFov()), 16.0f / 9.0f, 0.1f, 100.0f);
+		const float aspect = static_cast<float>(settings.m_width) / static_cast<float>(settings.m_height);
+		projection = glm::perspective(glm::radians(m_camera->GetFov()), aspect, 0.1f, 100.0f);
 		//--Projection
 
+		const StreamingView streamingView(cameraState.m_pos, cameraState.m_front, m_camera->GetFov(), settings.m_height);
+
+		GetUploadQueue().Process(settings.m_uploadBudgetMs);
+		GetTextureCache().Update();
+		// the backpack's size is only known once it loaded
+		if(!hasBackpackBounds && backpack->IsReady())
+		{
+			scene.SetDrawableBounds(backpackDrawable, BoundingSphere::FromBox(backpack->GetBoundsMin(), backpack->GetBoundsMax()));
+			hasBackpackBounds = true;
+		}
+		UpdateScene(scene);
+		if(m_isShaderReloadRequested)
+		{
+			m_isShaderReloadRequested = false;
+			std::cout << "shaders reloaded: " << containerShaders.ReloadChanged() + modelShaders.ReloadChanged() << " variants" << std::endl;
+		}
+
 		//----render
+		gpuProfiler.BeginFrame();
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//==Container
-		containerShader.Use();
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture0);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, texture1);
-
-		glBindVertexArray(VAO);
+		//==Scene
+		// every container and backpack, culled and drawn a drawable at a time
+		sceneRenderer.Render(scene, view, projection, streamingView, gpuProfiler);
+		//--Scene
 
-		containerShader.SetMat4("uView", view);
-		containerShader.SetMat4("uProjection", projection);
+		//==Overlay
+		if(!isHeadless)
+		{
+			PROFILE_ZONE("Draw Overlay");
+			GPU_SCOPE(gpuProfiler, "Overlay");
+			frameStats.DrawOverlay(m_overlay);
+			gpuProfiler.DrawOverlay(m_overlay);
+			DrawMemoryOverlay(GetMemoryStats(), m_overlay);
+			m_overlay.Render();
+		}
+		//--Overlay
 
+		gpuProfiler.EndFrame();
+		//====render
 
-		for(int i = -25; i < 25; i++)
+		if(isHeadless)
 		{
-			for(int j = -25; j < 25; j++)
+			PROFILE_ZONE("Throttle");
+			GLsync& fence = frameFences[frameIndex % HEADLESS_FRAMES_IN_FLIGHT];
+			if(fence)
 			{
-				model = identity;
-				model = glm::translate(model, glm::vec3(j, 0, i));
-				glDrawArrays(GL_TRIANGLES, 0, 36);
-				containerShader.SetMat4("uModel", model);
+				glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+				glDeleteSync(fence);
+			}
+			fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			glFlush();
+		}
+		else
+		{
+			// check and call events and swap the buffers
+			{
+				PROFILE_ZONE("SwapBuffers");
+				glfwSwapBuffers(window);
+			}
+			{
+				PROFILE_ZONE("PollEvents");
+				glfwPollEvents();
 			}
 		}
 
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
-		//==Container
-
-		//==Backpack
-		backpackShader.Use();
-		backpackShader.SetMat4("uView", view);
-		backpackShader.SetMat4("uProjection", projection);
-
-		model = identity;
-		model = glm::translate(model, glm::vec3(-2, 2, -2));
-		model = glm::scale(model, glm::vec3(0.5));
-		backpackShader.SetMat4("uModel", model);
-
-		backpack->Draw(backpackShader);
-		//--Backpack
-
-		//====render
+		// startup ends with the first frame that has the scene in it, which for an asynchronous load
+		// comes some frames after the first one
+		if(!startupTimer.HasMilestone("scene_ready"))
+		{
+			const bool isFirstFrame = frameIndex == 0;
+			const bool isSceneReady = backpack->IsReady();
+			if(isFirstFrame || isSceneReady)
+			{
+				// waits until the frame is actually done instead of just queued
+				glFinish();
+				if(isFirstFrame)
+				{
+					startupTimer.EndPhase();
+					startupTimer.MarkMilestone("first_frame");
+				}
+			}
+			if(isSceneReady)
+			{
+				startupTimer.MarkMilestone("scene_ready");
+				const Model::LoadTimes& loadTimes = backpack->GetLoadTimes();
+				startupTimer.AddSpan("backpack_import", loadTimes.m_importStartNs, loadTimes.m_importEndNs);
+				startupTimer.AddSpan("backpack_upload", loadTimes.m_uploadStartNs, loadTimes.m_uploadEndNs);
+				if(settings.m_startupReportPath)
+					startupTimer.Write(settings.m_startupReportPath);
+				if(settings.m_isStartupOnly)
+					break;
+			}
+		}
 
-		// check and call events and swap the buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		const uint64_t frameEndNs = CpuProfiler::NowNs();
+		deltaTime = static_cast<float>((frameEndNs - frameStartNs) * 1e-9);
+		const double frameMs = (frameEndNs - frameStartNs) * 1e-6;
+		frameStats.EndFrame(frameMs);
 
-		const double frameEndTime = glfwGetTime();
-		deltaTime = static_cast<float>(frameEndTime - frameStartTime);
+		report.AddFrame(frameMs, GetRenderStats());
+		if(gpuProfiler.GetResultFrameIndex() != lastGpuResultFrame)
+		{
+			lastGpuResultFrame = gpuProfiler.GetResultFrameIndex();
+			report.AddGpuFrame(gpuProfiler.GetFrameGpuMs());
+		}
+		frameIndex++;
 	}
 
+	for(GLsync fence : frameFences)
+	{
+		if(fence)
+			glDeleteSync(fence);
+	}
+	// the report always goes to stdout in headless mode, windowed runs only write it when asked to
+	if(isHeadless || settings.m_reportPath)
+		report.Write(settings, settings.m_reportPath);
+
+	// loads still in flight finish on the workers, their uploads run below
+	GetThreadPool().Shutdown();
+	m_inputRecorder.Close();
+	if(settings.m_cpuTracePath)
+		CpuProfiler::WriteChromeTrace(settings.m_cpuTracePath);
+	gpuProfiler.Delete();
+	if(!isHeadless)
+		m_overlay.Delete();
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
-	backpackShader.Delete();
-	containerShader.Delete();
-	glfwTerminate();
+	modelShaders.Delete();
+	containerShaders.Delete();
+	// textures nothing references anymore are freed while the context still exists
+	sceneRenderer.Clear();
+	backpack.reset();
+	texture0 = TextureHandle();
+	texture1 = TextureHandle();
+	// queued uploads, level loads in flight included, hold their model or texture until they ran,
+	// so repeat until nothing is queued anymore
+	do
+	{
+		GetTextureCache().Update(0);
+	} while(GetUploadQueue().Flush() > 0);
+	// workers are done and the loads uploaded, nothing writes into the staging buffers anymore
+	GetPixelBufferPool().Delete();
+	if(isHeadless)
+	{
+		renderTarget.Delete();
+		headlessContext.Destroy();
+	}
+	else
+	{
+		glfwTerminate();
+	}
+	// everything tracked was released above, what is left leaked
+	GetMemoryStats().ReportLeaks();
 	return 0;
 }